@@ -0,0 +1,67 @@
+#include "arena.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+void arena_init(Arena* a, size_t chunk_size) {
+    a->head = NULL;
+    a->chunk_size = chunk_size > 0 ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+    a->alloc_count = 0;
+    a->chunk_count = 0;
+    a->bytes_used = 0;
+}
+
+void* arena_alloc(Arena* a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    ArenaChunk* chunk = a->head;
+    if (!chunk || chunk->used + size > chunk->capacity) {
+        // oversized allocations get a chunk of their own so they don't waste the rest of a normal one
+        size_t capacity = size > a->chunk_size ? size : a->chunk_size;
+        ArenaChunk* new_chunk = malloc(sizeof(ArenaChunk) + capacity);
+        if (!new_chunk) {
+            fprintf(stderr, "failed to malloc arena chunk\n");
+            exit(1);
+        }
+        new_chunk->used = 0;
+        new_chunk->capacity = capacity;
+        a->chunk_count++;
+
+        if (chunk && size > a->chunk_size) {
+            // keep bumping from the current chunk afterwards, as it likely still has room
+            new_chunk->next = chunk->next;
+            chunk->next = new_chunk;
+        } else {
+            new_chunk->next = chunk;
+            a->head = new_chunk;
+        }
+        chunk = new_chunk;
+    }
+
+    void* out = chunk->data + chunk->used;
+    chunk->used += size;
+    a->alloc_count++;
+    a->bytes_used += size;
+    return out;
+}
+
+char* arena_strndup(Arena* a, const char* str, size_t len) {
+    char* out = arena_alloc(a, len + 1);
+    memcpy(out, str, len);
+    out[len] = '\0';
+    return out;
+}
+
+void arena_free(Arena* a) {
+    ArenaChunk* chunk = a->head;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    a->head = NULL;
+}
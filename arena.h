@@ -0,0 +1,33 @@
+#ifndef GRBLANG_ARENA_H
+#define GRBLANG_ARENA_H
+
+#include <stddef.h>
+
+// bump allocator, everything allocated from an arena is released at once by arena_free & can't be freed individually
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t used;
+    size_t capacity;
+    _Alignas(max_align_t) unsigned char data[];
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk* head;
+    size_t chunk_size;
+
+    // stats, only used for benchmarking
+    long alloc_count;
+    long chunk_count;
+    size_t bytes_used;
+} Arena;
+
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+void arena_init(Arena* a, size_t chunk_size);
+// memory is aligned for any type & is not zeroed
+void* arena_alloc(Arena* a, size_t size);
+// returns a nul terminated copy of the len bytes at str
+char* arena_strndup(Arena* a, const char* str, size_t len);
+void arena_free(Arena* a);
+
+#endif //GRBLANG_ARENA_H
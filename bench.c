@@ -0,0 +1,922 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <glob.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "bytecode_emit.h"
+#include "bytecode_opt.h"
+#include "cfg.h"
+#include "flat_ast.h"
+#include "interner.h"
+#include "ir.h"
+#include "ir_lower.h"
+#include "ir_opt.h"
+#include "lexer.h"
+#include "lexer_scan.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "reg_vm.h"
+#include "resolver.h"
+#include "source.h"
+#include "type_checker.h"
+#include "vm.h"
+
+// usage: grblang_bench [benchmark name], runs every benchmark if no name is given
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} Buffer;
+
+static void buffer_append(Buffer* b, const char* str) {
+    size_t len = strlen(str);
+    if (b->len + len + 1 > b->capacity) {
+        while (b->len + len + 1 > b->capacity) {
+            b->capacity = b->capacity ? b->capacity * 2 : 4096;
+        }
+        char* new_data = realloc(b->data, b->capacity);
+        if (!new_data) {
+            fprintf(stderr, "failed to realloc bench buffer\n");
+            exit(1);
+        }
+        b->data = new_data;
+    }
+    memcpy(b->data + b->len, str, len + 1);
+    b->len += len;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// roughly what our generated config scripts look like, long identifiers, lots of indentation & string literals
+static Buffer generate_source(size_t target_len) {
+    Buffer b = {0};
+    char line[256];
+    for (int i = 0; b.len < target_len; i++) {
+        snprintf(line, sizeof(line), "var int generated_config_value_%c%c = %d * (%d + 12345678);\n", 'a' + i % 26, 'a' + (i / 26) % 26, i, i % 977);
+        buffer_append(&b, line);
+        snprintf(line, sizeof(line), "var string generated_config_name_%c%c = \"this is a fairly long generated string literal number\";\n", 'a' + i % 26, 'a' + (i / 26) % 26);
+        buffer_append(&b, line);
+        snprintf(line, sizeof(line), "if (generated_config_value_%c%c > 100) {\n        generated_config_value_%c%c += 1;\n};\n", 'a' + i % 26, 'a' + (i / 26) % 26, 'a' + i % 26, 'a' + (i / 26) % 26);
+        buffer_append(&b, line);
+    }
+    return b;
+}
+
+static void bench_lexer(void) {
+    Buffer src = generate_source(8 * 1024 * 1024);
+    double mb = src.len / (1024.0 * 1024.0);
+    int runs = 5;
+
+    for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+        if (!scan_set_level(level)) {
+            printf("lexer/%-8s unsupported on this cpu\n", scan_level_string(level));
+            continue;
+        }
+
+        double best = 1e9;
+        long tokens = 0;
+        for (int run = 0; run < runs; run++) {
+            Lexer l;
+            lexer_init(&l, src.data, src.len);
+            tokens = 0;
+
+            double start = now_seconds();
+            Token t;
+            while ((t = lex_next(&l)).type != TOK_EOF) {
+                if (t.type == TOK_STRING) free(t.value.string_val);
+                tokens++;
+            }
+            double elapsed = now_seconds() - start;
+            if (elapsed < best) best = elapsed;
+        }
+
+        printf("lexer/%-8s %8.2f MB in %7.2f ms, %8.1f MB/s, %ld tokens\n", scan_level_string(level), mb, best * 1000, mb / best, tokens);
+    }
+
+    scan_set_level(scan_best_level());
+    free(src.data);
+}
+
+// raw kernel throughput on long runs, this is the upper bound of what the kernels can give the lexer
+static void bench_scan(void) {
+    size_t len = 8 * 1024 * 1024;
+    char* buf = malloc(len);
+    double mb = len / (1024.0 * 1024.0);
+    int runs = 5;
+
+    struct {
+        const char* name;
+        char fill;
+        size_t (*kernel)(const char* p, size_t n);
+    } cases[] = {
+        {"whitespace", ' ', scan_whitespace},
+        {"ident", 'x', scan_ident},
+        {"digits", '7', scan_digits},
+        {"string", 's', scan_string_body},
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        memset(buf, cases[c].fill, len);
+        for (ScanLevel level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+            if (!scan_set_level(level)) continue;
+
+            double best = 1e9;
+            for (int run = 0; run < runs; run++) {
+                double start = now_seconds();
+                size_t n = cases[c].kernel(buf, len);
+                double elapsed = now_seconds() - start;
+                if (n != len) {
+                    fprintf(stderr, "error: %s kernel stopped early at %zu\n", cases[c].name, n);
+                    exit(1);
+                }
+                if (elapsed < best) best = elapsed;
+            }
+            printf("scan/%-10s/%-8s %9.1f MB/s\n", cases[c].name, scan_level_string(level), mb / best);
+        }
+    }
+
+    scan_set_level(scan_best_level());
+    free(buf);
+}
+
+// a valid program (unlike generate_source) so it can go through the whole front end
+static Buffer generate_program(size_t target_len) {
+    Buffer b = {0};
+    char line[256];
+    int vars = 64;
+    for (int i = 0; i < vars; i++) {
+        snprintf(line, sizeof(line), "var int accumulator_%c%c = %d;\n", 'a' + i % 26, 'a' + i / 26, i);
+        buffer_append(&b, line);
+    }
+    for (int i = 0; b.len < target_len; i++) {
+        int v = i % vars;
+        snprintf(line, sizeof(line), "accumulator_%c%c += %d * (accumulator_%c%c + 3);\n", 'a' + v % 26, 'a' + v / 26, i % 1000, 'a' + (v * 7) % vars % 26, 'a' + (v * 7) % vars / 26);
+        buffer_append(&b, line);
+        snprintf(line, sizeof(line), "if (accumulator_%c%c > %d) {\n    accumulator_%c%c = accumulator_%c%c - 1;\n};\n", 'a' + v % 26, 'a' + v / 26, i % 500, 'a' + v % 26, 'a' + v / 26, 'a' + v % 26, 'a' + v / 26);
+        buffer_append(&b, line);
+    }
+    return b;
+}
+
+// exactly statements top level statements (if statements count as one) using a handful of variables
+static Buffer generate_statements(int statements) {
+    Buffer b = {0};
+    char line[256];
+    int vars = 64;
+    for (int i = 0; i < vars; i++) {
+        snprintf(line, sizeof(line), "var int accumulator_%c%c = %d;\n", 'a' + i % 26, 'a' + i / 26, i);
+        buffer_append(&b, line);
+    }
+    for (int i = vars; i < statements; i++) {
+        int v = i % vars;
+        if (i % 2 == 0) {
+            snprintf(line, sizeof(line), "accumulator_%c%c += %d * (accumulator_%c%c + 3);\n", 'a' + v % 26, 'a' + v / 26, i % 1000, 'a' + (v * 7) % vars % 26, 'a' + (v * 7) % vars / 26);
+        } else {
+            snprintf(line, sizeof(line), "if (accumulator_%c%c > %d) {\n    accumulator_%c%c = accumulator_%c%c - 1;\n};\n", 'a' + v % 26, 'a' + v / 26, i % 500, 'a' + v % 26, 'a' + v / 26, 'a' + v % 26, 'a' + v / 26);
+        }
+        buffer_append(&b, line);
+    }
+    return b;
+}
+
+// statements that are almost entirely long int expressions, to weigh expression parsing over everything else
+static Buffer generate_expressions(int statements) {
+    Buffer b = {0};
+    char line[512];
+    int vars = 64;
+    for (int i = 0; i < vars; i++) {
+        snprintf(line, sizeof(line), "var int accumulator_%c%c = %d;\n", 'a' + i % 26, 'a' + i / 26, i);
+        buffer_append(&b, line);
+    }
+    for (int i = vars; i < statements; i++) {
+        int v = i % vars;
+        int w = (v * 7) % vars;
+        snprintf(line, sizeof(line), "accumulator_%c%c = (accumulator_%c%c + %d) * 3 - accumulator_%c%c / 2 %% 5 + -%d * (accumulator_%c%c - 1) + %d / (1 + accumulator_%c%c * accumulator_%c%c);\n",
+            'a' + v % 26, 'a' + v / 26, 'a' + v % 26, 'a' + v / 26, i % 1000, 'a' + w % 26, 'a' + w / 26, i % 97, 'a' + w % 26, 'a' + w / 26, i % 13, 'a' + v % 26, 'a' + v / 26, 'a' + w % 26, 'a' + w / 26);
+        buffer_append(&b, line);
+    }
+    return b;
+}
+
+static void bench_expr(void) {
+    int statements = 100000;
+    Buffer src = generate_expressions(statements);
+    int runs = 5;
+
+    double best = 1e9;
+    long nodes = 0;
+    for (int run = 0; run < runs; run++) {
+        Lexer l;
+        lexer_init(&l, src.data, src.len);
+
+        double start = now_seconds();
+        Parser p;
+        parser_init(&p, &l);
+        parse_program(&p);
+        double elapsed = now_seconds() - start;
+        nodes = p.arena.alloc_count;
+        parser_free(&p);
+
+        if (elapsed < best) best = elapsed;
+    }
+
+    printf("expr/       %d expression statements (%.2f MB) parsed in %7.2f ms, %.1f ns per node\n", statements, src.len / (1024.0 * 1024.0), best * 1000, best * 1e9 / nodes);
+    free(src.data);
+    free_interner();
+}
+
+static void bench_parse(void) {
+    int statements = 100000;
+    Buffer src = generate_statements(statements);
+    int runs = 5;
+
+    // the first run is what a real compile sees, later ones get memory the allocator has already faulted in
+    double first = 0;
+    double best = 1e9;
+    double best_free = 1e9;
+    Arena stats = {0};
+    for (int run = 0; run < runs; run++) {
+        Lexer l;
+        lexer_init(&l, src.data, src.len);
+
+        double start = now_seconds();
+        Parser p;
+        parser_init(&p, &l);
+        ASTNode* node = parse_program(&p);
+        double elapsed = now_seconds() - start;
+        if (node->program.count != statements) {
+            fprintf(stderr, "error: parsed %d statements, expected %d\n", node->program.count, statements);
+            exit(1);
+        }
+        stats = p.arena;
+
+        start = now_seconds();
+        parser_free(&p);
+        double elapsed_free = now_seconds() - start;
+
+        if (run == 0) first = elapsed;
+        if (elapsed < best) best = elapsed;
+        if (elapsed_free < best_free) best_free = elapsed_free;
+    }
+
+    printf("parse/      %d statements in %7.2f ms (first run %7.2f ms), freed in %6.3f ms\n", statements, best * 1000, first * 1000, best_free * 1000);
+    printf("parse/      %ld nodes & arrays (%.2f MB) served by %ld chunk mallocs\n", stats.alloc_count, stats.bytes_used / (1024.0 * 1024.0), stats.chunk_count);
+    free(src.data);
+    free_interner();
+}
+
+// type check + bytecode gen of a single expression nested depth deep, time per level should stay flat as depth grows
+static void bench_nested(void) {
+    int runs = 5;
+
+    for (int depth = 1000; depth <= 16000; depth *= 2) {
+        Buffer src = {0};
+        buffer_append(&src, "var int x = 1;\nvar int y = ");
+        // half left nested (a chain), half right nested (parens)
+        for (int i = 0; i < depth / 2; i++) {
+            buffer_append(&src, "(x + ");
+        }
+        buffer_append(&src, "1");
+        for (int i = 0; i < depth / 2; i++) {
+            buffer_append(&src, ")");
+        }
+        for (int i = 0; i < depth / 2; i++) {
+            buffer_append(&src, " + x");
+        }
+        buffer_append(&src, ";\n");
+
+        double best = 1e9;
+        for (int run = 0; run < runs; run++) {
+            Lexer l;
+            lexer_init(&l, src.data, src.len);
+            Parser p;
+            parser_init(&p, &l);
+            ASTNode* node = parse_program(&p);
+            Resolver r;
+            resolver_init(&r);
+            resolve(node, &r);
+            BytecodeEmitter b;
+            bytecode_init(&b);
+
+            double start = now_seconds();
+            type_check(node, &r);
+            bytecode_gen(node, &b, &r);
+            double elapsed = now_seconds() - start;
+            if (elapsed < best) best = elapsed;
+
+            free(b.code);
+            free(b.constants);
+            free_bytecode_emitter(&b);
+            free_resolver(&r);
+            parser_free(&p);
+        }
+
+        printf("nested/     depth %6d checked & emitted in %8.3f ms, %6.1f ns per level\n", depth, best * 1000, best * 1e9 / depth);
+        free(src.data);
+    }
+    free_interner();
+}
+
+// identifiers can't have digits, so i is spelled out in base 26. the underscore keeps it from ever spelling a keyword
+static void bench_var_name(char prefix, int i, char out[16]) {
+    int len = 0;
+    out[len++] = prefix;
+    out[len++] = '_';
+    do {
+        out[len++] = 'a' + i % 26;
+        i /= 26;
+    } while (i > 0);
+    out[len] = '\0';
+}
+
+// n distinct variables, each declared from the one before it, then the same number again split across if blocks
+static void bench_resolve(void) {
+    int runs = 5;
+
+    for (int vars = 2000; vars <= 32000; vars *= 2) {
+        Buffer src = {0};
+        char line[128];
+        char name[16];
+        char prev[16];
+        buffer_append(&src, "var int v_a = 1;\n");
+        for (int i = 1; i < vars; i++) {
+            bench_var_name('v', i, name);
+            bench_var_name('v', i - 1, prev);
+            snprintf(line, sizeof(line), "var int %s = %s + 1;\n", name, prev);
+            buffer_append(&src, line);
+        }
+        for (int i = 0; i < vars; i++) {
+            if (i % 8 == 0) buffer_append(&src, i ? "};\nif (v_a > 0) {\n" : "if (v_a > 0) {\n");
+            bench_var_name('b', i, name);
+            bench_var_name('v', i, prev);
+            snprintf(line, sizeof(line), "    var int %s = %s;\n", name, prev);
+            buffer_append(&src, line);
+        }
+        buffer_append(&src, "};\n");
+
+        Lexer l;
+        lexer_init(&l, src.data, src.len);
+        Parser p;
+        parser_init(&p, &l);
+        ASTNode* node = parse_program(&p);
+
+        double best = 1e9;
+        int num_locals = 0;
+        for (int run = 0; run < runs; run++) {
+            Resolver r;
+            resolver_init(&r);
+            double start = now_seconds();
+            resolve(node, &r);
+            double elapsed = now_seconds() - start;
+            if (elapsed < best) best = elapsed;
+            num_locals = r.num_locals;
+            free_resolver(&r);
+        }
+
+        printf("resolve/    %6d declarations resolved in %8.3f ms, %6.1f ns per declaration, %6d locals\n", vars * 2, best * 1000, best * 1e9 / (vars * 2), num_locals);
+        parser_free(&p);
+        free(src.data);
+    }
+    free_interner();
+}
+
+// compiles src through the whole front end, ready for vm_init
+static int compile_program(const char* src, BytecodeEmitter* b, bool loop_opts, int unroll) {
+    Lexer l;
+    lexer_init(&l, src, strlen(src));
+    Parser p;
+    parser_init(&p, &l);
+    ASTNode* node = parse_program(&p);
+    Resolver r;
+    resolver_init(&r);
+    resolve(node, &r);
+    type_check(node, &r);
+    optimize_ast(node, &p.arena);
+    bytecode_init(b);
+    Ir ir;
+    ir_init(&ir);
+    int num_locals = -1;
+    if (ir_build(&ir, node, r.num_locals)) {
+        ir_optimize(&ir);
+        if (loop_opts) {
+            ir_optimize_loops(&ir);
+            ir_unroll_loops(&ir, unroll);
+        }
+        num_locals = ir_lower(&ir, b);
+    }
+    free_ir(&ir);
+    if (num_locals == -1) {
+        bytecode_gen(node, b, &r);
+        num_locals = r.num_locals;
+    }
+    peephole_optimize(b);
+    cfg_optimize(b);
+    free_bytecode_emitter(b);
+    parser_free(&p);
+    free_resolver(&r);
+    return num_locals;
+}
+
+typedef struct {
+    const char* name;
+    const char* src;
+    // of the innermost loop
+    int iterations;
+} LoopProgram;
+
+// counted loops, the shape most scripts spend their time in
+static const LoopProgram loop_programs[] = {
+    {"count",
+        "var int i = 0;\n"
+        "var int sum = 0;\n"
+        "while (i < 10000000) {\n"
+        "    sum += i % 7;\n"
+        "    i += 1;\n"
+        "};\n"
+        "sum;\n",
+        10000000},
+    {"nested",
+        "var int i = 0;\n"
+        "var int sum = 0;\n"
+        "while (i < 100000) {\n"
+        "    var int j = 0;\n"
+        "    while (j < 100) {\n"
+        "        sum = sum + j;\n"
+        "        j += 1;\n"
+        "    };\n"
+        "    i += 1;\n"
+        "};\n"
+        "sum;\n",
+        10000000},
+    {"branchy",
+        "var int i = 0;\n"
+        "var int a = 0;\n"
+        "var int b = 0;\n"
+        "while (i < 10000000) {\n"
+        "    i += 1;\n"
+        "    if (i % 3 == 0) {\n"
+        "        a += 1;\n"
+        "    } else {\n"
+        "        if (i % 3 == 1) {\n"
+        "            b += 1;\n"
+        "        } else {\n"
+        "            a -= 1;\n"
+        "        };\n"
+        "    };\n"
+        "};\n"
+        "a + b;\n",
+        10000000},
+    {"invariant",
+        "var int n = 0;\n"
+        "while (n < 1000) {\n"
+        "    n += 7;\n"
+        "};\n"
+        "var int k = n % 8;\n"
+        "var int i = 0;\n"
+        "var int sum = 0;\n"
+        "while (i < 10000000) {\n"
+        "    sum += i * (k * n + 1) + i / 4;\n"
+        "    i += 1;\n"
+        "};\n"
+        "sum;\n",
+        10000000},
+    {"arrays",
+        "var int[] a = [0, 0, 0, 0, 0, 0, 0, 0];\n"
+        "var int i = 0;\n"
+        "var int sum = 0;\n"
+        "while (i < 10000000) {\n"
+        "    var int k = i % 8;\n"
+        "    a[k] = a[k] + i;\n"
+        "    sum += a[k] / (k + 1);\n"
+        "    i += 1;\n"
+        "};\n"
+        "sum;\n",
+        10000000},
+};
+
+static long count_instructions(const char* src, bool loop_opts, int unroll) {
+    BytecodeEmitter b;
+    int num_locals = compile_program(src, &b, loop_opts, unroll);
+    VM vm;
+    vm_init(&vm, &b, num_locals);
+    vm_run(&vm);
+    long instructions = vm.instruction_count;
+    vm_free(&vm);
+    return instructions;
+}
+
+static void bench_loop(void) {
+    int runs = 5;
+
+    for (size_t p = 0; p < sizeof(loop_programs) / sizeof(loop_programs[0]); p++) {
+        const LoopProgram* program = &loop_programs[p];
+        double best = 1e9;
+        int code_size = 0;
+        int const_count = 0;
+        long instructions = 0;
+        for (int run = 0; run < runs; run++) {
+            BytecodeEmitter b;
+            int num_locals = compile_program(program->src, &b, true, IR_UNROLL_FACTOR);
+            code_size = b.code_size;
+            const_count = b.const_count;
+
+            VM vm;
+            vm_init(&vm, &b, num_locals);
+            double start = now_seconds();
+            vm_run(&vm);
+            double elapsed = now_seconds() - start;
+            if (elapsed < best) best = elapsed;
+            instructions = vm.instruction_count;
+            vm_free(&vm);
+        }
+
+        // the same program without unrolling & without any of the loop passes, only for the counts
+        long instructions_rolled = count_instructions(program->src, true, 1);
+        long instructions_before = count_instructions(program->src, false, 1);
+
+        printf("loop/%-9s %d iterations in %8.2f ms, %6.2f ns & %5.2f instructions per iteration (%5.2f not unrolled, %5.2f without loop opts), %d bytes of bytecode, %d constants\n",
+            program->name, program->iterations, best * 1000, best * 1e9 / program->iterations, (double) instructions / program->iterations,
+            (double) instructions_rolled / program->iterations, (double) instructions_before / program->iterations, code_size, const_count);
+    }
+    free_interner();
+}
+
+// instructions per second through vm_run on the same loops, as built. configure with GRBLANG_THREADED_DISPATCH on &
+// off to compare the dispatch modes
+static void bench_dispatch(void) {
+    int runs = 5;
+
+    for (size_t p = 0; p < sizeof(loop_programs) / sizeof(loop_programs[0]); p++) {
+        const LoopProgram* program = &loop_programs[p];
+        double best = 1e9;
+        long instructions = 0;
+        for (int run = 0; run < runs; run++) {
+            BytecodeEmitter b;
+            int num_locals = compile_program(program->src, &b, true, IR_UNROLL_FACTOR);
+
+            VM vm;
+            vm_init(&vm, &b, num_locals);
+            double start = now_seconds();
+            vm_run(&vm);
+            double elapsed = now_seconds() - start;
+            if (elapsed < best) best = elapsed;
+            instructions = vm.instruction_count;
+            vm_free(&vm);
+        }
+
+        printf("dispatch/%-9s %-9s %ld instructions in %8.2f ms, %7.1f million instructions per second\n",
+            vm_dispatch_name(), program->name, instructions, best * 1000, instructions / best / 1e6);
+    }
+    free_interner();
+}
+
+// the same front end as compile_program, lowered for the register vm. false if the program can't be
+static bool compile_regs(const char* src, RegCode* code) {
+    Lexer l;
+    lexer_init(&l, src, strlen(src));
+    Parser p;
+    parser_init(&p, &l);
+    ASTNode* node = parse_program(&p);
+    Resolver r;
+    resolver_init(&r);
+    resolve(node, &r);
+    type_check(node, &r);
+    optimize_ast(node, &p.arena);
+    Ir ir;
+    ir_init(&ir);
+    bool lowered = false;
+    if (ir_build(&ir, node, r.num_locals)) {
+        ir_optimize(&ir);
+        ir_optimize_loops(&ir);
+        ir_unroll_loops(&ir, IR_UNROLL_FACTOR);
+        reg_code_init(code);
+        lowered = ir_lower_regs(&ir, code);
+        if (!lowered) free_reg_code(code);
+    }
+    free_ir(&ir);
+    parser_free(&p);
+    free_resolver(&r);
+    return lowered;
+}
+
+// the stack vm against the register vm on the loops, both as built
+static void bench_regs(void) {
+    int runs = 5;
+
+    for (size_t p = 0; p < sizeof(loop_programs) / sizeof(loop_programs[0]); p++) {
+        const LoopProgram* program = &loop_programs[p];
+        double best_stack = 1e9;
+        double best_regs = 1e9;
+        long stack_instructions = 0;
+        long reg_instructions = 0;
+        for (int run = 0; run < runs; run++) {
+            BytecodeEmitter b;
+            int num_locals = compile_program(program->src, &b, true, IR_UNROLL_FACTOR);
+            VM vm;
+            vm_init(&vm, &b, num_locals);
+            double start = now_seconds();
+            vm_run(&vm);
+            double elapsed = now_seconds() - start;
+            if (elapsed < best_stack) best_stack = elapsed;
+            stack_instructions = vm.instruction_count;
+            vm_free(&vm);
+
+            RegCode code;
+            if (!compile_regs(program->src, &code)) {
+                fprintf(stderr, "error: `%s` can't be lowered for the register vm\n", program->name);
+                exit(1);
+            }
+            RegVM reg_vm;
+            reg_vm_init(&reg_vm, &code);
+            start = now_seconds();
+            reg_vm_run(&reg_vm);
+            elapsed = now_seconds() - start;
+            if (elapsed < best_regs) best_regs = elapsed;
+            reg_instructions = reg_vm.instruction_count;
+            reg_vm_free(&reg_vm);
+        }
+
+        printf("regs/%-9s stack %6.2f instructions & %6.2f ns per iteration, registers %6.2f instructions & %6.2f ns per iteration\n",
+            program->name, (double) stack_instructions / program->iterations, best_stack * 1e9 / program->iterations,
+            (double) reg_instructions / program->iterations, best_regs * 1e9 / program->iterations);
+    }
+    free_interner();
+}
+
+typedef struct {
+    long code_bytes;
+    double load;
+    double run;
+    long instructions;
+} FormatResult;
+
+// loads & runs src's bytecode in the byte format or the word one, best times of runs
+static FormatResult run_format(const char* src, bool words, int runs) {
+    FormatResult result = {.load = 1e9, .run = 1e9};
+    for (int run = 0; run < runs; run++) {
+        BytecodeEmitter b;
+        int num_locals = compile_program(src, &b, true, IR_UNROLL_FACTOR);
+        int word_count = 0;
+        uint32_t* code_words = words ? bytecode_emit_words(&b, &word_count) : NULL;
+
+        VM vm;
+        double start = now_seconds();
+        if (words) {
+            vm_init_words(&vm, &b, code_words, word_count, num_locals);
+        } else {
+            vm_init(&vm, &b, num_locals);
+        }
+        double loaded = now_seconds();
+        vm_run(&vm);
+        double end = now_seconds();
+        if (loaded - start < result.load) result.load = loaded - start;
+        if (end - loaded < result.run) result.run = end - loaded;
+        result.code_bytes = words ? word_count * 4L : b.code_size;
+        result.instructions = vm.instruction_count;
+        vm_free(&vm);
+        free(code_words);
+    }
+    return result;
+}
+
+static void print_formats(const char* name, FormatResult bytes, FormatResult words) {
+    printf("words/%-14s bytes %9ld B, load %8.3f ms, run %8.2f ms | words %9ld B, load %8.3f ms, run %8.2f ms\n", name,
+        bytes.code_bytes, bytes.load * 1000, bytes.run * 1000, words.code_bytes, words.load * 1000, words.run * 1000);
+}
+
+static void add_format(FormatResult* total, FormatResult r) {
+    total->code_bytes += r.code_bytes;
+    total->load += r.load;
+    total->run += r.run;
+    total->instructions += r.instructions;
+}
+
+static Buffer read_file(const char* path) {
+    Buffer b = {0};
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "error: failed to open `%s`\n", path);
+        exit(1);
+    }
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk) - 1, f)) > 0) {
+        chunk[n] = '\0';
+        buffer_append(&b, chunk);
+    }
+    fclose(f);
+    return b;
+}
+
+// the byte format against the fixed width word one: code size, vm_init time & vm_run time, over tests/ (run from the
+// repo root), generated straight line programs & the loops
+static void bench_words(void) {
+    int runs = 5;
+
+    glob_t corpus;
+    FormatResult corpus_bytes = {0};
+    FormatResult corpus_words = {0};
+    if (glob("tests/*.grb", 0, NULL, &corpus) == 0) {
+        for (size_t i = 0; i < corpus.gl_pathc; i++) {
+            Buffer src = read_file(corpus.gl_pathv[i]);
+            add_format(&corpus_bytes, run_format(src.data, false, runs));
+            add_format(&corpus_words, run_format(src.data, true, runs));
+            free(src.data);
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "tests (%zu)", corpus.gl_pathc);
+        print_formats(name, corpus_bytes, corpus_words);
+        globfree(&corpus);
+    }
+
+    size_t sizes[] = {1024 * 1024, 8 * 1024 * 1024};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        Buffer src = generate_program(sizes[i]);
+        char name[32];
+        snprintf(name, sizeof(name), "generated %zuMB", sizes[i] / (1024 * 1024));
+        print_formats(name, run_format(src.data, false, 3), run_format(src.data, true, 3));
+        free(src.data);
+    }
+
+    for (size_t p = 0; p < sizeof(loop_programs) / sizeof(loop_programs[0]); p++) {
+        print_formats(loop_programs[p].name, run_format(loop_programs[p].src, false, runs), run_format(loop_programs[p].src, true, runs));
+    }
+    free_interner();
+}
+
+// resolve + type check + bytecode gen over the same parse, on the pointer tree & on the flat ast
+static void bench_frontend(void) {
+    int statements = 1000000;
+    Buffer src = generate_statements(statements);
+    int runs = 5;
+
+    Lexer l;
+    lexer_init(&l, src.data, src.len);
+    Parser p;
+    parser_init(&p, &l);
+    ASTNode* node = parse_program(&p);
+
+    double best_tree = 1e9;
+    double best_flatten = 1e9;
+    double best_flat = 1e9;
+    int tree_code_size = 0;
+    int flat_code_size = 0;
+    for (int run = 0; run < runs; run++) {
+        Resolver r;
+        resolver_init(&r);
+        BytecodeEmitter b;
+        bytecode_init(&b);
+        double start = now_seconds();
+        resolve(node, &r);
+        type_check(node, &r);
+        bytecode_gen(node, &b, &r);
+        double elapsed = now_seconds() - start;
+        if (elapsed < best_tree) best_tree = elapsed;
+        tree_code_size = b.code_size;
+        free_resolver(&r);
+        free(b.code);
+        free(b.constants);
+        free_bytecode_emitter(&b);
+
+        resolver_init(&r);
+        bytecode_init(&b);
+        FlatAst flat;
+        flat_ast_init(&flat);
+        start = now_seconds();
+        flat_ast_build(&flat, node);
+        double built = now_seconds();
+        flat_resolve(&flat, &r);
+        flat_type_check(&flat, &r);
+        flat_bytecode_gen(&flat, &b);
+        double end = now_seconds();
+        if (built - start < best_flatten) best_flatten = built - start;
+        if (end - built < best_flat) best_flat = end - built;
+        flat_code_size = b.code_size;
+        flat_ast_free(&flat);
+        free_resolver(&r);
+        free(b.code);
+        free(b.constants);
+        free_bytecode_emitter(&b);
+    }
+
+    if (tree_code_size != flat_code_size) {
+        fprintf(stderr, "error: tree & flat bytecode differ in size (%d vs %d)\n", tree_code_size, flat_code_size);
+        exit(1);
+    }
+    printf("frontend/tree %d statements, passes %7.2f ms\n", statements, best_tree * 1000);
+    printf("frontend/flat %d statements, passes %7.2f ms (+ %7.2f ms to flatten)\n", statements, best_flat * 1000, best_flatten * 1000);
+
+    parser_free(&p);
+    free(src.data);
+    free_interner();
+}
+
+// runs in a forked child so ru_maxrss is just this mode's peak
+static void compile_source_file(const char* path, bool stream) {
+    double start = now_seconds();
+
+    Source src;
+    if (!source_open_mode(path, stream, &src)) {
+        exit(1);
+    }
+    Lexer l;
+    if (src.stream) {
+        lexer_init_stream(&l, src.stream, LEXER_DEFAULT_WINDOW);
+    } else {
+        lexer_init(&l, src.data, src.len);
+    }
+
+    Parser p;
+    parser_init(&p, &l);
+    ASTNode* node = parse_program(&p);
+    Resolver r;
+    resolver_init(&r);
+    resolve(node, &r);
+    type_check(node, &r);
+    BytecodeEmitter b;
+    bytecode_init(&b);
+    bytecode_gen(node, &b, &r);
+
+    // this is the point where the vm could start running
+    double elapsed = now_seconds() - start;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("load/%-6s time to first instruction %8.2f ms, peak rss %8.2f MB, %d bytes of bytecode, %d constants\n", stream ? "stream" : "mmap", elapsed * 1000, usage.ru_maxrss / 1024.0, b.code_size, b.const_count);
+    fflush(stdout);
+}
+
+static void bench_load(void) {
+    Buffer program = generate_program(16 * 1024 * 1024);
+    char path[] = "/tmp/grblang_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, program.data, program.len) != (ssize_t) program.len) {
+        fprintf(stderr, "error: failed to write generated program\n");
+        exit(1);
+    }
+    close(fd);
+    printf("load/       %.2f MB generated program\n", program.len / (1024.0 * 1024.0));
+    free(program.data);
+
+    for (int stream = 0; stream <= 1; stream++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            compile_source_file(path, stream);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+    }
+
+    unlink(path);
+}
+
+typedef struct {
+    const char* name;
+    void (*fn)(void);
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    {"lexer", bench_lexer},
+    {"scan", bench_scan},
+    {"load", bench_load},
+    {"parse", bench_parse},
+    {"expr", bench_expr},
+    {"frontend", bench_frontend},
+    {"nested", bench_nested},
+    {"resolve", bench_resolve},
+    {"loop", bench_loop},
+    {"dispatch", bench_dispatch},
+    {"words", bench_words},
+    {"regs", bench_regs},
+};
+
+int main(int argc, char* argv[]) {
+    const char* only = argc > 1 ? argv[1] : NULL;
+    bool ran = false;
+
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (only && strcmp(only, benchmarks[i].name) != 0) continue;
+        benchmarks[i].fn();
+        ran = true;
+    }
+
+    if (!ran) {
+        fprintf(stderr, "error: unknown benchmark `%s`\n", only);
+        return 1;
+    }
+
+    return 0;
+}
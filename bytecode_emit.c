@@ -1,4 +1,5 @@
 #include "bytecode_emit.h"
+#include "bytecode_opt.h"
 #include "lexer.h"
 #include "parser.h"
 #include "resolver.h"
@@ -18,8 +19,29 @@ void bytecode_init(BytecodeEmitter* b) {
     b->code_capacity = initial_capacity;
 
     b->constants = malloc(initial_capacity * sizeof(StackValue));
+    b->const_hashes = malloc(initial_capacity * sizeof(uint32_t));
     b->const_count = 0;
     b->const_capacity = initial_capacity;
+
+    b->const_slot_capacity = initial_capacity * 2;
+    b->const_slots = calloc(b->const_slot_capacity, sizeof(uint32_t));
+
+    b->fusable_cmp_end = -1;
+
+    b->far_jumps = NULL;
+    b->far_jump_count = 0;
+    b->far_jump_capacity = 0;
+}
+
+void free_bytecode_emitter(BytecodeEmitter* b) {
+    free(b->const_slots);
+    free(b->const_hashes);
+    free(b->far_jumps);
+    b->const_slots = NULL;
+    b->const_hashes = NULL;
+    b->far_jumps = NULL;
+    b->far_jump_count = 0;
+    b->far_jump_capacity = 0;
 }
 
 void bytecode_resize_code(BytecodeEmitter* b) {
@@ -43,9 +65,78 @@ void bytecode_resize_const(BytecodeEmitter* b) {
     }
 
     b->constants = new_constants;
+
+    uint32_t* new_hashes = realloc(b->const_hashes, new_capacity * sizeof(uint32_t));
+    if (!new_hashes) {
+        fprintf(stderr,"failed to realloc constant hashes arr\n");
+        exit(1);
+    }
+    b->const_hashes = new_hashes;
     b->const_capacity = new_capacity;
 }
 
+static void bytecode_resize_const_slots(BytecodeEmitter* b) {
+    int new_capacity = b->const_slot_capacity * 2;
+    uint32_t* new_slots = calloc(new_capacity, sizeof(uint32_t));
+    if (!new_slots) {
+        fprintf(stderr, "failed to calloc constant slots arr\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < b->const_count; i++) {
+        uint32_t idx = b->const_hashes[i] & (new_capacity - 1);
+        while (new_slots[idx]) {
+            idx = (idx + 1) & (new_capacity - 1);
+        }
+        new_slots[idx] = i + 1;
+    }
+
+    free(b->const_slots);
+    b->const_slots = new_slots;
+    b->const_slot_capacity = new_capacity;
+}
+
+static bool is_int_type(VarType type) {
+    return type.base_type == VALUE_INT && type.nested == -1;
+}
+
+// jumps over the right side of && or || when the left one already decides it. the jump pops that value, so
+// end_short_circuit pushes it again where it lands & both ways leave one bool on the stack
+static int emit_short_circuit_jump(BytecodeEmitter* b, TokenType op) {
+    return op == TOK_AND ? emit_jmpn(b, 0) : emit_jmpt(b, 0);
+}
+
+static void end_short_circuit(BytecodeEmitter* b, TokenType op, int skip_start) {
+    int end_start = emit_jmp(b, 0);
+    patch_int(b, b->code_size - (skip_start + 2), skip_start);
+    emit_push_bool(b, op == TOK_OR);
+    patch_int(b, b->code_size - (end_start + 2), end_start);
+}
+
+static bool is_expression(ASTNodeType type) {
+    switch (type) {
+        case AST_INT:
+        case AST_BOOL:
+        case AST_STRING:
+        case AST_BINARY_OP:
+        case AST_UNARY_OP:
+        case AST_VAR_REF:
+        case AST_ARRAY:
+        case AST_ARRAY_INDEX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void gen_statement(ASTNode* stmt, BytecodeEmitter* b, Resolver* r) {
+    bytecode_gen(stmt, b, r);
+    // every statement leaves the stack as it found it, an expression's value is popped as the program's result
+    if (stmt && is_expression(stmt->type)) {
+        emit_byte(b, OP_RESULT);
+    }
+}
+
 void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r) {
     if (!node) return;
 
@@ -57,71 +148,36 @@ void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r) {
             emit_push_bool(b, node->bool_val);
             break;
         case AST_STRING:
-            emit_push_string(b, node->string.string_val);
+            emit_push_string(b, node->string.string_val, node->string.len);
             break;
-        case AST_BINARY_OP:
+        case AST_BINARY_OP: {
             // need to output left/right differently from all other ops for and and or
-            if (node->binary_op.op == TOK_AND) {
-                bytecode_gen(node->binary_op.left, b, r);
-                int jmpn_start = emit_jmpn(b, 0);
-                bytecode_gen(node->binary_op.right, b, r);
-                int jmpn_step_count = b->code_size - (jmpn_start + 2);
-                patch_int(b, jmpn_step_count, jmpn_start);
-                break;
-            } else if (node->binary_op.op == TOK_OR) {
+            if (node->binary_op.op == TOK_AND || node->binary_op.op == TOK_OR) {
                 bytecode_gen(node->binary_op.left, b, r);
-                int jmpt_start = emit_jmpt(b, 0);
+                int skip_start = emit_short_circuit_jump(b, node->binary_op.op);
                 bytecode_gen(node->binary_op.right, b, r);
-                int jmpt_step_count = b->code_size - (jmpt_start + 2);
-                patch_int(b, jmpt_step_count, jmpt_start);
+                end_short_circuit(b, node->binary_op.op, skip_start);
                 break;
             }
 
-            bytecode_gen(node->binary_op.left, b, r);
-            bytecode_gen(node->binary_op.right, b, r);
-
-            switch (node->binary_op.op) {
-                case TOK_PLUS: {
-                    VarType leftType = get_expr_type(node->binary_op.left, r);
-                    if (leftType.nested != -1) {
-                        emit_byte(b, OP_ARRAPPEND);
-                    } else if (leftType.base_type == VALUE_INT && leftType.nested == -1) {
-                        emit_byte(b, OP_IADD);
-                    } else if (leftType.base_type == VALUE_STRING && leftType.nested == -1) {
-                        emit_byte(b, OP_SCONCAT);
-                    }
+            ASTNode* left = node->binary_op.left;
+            ASTNode* right = node->binary_op.right;
+            if (left->type == AST_VAR_REF && is_int_type(left->var_type)) {
+                if (node->binary_op.op == TOK_PLUS && right->type == AST_VAR_REF) {
+                    emit_iload_iload_iadd(b, left->var_ref.slot, right->var_ref.slot);
                     break;
                 }
-                case TOK_MINUS: emit_byte(b, OP_ISUB); break;
-                case TOK_MULT: emit_byte(b, OP_IMUL); break;
-                case TOK_DIV: emit_byte(b, OP_IDIV); break;
-                case TOK_GREATER: emit_byte(b, OP_IGT); break;
-                case TOK_LESS: emit_byte(b, OP_ILT); break;
-                case TOK_GREATER_EQUALS: emit_byte(b, OP_IGTE); break;
-                case TOK_LESS_EQUALS: emit_byte(b, OP_ILTE); break;
-                case TOK_MODULO: emit_byte(b, OP_IMOD); break;
-                case TOK_EQUALS: {
-                    // can just check the left node as type checker should catch cases where it's not the same type on both sides
-                    VarType leftType = get_expr_type(node->binary_op.left, r);
-                    if (leftType.base_type == VALUE_INT && leftType.nested == -1) {
-                        emit_byte(b, OP_IEQ);
-                    } else if (leftType.base_type == VALUE_BOOL && leftType.nested == -1) {
-                        emit_byte(b, OP_BEQ);
-                    }
+                if (node->binary_op.op == TOK_LESS && right->type == AST_INT && emit_iload_push_ilt(b, left->var_ref.slot, right->int_val)) {
                     break;
                 }
-                case TOK_NOT_EQUALS: {
-                    VarType leftType = get_expr_type(node->binary_op.left, r);
-                    if (leftType.base_type == VALUE_INT && leftType.nested == -1) {
-                        emit_byte(b, OP_INEQ);
-                    } else if (leftType.base_type == VALUE_BOOL && leftType.nested == -1) {
-                        emit_byte(b, OP_BEQ);
-                    }
-                    break;
-                }
-                default: break;
             }
+
+            bytecode_gen(left, b, r);
+            bytecode_gen(right, b, r);
+
+            emit_binary_op(b, node->binary_op.op, left->var_type);
             break;
+        }
         case AST_UNARY_OP:
             bytecode_gen(node->unary_op.right, b, r);
 
@@ -140,6 +196,10 @@ void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r) {
             emit_store(b, node->var_type, node->var_assign.slot);
             break;
         case AST_COMPOUND_ASSIGNMENT:
+            if (node->compound_assignment.value->type == AST_INT &&
+                emit_iinc(b, node->compound_assignment.op, node->compound_assignment.slot, node->compound_assignment.value->int_val)) {
+                break;
+            }
             bytecode_gen(node->compound_assignment.value, b, r);
             emit_icompound_assignment(b, node->compound_assignment.op, node->compound_assignment.slot);
             break;
@@ -148,7 +208,7 @@ void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r) {
             break;
         case AST_PROGRAM:
             for (int i = 0; i < node->program.count; i++) {
-                bytecode_gen(node->program.statements[i], b, r);
+                gen_statement(node->program.statements[i], b, r);
             }
             break;
         case AST_IF: {
@@ -157,7 +217,7 @@ void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r) {
             int jmpn_step_start = emit_jmpn(b, 0);
             int curr_instruction_count = b->code_size;
             for (int i = 0; i < node->if_stmt.success_count; i++) {
-                bytecode_gen(node->if_stmt.success_statements[i], b, r);
+                gen_statement(node->if_stmt.success_statements[i], b, r);
             }
             int jmpn_instruction_count = b->code_size - curr_instruction_count;
             if (node->if_stmt.fail_statements) {
@@ -172,7 +232,7 @@ void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r) {
                 int jmp_step_start = emit_jmp(b, 0);
                 int curr_instruction_count = b->code_size;
                 for (int i = 0; i < node->if_stmt.fail_count; i++) {
-                    bytecode_gen(node->if_stmt.fail_statements[i], b, r);
+                    gen_statement(node->if_stmt.fail_statements[i], b, r);
                 }
                 int jmp_instruction_count = b->code_size - curr_instruction_count;
                 patch_int(b, jmp_instruction_count, jmp_step_start);
@@ -185,7 +245,7 @@ void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r) {
             int jmpn_idx = emit_jmpn(b, 0);
 
             for (int i = 0; i < node->while_stmt.statements_count; i++) {
-                bytecode_gen(node->while_stmt.statements[i], b, r);
+                gen_statement(node->while_stmt.statements[i], b, r);
             }
 
             emit_jmp(b, jmp_start - b->code_size - 3);
@@ -218,22 +278,269 @@ void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r) {
     }
 }
 
-uint16_t add_const(BytecodeEmitter* b, StackValue val) {
+static void flat_gen_node(FlatAst* ast, NodeIndex node, BytecodeEmitter* b);
+
+static void flat_gen_children(FlatAst* ast, NodeIndex node, uint32_t from, uint32_t to, BytecodeEmitter* b) {
+    for (uint32_t i = from; i < to; i++) {
+        flat_gen_node(ast, flat_child(ast, node, i), b);
+    }
+}
+
+static void flat_gen_statements(FlatAst* ast, NodeIndex node, uint32_t from, uint32_t to, BytecodeEmitter* b) {
+    for (uint32_t i = from; i < to; i++) {
+        NodeIndex stmt = flat_child(ast, node, i);
+        flat_gen_node(ast, stmt, b);
+        if (is_expression(ast->kinds[stmt])) {
+            emit_byte(b, OP_RESULT);
+        }
+    }
+}
+
+static void flat_gen_node(FlatAst* ast, NodeIndex node, BytecodeEmitter* b) {
+    FlatNodeData* data = &ast->data[node];
+    uint32_t child_count = ast->child_count[node];
+
+    switch (ast->kinds[node]) {
+        case AST_INT:
+            emit_push_int(b, data->int_val);
+            break;
+        case AST_BOOL:
+            emit_push_bool(b, data->bool_val);
+            break;
+        case AST_STRING:
+            emit_push_string(b, data->string.string_val, data->string.len);
+            break;
+        case AST_BINARY_OP: {
+            if (data->op == TOK_AND || data->op == TOK_OR) {
+                flat_gen_node(ast, flat_child(ast, node, 0), b);
+                int skip_start = emit_short_circuit_jump(b, data->op);
+                flat_gen_node(ast, flat_child(ast, node, 1), b);
+                end_short_circuit(b, data->op, skip_start);
+                break;
+            }
+
+            NodeIndex left = flat_child(ast, node, 0);
+            NodeIndex right = flat_child(ast, node, 1);
+            if (ast->kinds[left] == AST_VAR_REF && is_int_type(ast->types[left])) {
+                if (data->op == TOK_PLUS && ast->kinds[right] == AST_VAR_REF) {
+                    emit_iload_iload_iadd(b, ast->data[left].var.slot, ast->data[right].var.slot);
+                    break;
+                }
+                if (data->op == TOK_LESS && ast->kinds[right] == AST_INT && emit_iload_push_ilt(b, ast->data[left].var.slot, ast->data[right].int_val)) {
+                    break;
+                }
+            }
+
+            flat_gen_children(ast, node, 0, 2, b);
+            emit_binary_op(b, data->op, ast->types[left]);
+            break;
+        }
+        case AST_UNARY_OP:
+            flat_gen_node(ast, flat_child(ast, node, 0), b);
+
+            switch (data->op) {
+                case TOK_MINUS: emit_byte(b, OP_INEG); break;
+                case TOK_EXCLAM: emit_byte(b, OP_NOT); break;
+                default: break;
+            }
+            break;
+        case AST_VAR_DECL:
+        case AST_VAR_ASSIGN:
+            flat_gen_node(ast, flat_child(ast, node, 0), b);
+            emit_store(b, data->var.type, data->var.slot);
+            break;
+        case AST_COMPOUND_ASSIGNMENT: {
+            NodeIndex value = flat_child(ast, node, 0);
+            if (ast->kinds[value] == AST_INT && emit_iinc(b, data->var.op, data->var.slot, ast->data[value].int_val)) {
+                break;
+            }
+            flat_gen_node(ast, value, b);
+            emit_icompound_assignment(b, data->var.op, data->var.slot);
+            break;
+        }
+        case AST_VAR_REF:
+            emit_load(b, data->var.type, data->var.slot);
+            break;
+        case AST_PROGRAM:
+            flat_gen_statements(ast, node, 0, child_count, b);
+            break;
+        case AST_IF: {
+            flat_gen_node(ast, flat_child(ast, node, 0), b);
+
+            uint32_t success_end = 1 + data->if_stmt.success_count;
+            int jmpn_step_start = emit_jmpn(b, 0);
+            int curr_instruction_count = b->code_size;
+            flat_gen_statements(ast, node, 1, success_end, b);
+            int jmpn_instruction_count = b->code_size - curr_instruction_count;
+            if (data->if_stmt.fail_count != -1) {
+                // required to skip the JMP generated by the else block
+                jmpn_instruction_count += 3;
+            }
+            patch_int(b, jmpn_instruction_count, jmpn_step_start);
+
+            if (data->if_stmt.fail_count != -1) {
+                int jmp_step_start = emit_jmp(b, 0);
+                int curr_instruction_count = b->code_size;
+                flat_gen_statements(ast, node, success_end, child_count, b);
+                patch_int(b, b->code_size - curr_instruction_count, jmp_step_start);
+            }
+            break;
+        }
+        case AST_WHILE: {
+            int jmp_start = b->code_size;
+            flat_gen_node(ast, flat_child(ast, node, 0), b);
+            int jmpn_idx = emit_jmpn(b, 0);
+
+            flat_gen_statements(ast, node, 1, child_count, b);
+
+            emit_jmp(b, jmp_start - b->code_size - 3);
+            patch_int(b, b->code_size - (jmpn_idx + 2), jmpn_idx);
+            break;
+        }
+        case AST_ARRAY:
+            flat_gen_children(ast, node, 0, child_count, b);
+
+            emit_byte(b, OP_PUSH_ARRAY);
+            emit_byte(b, (child_count >> 8) & 0xFF);
+            emit_byte(b, child_count & 0xFF);
+            break;
+        case AST_ARRAY_INDEX:
+            // index before array
+            flat_gen_node(ast, flat_child(ast, node, 1), b);
+            flat_gen_node(ast, flat_child(ast, node, 0), b);
+            emit_byte(b, OP_ARRLOADIDX);
+            break;
+        case AST_ARRAY_INDEX_ASSIGN: {
+            NodeIndex arr_index = flat_child(ast, node, 0);
+            flat_gen_node(ast, flat_child(ast, arr_index, 1), b);
+            flat_gen_node(ast, flat_child(ast, arr_index, 0), b);
+            flat_gen_node(ast, flat_child(ast, node, 1), b);
+            emit_byte(b, OP_ARRSTOREIDX);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void flat_bytecode_gen(FlatAst* ast, BytecodeEmitter* b) {
+    if (ast->root == FLAT_NONE) return;
+    flat_gen_node(ast, ast->root, b);
+}
+
+static bool is_dedupable(StackValue val) {
+    return val.type.nested == -1 && (val.type.base_type == VALUE_INT || val.type.base_type == VALUE_STRING);
+}
+
+static uint32_t hash_const(StackValue val) {
+    if (val.type.base_type == VALUE_INT) {
+        // fibonacci hashing, so small sequential ints spread over the table
+        return (uint32_t) val.int_val * 2654435769u;
+    }
+
+    // fnv-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < val.string_val->len; i++) {
+        hash ^= (uint8_t) val.string_val->string_val[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool const_equals(StackValue a, StackValue b) {
+    if (a.type.base_type != b.type.base_type || a.type.nested != b.type.nested) return false;
+    if (a.type.base_type == VALUE_INT) return a.int_val == b.int_val;
+    return a.string_val->len == b.string_val->len && memcmp(a.string_val->string_val, b.string_val->string_val, a.string_val->len) == 0;
+}
+
+static int append_const(BytecodeEmitter* b, StackValue val, uint32_t hash) {
+    if (b->const_count > CONST_WIDE_MAX) {
+        fprintf(stderr, "too many constants, the limit is %d\n", CONST_WIDE_MAX + 1);
+        exit(1);
+    }
     if (b->const_count >= b->const_capacity) {
         bytecode_resize_const(b);
     }
 
     b->constants[b->const_count] = val;
+    b->const_hashes[b->const_count] = hash;
     return b->const_count++;
 }
 
+// returns the index of the constant equal to val, or -1 with *slot set to where it should be inserted
+static int find_const(BytecodeEmitter* b, StackValue val, uint32_t hash, uint32_t* slot) {
+    // kept at most half full so probe chains stay short
+    if ((b->const_count + 1) * 2 > b->const_slot_capacity) {
+        bytecode_resize_const_slots(b);
+    }
+
+    uint32_t idx = hash & (b->const_slot_capacity - 1);
+    while (b->const_slots[idx]) {
+        int existing = b->const_slots[idx] - 1;
+        if (b->const_hashes[existing] == hash && const_equals(b->constants[existing], val)) {
+            return existing;
+        }
+        idx = (idx + 1) & (b->const_slot_capacity - 1);
+    }
+    *slot = idx;
+    return -1;
+}
+
+int add_const(BytecodeEmitter* b, StackValue val) {
+    if (!is_dedupable(val)) {
+        return append_const(b, val, 0);
+    }
+
+    uint32_t hash = hash_const(val);
+    uint32_t slot;
+    int existing = find_const(b, val, hash, &slot);
+    if (existing != -1) {
+        return existing;
+    }
+
+    int idx = append_const(b, val, hash);
+    b->const_slots[slot] = idx + 1;
+    return idx;
+}
+
+// OP_PUSH/OP_PUSH_STRING with a 16-bit index, or their wide forms once the pool outgrows that
+static void emit_push_const(BytecodeEmitter* b, BytecodeOp op, BytecodeOp wide_op, int idx) {
+    if (idx > CONST_NARROW_MAX) {
+        emit_byte(b, wide_op);
+        emit_byte(b, (idx >> 16) & 0xFF);
+    } else {
+        emit_byte(b, op);
+    }
+    emit_byte(b, (idx >> 8) & 0xFF);
+    emit_byte(b, idx & 0xFF);
+}
+
 void emit_push_int(BytecodeEmitter* b, int val) {
+    // small ints are encoded in the instruction so they don't touch the constant pool
+    if (val == 0) {
+        emit_byte(b, OP_PUSH_0);
+        return;
+    }
+    if (val == 1) {
+        emit_byte(b, OP_PUSH_1);
+        return;
+    }
+    if (val >= INT8_MIN && val <= INT8_MAX) {
+        emit_byte(b, OP_PUSH_I8);
+        emit_byte(b, (uint8_t) val);
+        return;
+    }
+    if (val >= INT16_MIN && val <= INT16_MAX) {
+        emit_byte(b, OP_PUSH_I16);
+        emit_byte(b, (val >> 8) & 0xFF);
+        emit_byte(b, val & 0xFF);
+        return;
+    }
+
     VarType int_type = {.base_type = VALUE_INT, .nested = -1};
     StackValue sv = {.type = int_type, .int_val = val};
-    uint16_t idx = add_const(b, sv);
-    emit_byte(b, OP_PUSH);
-    emit_byte(b, (idx >> 8) & 0xFF);
-    emit_byte(b, idx & 0xFF);
+    int idx = add_const(b, sv);
+    emit_push_const(b, OP_PUSH, OP_PUSH_W, idx);
 }
 
 void emit_push_bool(BytecodeEmitter* b, bool val) {
@@ -252,6 +559,49 @@ void emit_byte(BytecodeEmitter* b, uint8_t val) {
     b->code[b->code_size++] = val;
 }
 
+void emit_binary_op(BytecodeEmitter* b, TokenType op, VarType leftType) {
+    switch (op) {
+        case TOK_PLUS: {
+            if (leftType.nested != -1) {
+                emit_byte(b, OP_ARRAPPEND);
+            } else if (leftType.base_type == VALUE_INT && leftType.nested == -1) {
+                emit_byte(b, OP_IADD);
+            } else if (leftType.base_type == VALUE_STRING && leftType.nested == -1) {
+                emit_byte(b, OP_SCONCAT);
+            }
+            break;
+        }
+        case TOK_MINUS: emit_byte(b, OP_ISUB); break;
+        case TOK_MULT: emit_byte(b, OP_IMUL); break;
+        case TOK_DIV: emit_byte(b, OP_IDIV); break;
+        case TOK_GREATER: emit_byte(b, OP_IGT); b->fusable_cmp_end = b->code_size; break;
+        case TOK_LESS: emit_byte(b, OP_ILT); b->fusable_cmp_end = b->code_size; break;
+        case TOK_GREATER_EQUALS: emit_byte(b, OP_IGTE); b->fusable_cmp_end = b->code_size; break;
+        case TOK_LESS_EQUALS: emit_byte(b, OP_ILTE); b->fusable_cmp_end = b->code_size; break;
+        case TOK_MODULO: emit_byte(b, OP_IMOD); break;
+        case TOK_EQUALS: {
+            // can just check the left node as type checker should catch cases where it's not the same type on both sides
+            if (leftType.base_type == VALUE_INT && leftType.nested == -1) {
+                emit_byte(b, OP_IEQ);
+                b->fusable_cmp_end = b->code_size;
+            } else if (leftType.base_type == VALUE_BOOL && leftType.nested == -1) {
+                emit_byte(b, OP_BEQ);
+            }
+            break;
+        }
+        case TOK_NOT_EQUALS: {
+            if (leftType.base_type == VALUE_INT && leftType.nested == -1) {
+                emit_byte(b, OP_INEQ);
+                b->fusable_cmp_end = b->code_size;
+            } else if (leftType.base_type == VALUE_BOOL && leftType.nested == -1) {
+                emit_byte(b, OP_BNEQ);
+            }
+            break;
+        }
+        default: break;
+    }
+}
+
 void emit_store(BytecodeEmitter* b, VarType type, int slot) {
     if (type.nested != -1) {
         emit_byte(b, OP_ARRSTORE);
@@ -323,12 +673,47 @@ void emit_icompound_assignment(BytecodeEmitter* b, TokenType op, int slot) {
     emit_byte(b, slot & 0xFF);
 }
 
+bool emit_iinc(BytecodeEmitter* b, TokenType op, int slot, int k) {
+    if (op == TOK_MINUS_EQUALS) {
+        if (k == INT8_MIN) return false;
+        k = -k;
+    } else if (op != TOK_PLUS_EQUALS) {
+        return false;
+    }
+    if (k < INT8_MIN || k > INT8_MAX) return false;
+
+    emit_byte(b, OP_IINC);
+    emit_byte(b, (slot >> 8) & 0xFF);
+    emit_byte(b, slot & 0xFF);
+    emit_byte(b, (uint8_t) k);
+    return true;
+}
+
+static BytecodeOp fused_cmp_jmpn(uint8_t cmp) {
+    switch (cmp) {
+        case OP_IGT: return OP_IGT_JMPN;
+        case OP_IGTE: return OP_IGTE_JMPN;
+        case OP_ILT: return OP_ILT_JMPN;
+        case OP_ILTE: return OP_ILTE_JMPN;
+        case OP_IEQ: return OP_IEQ_JMPN;
+        default: return OP_INEQ_JMPN;
+    }
+}
+
 int emit_jmpn(BytecodeEmitter* b, int steps) {
-    emit_byte(b, OP_JMPN);
+    if (b->fusable_cmp_end == b->code_size) {
+        // the comparison's bool would only be pushed to be popped again by the jump
+        b->code_size--;
+        emit_byte(b, fused_cmp_jmpn(b->code[b->code_size]));
+    } else {
+        emit_byte(b, OP_JMPN);
+    }
+    b->fusable_cmp_end = -1;
 
     int idx = b->code_size;
-    emit_byte(b, (steps >> 8) & 0xFF);
-    emit_byte(b, steps & 0xFF);
+    emit_byte(b, 0);
+    emit_byte(b, 0);
+    patch_int(b, steps, idx);
     return idx;
 }
 
@@ -336,8 +721,9 @@ int emit_jmpt(BytecodeEmitter* b, int steps) {
     emit_byte(b, OP_JMPT);
 
     int idx = b->code_size;
-    emit_byte(b, (steps >> 8) & 0xFF);
-    emit_byte(b, steps & 0xFF);
+    emit_byte(b, 0);
+    emit_byte(b, 0);
+    patch_int(b, steps, idx);
     return idx;
 }
 
@@ -345,27 +731,202 @@ int emit_jmp(BytecodeEmitter* b, int steps) {
     emit_byte(b, OP_JMP);
 
     int idx = b->code_size;
-    emit_byte(b, (steps >> 8) & 0xFF);
-    emit_byte(b, steps & 0xFF);
+    emit_byte(b, 0);
+    emit_byte(b, 0);
+    patch_int(b, steps, idx);
     return idx;
 }
 
+static int find_far_jump(BytecodeEmitter* b, int at) {
+    for (int i = 0; i < b->far_jump_count; i++) {
+        if (b->far_jumps[i].at == at) return i;
+    }
+    return -1;
+}
+
 void patch_int(BytecodeEmitter* b, int new_val, int starts_at) {
+    // a jump may now land right after the last comparison, so it can't be fused away anymore
+    b->fusable_cmp_end = -1;
+
+    int far = find_far_jump(b, starts_at);
+    if (new_val < INT16_MIN || new_val > INT16_MAX) {
+        if (far == -1) {
+            if (b->far_jump_count == b->far_jump_capacity) {
+                int new_capacity = b->far_jump_capacity > 0 ? b->far_jump_capacity * 2 : 8;
+                FarJump* new_far_jumps = realloc(b->far_jumps, new_capacity * sizeof(FarJump));
+                if (!new_far_jumps) {
+                    fprintf(stderr, "failed to realloc far jumps arr\n");
+                    exit(1);
+                }
+                b->far_jumps = new_far_jumps;
+                b->far_jump_capacity = new_capacity;
+            }
+            far = b->far_jump_count++;
+        }
+        b->far_jumps[far].at = starts_at;
+        b->far_jumps[far].steps = new_val;
+        new_val = 0;
+    } else if (far != -1) {
+        b->far_jumps[far] = b->far_jumps[--b->far_jump_count];
+    }
+
     b->code[starts_at] = (new_val >> 8) & 0xFF;
     b->code[starts_at + 1] = new_val & 0xFF;
 }
 
-void emit_push_string(BytecodeEmitter* b, char* str) {
-    StringValue* strv = malloc(sizeof(StringValue));
-    strv->string_val = strdup(str);
-    strv->len = strlen(str);
-    strv->ref_count = 1;
+int jump_steps_at(BytecodeEmitter* b, int starts_at) {
+    int far = find_far_jump(b, starts_at);
+    if (far != -1) return b->far_jumps[far].steps;
+    return (int16_t) ((b->code[starts_at] << 8) | b->code[starts_at + 1]);
+}
+
+void emit_iload_iload_iadd(BytecodeEmitter* b, int slot_a, int slot_b) {
+    emit_byte(b, OP_ILOAD_ILOAD_IADD);
+    emit_byte(b, (slot_a >> 8) & 0xFF);
+    emit_byte(b, slot_a & 0xFF);
+    emit_byte(b, (slot_b >> 8) & 0xFF);
+    emit_byte(b, slot_b & 0xFF);
+}
+
+bool emit_iload_push_ilt(BytecodeEmitter* b, int slot, int k) {
+    if (k < INT16_MIN || k > INT16_MAX) return false;
+
+    emit_byte(b, OP_ILOAD_PUSH_ILT);
+    emit_byte(b, (slot >> 8) & 0xFF);
+    emit_byte(b, slot & 0xFF);
+    emit_byte(b, (k >> 8) & 0xFF);
+    emit_byte(b, k & 0xFF);
+    return true;
+}
+
+int add_string_const(BytecodeEmitter* b, const char* str, int len) {
+    // looked up before copying, so repeats of a literal don't allocate at all
+    StringValue key = {.string_val = (char*) str, .len = len, .ref_count = 0};
     VarType string_type = {.base_type = VALUE_STRING, .nested = -1};
-    StackValue sv = {.type = string_type , .string_val = strv};
+    StackValue key_sv = {.type = string_type, .string_val = &key};
+
+    uint32_t hash = hash_const(key_sv);
+    uint32_t slot;
+    int idx = find_const(b, key_sv, hash, &slot);
+    if (idx == -1) {
+        StringValue* strv = malloc(sizeof(StringValue));
+        strv->string_val = malloc(len + 1);
+        memcpy(strv->string_val, str, len);
+        strv->string_val[len] = '\0';
+        strv->len = len;
+        // the pool's own reference, so the constant outlives every value pushed from it
+        strv->ref_count = 1;
+        StackValue sv = {.type = string_type , .string_val = strv};
+
+        idx = append_const(b, sv, hash);
+        b->const_slots[slot] = idx + 1;
+    }
+    return idx;
+}
 
-    uint16_t idx = add_const(b, sv);
+void emit_push_string(BytecodeEmitter* b, const char* str, int len) {
+    emit_push_const(b, OP_PUSH_STRING, OP_PUSH_STRING_W, add_string_const(b, str, len));
+}
 
-    emit_byte(b, OP_PUSH_STRING);
-    emit_byte(b, (idx >> 8) & 0xFF);
-    emit_byte(b, idx & 0xFF);
+static uint32_t word(uint8_t op, int a) {
+    return op | ((uint32_t) a & 0xFFFFFF) << 8;
+}
+
+static uint32_t word_ab(uint8_t op, int a, int b) {
+    return op | ((uint32_t) a & 0xFFF) << 8 | ((uint32_t) b & 0xFFF) << 20;
+}
+
+static bool fits_word_slot(int slot) {
+    return slot <= WORD_SLOT_MAX;
+}
+
+static bool fits_word_imm(int k) {
+    return k >= WORD_IMM_MIN && k <= WORD_IMM_MAX;
+}
+
+// a two operand instruction whose operands don't fit in a word is split back into the instructions it fuses
+static int word_count(DecodedInstr* instr) {
+    switch (instr->op) {
+        case OP_IINC:
+            return fits_word_slot(instr->a) ? 1 : 2;
+        case OP_ILOAD_ILOAD_IADD:
+            return fits_word_slot(instr->a) && fits_word_slot(instr->b) ? 1 : 3;
+        case OP_ILOAD_PUSH_ILT:
+            return fits_word_slot(instr->a) && fits_word_imm(instr->b) ? 1 : 3;
+        default:
+            return 1;
+    }
+}
+
+uint32_t* bytecode_emit_words(BytecodeEmitter* b, int* count) {
+    int n;
+    DecodedInstr* instrs = bytecode_decode(b, &n);
+    // index of the first word of each instruction
+    int* word_at = malloc(sizeof(int) * (n + 1));
+    if (!word_at) {
+        fprintf(stderr, "failed to malloc word offsets\n");
+        exit(1);
+    }
+    int size = 0;
+    for (int i = 0; i < n; i++) {
+        word_at[i] = size;
+        size += word_count(&instrs[i]);
+    }
+    word_at[n] = size;
+
+    uint32_t* words = malloc(sizeof(uint32_t) * (size > 0 ? size : 1));
+    if (!words) {
+        fprintf(stderr, "failed to malloc words arr\n");
+        exit(1);
+    }
+
+    int pos = 0;
+    for (int i = 0; i < n; i++) {
+        DecodedInstr* instr = &instrs[i];
+        if (bytecode_is_jump(instr->op)) {
+            int steps = word_at[instr->target] - (pos + 1);
+            if (steps < WORD_JUMP_MIN || steps > WORD_JUMP_MAX) {
+                fprintf(stderr, "jump of %d words doesn't fit in the word format\n", steps);
+                exit(1);
+            }
+            words[pos++] = word(instr->op, steps);
+            continue;
+        }
+
+        if (word_count(instr) == 1) {
+            switch (bytecode_operand_format(instr->op)) {
+                case OPERAND_U16_I8:
+                case OPERAND_U16_U16:
+                case OPERAND_U16_I16:
+                    words[pos++] = word_ab(instr->op, instr->a, instr->b);
+                    break;
+                default:
+                    words[pos++] = word(instr->op, instr->a);
+                    break;
+            }
+            continue;
+        }
+
+        switch (instr->op) {
+            case OP_IINC:
+                words[pos++] = word(OP_PUSH_I8, instr->b);
+                words[pos++] = word(OP_IADDSTORE, instr->a);
+                break;
+            case OP_ILOAD_ILOAD_IADD:
+                words[pos++] = word(OP_ILOAD, instr->a);
+                words[pos++] = word(OP_ILOAD, instr->b);
+                words[pos++] = word(OP_IADD, 0);
+                break;
+            case OP_ILOAD_PUSH_ILT:
+                words[pos++] = word(OP_ILOAD, instr->a);
+                words[pos++] = word(OP_PUSH_I16, instr->b);
+                words[pos++] = word(OP_ILT, 0);
+                break;
+        }
+    }
+
+    free(word_at);
+    free(instrs);
+    *count = size;
+    return words;
 }
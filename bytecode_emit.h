@@ -2,11 +2,18 @@
 #define GRBLANG_BYTECODE_EMIT_H
 #include <stdint.h>
 
+#include "flat_ast.h"
 #include "lexer.h"
 #include "parser.h"
 #include "resolver.h"
 #include "stack.h"
 
+typedef struct {
+    // offset of the jump's operand
+    int at;
+    int steps;
+} FarJump;
+
 typedef struct {
     uint8_t* code;
     int code_size;
@@ -15,8 +22,27 @@ typedef struct {
     StackValue* constants;
     int const_count;
     int const_capacity;
+
+    // open addressing table of constant index + 1, 0 marks an empty slot. equal int & string literals share one constant
+    uint32_t* const_slots;
+    uint32_t* const_hashes;
+    int const_slot_capacity;
+
+    // code_size right after emit_binary_op emitted an int comparison, -1 otherwise. emit_jmpn fuses that comparison
+    // into the jump if nothing, not even a jump target, has been placed after it since
+    int fusable_cmp_end;
+
+    // jumps whose steps don't fit in their 16-bit operand. the operand is left as 0 & the real steps are kept here until
+    // bytecode_encode gives the jump its wide form, so the code can't run before it's been through bytecode_encode
+    FarJump* far_jumps;
+    int far_jump_count;
+    int far_jump_capacity;
 } BytecodeEmitter;
 
+// constants past this need the wide push instructions, which take a 24-bit index
+#define CONST_NARROW_MAX 0xFFFF
+#define CONST_WIDE_MAX 0xFFFFFF
+
 typedef enum {
     OP_PUSH, // 0
     OP_PUSH_TRUE, // true // 1
@@ -57,33 +83,108 @@ typedef enum {
     OP_ARRLOADIDX, // 36
     OP_ARRSTOREIDX, // 37
     OP_ARRAPPEND, // 38
+    OP_PUSH_W, // 24-bit constant index // 39
+    OP_PUSH_STRING_W, // 40
+    OP_PUSH_0, // 41
+    OP_PUSH_1, // 42
+    OP_PUSH_I8, // signed immediate // 43
+    OP_PUSH_I16, // 44
+    OP_IINC, // slot, signed 8-bit immediate // 45
+    // superinstructions, the compare & jump ones pop two ints & jump when the comparison is false
+    OP_IGT_JMPN, // 46
+    OP_IGTE_JMPN, // 47
+    OP_ILT_JMPN, // 48
+    OP_ILTE_JMPN, // 49
+    OP_IEQ_JMPN, // 50
+    OP_INEQ_JMPN, // 51
+    OP_ILOAD_ILOAD_IADD, // slot, slot // 52
+    OP_ILOAD_PUSH_ILT, // slot, signed 16-bit immediate // 53
+    OP_ISTORE_KEEP, // stores the top int without popping it // 54
+    // signed 32-bit steps, only emitted by bytecode_encode for jumps too far for the 16-bit ones
+    OP_JMP_W, // 55
+    OP_JMPN_W, // 56
+    OP_JMPT_W, // 57
+    OP_POP, // 58
+    // a division & a remainder by a power of two of a non negative int
+    OP_ISHR, // 59
+    OP_IAND, // 60
+    // the same as the checked ones, only emitted where the divisor is proven not 0 (nor -1 for INT_MIN) or the index in
+    // bounds
+    OP_IDIV_NC, // 61
+    OP_IMOD_NC, // 62
+    OP_ARRLOADIDX_NC, // 63
+    OP_ARRSTOREIDX_NC, // 64
+    // pops the value of an expression statement, the program's result unless another one runs after it
+    OP_RESULT, // 65
+    // never emitted, vm_init puts one after the last decoded instruction so vm_run can stop without checking pc
+    OP_HALT, // 66
+    OP_COUNT, // not an instruction, the number of opcodes
 } BytecodeOp;
 
 void bytecode_init(BytecodeEmitter* b);
+// code & constants are handed over to the vm, so this only frees what the emitter itself used while generating
+void free_bytecode_emitter(BytecodeEmitter* b);
 
 void bytecode_resize_code(BytecodeEmitter* b);
 void bytecode_resize_const(BytecodeEmitter* b);
 
 void bytecode_gen(ASTNode* node, BytecodeEmitter* b, Resolver* r);
+// the ast must have been through flat_resolve & flat_type_check
+void flat_bytecode_gen(FlatAst* ast, BytecodeEmitter* b);
 
-uint16_t add_const(BytecodeEmitter* b, StackValue val);
+// returns the index of val in the constant pool, reusing an existing int or string constant with the same value
+int add_const(BytecodeEmitter* b, StackValue val);
+// the same for a copy of str, which is only made if there's no equal string constant yet
+int add_string_const(BytecodeEmitter* b, const char* str, int len);
 
 void emit_push_int(BytecodeEmitter* b, int val);
 void emit_push_bool(BytecodeEmitter* b, bool val);
 void emit_byte(BytecodeEmitter* b, uint8_t val);
 
+// picks the instruction for op from the type of its left operand, for everything but && and || which need jumps
+void emit_binary_op(BytecodeEmitter* b, TokenType op, VarType leftType);
 void emit_store(BytecodeEmitter* b, VarType type, int slot);
 void emit_load(BytecodeEmitter* b, VarType type, int slot);
 
 void emit_icompound_assignment(BytecodeEmitter* b, TokenType op, int slot);
+// emits OP_IINC for slot += k or slot -= k, returns false if op or k can't be encoded that way
+bool emit_iinc(BytecodeEmitter* b, TokenType op, int slot, int k);
 
+// fuses with an int comparison emitted right before it, see fusable_cmp_end
 int emit_jmpn(BytecodeEmitter* b, int steps);
 int emit_jmpt(BytecodeEmitter* b, int steps);
 int emit_jmp(BytecodeEmitter* b, int steps);
 
-
+// steps that don't fit in 16 bits are recorded in far_jumps
 void patch_int(BytecodeEmitter* b, int new_value, int starts_at);
-
-void emit_push_string(BytecodeEmitter* b, char* str);
+// returns the steps of the jump whose operand is at starts_at, including far ones
+int jump_steps_at(BytecodeEmitter* b, int starts_at);
+
+// slot_a + slot_b in one instruction
+void emit_iload_iload_iadd(BytecodeEmitter* b, int slot_a, int slot_b);
+// slot < k in one instruction, returns false if k doesn't fit in the immediate
+bool emit_iload_push_ilt(BytecodeEmitter* b, int slot, int k);
+
+void emit_push_string(BytecodeEmitter* b, const char* str, int len);
+
+// the fixed width format, one 32-bit word per instruction: the opcode in the low 8 bits & the operand in the 24 above
+// it. the two operand instructions have a 12-bit slot then a 12-bit slot or signed immediate instead. a jump's operand
+// is its signed steps in words from the word after it
+#define WORD_OP(w) ((uint8_t) ((w) & 0xFF))
+#define WORD_A(w) ((int) ((w) >> 8))
+#define WORD_SIGNED_A(w) ((int32_t) (w) >> 8)
+#define WORD_AB_A(w) ((int) (((w) >> 8) & 0xFFF))
+#define WORD_AB_B(w) ((int) ((w) >> 20))
+#define WORD_AB_SIGNED_B(w) ((int32_t) (w) >> 20)
+
+#define WORD_SLOT_MAX 0xFFF
+#define WORD_IMM_MIN (-0x800)
+#define WORD_IMM_MAX 0x7FF
+#define WORD_JUMP_MIN (-0x800000)
+#define WORD_JUMP_MAX 0x7FFFFF
+
+// encodes b's code in the word format, also after free_bytecode_emitter. two operand instructions whose operands don't
+// fit are split back up. the caller frees the words
+uint32_t* bytecode_emit_words(BytecodeEmitter* b, int* count);
 
 #endif //GRBLANG_BYTECODE_EMIT_H
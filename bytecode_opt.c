@@ -0,0 +1,510 @@
+#include "bytecode_opt.h"
+#include "bytecode_emit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t operand_formats[OP_COUNT] = {
+    [OP_PUSH] = OPERAND_U16,
+    [OP_PUSH_ARRAY] = OPERAND_U16,
+    [OP_IADDSTORE] = OPERAND_U16,
+    [OP_ISUBSTORE] = OPERAND_U16,
+    [OP_IMULSTORE] = OPERAND_U16,
+    [OP_IDIVSTORE] = OPERAND_U16,
+    [OP_ISTORE] = OPERAND_U16,
+    [OP_ILOAD] = OPERAND_U16,
+    [OP_BSTORE] = OPERAND_U16,
+    [OP_BLOAD] = OPERAND_U16,
+    [OP_ARRSTORE] = OPERAND_U16,
+    [OP_ARRLOAD] = OPERAND_U16,
+    [OP_JMPN] = OPERAND_JUMP,
+    [OP_JMPT] = OPERAND_JUMP,
+    [OP_JMP] = OPERAND_JUMP,
+    [OP_PUSH_STRING] = OPERAND_U16,
+    [OP_SSTORE] = OPERAND_U16,
+    [OP_SLOAD] = OPERAND_U16,
+    [OP_PUSH_W] = OPERAND_U24,
+    [OP_PUSH_STRING_W] = OPERAND_U24,
+    [OP_PUSH_I8] = OPERAND_I8,
+    [OP_PUSH_I16] = OPERAND_I16,
+    [OP_IINC] = OPERAND_U16_I8,
+    [OP_IGT_JMPN] = OPERAND_JUMP,
+    [OP_IGTE_JMPN] = OPERAND_JUMP,
+    [OP_ILT_JMPN] = OPERAND_JUMP,
+    [OP_ILTE_JMPN] = OPERAND_JUMP,
+    [OP_IEQ_JMPN] = OPERAND_JUMP,
+    [OP_INEQ_JMPN] = OPERAND_JUMP,
+    [OP_ILOAD_ILOAD_IADD] = OPERAND_U16_U16,
+    [OP_ILOAD_PUSH_ILT] = OPERAND_U16_I16,
+    [OP_ISTORE_KEEP] = OPERAND_U16,
+    [OP_JMP_W] = OPERAND_JUMP_W,
+    [OP_JMPN_W] = OPERAND_JUMP_W,
+    [OP_JMPT_W] = OPERAND_JUMP_W,
+};
+
+static const uint8_t operand_lengths[] = {
+    [OPERAND_NONE] = 0,
+    [OPERAND_U16] = 2,
+    [OPERAND_JUMP] = 2,
+    [OPERAND_JUMP_W] = 4,
+    [OPERAND_U24] = 3,
+    [OPERAND_I8] = 1,
+    [OPERAND_I16] = 2,
+    [OPERAND_U16_I8] = 3,
+    [OPERAND_U16_U16] = 4,
+    [OPERAND_U16_I16] = 4,
+};
+
+typedef struct {
+    uint8_t pops;
+    uint8_t pushes;
+} StackEffect;
+
+// OP_PUSH_ARRAY's pops are its operand. everything left out neither pops nor pushes
+static const StackEffect stack_effects[OP_COUNT] = {
+    [OP_PUSH] = {0, 1},
+    [OP_PUSH_TRUE] = {0, 1},
+    [OP_PUSH_FALSE] = {0, 1},
+    [OP_PUSH_ARRAY] = {0, 1},
+    [OP_IADD] = {2, 1},
+    [OP_IADDSTORE] = {1, 0},
+    [OP_ISUB] = {2, 1},
+    [OP_ISUBSTORE] = {1, 0},
+    [OP_IMUL] = {2, 1},
+    [OP_IMULSTORE] = {1, 0},
+    [OP_IDIV] = {2, 1},
+    [OP_IDIVSTORE] = {1, 0},
+    [OP_INEG] = {1, 1},
+    [OP_IGT] = {2, 1},
+    [OP_IGTE] = {2, 1},
+    [OP_ILT] = {2, 1},
+    [OP_ILTE] = {2, 1},
+    [OP_IEQ] = {2, 1},
+    [OP_IMOD] = {2, 1},
+    [OP_BEQ] = {2, 1},
+    [OP_INEQ] = {2, 1},
+    [OP_BNEQ] = {2, 1},
+    [OP_ISTORE] = {1, 0},
+    [OP_ILOAD] = {0, 1},
+    [OP_BSTORE] = {1, 0},
+    [OP_BLOAD] = {0, 1},
+    [OP_ARRSTORE] = {1, 0},
+    [OP_ARRLOAD] = {0, 1},
+    [OP_NOT] = {1, 1},
+    [OP_JMPN] = {1, 0},
+    [OP_JMPT] = {1, 0},
+    [OP_PUSH_STRING] = {0, 1},
+    [OP_SCONCAT] = {2, 1},
+    [OP_SSTORE] = {1, 0},
+    [OP_SLOAD] = {0, 1},
+    [OP_ARRLOADIDX] = {2, 1},
+    [OP_ARRSTOREIDX] = {3, 0},
+    [OP_ARRAPPEND] = {2, 1},
+    [OP_PUSH_W] = {0, 1},
+    [OP_PUSH_STRING_W] = {0, 1},
+    [OP_PUSH_0] = {0, 1},
+    [OP_PUSH_1] = {0, 1},
+    [OP_PUSH_I8] = {0, 1},
+    [OP_PUSH_I16] = {0, 1},
+    [OP_IGT_JMPN] = {2, 0},
+    [OP_IGTE_JMPN] = {2, 0},
+    [OP_ILT_JMPN] = {2, 0},
+    [OP_ILTE_JMPN] = {2, 0},
+    [OP_IEQ_JMPN] = {2, 0},
+    [OP_INEQ_JMPN] = {2, 0},
+    [OP_ILOAD_ILOAD_IADD] = {0, 1},
+    [OP_ILOAD_PUSH_ILT] = {0, 1},
+    // peeks, so there has to be a value to store
+    [OP_ISTORE_KEEP] = {1, 1},
+    [OP_JMPN_W] = {1, 0},
+    [OP_JMPT_W] = {1, 0},
+    [OP_POP] = {1, 0},
+    [OP_ISHR] = {2, 1},
+    [OP_IAND] = {2, 1},
+    [OP_IDIV_NC] = {2, 1},
+    [OP_IMOD_NC] = {2, 1},
+    [OP_ARRLOADIDX_NC] = {2, 1},
+    [OP_ARRSTOREIDX_NC] = {3, 0},
+    [OP_RESULT] = {1, 0},
+};
+
+OperandFormat bytecode_operand_format(uint8_t op) {
+    if (op >= OP_COUNT) {
+        fprintf(stderr, "invalid opcode `%d` in bytecode\n", op);
+        exit(1);
+    }
+    return operand_formats[op];
+}
+
+int bytecode_op_length(uint8_t op) {
+    return 1 + operand_lengths[bytecode_operand_format(op)];
+}
+
+bool bytecode_is_jump(uint8_t op) {
+    OperandFormat format = bytecode_operand_format(op);
+    return format == OPERAND_JUMP || format == OPERAND_JUMP_W;
+}
+
+void bytecode_stack_effect(uint8_t op, int a, int* pops, int* pushes) {
+    *pops = op == OP_PUSH_ARRAY ? a : stack_effects[op].pops;
+    *pushes = stack_effects[op].pushes;
+}
+
+static uint8_t short_jump(uint8_t op) {
+    switch (op) {
+        case OP_JMP_W: return OP_JMP;
+        case OP_JMPN_W: return OP_JMPN;
+        case OP_JMPT_W: return OP_JMPT;
+        default: return op;
+    }
+}
+
+static uint8_t wide_jump(uint8_t op) {
+    switch (op) {
+        case OP_JMP: return OP_JMP_W;
+        case OP_JMPT: return OP_JMPT_W;
+        default: return OP_JMPN_W;
+    }
+}
+
+// the comparison a compare & jump does before its jump, OP_COUNT for the plain jumps
+static uint8_t jump_comparison(uint8_t op) {
+    switch (op) {
+        case OP_IGT_JMPN: return OP_IGT;
+        case OP_IGTE_JMPN: return OP_IGTE;
+        case OP_ILT_JMPN: return OP_ILT;
+        case OP_ILTE_JMPN: return OP_ILTE;
+        case OP_IEQ_JMPN: return OP_IEQ;
+        case OP_INEQ_JMPN: return OP_INEQ;
+        default: return OP_COUNT;
+    }
+}
+
+static uint8_t fused_jump(uint8_t cmp) {
+    switch (cmp) {
+        case OP_IGT: return OP_IGT_JMPN;
+        case OP_IGTE: return OP_IGTE_JMPN;
+        case OP_ILT: return OP_ILT_JMPN;
+        case OP_ILTE: return OP_ILTE_JMPN;
+        case OP_IEQ: return OP_IEQ_JMPN;
+        case OP_INEQ: return OP_INEQ_JMPN;
+        default: return OP_COUNT;
+    }
+}
+
+// a wide compare & jump is written as its comparison followed by OP_JMPN_W
+static int encoded_length(uint8_t op, bool wide) {
+    if (!wide) return bytecode_op_length(op);
+    return (jump_comparison(op) != OP_COUNT ? 1 : 0) + bytecode_op_length(OP_JMP_W);
+}
+
+static int read_u16(uint8_t* code) {
+    return (code[0] << 8) | code[1];
+}
+
+DecodedInstr* bytecode_decode(BytecodeEmitter* b, int* count) {
+    // instruction index starting at each byte offset, -1 for operand bytes
+    int* index_at = malloc(sizeof(int) * (b->code_size + 1));
+    DecodedInstr* instrs = malloc(sizeof(DecodedInstr) * (b->code_size > 0 ? b->code_size : 1));
+    if (!index_at || !instrs) {
+        fprintf(stderr, "failed to malloc decoded bytecode\n");
+        exit(1);
+    }
+    for (int i = 0; i <= b->code_size; i++) {
+        index_at[i] = -1;
+    }
+
+    int n = 0;
+    for (int offset = 0; offset < b->code_size; offset += bytecode_op_length(b->code[offset])) {
+        index_at[offset] = n++;
+    }
+    index_at[b->code_size] = n;
+
+    for (int offset = 0, i = 0; offset < b->code_size; offset += bytecode_op_length(b->code[offset]), i++) {
+        DecodedInstr* instr = &instrs[i];
+        uint8_t* operands = b->code + offset + 1;
+        // wide jumps decode as the short ones, bytecode_encode picks the form again from where they land
+        instr->op = short_jump(b->code[offset]);
+        instr->a = 0;
+        instr->b = 0;
+        instr->target = -1;
+        instr->offset = offset;
+        instr->deleted = false;
+
+        switch (bytecode_operand_format(instr->op)) {
+            case OPERAND_NONE:
+                break;
+            case OPERAND_U16:
+                instr->a = read_u16(operands);
+                break;
+            case OPERAND_JUMP:
+            case OPERAND_JUMP_W: {
+                int len = bytecode_op_length(b->code[offset]);
+                if (len == 3) {
+                    instr->a = jump_steps_at(b, offset + 1);
+                } else {
+                    instr->a = (int32_t) (((uint32_t) read_u16(operands) << 16) | read_u16(operands + 2));
+                }
+                long dest = (long) offset + len + instr->a;
+                if (dest < 0 || dest > b->code_size || index_at[dest] == -1) {
+                    fprintf(stderr, "invalid jump from offset %d to %ld in bytecode\n", offset, dest);
+                    exit(1);
+                }
+                instr->target = index_at[dest];
+                break;
+            }
+            case OPERAND_U24:
+                instr->a = (operands[0] << 16) | read_u16(operands + 1);
+                break;
+            case OPERAND_I8:
+                instr->a = (int8_t) operands[0];
+                break;
+            case OPERAND_I16:
+                instr->a = (int16_t) read_u16(operands);
+                break;
+            case OPERAND_U16_I8:
+                instr->a = read_u16(operands);
+                instr->b = (int8_t) operands[2];
+                break;
+            case OPERAND_U16_U16:
+                instr->a = read_u16(operands);
+                instr->b = read_u16(operands + 2);
+                break;
+            case OPERAND_U16_I16:
+                instr->a = read_u16(operands);
+                instr->b = (int16_t) read_u16(operands + 2);
+                break;
+        }
+    }
+
+    free(index_at);
+    *count = n;
+    return instrs;
+}
+
+// new byte offset of every instruction, a deleted one gets the offset of the next one that's kept. returns the code size
+static int layout(DecodedInstr* instrs, int count, bool* wide, int* new_offsets) {
+    int size = 0;
+    for (int i = 0; i < count; i++) {
+        new_offsets[i] = size;
+        if (!instrs[i].deleted) {
+            size += encoded_length(instrs[i].op, wide[i]);
+        }
+    }
+    new_offsets[count] = size;
+    return size;
+}
+
+static int jump_steps(DecodedInstr* instrs, int i, bool* wide, int* new_offsets) {
+    return new_offsets[instrs[i].target] - (new_offsets[i] + encoded_length(instrs[i].op, wide[i]));
+}
+
+void bytecode_encode(BytecodeEmitter* b, DecodedInstr* instrs, int count) {
+    int* new_offsets = malloc(sizeof(int) * (count + 1));
+    bool* wide = calloc(count > 0 ? count : 1, sizeof(bool));
+    if (!new_offsets || !wide) {
+        fprintf(stderr, "failed to malloc bytecode offsets\n");
+        exit(1);
+    }
+
+    // every jump starts short & is widened once its steps don't fit. widening only ever moves code further apart, so
+    // this stops once a layout needs no more wide jumps
+    int size;
+    bool widened = true;
+    while (widened) {
+        size = layout(instrs, count, wide, new_offsets);
+        widened = false;
+        for (int i = 0; i < count; i++) {
+            if (instrs[i].deleted || wide[i] || !bytecode_is_jump(instrs[i].op)) continue;
+            int steps = jump_steps(instrs, i, wide, new_offsets);
+            if (steps < INT16_MIN || steps > INT16_MAX) {
+                wide[i] = true;
+                widened = true;
+            }
+        }
+    }
+
+    uint8_t* code = malloc(size > 0 ? size : 1);
+    if (!code) {
+        fprintf(stderr, "failed to malloc bytecode arr\n");
+        exit(1);
+    }
+
+    int pos = 0;
+    for (int i = 0; i < count; i++) {
+        DecodedInstr* instr = &instrs[i];
+        if (instr->deleted) continue;
+
+        int a = instr->a;
+        if (bytecode_is_jump(instr->op)) {
+            a = jump_steps(instrs, i, wide, new_offsets);
+        }
+
+        if (wide[i]) {
+            if (jump_comparison(instr->op) != OP_COUNT) {
+                code[pos++] = jump_comparison(instr->op);
+            }
+            code[pos++] = wide_jump(instr->op);
+            code[pos++] = (a >> 24) & 0xFF;
+            code[pos++] = (a >> 16) & 0xFF;
+            code[pos++] = (a >> 8) & 0xFF;
+            code[pos++] = a & 0xFF;
+            continue;
+        }
+
+        code[pos++] = instr->op;
+        switch (bytecode_operand_format(instr->op)) {
+            case OPERAND_NONE:
+            case OPERAND_JUMP_W:
+                break;
+            case OPERAND_I8:
+                code[pos++] = a & 0xFF;
+                break;
+            case OPERAND_U24:
+                code[pos++] = (a >> 16) & 0xFF;
+                // fallthrough
+            case OPERAND_U16:
+            case OPERAND_JUMP:
+            case OPERAND_I16:
+                code[pos++] = (a >> 8) & 0xFF;
+                code[pos++] = a & 0xFF;
+                break;
+            case OPERAND_U16_I8:
+                code[pos++] = (a >> 8) & 0xFF;
+                code[pos++] = a & 0xFF;
+                code[pos++] = instr->b & 0xFF;
+                break;
+            case OPERAND_U16_U16:
+            case OPERAND_U16_I16:
+                code[pos++] = (a >> 8) & 0xFF;
+                code[pos++] = a & 0xFF;
+                code[pos++] = (instr->b >> 8) & 0xFF;
+                code[pos++] = instr->b & 0xFF;
+                break;
+        }
+    }
+
+    free(new_offsets);
+    free(wide);
+    free(b->code);
+    b->code = code;
+    b->code_size = size;
+    b->code_capacity = size > 0 ? size : 1;
+    // offsets have all moved, so nothing emitted before can be fused with anymore
+    b->fusable_cmp_end = -1;
+    // & every far jump is in the code itself now
+    b->far_jump_count = 0;
+}
+
+static int next_live(DecodedInstr* instrs, int count, int i) {
+    i++;
+    while (i < count && instrs[i].deleted) {
+        i++;
+    }
+    return i;
+}
+
+// one pass over the code, returns true if anything was rewritten
+static bool peephole_pass(DecodedInstr* instrs, int count, bool* is_target) {
+    // jumps to deleted instructions really land on the next one that's kept
+    memset(is_target, 0, sizeof(bool) * (count + 1));
+    for (int i = 0; i < count; i++) {
+        if (instrs[i].deleted || instrs[i].target == -1) continue;
+        if (instrs[i].target < count && instrs[instrs[i].target].deleted) {
+            instrs[i].target = next_live(instrs, count, instrs[i].target);
+        }
+        is_target[instrs[i].target] = true;
+    }
+
+    bool changed = false;
+    for (int i = next_live(instrs, count, -1); i < count; i = next_live(instrs, count, i)) {
+        DecodedInstr* instr = &instrs[i];
+        int j = next_live(instrs, count, i);
+
+        // JMP +0
+        if (instr->op == OP_JMP && instr->target == j) {
+            instr->deleted = true;
+            changed = true;
+            continue;
+        }
+
+        // everything else merges the next instruction into this one, which can't happen if something jumps between them
+        if (j == count || is_target[j]) continue;
+        DecodedInstr* next = &instrs[j];
+
+        switch (instr->op) {
+            case OP_ISTORE:
+                // ISTORE s; ILOAD s -> ISTORE_KEEP s
+                if (next->op == OP_ILOAD && next->a == instr->a) {
+                    instr->op = OP_ISTORE_KEEP;
+                    next->deleted = true;
+                    changed = true;
+                }
+                break;
+            case OP_PUSH_TRUE:
+            case OP_PUSH_FALSE: {
+                // a branch on a constant either always jumps or never does
+                if (next->op != OP_JMPN && next->op != OP_JMPT) break;
+                bool jumps = (instr->op == OP_PUSH_TRUE) == (next->op == OP_JMPT);
+                if (jumps) {
+                    instr->op = OP_JMP;
+                    instr->target = next->target;
+                } else {
+                    instr->deleted = true;
+                }
+                next->deleted = true;
+                changed = true;
+                break;
+            }
+            case OP_IGT:
+            case OP_IGTE:
+            case OP_ILT:
+            case OP_ILTE:
+            case OP_IEQ:
+            case OP_INEQ:
+                // the comparisons the emitter couldn't fuse, like one a jump had been patched to land after
+                if (next->op == OP_JMPN) {
+                    instr->op = fused_jump(instr->op);
+                    instr->target = next->target;
+                    next->deleted = true;
+                    changed = true;
+                }
+                break;
+            case OP_NOT:
+                // NOT; JMPN -> JMPT & the other way round
+                if (next->op == OP_JMPN || next->op == OP_JMPT) {
+                    instr->op = next->op == OP_JMPN ? OP_JMPT : OP_JMPN;
+                    instr->target = next->target;
+                    next->deleted = true;
+                    changed = true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return changed;
+}
+
+void peephole_optimize(BytecodeEmitter* b) {
+    int count;
+    DecodedInstr* instrs = bytecode_decode(b, &count);
+    bool* is_target = malloc(sizeof(bool) * (count + 1));
+    if (!is_target) {
+        fprintf(stderr, "failed to malloc jump targets\n");
+        exit(1);
+    }
+
+    // a rewrite can expose another, like a JMP +0 left behind by a deleted branch
+    bool changed = false;
+    while (peephole_pass(instrs, count, is_target)) {
+        changed = true;
+    }
+    if (changed || b->far_jump_count > 0) {
+        bytecode_encode(b, instrs, count);
+    }
+
+    free(is_target);
+    free(instrs);
+}
@@ -0,0 +1,53 @@
+#ifndef GRBLANG_BYTECODE_OPT_H
+#define GRBLANG_BYTECODE_OPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bytecode_emit.h"
+
+// how an instruction's operand bytes are laid out, all multi byte operands are big endian
+typedef enum {
+    OPERAND_NONE,
+    OPERAND_U16, // slot, constant index or array length
+    OPERAND_JUMP, // signed 16-bit offset from the end of the instruction
+    OPERAND_JUMP_W, // signed 32-bit offset from the end of the instruction
+    OPERAND_U24, // wide constant index
+    OPERAND_I8,
+    OPERAND_I16,
+    OPERAND_U16_I8, // slot, immediate
+    OPERAND_U16_U16, // slot, slot
+    OPERAND_U16_I16, // slot, immediate
+} OperandFormat;
+
+OperandFormat bytecode_operand_format(uint8_t op);
+// including the opcode byte
+int bytecode_op_length(uint8_t op);
+bool bytecode_is_jump(uint8_t op);
+// how many values op pops off the stack & then pushes, a is its decoded operand as OP_PUSH_ARRAY pops that many
+void bytecode_stack_effect(uint8_t op, int a, int* pops, int* pushes);
+
+typedef struct {
+    uint8_t op;
+    // decoded operands, b is only used by the two operand formats
+    int a;
+    int b;
+    // index of the instruction a jump lands on, -1 for everything else. a jump to the end of the code targets count
+    int target;
+    // byte offset it was decoded from
+    int offset;
+    // set by passes to drop it when re-encoding, jumps to it land on the next instruction that's kept
+    bool deleted;
+} DecodedInstr;
+
+// decodes all of b's code, jump offsets are resolved to instruction indices. wide jumps decode as their short op (a
+// wide compare & jump as its comparison then OP_JMPN). the caller frees the returned array
+DecodedInstr* bytecode_decode(BytecodeEmitter* b, int* count);
+// replaces b's code with instrs, recomputing every jump offset from the targets. jumps get the short form wherever
+// their steps fit & the wide one everywhere else
+void bytecode_encode(BytecodeEmitter* b, DecodedInstr* instrs, int count);
+
+// rewrites redundant instruction windows in b's code until none are left, see bytecode_opt.c for the patterns
+void peephole_optimize(BytecodeEmitter* b);
+
+#endif //GRBLANG_BYTECODE_OPT_H
@@ -0,0 +1,168 @@
+#include "cfg.h"
+#include "bytecode_emit.h"
+#include "bytecode_opt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int next_live(DecodedInstr* instrs, int count, int i) {
+    i++;
+    while (i < count && instrs[i].deleted) {
+        i++;
+    }
+    return i;
+}
+
+void cfg_build(CFG* cfg, DecodedInstr* instrs, int count) {
+    bool* leader = calloc(count + 1, sizeof(bool));
+    cfg->block_of = malloc(sizeof(int) * (count > 0 ? count : 1));
+    if (!leader || !cfg->block_of) {
+        fprintf(stderr, "failed to malloc cfg\n");
+        exit(1);
+    }
+
+    // a block starts at the first instruction, at every jump target & right after every jump
+    leader[next_live(instrs, count, -1)] = true;
+    for (int i = 0; i < count; i++) {
+        if (instrs[i].deleted || !bytecode_is_jump(instrs[i].op)) continue;
+        int target = instrs[i].target;
+        if (target < count && instrs[target].deleted) target = next_live(instrs, count, target);
+        instrs[i].target = target;
+        leader[target] = true;
+        leader[next_live(instrs, count, i)] = true;
+    }
+
+    int block_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (leader[i] && !instrs[i].deleted) block_count++;
+    }
+    cfg->blocks = malloc(sizeof(BasicBlock) * (block_count > 0 ? block_count : 1));
+    if (!cfg->blocks) {
+        fprintf(stderr, "failed to malloc cfg blocks\n");
+        exit(1);
+    }
+    cfg->count = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (instrs[i].deleted) {
+            cfg->block_of[i] = -1;
+            continue;
+        }
+        if (leader[i]) {
+            if (cfg->count > 0) cfg->blocks[cfg->count - 1].end = i;
+            BasicBlock* block = &cfg->blocks[cfg->count++];
+            block->start = i;
+            block->succ[0] = -1;
+            block->succ[1] = -1;
+            block->reachable = false;
+        }
+        cfg->block_of[i] = cfg->count - 1;
+    }
+    if (cfg->count > 0) cfg->blocks[cfg->count - 1].end = count;
+
+    for (int k = 0; k < cfg->count; k++) {
+        BasicBlock* block = &cfg->blocks[k];
+        int last = block->start;
+        for (int i = block->start; i < block->end; i++) {
+            if (!instrs[i].deleted) last = i;
+        }
+
+        uint8_t op = instrs[last].op;
+        if (op != OP_JMP && k + 1 < cfg->count) {
+            block->succ[0] = k + 1;
+        }
+        // a jump to the end of the code leaves the program, which isn't a block
+        if (bytecode_is_jump(op) && instrs[last].target < count) {
+            block->succ[1] = cfg->block_of[instrs[last].target];
+        }
+    }
+
+    free(leader);
+}
+
+void cfg_mark_reachable(CFG* cfg) {
+    if (cfg->count == 0) return;
+
+    int* work = malloc(sizeof(int) * cfg->count);
+    if (!work) {
+        fprintf(stderr, "failed to malloc cfg worklist\n");
+        exit(1);
+    }
+    int work_count = 0;
+    cfg->blocks[0].reachable = true;
+    work[work_count++] = 0;
+
+    while (work_count > 0) {
+        BasicBlock* block = &cfg->blocks[work[--work_count]];
+        for (int s = 0; s < 2; s++) {
+            int succ = block->succ[s];
+            if (succ != -1 && !cfg->blocks[succ].reachable) {
+                cfg->blocks[succ].reachable = true;
+                work[work_count++] = succ;
+            }
+        }
+    }
+    free(work);
+}
+
+void free_cfg(CFG* cfg) {
+    free(cfg->blocks);
+    free(cfg->block_of);
+    cfg->blocks = NULL;
+    cfg->block_of = NULL;
+    cfg->count = 0;
+}
+
+// where a jump to target really ends up once every unconditional jump on the way is followed. the hops are capped so
+// a cycle of jumps (an empty infinite loop) just stops somewhere on it
+static int thread_target(DecodedInstr* instrs, int count, int target) {
+    for (int hops = 0; target < count && instrs[target].op == OP_JMP && hops < count; hops++) {
+        target = instrs[target].target;
+    }
+    return target;
+}
+
+void cfg_optimize(BytecodeEmitter* b) {
+    int count;
+    DecodedInstr* instrs = bytecode_decode(b, &count);
+    bool changed = false;
+
+    for (int i = 0; i < count; i++) {
+        if (!bytecode_is_jump(instrs[i].op)) continue;
+        int target = thread_target(instrs, count, instrs[i].target);
+        if (target != instrs[i].target) {
+            instrs[i].target = target;
+            changed = true;
+        }
+    }
+
+    CFG cfg;
+    cfg_build(&cfg, instrs, count);
+    cfg_mark_reachable(&cfg);
+    for (int k = 0; k < cfg.count; k++) {
+        BasicBlock* block = &cfg.blocks[k];
+        if (block->reachable) continue;
+        for (int i = block->start; i < block->end; i++) {
+            instrs[i].deleted = true;
+        }
+        changed = true;
+    }
+    free_cfg(&cfg);
+
+    // with the dead blocks gone a jump can end up landing right after itself. going backwards, a jump deleted here is
+    // already out of the way when the one before it is checked
+    for (int i = count - 1; i >= 0; i--) {
+        if (instrs[i].deleted || instrs[i].op != OP_JMP) continue;
+        int target = instrs[i].target;
+        if (target < count && instrs[target].deleted) target = next_live(instrs, count, target);
+        if (target == next_live(instrs, count, i)) {
+            instrs[i].deleted = true;
+            changed = true;
+        }
+    }
+
+    if (changed || b->far_jump_count > 0) {
+        bytecode_encode(b, instrs, count);
+    }
+    free(instrs);
+}
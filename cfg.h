@@ -0,0 +1,36 @@
+#ifndef GRBLANG_CFG_H
+#define GRBLANG_CFG_H
+
+#include <stdbool.h>
+
+#include "bytecode_emit.h"
+#include "bytecode_opt.h"
+
+typedef struct {
+    // the block's instructions are [start, end), deleted ones in that range included
+    int start;
+    int end;
+    // blocks control can go to next, -1 for none. succ[0] is the fallthrough, succ[1] where a jump lands
+    int succ[2];
+    bool reachable;
+} BasicBlock;
+
+typedef struct {
+    BasicBlock* blocks;
+    int count;
+    // block each instruction is in, -1 for deleted ones
+    int* block_of;
+} CFG;
+
+// splits the live instructions into basic blocks & links them, reachable is left false
+void cfg_build(CFG* cfg, DecodedInstr* instrs, int count);
+// marks every block that can run, starting from the first
+void cfg_mark_reachable(CFG* cfg);
+void free_cfg(CFG* cfg);
+
+// threads jumps to unconditional jumps straight to where those end up, deletes the blocks that can't run & the jumps to
+// the very next instruction that leaves. this is also where far jumps get their wide form, so it has to run before
+// the vm gets the code
+void cfg_optimize(BytecodeEmitter* b);
+
+#endif //GRBLANG_CFG_H
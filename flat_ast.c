@@ -0,0 +1,400 @@
+#include "flat_ast.h"
+#include "parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// child indices are collected here until their parent is added, nested nodes push on top & pop themselves
+typedef struct {
+    NodeIndex* data;
+    int count;
+    int capacity;
+} FlatScratch;
+
+static void* flat_realloc(void* ptr, size_t size) {
+    void* out = realloc(ptr, size);
+    if (!out) {
+        fprintf(stderr, "failed to realloc flat ast arrays\n");
+        exit(1);
+    }
+    return out;
+}
+
+void flat_ast_init(FlatAst* ast) {
+    ast->capacity = 256;
+    ast->count = 0;
+    ast->kinds = flat_realloc(NULL, sizeof(uint8_t) * ast->capacity);
+    ast->types = flat_realloc(NULL, sizeof(VarType) * ast->capacity);
+    ast->first_child = flat_realloc(NULL, sizeof(uint32_t) * ast->capacity);
+    ast->child_count = flat_realloc(NULL, sizeof(uint32_t) * ast->capacity);
+    ast->data = flat_realloc(NULL, sizeof(FlatNodeData) * ast->capacity);
+
+    ast->child_list_capacity = 256;
+    ast->child_list_count = 0;
+    ast->child_list = flat_realloc(NULL, sizeof(NodeIndex) * ast->child_list_capacity);
+
+    ast->params_capacity = 16;
+    ast->params_count = 0;
+    ast->params = flat_realloc(NULL, sizeof(FunctionParam) * ast->params_capacity);
+
+    ast->scopes_capacity = 16;
+    ast->scopes_count = 0;
+    ast->scopes = flat_realloc(NULL, sizeof(FlatScopeEvent) * ast->scopes_capacity);
+
+    ast->root = FLAT_NONE;
+}
+
+static void scratch_push(FlatScratch* s, NodeIndex idx) {
+    if (s->count >= s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 256;
+        s->data = flat_realloc(s->data, sizeof(NodeIndex) * s->capacity);
+    }
+    s->data[s->count++] = idx;
+}
+
+// adds a node whose children are everything pushed onto the scratch stack since base, & pops them
+static NodeIndex flat_add(FlatAst* ast, FlatScratch* s, int base, ASTNodeType kind, FlatNodeData data) {
+    if (ast->count >= ast->capacity) {
+        ast->capacity *= 2;
+        ast->kinds = flat_realloc(ast->kinds, sizeof(uint8_t) * ast->capacity);
+        ast->types = flat_realloc(ast->types, sizeof(VarType) * ast->capacity);
+        ast->first_child = flat_realloc(ast->first_child, sizeof(uint32_t) * ast->capacity);
+        ast->child_count = flat_realloc(ast->child_count, sizeof(uint32_t) * ast->capacity);
+        ast->data = flat_realloc(ast->data, sizeof(FlatNodeData) * ast->capacity);
+    }
+
+    int children = s->count - base;
+    while (ast->child_list_count + children > ast->child_list_capacity) {
+        ast->child_list_capacity *= 2;
+        ast->child_list = flat_realloc(ast->child_list, sizeof(NodeIndex) * ast->child_list_capacity);
+    }
+    if (children > 0) {
+        memcpy(ast->child_list + ast->child_list_count, s->data + base, sizeof(NodeIndex) * children);
+    }
+    s->count = base;
+
+    NodeIndex idx = ast->count++;
+    VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+    ast->kinds[idx] = kind;
+    ast->types[idx] = unknown_type;
+    ast->first_child[idx] = ast->child_list_count;
+    ast->child_count[idx] = children;
+    ast->data[idx] = data;
+    ast->child_list_count += children;
+    return idx;
+}
+
+static NodeIndex flatten(FlatAst* ast, FlatScratch* s, ASTNode* node);
+
+static void scope_event(FlatAst* ast, bool open, uint32_t params_start, int params_len) {
+    if (ast->scopes_count >= ast->scopes_capacity) {
+        ast->scopes_capacity *= 2;
+        ast->scopes = flat_realloc(ast->scopes, sizeof(FlatScopeEvent) * ast->scopes_capacity);
+    }
+    FlatScopeEvent* event = &ast->scopes[ast->scopes_count++];
+    event->pos = ast->count;
+    event->open = open;
+    event->params_start = params_start;
+    event->params_len = params_len;
+}
+
+static void flatten_list(FlatAst* ast, FlatScratch* s, ASTNode** nodes, int count) {
+    for (int i = 0; i < count; i++) {
+        // has to be read into a local first, as flatten can realloc s->data
+        NodeIndex child = flatten(ast, s, nodes[i]);
+        scratch_push(s, child);
+    }
+}
+
+// flattens a block's statements, wrapped in their own scope
+static void flatten_block(FlatAst* ast, FlatScratch* s, ASTNode** nodes, int count) {
+    scope_event(ast, true, 0, 0);
+    flatten_list(ast, s, nodes, count);
+    scope_event(ast, false, 0, 0);
+}
+
+static void flatten_one(FlatAst* ast, FlatScratch* s, ASTNode* node) {
+    NodeIndex child = flatten(ast, s, node);
+    scratch_push(s, child);
+}
+
+static NodeIndex flatten(FlatAst* ast, FlatScratch* s, ASTNode* node) {
+    int base = s->count;
+    FlatNodeData data;
+    memset(&data, 0, sizeof(data));
+
+    switch (node->type) {
+        case AST_INT:
+            data.int_val = node->int_val;
+            break;
+        case AST_BOOL:
+            data.bool_val = node->bool_val;
+            break;
+        case AST_STRING:
+            data.string.string_val = node->string.string_val;
+            data.string.len = node->string.len;
+            break;
+        case AST_BINARY_OP:
+            flatten_one(ast, s, node->binary_op.left);
+            flatten_one(ast, s, node->binary_op.right);
+            data.op = node->binary_op.op;
+            break;
+        case AST_UNARY_OP:
+            flatten_one(ast, s, node->unary_op.right);
+            data.op = node->unary_op.op;
+            break;
+        case AST_COMPOUND_ASSIGNMENT:
+            flatten_one(ast, s, node->compound_assignment.value);
+            data.var.name = node->compound_assignment.name;
+            data.var.op = node->compound_assignment.op;
+            data.var.slot = -1;
+            break;
+        case AST_PROGRAM:
+            flatten_list(ast, s, node->program.statements, node->program.count);
+            break;
+        case AST_IF:
+            flatten_one(ast, s, node->if_stmt.condition);
+            flatten_block(ast, s, node->if_stmt.success_statements, node->if_stmt.success_count);
+            data.if_stmt.success_count = node->if_stmt.success_count;
+            data.if_stmt.fail_count = -1;
+            if (node->if_stmt.fail_statements) {
+                flatten_block(ast, s, node->if_stmt.fail_statements, node->if_stmt.fail_count);
+                data.if_stmt.fail_count = node->if_stmt.fail_count;
+            }
+            break;
+        case AST_WHILE:
+            flatten_one(ast, s, node->while_stmt.condition);
+            flatten_block(ast, s, node->while_stmt.statements, node->while_stmt.statements_count);
+            break;
+        case AST_ARRAY:
+            flatten_list(ast, s, node->array_literal.arr, node->array_literal.len);
+            break;
+        case AST_ARRAY_INDEX:
+            flatten_one(ast, s, node->array_index.array_expr);
+            flatten_one(ast, s, node->array_index.index_expr);
+            break;
+        case AST_ARRAY_INDEX_ASSIGN:
+            flatten_one(ast, s, node->array_assign_expr.arr_index_expr);
+            flatten_one(ast, s, node->array_assign_expr.value);
+            break;
+        case AST_VAR_DECL:
+            flatten_one(ast, s, node->var_decl.value);
+            data.var.name = node->var_decl.name;
+            data.var.type = node->var_type;
+            data.var.slot = -1;
+            break;
+        case AST_VAR_ASSIGN:
+            flatten_one(ast, s, node->var_assign.value);
+            data.var.name = node->var_assign.name;
+            data.var.slot = -1;
+            break;
+        case AST_VAR_REF:
+            data.var.name = node->var_ref.name;
+            data.var.slot = -1;
+            break;
+        case AST_FUNCTION_CALL:
+            flatten_list(ast, s, node->function_call.args, node->function_call.args_len);
+            data.var.name = node->function_call.name;
+            data.var.slot = -1;
+            break;
+        case AST_FUNCTION_DECL:
+            while (ast->params_count + node->function_decl.params_len > ast->params_capacity) {
+                ast->params_capacity *= 2;
+                ast->params = flat_realloc(ast->params, sizeof(FunctionParam) * ast->params_capacity);
+            }
+            memcpy(ast->params + ast->params_count, node->function_decl.params, sizeof(FunctionParam) * node->function_decl.params_len);
+            data.function_decl.name = node->function_decl.name;
+            data.function_decl.slot = -1;
+            data.function_decl.params_start = ast->params_count;
+            data.function_decl.params_len = node->function_decl.params_len;
+            data.function_decl.return_type = node->function_decl.return_type;
+            ast->params_count += node->function_decl.params_len;
+
+            scope_event(ast, true, data.function_decl.params_start, data.function_decl.params_len);
+            flatten_list(ast, s, node->function_decl.stmts, node->function_decl.stmts_len);
+            scope_event(ast, false, 0, 0);
+            break;
+        case AST_RETURN_STMT:
+            flatten_one(ast, s, node->return_stmt.expr);
+            break;
+    }
+
+    return flat_add(ast, s, base, node->type, data);
+}
+
+void flat_ast_build(FlatAst* ast, ASTNode* node) {
+    FlatScratch s = {0};
+    ast->root = flatten(ast, &s, node);
+    free(s.data);
+}
+
+void flat_ast_free(FlatAst* ast) {
+    free(ast->kinds);
+    free(ast->types);
+    free(ast->first_child);
+    free(ast->child_count);
+    free(ast->data);
+    free(ast->child_list);
+    free(ast->params);
+    free(ast->scopes);
+}
+
+void flat_ast_print(FlatAst* ast, NodeIndex node, int indent, bool newline) {
+    if (node == FLAT_NONE) return;
+    for (int i = 0; i < indent; i++) {
+        printf(" ");
+    }
+
+    FlatNodeData* data = &ast->data[node];
+    switch (ast->kinds[node]) {
+        case AST_INT:
+            printf("AST_INT(%d)", data->int_val);
+            break;
+        case AST_BOOL:
+            printf("AST_BOOL(%s)", data->bool_val ? "true" : "false");
+            break;
+        case AST_STRING:
+            printf("AST_STRING(%.*s)", data->string.len, data->string.string_val);
+            break;
+        case AST_BINARY_OP:
+            printf("AST_BINARY_OP(%s)", op_string(data->op));
+            if (newline) {
+                printf("\n");
+            }
+            flat_ast_print(ast, flat_child(ast, node, 0), indent + 1, false);
+            flat_ast_print(ast, flat_child(ast, node, 1), indent + 1, false);
+            return;
+        case AST_COMPOUND_ASSIGNMENT: {
+            printf("AST_COMPOUND_ASSIGN(slot=%d,%s%s", data->var.slot, symbol_name(data->var.name), op_string(data->var.op));
+            flat_ast_print(ast, flat_child(ast, node, 0), 0, false);
+            char buffer[50];
+            var_type_string(data->var.type, buffer);
+            printf(";t=%s(%d))", buffer, data->var.type.base_type);
+            break;
+        }
+        case AST_UNARY_OP:
+            printf("AST_UNARY_OP(%c)", data->op == TOK_MINUS ? '-' : '!');
+            if (newline) {
+                printf("\n");
+            }
+            flat_ast_print(ast, flat_child(ast, node, 0), indent + 1, true);
+            return;
+        case AST_PROGRAM:
+            printf("AST_PROGRAM");
+            if (newline) {
+                printf("\n");
+            }
+            for (uint32_t i = 0; i < ast->child_count[node]; i++) {
+                flat_ast_print(ast, flat_child(ast, node, i), indent + 1, true);
+            }
+            return;
+        case AST_IF: {
+            printf("AST_IF(condition =");
+            flat_ast_print(ast, flat_child(ast, node, 0), indent, false);
+            printf(", success =");
+            int i = 1;
+            for (; i <= data->if_stmt.success_count; i++) {
+                flat_ast_print(ast, flat_child(ast, node, i), indent, false);
+                printf(";");
+            }
+            if (data->if_stmt.fail_count != -1) {
+                printf(", fail =");
+                for (; i < (int) ast->child_count[node]; i++) {
+                    flat_ast_print(ast, flat_child(ast, node, i), indent, false);
+                    printf(";");
+                }
+            }
+            printf(")");
+            break;
+        }
+        case AST_WHILE:
+            printf("AST_WHILE(condition =");
+            flat_ast_print(ast, flat_child(ast, node, 0), indent, false);
+            printf(", statements =");
+            for (uint32_t i = 1; i < ast->child_count[node]; i++) {
+                flat_ast_print(ast, flat_child(ast, node, i), indent, false);
+                printf(";");
+            }
+            printf(")");
+            break;
+        case AST_VAR_ASSIGN:
+        case AST_VAR_DECL: {
+            printf("%s(slot=%d,%s=", ast->kinds[node] == AST_VAR_DECL ? "AST_VAR_DECL" : "AST_VAR_ASSIGN", data->var.slot, symbol_name(data->var.name));
+            flat_ast_print(ast, flat_child(ast, node, 0), 0, false);
+            char buffer[50];
+            var_type_string(data->var.type, buffer);
+            printf(";t=%s(%d))", buffer, data->var.type.base_type);
+            break;
+        }
+        case AST_VAR_REF: {
+            char buffer[50];
+            var_type_string(data->var.type, buffer);
+            printf("AST_VAR_REF(slot=%d,%s;t=%s(%d))", data->var.slot, symbol_name(data->var.name), buffer, data->var.type.base_type);
+            break;
+        }
+        case AST_ARRAY:
+            printf("AST_ARRAY([");
+            for (uint32_t i = 0; i < ast->child_count[node]; i++) {
+                flat_ast_print(ast, flat_child(ast, node, i), indent, false);
+                if (i != ast->child_count[node] - 1) {
+                    printf(", ");
+                }
+            }
+            printf("])");
+            break;
+        case AST_ARRAY_INDEX:
+            printf("AST_ARRAY_INDEX(");
+            flat_ast_print(ast, flat_child(ast, node, 0), 0, false);
+            printf("[");
+            flat_ast_print(ast, flat_child(ast, node, 1), 0, false);
+            printf("])");
+            break;
+        case AST_ARRAY_INDEX_ASSIGN:
+            printf("AST_ARRAY_INDEX_ASSIGN(");
+            flat_ast_print(ast, flat_child(ast, node, 0), 0, false);
+            printf("=");
+            flat_ast_print(ast, flat_child(ast, node, 1), 0, false);
+            printf(")");
+            break;
+        case AST_FUNCTION_CALL:
+            printf("AST_FUNCTION_CALL(slot=%d, %s(", data->var.slot, symbol_name(data->var.name));
+            for (uint32_t i = 0; i < ast->child_count[node]; i++) {
+                flat_ast_print(ast, flat_child(ast, node, i), indent, false);
+                if (i != ast->child_count[node] - 1) {
+                    printf(", ");
+                }
+            }
+            printf("))");
+            break;
+        case AST_FUNCTION_DECL:
+            printf("AST_FUNCTION_DECL(slot=%d, %s(", data->function_decl.slot, symbol_name(data->function_decl.name));
+            for (int i = 0; i < data->function_decl.params_len; i++) {
+                FunctionParam param = ast->params[data->function_decl.params_start + i];
+                printf("%s(%d) %s", base_type_string(param.type.base_type), param.type.nested, symbol_name(param.name));
+                if (i != data->function_decl.params_len - 1) {
+                    printf(", ");
+                }
+            }
+            printf(") ");
+            printf("{");
+            for (uint32_t i = 0; i < ast->child_count[node]; i++) {
+                flat_ast_print(ast, flat_child(ast, node, i), indent, false);
+                printf(";");
+            }
+            printf("}");
+            break;
+        case AST_RETURN_STMT:
+            printf("AST_RETURN(");
+            flat_ast_print(ast, flat_child(ast, node, 0), indent, false);
+            printf(")");
+            break;
+        default:
+            printf("unknown ast type: %d\n", ast->kinds[node]);
+            return;
+    }
+
+    if (newline) {
+        printf("\n");
+    }
+}
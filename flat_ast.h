@@ -0,0 +1,116 @@
+#ifndef GRBLANG_FLAT_AST_H
+#define GRBLANG_FLAT_AST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "interner.h"
+#include "lexer.h"
+#include "parser.h"
+
+// an alternative to the pointer linked ASTNode tree: nodes live in parallel arrays & refer to each other by 32-bit index.
+// nodes are stored in post order (every child comes before its parent, siblings in source order), so passes that only need
+// a node's children to already be done (resolving, typing) are a single linear scan over the arrays
+typedef uint32_t NodeIndex;
+
+#define FLAT_NONE UINT32_MAX
+
+// cold, per kind payload. only read by the pass that cares about that kind of node
+typedef union {
+    int int_val;
+    bool bool_val;
+    // AST_BINARY_OP & AST_UNARY_OP
+    TokenType op;
+
+    struct {
+        // not nul terminated, points into the source or parser arena so those have to outlive the flat ast
+        const char* string_val;
+        int len;
+    } string;
+
+    // AST_VAR_DECL, AST_VAR_ASSIGN, AST_COMPOUND_ASSIGNMENT, AST_VAR_REF & AST_FUNCTION_CALL
+    struct {
+        SymbolId name;
+        int slot;
+        // only for AST_COMPOUND_ASSIGNMENT
+        TokenType op;
+        // declared type for AST_VAR_DECL, set by the resolver for assignments
+        VarType type;
+    } var;
+
+    struct {
+        int success_count;
+        // -1 if there's no else block
+        int fail_count;
+    } if_stmt;
+
+    struct {
+        SymbolId name;
+        int slot;
+        // index into FlatAst.params
+        uint32_t params_start;
+        int params_len;
+        VarType return_type;
+    } function_decl;
+} FlatNodeData;
+
+// where a block scope (if/else/while body, function body) starts or ends, so a linear scan over the nodes can track scopes
+typedef struct {
+    // applied just before node pos is visited, events at ast->count apply after the last node
+    NodeIndex pos;
+    bool open;
+    // params declared into a function body's scope when it's opened
+    uint32_t params_start;
+    int params_len;
+} FlatScopeEvent;
+
+typedef struct {
+    // hot, touched by every pass
+    uint8_t* kinds; // ASTNodeType
+    // the type of the node as an expression, VALUE_UNKNOWN for statements. filled in by flat_type_check
+    VarType* types;
+    // children of node i are child_list[first_child[i]] .. child_list[first_child[i] + child_count[i] - 1]
+    uint32_t* first_child;
+    uint32_t* child_count;
+
+    // cold
+    FlatNodeData* data;
+
+    int count;
+    int capacity;
+
+    // children per kind:
+    // AST_BINARY_OP left, right. AST_UNARY_OP right. AST_VAR_DECL/ASSIGN, AST_COMPOUND_ASSIGNMENT value.
+    // AST_PROGRAM statements. AST_IF condition, success statements, fail statements. AST_WHILE condition, statements.
+    // AST_ARRAY elements. AST_ARRAY_INDEX array, index. AST_ARRAY_INDEX_ASSIGN array index, value.
+    // AST_FUNCTION_CALL args. AST_FUNCTION_DECL statements. AST_RETURN_STMT expr
+    NodeIndex* child_list;
+    int child_list_count;
+    int child_list_capacity;
+
+    FunctionParam* params;
+    int params_count;
+    int params_capacity;
+
+    // in the order they happen
+    FlatScopeEvent* scopes;
+    int scopes_count;
+    int scopes_capacity;
+
+    // always the last node, as it's the parent of everything
+    NodeIndex root;
+} FlatAst;
+
+void flat_ast_init(FlatAst* ast);
+// flattens the tree rooted at node (ideally the AST_PROGRAM node) into ast, the tree isn't modified
+void flat_ast_build(FlatAst* ast, ASTNode* node);
+void flat_ast_free(FlatAst* ast);
+
+static inline NodeIndex flat_child(FlatAst* ast, NodeIndex node, uint32_t i) {
+    return ast->child_list[ast->first_child[node] + i];
+}
+
+// same output as print_ast on the equivalent tree
+void flat_ast_print(FlatAst* ast, NodeIndex node, int indent, bool newline);
+
+#endif //GRBLANG_FLAT_AST_H
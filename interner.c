@@ -0,0 +1,158 @@
+#include "interner.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERNER_BLOCK_SIZE (64 * 1024)
+
+// strings are packed into large blocks rather than malloc'd one by one
+typedef struct InternBlock {
+    struct InternBlock* next;
+    int used;
+    int capacity;
+    char data[];
+} InternBlock;
+
+typedef struct {
+    // open addressing table of id + 1, 0 marks an empty slot
+    uint32_t* slots;
+    int slot_capacity;
+
+    const char** names;
+    int* lens;
+    uint32_t* hashes;
+    int count;
+    int capacity;
+
+    InternBlock* blocks;
+} Interner;
+
+static Interner interner = {0};
+
+static uint32_t hash_bytes(const char* str, int len) {
+    // fnv-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash ^= (uint8_t) str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static char* interner_store(const char* str, int len) {
+    InternBlock* block = interner.blocks;
+    if (!block || block->used + len + 1 > block->capacity) {
+        int capacity = len + 1 > INTERNER_BLOCK_SIZE ? len + 1 : INTERNER_BLOCK_SIZE;
+        InternBlock* new_block = malloc(sizeof(InternBlock) + capacity);
+        if (!new_block) {
+            fprintf(stderr, "failed to malloc interner block\n");
+            exit(1);
+        }
+        new_block->next = block;
+        new_block->used = 0;
+        new_block->capacity = capacity;
+        interner.blocks = new_block;
+        block = new_block;
+    }
+
+    char* out = block->data + block->used;
+    memcpy(out, str, len);
+    out[len] = '\0';
+    block->used += len + 1;
+    return out;
+}
+
+static void interner_resize_slots(void) {
+    int new_capacity = interner.slot_capacity ? interner.slot_capacity * 2 : 256;
+    uint32_t* new_slots = calloc(new_capacity, sizeof(uint32_t));
+    if (!new_slots) {
+        fprintf(stderr, "failed to calloc interner slots\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < interner.count; i++) {
+        uint32_t idx = interner.hashes[i] & (new_capacity - 1);
+        while (new_slots[idx]) {
+            idx = (idx + 1) & (new_capacity - 1);
+        }
+        new_slots[idx] = i + 1;
+    }
+
+    free(interner.slots);
+    interner.slots = new_slots;
+    interner.slot_capacity = new_capacity;
+}
+
+static void interner_resize_names(void) {
+    int new_capacity = interner.capacity ? interner.capacity * 2 : 256;
+    const char** new_names = realloc(interner.names, sizeof(char*) * new_capacity);
+    int* new_lens = realloc(interner.lens, sizeof(int) * new_capacity);
+    uint32_t* new_hashes = realloc(interner.hashes, sizeof(uint32_t) * new_capacity);
+    if (!new_names || !new_lens || !new_hashes) {
+        fprintf(stderr, "failed to realloc interner names\n");
+        exit(1);
+    }
+    interner.names = new_names;
+    interner.lens = new_lens;
+    interner.hashes = new_hashes;
+    interner.capacity = new_capacity;
+}
+
+SymbolId intern(const char* str, int len) {
+    // kept at most half full so probe chains stay short
+    if ((interner.count + 1) * 2 > interner.slot_capacity) {
+        interner_resize_slots();
+    }
+
+    uint32_t hash = hash_bytes(str, len);
+    uint32_t idx = hash & (interner.slot_capacity - 1);
+    while (interner.slots[idx]) {
+        SymbolId sym = interner.slots[idx] - 1;
+        if (interner.hashes[sym] == hash && interner.lens[sym] == len && memcmp(interner.names[sym], str, len) == 0) {
+            return sym;
+        }
+        idx = (idx + 1) & (interner.slot_capacity - 1);
+    }
+
+    if (interner.count >= interner.capacity) {
+        interner_resize_names();
+    }
+
+    SymbolId sym = interner.count++;
+    interner.names[sym] = interner_store(str, len);
+    interner.lens[sym] = len;
+    interner.hashes[sym] = hash;
+    interner.slots[idx] = sym + 1;
+    return sym;
+}
+
+const char* symbol_name(SymbolId sym) {
+    if (sym >= (SymbolId) interner.count) {
+        return "<invalid symbol>";
+    }
+    return interner.names[sym];
+}
+
+int symbol_count(void) {
+    return interner.count;
+}
+
+void free_interner(void) {
+    InternBlock* block = interner.blocks;
+    while (block) {
+        InternBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(interner.slots);
+    free(interner.names);
+    free(interner.lens);
+    free(interner.hashes);
+
+    Interner empty = {0};
+    interner = empty;
+}
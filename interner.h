@@ -0,0 +1,18 @@
+#ifndef GRBLANG_INTERNER_H
+#define GRBLANG_INTERNER_H
+
+#include <stdint.h>
+
+// identifiers are interned once by the lexer & referred to by id everywhere after that, so two names are the same iff their ids are equal
+typedef uint32_t SymbolId;
+
+// returns the id for the len bytes at str, adding a copy of them to the global table if they haven't been seen before
+SymbolId intern(const char* str, int len);
+// nul terminated, valid until free_interner is called
+const char* symbol_name(SymbolId sym);
+int symbol_count(void);
+
+// frees every interned string, any SymbolId held after this is invalid
+void free_interner(void);
+
+#endif //GRBLANG_INTERNER_H
@@ -0,0 +1,801 @@
+#include "ir.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void ir_init(Ir* ir) {
+    int initial_capacity = 128;
+    ir->instrs = malloc(initial_capacity * sizeof(IrInstr));
+    ir->count = 0;
+    ir->capacity = initial_capacity;
+
+    ir->args = malloc(initial_capacity * sizeof(IrValue));
+    ir->args_count = 0;
+    ir->args_capacity = initial_capacity;
+
+    ir->blocks = malloc(16 * sizeof(IrBlock));
+    ir->block_count = 0;
+    ir->block_capacity = 16;
+
+    if (!ir->instrs || !ir->args || !ir->blocks) {
+        fprintf(stderr, "failed to malloc ir\n");
+        exit(1);
+    }
+}
+
+void free_ir(Ir* ir) {
+    for (int i = 0; i < ir->block_count; i++) {
+        free(ir->blocks[i].instrs);
+    }
+    free(ir->blocks);
+    free(ir->args);
+    free(ir->instrs);
+    ir->blocks = NULL;
+    ir->args = NULL;
+    ir->instrs = NULL;
+}
+
+IrValue ir_resolve(Ir* ir, IrValue v) {
+    if (v == -1) return v;
+    IrValue root = v;
+    while (ir->instrs[root].replaced_by != -1) {
+        root = ir->instrs[root].replaced_by;
+    }
+    // point the whole chain at the end of it, so the next lookup is a single step
+    while (ir->instrs[v].replaced_by != -1) {
+        IrValue next = ir->instrs[v].replaced_by;
+        ir->instrs[v].replaced_by = root;
+        v = next;
+    }
+    return root;
+}
+
+IrValue ir_arg(Ir* ir, IrValue v, int i) {
+    return ir_resolve(ir, ir->args[ir->instrs[v].args_start + i]);
+}
+
+void ir_resolve_args(Ir* ir) {
+    for (int i = 0; i < ir->args_count; i++) {
+        ir->args[i] = ir_resolve(ir, ir->args[i]);
+    }
+    for (int i = 0; i < ir->block_count; i++) {
+        ir->blocks[i].cond = ir_resolve(ir, ir->blocks[i].cond);
+    }
+}
+
+bool ir_is_const(Ir* ir, IrValue v) {
+    IrOp op = ir->instrs[v].op;
+    return op == IR_CONST_INT || op == IR_CONST_BOOL || op == IR_CONST_STRING;
+}
+
+bool ir_has_value(Ir* ir, IrValue v) {
+    IrOp op = ir->instrs[v].op;
+    return op != IR_ARRSTOREIDX && op != IR_RESULT;
+}
+
+// blocks are in layout order, where every edge but a loop's back edge goes forward, so one pass over them is enough
+int* ir_idoms(Ir* ir) {
+    int* idom = malloc(sizeof(int) * (ir->block_count > 0 ? ir->block_count : 1));
+    if (!idom) {
+        fprintf(stderr, "failed to malloc idoms\n");
+        exit(1);
+    }
+
+    idom[0] = -1;
+    for (int b = 1; b < ir->block_count; b++) {
+        int dom = -1;
+        for (int i = 0; i < ir->blocks[b].pred_count; i++) {
+            int pred = ir->blocks[b].preds[i];
+            if (pred >= b) continue;
+            if (dom == -1) {
+                dom = pred;
+                continue;
+            }
+            while (pred != dom) {
+                while (pred > dom) pred = idom[pred];
+                while (dom > pred) dom = idom[dom];
+            }
+        }
+        idom[b] = dom;
+    }
+    return idom;
+}
+
+typedef struct {
+    int slot;
+    IrValue old;
+} DefLogEntry;
+
+typedef struct {
+    Ir* ir;
+    // block new instructions go into
+    int block;
+
+    // the value each slot holds at this point of the program, -1 if it was never assigned
+    IrValue* defs;
+    int num_slots;
+    // every change to defs, so an if's branches & a loop's body can be undone back to where they started
+    DefLogEntry* log;
+    int log_count;
+    int log_capacity;
+    // scratch for deduplicating slots, all false between uses
+    bool* seen;
+
+    bool failed;
+} IrBuilder;
+
+static void reserve_blocks(Ir* ir, int count) {
+    if (count <= ir->block_capacity) return;
+    int new_capacity = ir->block_capacity * 2;
+    while (new_capacity < count) new_capacity *= 2;
+    IrBlock* new_blocks = realloc(ir->blocks, new_capacity * sizeof(IrBlock));
+    if (!new_blocks) {
+        fprintf(stderr, "failed to realloc ir blocks arr\n");
+        exit(1);
+    }
+    ir->blocks = new_blocks;
+    ir->block_capacity = new_capacity;
+}
+
+static void block_init(IrBlock* block) {
+    block->instrs = NULL;
+    block->count = 0;
+    block->capacity = 0;
+    block->pred_count = 0;
+    block->term = IR_EXIT;
+    block->cond = -1;
+    block->succs[0] = -1;
+    block->succs[1] = -1;
+}
+
+static int new_block(Ir* ir) {
+    reserve_blocks(ir, ir->block_count + 1);
+    block_init(&ir->blocks[ir->block_count]);
+    return ir->block_count++;
+}
+
+void ir_insert_blocks(Ir* ir, int at, int n) {
+    reserve_blocks(ir, ir->block_count + n);
+    memmove(&ir->blocks[at + n], &ir->blocks[at], (ir->block_count - at) * sizeof(IrBlock));
+    ir->block_count += n;
+    for (int b = at; b < at + n; b++) {
+        block_init(&ir->blocks[b]);
+    }
+
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        for (int p = 0; p < block->pred_count; p++) {
+            if (block->preds[p] >= at) block->preds[p] += n;
+        }
+        for (int s = 0; s < 2; s++) {
+            if (block->succs[s] >= at) block->succs[s] += n;
+        }
+    }
+    for (IrValue v = 0; v < ir->count; v++) {
+        if (ir->instrs[v].block >= at) ir->instrs[v].block += n;
+    }
+}
+
+static void end_with_jmp(Ir* ir, int from, int to) {
+    ir->blocks[from].term = IR_JMP;
+    ir->blocks[from].succs[0] = to;
+    ir->blocks[to].preds[ir->blocks[to].pred_count++] = from;
+}
+
+IrValue ir_add_instr(Ir* ir, int block, IrOp op, VarType type, IrValue* args, int args_count) {
+    if (ir->count == ir->capacity) {
+        int new_capacity = ir->capacity * 2;
+        IrInstr* new_instrs = realloc(ir->instrs, new_capacity * sizeof(IrInstr));
+        if (!new_instrs) {
+            fprintf(stderr, "failed to realloc ir instrs arr\n");
+            exit(1);
+        }
+        ir->instrs = new_instrs;
+        ir->capacity = new_capacity;
+    }
+    while (ir->args_count + args_count > ir->args_capacity) {
+        int new_capacity = ir->args_capacity * 2;
+        IrValue* new_args = realloc(ir->args, new_capacity * sizeof(IrValue));
+        if (!new_args) {
+            fprintf(stderr, "failed to realloc ir args arr\n");
+            exit(1);
+        }
+        ir->args = new_args;
+        ir->args_capacity = new_capacity;
+    }
+
+    IrValue v = ir->count++;
+    IrInstr* instr = &ir->instrs[v];
+    memset(instr, 0, sizeof(IrInstr));
+    instr->op = op;
+    instr->type = type;
+    instr->args_start = ir->args_count;
+    instr->args_count = args_count;
+    instr->removed = false;
+    instr->replaced_by = -1;
+    for (int i = 0; i < args_count; i++) {
+        ir->args[ir->args_count++] = args[i];
+    }
+    ir_append(ir, block, v);
+    return v;
+}
+
+void ir_append(Ir* ir, int block, IrValue v) {
+    IrBlock* b = &ir->blocks[block];
+    if (b->count == b->capacity) {
+        int new_capacity = b->capacity > 0 ? b->capacity * 2 : 8;
+        IrValue* new_block_instrs = realloc(b->instrs, new_capacity * sizeof(IrValue));
+        if (!new_block_instrs) {
+            fprintf(stderr, "failed to realloc ir block arr\n");
+            exit(1);
+        }
+        b->instrs = new_block_instrs;
+        b->capacity = new_capacity;
+    }
+    b->instrs[b->count++] = v;
+    ir->instrs[v].block = block;
+}
+
+static IrValue add_instr(IrBuilder* builder, IrOp op, VarType type, IrValue* args, int args_count) {
+    return ir_add_instr(builder->ir, builder->block, op, type, args, args_count);
+}
+
+static void set_def(IrBuilder* builder, int slot, IrValue v) {
+    if (builder->log_count == builder->log_capacity) {
+        int new_capacity = builder->log_capacity > 0 ? builder->log_capacity * 2 : 64;
+        DefLogEntry* new_log = realloc(builder->log, new_capacity * sizeof(DefLogEntry));
+        if (!new_log) {
+            fprintf(stderr, "failed to realloc ir def log arr\n");
+            exit(1);
+        }
+        builder->log = new_log;
+        builder->log_capacity = new_capacity;
+    }
+    builder->log[builder->log_count].slot = slot;
+    builder->log[builder->log_count].old = builder->defs[slot];
+    builder->log_count++;
+    builder->defs[slot] = v;
+}
+
+static void undo_defs(IrBuilder* builder, int log_count) {
+    while (builder->log_count > log_count) {
+        DefLogEntry* entry = &builder->log[--builder->log_count];
+        builder->defs[entry->slot] = entry->old;
+    }
+}
+
+// the slots changed since log_count & the values they hold now, each slot once
+static int changed_slots(IrBuilder* builder, int log_count, int** slots, IrValue** values) {
+    int n = builder->log_count - log_count;
+    *slots = malloc(sizeof(int) * (n > 0 ? n : 1));
+    *values = malloc(sizeof(IrValue) * (n > 0 ? n : 1));
+    if (!*slots || !*values) {
+        fprintf(stderr, "failed to malloc changed slots\n");
+        exit(1);
+    }
+
+    int count = 0;
+    for (int i = log_count; i < builder->log_count; i++) {
+        int slot = builder->log[i].slot;
+        if (builder->seen[slot]) continue;
+        builder->seen[slot] = true;
+        (*slots)[count] = slot;
+        (*values)[count] = builder->defs[slot];
+        count++;
+    }
+    for (int i = 0; i < count; i++) {
+        builder->seen[(*slots)[i]] = false;
+    }
+    return count;
+}
+
+static IrValue read_slot(IrBuilder* builder, int slot) {
+    if (builder->defs[slot] == -1) {
+        VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+        return add_instr(builder, IR_UNDEF, unknown_type, NULL, 0);
+    }
+    return builder->defs[slot];
+}
+
+static VarType phi_type(Ir* ir, IrValue a, IrValue b) {
+    return ir->instrs[a].op == IR_UNDEF ? ir->instrs[b].type : ir->instrs[a].type;
+}
+
+static bool is_type(VarType type, BaseType base) {
+    return type.base_type == base && type.nested == -1;
+}
+
+static IrValue build_expr(IrBuilder* builder, ASTNode* node);
+
+static IrValue build_binary(IrBuilder* builder, ASTNode* node) {
+    TokenType op = node->binary_op.op;
+    if (op == TOK_AND || op == TOK_OR) {
+        builder->failed = true;
+        return -1;
+    }
+
+    IrValue args[2];
+    args[0] = build_expr(builder, node->binary_op.left);
+    args[1] = build_expr(builder, node->binary_op.right);
+    if (builder->failed) return -1;
+
+    VarType left = node->binary_op.left->var_type;
+    IrOp ir_op;
+    switch (op) {
+        case TOK_PLUS:
+            if (left.nested != -1) {
+                ir_op = IR_ARRAPPEND;
+            } else if (is_type(left, VALUE_INT)) {
+                ir_op = IR_IADD;
+            } else if (is_type(left, VALUE_STRING)) {
+                ir_op = IR_SCONCAT;
+            } else {
+                builder->failed = true;
+                return -1;
+            }
+            break;
+        case TOK_MINUS: ir_op = IR_ISUB; break;
+        case TOK_MULT: ir_op = IR_IMUL; break;
+        case TOK_DIV: ir_op = IR_IDIV; break;
+        case TOK_MODULO: ir_op = IR_IMOD; break;
+        case TOK_GREATER: ir_op = IR_IGT; break;
+        case TOK_GREATER_EQUALS: ir_op = IR_IGTE; break;
+        case TOK_LESS: ir_op = IR_ILT; break;
+        case TOK_LESS_EQUALS: ir_op = IR_ILTE; break;
+        case TOK_EQUALS:
+        case TOK_NOT_EQUALS:
+            if (is_type(left, VALUE_INT)) {
+                ir_op = op == TOK_EQUALS ? IR_IEQ : IR_INEQ;
+            } else if (is_type(left, VALUE_BOOL)) {
+                ir_op = op == TOK_EQUALS ? IR_BEQ : IR_BNEQ;
+            } else {
+                // bytecode_gen emits nothing for these either
+                builder->failed = true;
+                return -1;
+            }
+            break;
+        default:
+            builder->failed = true;
+            return -1;
+    }
+    return add_instr(builder, ir_op, node->var_type, args, 2);
+}
+
+static IrValue build_expr(IrBuilder* builder, ASTNode* node) {
+    if (builder->failed) return -1;
+
+    switch (node->type) {
+        case AST_INT: {
+            IrValue v = add_instr(builder, IR_CONST_INT, node->var_type, NULL, 0);
+            builder->ir->instrs[v].int_val = node->int_val;
+            return v;
+        }
+        case AST_BOOL: {
+            IrValue v = add_instr(builder, IR_CONST_BOOL, node->var_type, NULL, 0);
+            builder->ir->instrs[v].bool_val = node->bool_val;
+            return v;
+        }
+        case AST_STRING: {
+            IrValue v = add_instr(builder, IR_CONST_STRING, node->var_type, NULL, 0);
+            builder->ir->instrs[v].string.string_val = node->string.string_val;
+            builder->ir->instrs[v].string.len = node->string.len;
+            return v;
+        }
+        case AST_VAR_REF:
+            return read_slot(builder, node->var_ref.slot);
+        case AST_BINARY_OP:
+            return build_binary(builder, node);
+        case AST_UNARY_OP: {
+            IrValue right = build_expr(builder, node->unary_op.right);
+            if (builder->failed) return -1;
+            switch (node->unary_op.op) {
+                case TOK_MINUS: return add_instr(builder, IR_INEG, node->var_type, &right, 1);
+                case TOK_EXCLAM: return add_instr(builder, IR_NOT, node->var_type, &right, 1);
+                default:
+                    builder->failed = true;
+                    return -1;
+            }
+        }
+        case AST_ARRAY: {
+            int len = node->array_literal.len;
+            IrValue* elems = malloc(sizeof(IrValue) * (len > 0 ? len : 1));
+            if (!elems) {
+                fprintf(stderr, "failed to malloc ir array elements\n");
+                exit(1);
+            }
+            for (int i = 0; i < len; i++) {
+                elems[i] = build_expr(builder, node->array_literal.arr[i]);
+            }
+            IrValue v = builder->failed ? -1 : add_instr(builder, IR_ARRAY, node->var_type, elems, len);
+            free(elems);
+            return v;
+        }
+        case AST_ARRAY_INDEX: {
+            IrValue args[2];
+            args[0] = build_expr(builder, node->array_index.index_expr);
+            args[1] = build_expr(builder, node->array_index.array_expr);
+            if (builder->failed) return -1;
+            return add_instr(builder, IR_ARRLOADIDX, node->var_type, args, 2);
+        }
+        default:
+            builder->failed = true;
+            return -1;
+    }
+}
+
+static void build_block(IrBuilder* builder, ASTNode** statements, int count);
+
+// every slot the statements may assign, which are the ones a loop over them needs phis for
+static void assigned_slots(ASTNode** statements, int count, bool* assigned) {
+    for (int i = 0; i < count; i++) {
+        ASTNode* node = statements[i];
+        switch (node->type) {
+            case AST_VAR_DECL: assigned[node->var_decl.slot] = true; break;
+            case AST_VAR_ASSIGN: assigned[node->var_assign.slot] = true; break;
+            case AST_COMPOUND_ASSIGNMENT: assigned[node->compound_assignment.slot] = true; break;
+            case AST_IF:
+                assigned_slots(node->if_stmt.success_statements, node->if_stmt.success_count, assigned);
+                if (node->if_stmt.fail_statements) {
+                    assigned_slots(node->if_stmt.fail_statements, node->if_stmt.fail_count, assigned);
+                }
+                break;
+            case AST_WHILE:
+                assigned_slots(node->while_stmt.statements, node->while_stmt.statements_count, assigned);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void build_if(IrBuilder* builder, ASTNode* node) {
+    Ir* ir = builder->ir;
+    IrValue cond = build_expr(builder, node->if_stmt.condition);
+    if (builder->failed) return;
+
+    int start = builder->block;
+    int start_log = builder->log_count;
+
+    int then_block = new_block(ir);
+    ir->blocks[start].term = IR_BRANCH;
+    ir->blocks[start].cond = cond;
+    ir->blocks[start].succs[0] = then_block;
+    ir->blocks[then_block].preds[ir->blocks[then_block].pred_count++] = start;
+    builder->block = then_block;
+    build_block(builder, node->if_stmt.success_statements, node->if_stmt.success_count);
+    int then_end = builder->block;
+    int* then_slots;
+    IrValue* then_values;
+    int then_count = changed_slots(builder, start_log, &then_slots, &then_values);
+    undo_defs(builder, start_log);
+
+    // there's always an else block, even an empty one, so the false edge never goes straight to a block with phis
+    int else_block = new_block(ir);
+    ir->blocks[start].succs[1] = else_block;
+    ir->blocks[else_block].preds[ir->blocks[else_block].pred_count++] = start;
+    builder->block = else_block;
+    if (node->if_stmt.fail_statements) {
+        build_block(builder, node->if_stmt.fail_statements, node->if_stmt.fail_count);
+    }
+    int else_end = builder->block;
+    int* else_slots;
+    IrValue* else_values;
+    int else_count = changed_slots(builder, start_log, &else_slots, &else_values);
+    undo_defs(builder, start_log);
+
+    int join = new_block(ir);
+    end_with_jmp(ir, then_end, join);
+    end_with_jmp(ir, else_end, join);
+    builder->block = join;
+
+    if (builder->failed) {
+        free(then_slots);
+        free(then_values);
+        free(else_slots);
+        free(else_values);
+        return;
+    }
+
+    // defs is back to what it was before the if, which is what each branch sees for slots it didn't change
+    IrValue* then_at = malloc(sizeof(IrValue) * (then_count + else_count + 1));
+    IrValue* else_at = malloc(sizeof(IrValue) * (then_count + else_count + 1));
+    int* slots = malloc(sizeof(int) * (then_count + else_count + 1));
+    if (!then_at || !else_at || !slots) {
+        fprintf(stderr, "failed to malloc if phis\n");
+        exit(1);
+    }
+    int count = 0;
+    for (int i = 0; i < then_count; i++) {
+        slots[count] = then_slots[i];
+        then_at[count] = then_values[i];
+        else_at[count] = builder->defs[then_slots[i]];
+        builder->seen[then_slots[i]] = true;
+        count++;
+    }
+    for (int i = 0; i < else_count; i++) {
+        if (builder->seen[else_slots[i]]) {
+            for (int j = 0; j < then_count; j++) {
+                if (slots[j] == else_slots[i]) else_at[j] = else_values[i];
+            }
+            continue;
+        }
+        slots[count] = else_slots[i];
+        then_at[count] = builder->defs[else_slots[i]];
+        else_at[count] = else_values[i];
+        count++;
+    }
+
+    for (int i = 0; i < count; i++) {
+        builder->seen[slots[i]] = false;
+        IrValue merged = then_at[i];
+        if (then_at[i] != else_at[i]) {
+            if (then_at[i] == -1 || else_at[i] == -1) {
+                // assigned on one side only, & never before the if, so it's a variable scoped to that branch
+                merged = -1;
+            } else {
+                IrValue args[2] = {then_at[i], else_at[i]};
+                merged = add_instr(builder, IR_PHI, phi_type(ir, then_at[i], else_at[i]), args, 2);
+            }
+        }
+        set_def(builder, slots[i], merged);
+    }
+
+    free(then_at);
+    free(else_at);
+    free(slots);
+    free(then_slots);
+    free(then_values);
+    free(else_slots);
+    free(else_values);
+}
+
+static void build_while(IrBuilder* builder, ASTNode* node) {
+    Ir* ir = builder->ir;
+    int header = new_block(ir);
+    end_with_jmp(ir, builder->block, header);
+    builder->block = header;
+
+    // the body can't be built before the header's phis exist, so every slot it assigns gets one up front. those that
+    // turn out to be unchanged around the loop are removed as trivial later on
+    bool* assigned = calloc(builder->num_slots > 0 ? builder->num_slots : 1, sizeof(bool));
+    if (!assigned) {
+        fprintf(stderr, "failed to calloc loop slots\n");
+        exit(1);
+    }
+    assigned_slots(node->while_stmt.statements, node->while_stmt.statements_count, assigned);
+
+    int phi_count = 0;
+    for (int slot = 0; slot < builder->num_slots; slot++) {
+        if (assigned[slot] && builder->defs[slot] != -1) phi_count++;
+    }
+    IrValue* phis = malloc(sizeof(IrValue) * (phi_count > 0 ? phi_count : 1));
+    int* phi_slots = malloc(sizeof(int) * (phi_count > 0 ? phi_count : 1));
+    if (!phis || !phi_slots) {
+        fprintf(stderr, "failed to malloc loop phis\n");
+        exit(1);
+    }
+    phi_count = 0;
+    for (int slot = 0; slot < builder->num_slots; slot++) {
+        // a slot that's unassigned before the loop only holds variables declared inside it, which never outlive an
+        // iteration
+        if (!assigned[slot] || builder->defs[slot] == -1) continue;
+        IrValue args[2] = {builder->defs[slot], -1};
+        IrValue phi = add_instr(builder, IR_PHI, ir->instrs[builder->defs[slot]].type, args, 2);
+        phis[phi_count] = phi;
+        phi_slots[phi_count] = slot;
+        phi_count++;
+        set_def(builder, slot, phi);
+    }
+    free(assigned);
+    int header_log = builder->log_count;
+
+    IrValue cond = build_expr(builder, node->while_stmt.condition);
+    int cond_end = builder->block;
+
+    int body = new_block(ir);
+    ir->blocks[body].preds[ir->blocks[body].pred_count++] = cond_end;
+    builder->block = body;
+    build_block(builder, node->while_stmt.statements, node->while_stmt.statements_count);
+    end_with_jmp(ir, builder->block, header);
+
+    for (int i = 0; i < phi_count; i++) {
+        // the back edge is always the header's second pred
+        ir->args[ir->instrs[phis[i]].args_start + 1] = builder->defs[phi_slots[i]] == -1 ? phis[i] : builder->defs[phi_slots[i]];
+    }
+    // after the loop every slot holds what it did when the condition was last checked
+    undo_defs(builder, header_log);
+
+    int exit = new_block(ir);
+    ir->blocks[cond_end].term = IR_BRANCH;
+    ir->blocks[cond_end].cond = cond;
+    ir->blocks[cond_end].succs[0] = body;
+    ir->blocks[cond_end].succs[1] = exit;
+    ir->blocks[exit].preds[ir->blocks[exit].pred_count++] = cond_end;
+    builder->block = exit;
+
+    free(phis);
+    free(phi_slots);
+}
+
+static void build_statement(IrBuilder* builder, ASTNode* node) {
+    if (builder->failed) return;
+
+    switch (node->type) {
+        case AST_VAR_DECL: {
+            IrValue v = build_expr(builder, node->var_decl.value);
+            if (!builder->failed) set_def(builder, node->var_decl.slot, v);
+            break;
+        }
+        case AST_VAR_ASSIGN: {
+            IrValue v = build_expr(builder, node->var_assign.value);
+            if (!builder->failed) set_def(builder, node->var_assign.slot, v);
+            break;
+        }
+        case AST_COMPOUND_ASSIGNMENT: {
+            if (!is_type(node->var_type, VALUE_INT)) {
+                builder->failed = true;
+                return;
+            }
+            IrValue args[2];
+            args[1] = build_expr(builder, node->compound_assignment.value);
+            if (builder->failed) return;
+            args[0] = read_slot(builder, node->compound_assignment.slot);
+
+            IrOp op;
+            switch (node->compound_assignment.op) {
+                case TOK_PLUS_EQUALS: op = IR_IADD; break;
+                case TOK_MINUS_EQUALS: op = IR_ISUB; break;
+                case TOK_MULT_EQUALS: op = IR_IMUL; break;
+                case TOK_DIV_EQUALS: op = IR_IDIV; break;
+                default:
+                    builder->failed = true;
+                    return;
+            }
+            set_def(builder, node->compound_assignment.slot, add_instr(builder, op, node->var_type, args, 2));
+            break;
+        }
+        case AST_ARRAY_INDEX_ASSIGN: {
+            ASTNode* index = node->array_assign_expr.arr_index_expr;
+            IrValue args[3];
+            args[0] = build_expr(builder, index->array_index.index_expr);
+            args[1] = build_expr(builder, index->array_index.array_expr);
+            args[2] = build_expr(builder, node->array_assign_expr.value);
+            if (builder->failed) return;
+            VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+            add_instr(builder, IR_ARRSTOREIDX, unknown_type, args, 3);
+            break;
+        }
+        case AST_IF:
+            build_if(builder, node);
+            break;
+        case AST_WHILE:
+            build_while(builder, node);
+            break;
+        case AST_FUNCTION_DECL:
+        case AST_FUNCTION_CALL:
+        case AST_RETURN_STMT:
+        case AST_PROGRAM:
+            builder->failed = true;
+            break;
+        default: {
+            IrValue v = build_expr(builder, node);
+            if (builder->failed) return;
+            VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+            add_instr(builder, IR_RESULT, unknown_type, &v, 1);
+            break;
+        }
+    }
+}
+
+static void build_block(IrBuilder* builder, ASTNode** statements, int count) {
+    for (int i = 0; i < count && !builder->failed; i++) {
+        build_statement(builder, statements[i]);
+    }
+}
+
+bool ir_build(Ir* ir, ASTNode* program, int num_slots) {
+    IrBuilder builder;
+    builder.ir = ir;
+    builder.num_slots = num_slots;
+    builder.defs = malloc(sizeof(IrValue) * (num_slots > 0 ? num_slots : 1));
+    builder.seen = calloc(num_slots > 0 ? num_slots : 1, sizeof(bool));
+    builder.log = NULL;
+    builder.log_count = 0;
+    builder.log_capacity = 0;
+    builder.failed = false;
+    if (!builder.defs || !builder.seen) {
+        fprintf(stderr, "failed to malloc ir builder\n");
+        exit(1);
+    }
+    for (int i = 0; i < num_slots; i++) {
+        builder.defs[i] = -1;
+    }
+
+    builder.block = new_block(ir);
+    build_block(&builder, program->program.statements, program->program.count);
+
+    free(builder.defs);
+    free(builder.seen);
+    free(builder.log);
+    return !builder.failed;
+}
+
+static const char* op_names[] = {
+    [IR_CONST_INT] = "const",
+    [IR_CONST_BOOL] = "const",
+    [IR_CONST_STRING] = "const",
+    [IR_UNDEF] = "undef",
+    [IR_PHI] = "phi",
+    [IR_IADD] = "iadd",
+    [IR_ISUB] = "isub",
+    [IR_IMUL] = "imul",
+    [IR_IDIV] = "idiv",
+    [IR_IMOD] = "imod",
+    [IR_ISHR] = "ishr",
+    [IR_IAND] = "iand",
+    [IR_INEG] = "ineg",
+    [IR_IGT] = "igt",
+    [IR_IGTE] = "igte",
+    [IR_ILT] = "ilt",
+    [IR_ILTE] = "ilte",
+    [IR_IEQ] = "ieq",
+    [IR_INEQ] = "ineq",
+    [IR_BEQ] = "beq",
+    [IR_BNEQ] = "bneq",
+    [IR_NOT] = "not",
+    [IR_SCONCAT] = "sconcat",
+    [IR_ARRAY] = "array",
+    [IR_ARRLOADIDX] = "arrloadidx",
+    [IR_ARRSTOREIDX] = "arrstoreidx",
+    [IR_ARRAPPEND] = "arrappend",
+    [IR_RESULT] = "result",
+};
+
+void ir_print(Ir* ir) {
+    for (int i = 0; i < ir->block_count; i++) {
+        IrBlock* block = &ir->blocks[i];
+        printf("b%d:", i);
+        if (block->pred_count > 0) {
+            printf(" ; preds");
+            for (int p = 0; p < block->pred_count; p++) {
+                printf(" b%d", block->preds[p]);
+            }
+        }
+        printf("\n");
+
+        for (int j = 0; j < block->count; j++) {
+            IrValue v = block->instrs[j];
+            IrInstr* instr = &ir->instrs[v];
+            if (instr->removed) continue;
+
+            printf("    ");
+            if (ir_has_value(ir, v)) {
+                char type_buffer[50];
+                var_type_string(instr->type, type_buffer);
+                printf("v%d: %s = ", v, type_buffer);
+            }
+            printf("%s", op_names[instr->op]);
+            switch (instr->op) {
+                case IR_CONST_INT: printf(" %d", instr->int_val); break;
+                case IR_CONST_BOOL: printf(" %s", instr->bool_val ? "true" : "false"); break;
+                case IR_CONST_STRING: printf(" \"%.*s\"", instr->string.len, instr->string.string_val); break;
+                default: break;
+            }
+            for (int a = 0; a < instr->args_count; a++) {
+                printf("%s v%d", a == 0 ? "" : ",", ir_arg(ir, v, a));
+            }
+            printf("\n");
+        }
+
+        switch (block->term) {
+            case IR_EXIT: printf("    exit\n"); break;
+            case IR_JMP: printf("    jmp b%d\n", block->succs[0]); break;
+            case IR_BRANCH:
+                printf("    branch v%d, b%d, b%d\n", ir_resolve(ir, block->cond), block->succs[0], block->succs[1]);
+                break;
+        }
+    }
+}
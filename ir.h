@@ -0,0 +1,142 @@
+#ifndef GRBLANG_IR_H
+#define GRBLANG_IR_H
+
+#include <stdbool.h>
+
+#include "parser.h"
+
+// index of an instruction in Ir.instrs, which is also the ssa value it defines. -1 for none
+typedef int IrValue;
+
+typedef enum {
+    IR_CONST_INT,
+    IR_CONST_BOOL,
+    IR_CONST_STRING,
+    // what a slot holds on a path that never assigned it, only ever reaches phis that end up dead
+    IR_UNDEF,
+    // one arg per predecessor of its block, in the same order as preds
+    IR_PHI,
+    IR_IADD,
+    IR_ISUB,
+    IR_IMUL,
+    IR_IDIV,
+    IR_IMOD,
+    // only made by strength reduction, with a constant shift or mask
+    IR_ISHR,
+    IR_IAND,
+    IR_INEG,
+    IR_IGT,
+    IR_IGTE,
+    IR_ILT,
+    IR_ILTE,
+    IR_IEQ,
+    IR_INEQ,
+    IR_BEQ,
+    IR_BNEQ,
+    IR_NOT,
+    IR_SCONCAT,
+    // the elements, in order
+    IR_ARRAY,
+    // index, array
+    IR_ARRLOADIDX,
+    // index, array, value. defines no value
+    IR_ARRSTOREIDX,
+    // array, value. appends in place, so the value it defines is the same array
+    IR_ARRAPPEND,
+    // an expression statement, its value is the program's result unless another one runs after it. defines no value
+    IR_RESULT,
+} IrOp;
+
+typedef struct {
+    IrOp op;
+    // of the value it defines
+    VarType type;
+    int block;
+    // the operands are args[args_start, args_start + args_count) in the Ir
+    int args_start;
+    int args_count;
+    union {
+        int int_val;
+        bool bool_val;
+        struct {
+            // points into the ast, like the emitter's string literals
+            const char* string_val;
+            int len;
+        } string;
+    };
+    bool removed;
+    // a division or an array access that's been proven to never error, it's emitted without the check
+    bool unchecked;
+    // set when a pass finds a value that's the same as this one, uses read through it with ir_resolve
+    IrValue replaced_by;
+} IrInstr;
+
+typedef enum {
+    IR_EXIT,
+    IR_JMP,
+    IR_BRANCH,
+} IrTerminator;
+
+typedef struct {
+    // phis come first
+    IrValue* instrs;
+    int count;
+    int capacity;
+
+    // blocks only ever join two paths, an if's branches or a loop's entry & back edge
+    int preds[2];
+    int pred_count;
+
+    IrTerminator term;
+    // IR_BRANCH only
+    IrValue cond;
+    // IR_JMP goes to succs[0], IR_BRANCH to succs[0] if cond is true & succs[1] if it's false
+    int succs[2];
+} IrBlock;
+
+// blocks are in the order the code is laid out in, which the lowering relies on: a loop's blocks are contiguous from
+// its header to its back edge, & a block that branches has no phis in its successors
+typedef struct {
+    IrInstr* instrs;
+    int count;
+    int capacity;
+
+    IrValue* args;
+    int args_count;
+    int args_capacity;
+
+    IrBlock* blocks;
+    int block_count;
+    int block_capacity;
+} Ir;
+
+void ir_init(Ir* ir);
+void free_ir(Ir* ir);
+
+// builds the ssa form of a resolved & type checked program. returns false if it uses something the ir doesn't model
+// (&& and || which may leave nothing on the stack, or functions), bytecode_gen has to be used for those
+bool ir_build(Ir* ir, ASTNode* program, int num_slots);
+
+// adds an instruction to the end of block, passes use these to make new values
+IrValue ir_add_instr(Ir* ir, int block, IrOp op, VarType type, IrValue* args, int args_count);
+// adds v to the end of block's instructions, it's up to the caller to take it out of the block it was in
+void ir_append(Ir* ir, int block, IrValue v);
+// makes room for n empty blocks starting at at, the blocks from there on & everything pointing at them move up by n
+void ir_insert_blocks(Ir* ir, int at, int n);
+
+IrValue ir_resolve(Ir* ir, IrValue v);
+// the i-th operand of v, resolved
+IrValue ir_arg(Ir* ir, IrValue v, int i);
+// rewrites every operand to what it resolves to
+void ir_resolve_args(Ir* ir);
+
+bool ir_is_const(Ir* ir, IrValue v);
+// whether v defines a value at all, IR_ARRSTOREIDX & IR_RESULT don't
+bool ir_has_value(Ir* ir, IrValue v);
+
+// the immediate dominator of every block, -1 for the entry. the caller frees it
+int* ir_idoms(Ir* ir);
+
+void ir_print(Ir* ir);
+
+#endif //GRBLANG_IR_H
@@ -0,0 +1,1221 @@
+#include "ir_lower.h"
+#include "bytecode_emit.h"
+#include "ir.h"
+#include "lexer.h"
+#include "reg_vm.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// the root of a value emitted at the end of its block, inside a phi copy or the branch's condition
+#define ROOT_END -2
+
+typedef struct {
+    Ir* ir;
+    BytecodeEmitter* b;
+
+    int* uses;
+    // where the last use is, the block & the instruction using it or ROOT_END for phi copies & branches
+    int* use_block;
+    IrValue* use_by;
+    // the phi it's copied into at the end of a predecessor, -1 for none
+    IrValue* phi_user;
+    // contains something that can error, reads or changes an array, so it can't be moved past anything else that does
+    bool* tree_sensitive;
+    bool* is_inline;
+    // the non-inline instruction an inline value is emitted as part of, or ROOT_END
+    IrValue* root;
+
+    // position of every non-inline instruction, with one more before & after each block's
+    int* pos;
+    int* start_pos;
+    int* end_pos;
+    int pos_count;
+
+    int* slot;
+    int slot_count;
+
+    // an undef reached something other than a phi, which has nothing to push for it
+    bool undef_used;
+
+    // ir_lower_regs only, the register of every value with one, constants included, or -1
+    RegCode* code;
+    int* reg;
+    // written by values nothing reads & read right after by the phi copies that break a cycle, one for strings & one
+    // for everything else
+    int scratch;
+    int string_scratch;
+} Lowering;
+
+static void* lower_alloc(size_t count, size_t size) {
+    void* p = calloc(count > 0 ? count : 1, size);
+    if (!p) {
+        fprintf(stderr, "failed to malloc ir lowering\n");
+        exit(1);
+    }
+    return p;
+}
+
+static bool is_live(Ir* ir, IrValue v) {
+    return v != -1 && !ir->instrs[v].removed;
+}
+
+static bool is_sensitive_op(IrOp op) {
+    return op == IR_IDIV || op == IR_IMOD || op == IR_ARRLOADIDX || op == IR_ARRAPPEND;
+}
+
+static void add_use(Lowering* l, IrValue v, int block, IrValue by) {
+    l->uses[v]++;
+    l->use_block[v] = block;
+    l->use_by[v] = by;
+}
+
+static void count_uses(Lowering* l) {
+    Ir* ir = l->ir;
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            if (!is_live(ir, v)) continue;
+            IrInstr* instr = &ir->instrs[v];
+            for (int a = 0; a < instr->args_count; a++) {
+                IrValue arg = ir_arg(ir, v, a);
+                if (instr->op == IR_PHI) {
+                    // used by the copy at the end of the predecessor it comes from
+                    add_use(l, arg, block->preds[a], ROOT_END);
+                    l->phi_user[arg] = v;
+                } else {
+                    add_use(l, arg, b, v);
+                    if (ir->instrs[arg].op == IR_UNDEF) l->undef_used = true;
+                }
+            }
+        }
+        if (block->term == IR_BRANCH) {
+            add_use(l, block->cond, b, ROOT_END);
+        }
+    }
+}
+
+static bool is_inline_candidate(Lowering* l, IrValue v) {
+    Ir* ir = l->ir;
+    IrInstr* instr = &ir->instrs[v];
+    return instr->op != IR_PHI && instr->op != IR_UNDEF && ir_has_value(ir, v) && !ir_is_const(ir, v) &&
+           l->uses[v] == 1 && l->use_block[v] == instr->block;
+}
+
+static int operand_index(Ir* ir, IrValue user, IrValue v) {
+    for (int a = 0; a < ir->instrs[user].args_count; a++) {
+        if (ir_arg(ir, user, a) == v) return a;
+    }
+    return -1;
+}
+
+// whether w, inline somewhere in the tree v goes into & between v & its user, is in an operand of that user after
+// v's, so it's still emitted after v. anywhere else in the tree it could end up before v
+static bool emitted_after(Lowering* l, IrValue w, IrValue v) {
+    IrValue user = l->use_by[v];
+    if (user == ROOT_END) return false;
+    IrValue x = w;
+    while (l->is_inline[x] && l->use_by[x] != user) {
+        x = l->use_by[x];
+        if (x == ROOT_END) return false;
+    }
+    return l->is_inline[x] && operand_index(l->ir, user, x) > operand_index(l->ir, user, v);
+}
+
+// a value used once, later in its own block, is emitted right where it's used & never stored. if its tree is sensitive
+// that's only allowed when nothing sensitive that would then run before it runs in between, so blocks are walked
+// backwards & every user's placement is known before its operands'
+static void choose_inline(Lowering* l) {
+    Ir* ir = l->ir;
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            if (!is_live(ir, v) || ir->instrs[v].op == IR_PHI) continue;
+            bool sensitive = is_sensitive_op(ir->instrs[v].op);
+            for (int a = 0; a < ir->instrs[v].args_count; a++) {
+                IrValue arg = ir_arg(ir, v, a);
+                if (is_inline_candidate(l, arg)) sensitive = sensitive || l->tree_sensitive[arg];
+            }
+            l->tree_sensitive[v] = sensitive;
+        }
+
+        for (int i = block->count - 1; i >= 0; i--) {
+            IrValue v = block->instrs[i];
+            l->root[v] = -1;
+            if (!is_live(ir, v) || !is_inline_candidate(l, v)) continue;
+
+            IrValue user = l->use_by[v];
+            IrValue target = ROOT_END;
+            if (user != ROOT_END) {
+                target = l->is_inline[user] ? l->root[user] : user;
+            } else if (l->phi_user[v] != -1 && l->tree_sensitive[v]) {
+                // phi copies are reordered to not clobber each other, so what they compute can't be
+                continue;
+            }
+
+            bool movable = true;
+            if (l->tree_sensitive[v]) {
+                for (int j = i + 1; j < block->count; j++) {
+                    IrValue w = block->instrs[j];
+                    if (w == user) break;
+                    if (!is_live(ir, w)) continue;
+                    IrOp op = ir->instrs[w].op;
+                    if (!is_sensitive_op(op) && op != IR_ARRSTOREIDX) continue;
+                    if (l->is_inline[w] && l->root[w] == target && emitted_after(l, w, v)) continue;
+                    movable = false;
+                    break;
+                }
+            }
+            if (movable) {
+                l->is_inline[v] = true;
+                l->root[v] = target;
+            }
+        }
+    }
+}
+
+static bool needs_slot(Lowering* l, IrValue v) {
+    Ir* ir = l->ir;
+    if (!is_live(ir, v) || !ir_has_value(ir, v) || ir_is_const(ir, v) || l->is_inline[v]) return false;
+    IrOp op = ir->instrs[v].op;
+    return op != IR_UNDEF && (op == IR_PHI || l->uses[v] > 0);
+}
+
+static void number_positions(Lowering* l) {
+    Ir* ir = l->ir;
+    int pos = 0;
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        l->start_pos[b] = pos++;
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            if (!is_live(ir, v) || l->is_inline[v] || ir->instrs[v].op == IR_PHI || ir_is_const(ir, v)) continue;
+            l->pos[v] = pos++;
+        }
+        l->end_pos[b] = pos++;
+    }
+    l->pos_count = pos;
+}
+
+static int root_pos(Lowering* l, IrValue v) {
+    Ir* ir = l->ir;
+    if (!l->is_inline[v]) return l->pos[v];
+    if (l->root[v] == ROOT_END) return l->end_pos[ir->instrs[v].block];
+    return l->pos[l->root[v]];
+}
+
+// [from, to) in positions. a value read at some position ends its range there, so a value written at that same position
+// can share its slot. a block's live out values reach end_pos + 1, past the phi copies written at end_pos
+typedef struct {
+    int from;
+    int to;
+} LiveRange;
+
+typedef struct {
+    // every value's ranges, sorted & merged, are ranges[first[v], first[v] + count[v])
+    LiveRange* ranges;
+    int range_count;
+    int range_capacity;
+    int* first;
+    int* count;
+
+    // where each value is used, the block & the position, grouped by value like the ranges
+    int* use_start;
+    int* use_blocks;
+    int* use_positions;
+
+    // the value whose liveness was last marked at the start & the end of each block
+    IrValue* live_in;
+    IrValue* live_out;
+    int* worklist;
+} Liveness;
+
+static void add_range(Liveness* live, int from, int to) {
+    if (from >= to) return;
+    if (live->range_count == live->range_capacity) {
+        int new_capacity = live->range_capacity > 0 ? live->range_capacity * 2 : 256;
+        LiveRange* new_ranges = realloc(live->ranges, new_capacity * sizeof(LiveRange));
+        if (!new_ranges) {
+            fprintf(stderr, "failed to realloc live ranges arr\n");
+            exit(1);
+        }
+        live->ranges = new_ranges;
+        live->range_capacity = new_capacity;
+    }
+    live->ranges[live->range_count].from = from;
+    live->ranges[live->range_count].to = to;
+    live->range_count++;
+}
+
+static void record_use(Lowering* l, Liveness* live, int* filled, IrValue v, int block, int at) {
+    if (!needs_slot(l, v)) return;
+    int i = live->use_start[v] + filled[v]++;
+    live->use_blocks[i] = block;
+    live->use_positions[i] = at;
+}
+
+static void collect_uses(Lowering* l, Liveness* live) {
+    Ir* ir = l->ir;
+    int* filled = lower_alloc(ir->count, sizeof(int));
+    int total = 0;
+    for (IrValue v = 0; v < ir->count; v++) {
+        live->use_start[v] = total;
+        if (needs_slot(l, v)) total += l->uses[v];
+    }
+    live->use_start[ir->count] = total;
+    live->use_blocks = lower_alloc(total, sizeof(int));
+    live->use_positions = lower_alloc(total, sizeof(int));
+
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            if (!is_live(ir, v)) continue;
+            IrInstr* instr = &ir->instrs[v];
+            for (int a = 0; a < instr->args_count; a++) {
+                IrValue arg = ir_arg(ir, v, a);
+                if (instr->op == IR_PHI) {
+                    record_use(l, live, filled, arg, block->preds[a], l->end_pos[block->preds[a]]);
+                } else {
+                    record_use(l, live, filled, arg, b, root_pos(l, v));
+                }
+            }
+        }
+        if (block->term == IR_BRANCH) {
+            record_use(l, live, filled, block->cond, b, l->end_pos[b]);
+        }
+    }
+    free(filled);
+}
+
+static int compare_ranges(const void* a, const void* b) {
+    return ((const LiveRange*) a)->from - ((const LiveRange*) b)->from;
+}
+
+// walks back from every use to the definition, each block passed through has the value live all the way through. a
+// phi is defined at the start of its block, but its slot is also written by the copies at the end of every predecessor
+static void compute_ranges(Lowering* l, Liveness* live, IrValue v) {
+    Ir* ir = l->ir;
+    IrInstr* instr = &ir->instrs[v];
+    int def_block = instr->block;
+    int def_pos = instr->op == IR_PHI ? l->start_pos[def_block] : l->pos[v];
+    int first = live->range_count;
+
+    if (instr->op == IR_PHI) {
+        IrBlock* block = &ir->blocks[def_block];
+        for (int i = 0; i < block->pred_count; i++) {
+            add_range(live, l->end_pos[block->preds[i]], l->end_pos[block->preds[i]] + 1);
+        }
+    }
+
+    for (int u = live->use_start[v]; u < live->use_start[v + 1]; u++) {
+        int block = live->use_blocks[u];
+        int at = live->use_positions[u];
+        if (block == def_block && at >= def_pos) {
+            add_range(live, def_pos, at);
+            continue;
+        }
+        add_range(live, l->start_pos[block], at);
+        if (live->live_in[block] == v) continue;
+        live->live_in[block] = v;
+
+        int worklist_count = 0;
+        for (int p = 0; p < ir->blocks[block].pred_count; p++) {
+            live->worklist[worklist_count++] = ir->blocks[block].preds[p];
+        }
+        while (worklist_count > 0) {
+            int pred = live->worklist[--worklist_count];
+            if (live->live_out[pred] == v) continue;
+            live->live_out[pred] = v;
+            if (pred == def_block) {
+                add_range(live, def_pos, l->end_pos[pred] + 1);
+                continue;
+            }
+            add_range(live, l->start_pos[pred], l->end_pos[pred] + 1);
+            if (live->live_in[pred] == v) continue;
+            live->live_in[pred] = v;
+            for (int p = 0; p < ir->blocks[pred].pred_count; p++) {
+                live->worklist[worklist_count++] = ir->blocks[pred].preds[p];
+            }
+        }
+    }
+
+    // ranges that touch are merged, a value used & live out of the same block is one range
+    LiveRange* ranges = &live->ranges[first];
+    int count = live->range_count - first;
+    qsort(ranges, count, sizeof(LiveRange), compare_ranges);
+    int merged = 0;
+    for (int i = 0; i < count; i++) {
+        if (merged > 0 && ranges[i].from <= ranges[merged - 1].to) {
+            if (ranges[i].to > ranges[merged - 1].to) ranges[merged - 1].to = ranges[i].to;
+        } else {
+            ranges[merged++] = ranges[i];
+        }
+    }
+    live->range_count = first + merged;
+    live->first[v] = first;
+    live->count[v] = merged;
+}
+
+static bool ranges_intersect(Liveness* live, IrValue a, IrValue b) {
+    LiveRange* x = &live->ranges[live->first[a]];
+    LiveRange* y = &live->ranges[live->first[b]];
+    int i = 0, j = 0;
+    while (i < live->count[a] && j < live->count[b]) {
+        if (x[i].to <= y[j].from) {
+            i++;
+        } else if (y[j].to <= x[i].from) {
+            j++;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    int* ends;
+    int* values;
+    int count;
+} EndHeap;
+
+static void heap_push(EndHeap* heap, int end, IrValue v) {
+    int i = heap->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap->ends[parent] <= end) break;
+        heap->ends[i] = heap->ends[parent];
+        heap->values[i] = heap->values[parent];
+        i = parent;
+    }
+    heap->ends[i] = end;
+    heap->values[i] = v;
+}
+
+static IrValue heap_pop(EndHeap* heap) {
+    IrValue top = heap->values[0];
+    int end = heap->ends[--heap->count];
+    IrValue moved = heap->values[heap->count];
+    int i = 0;
+    while (true) {
+        int child = i * 2 + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && heap->ends[child + 1] < heap->ends[child]) child++;
+        if (heap->ends[child] >= end) break;
+        heap->ends[i] = heap->ends[child];
+        heap->values[i] = heap->values[child];
+        i = child;
+    }
+    heap->ends[i] = end;
+    heap->values[i] = moved;
+    return top;
+}
+
+// the slot an x = x + k value would like to share, so it can be a compound op
+static int operand_slot(Lowering* l, IrValue v) {
+    Ir* ir = l->ir;
+    IrOp op = ir->instrs[v].op;
+    if (op != IR_IADD && op != IR_ISUB && op != IR_IMUL) return -1;
+    IrValue left = ir_arg(ir, v, 0);
+    return needs_slot(l, left) ? l->slot[left] : -1;
+}
+
+// the slot v would like to share, so the copy or the load into it goes away. the phi a value is copied into comes
+// first, a loop's phis get theirs before the body, then a phi takes the slot of what comes in, even through an inline
+// x + k copied straight into it
+static int slot_hint(Lowering* l, IrValue v) {
+    Ir* ir = l->ir;
+    if (l->phi_user[v] != -1 && l->slot[l->phi_user[v]] != -1) {
+        return l->slot[l->phi_user[v]];
+    }
+    if (ir->instrs[v].op != IR_PHI) return operand_slot(l, v);
+    for (int i = 0; i < ir->instrs[v].args_count; i++) {
+        IrValue incoming = ir_arg(ir, v, i);
+        if (needs_slot(l, incoming) && l->slot[incoming] != -1) return l->slot[incoming];
+        if (l->is_inline[incoming] && operand_slot(l, incoming) != -1) return operand_slot(l, incoming);
+    }
+    return -1;
+}
+
+// linear scan over the values by where their ranges start. a slot whose values have all ended is free for anything,
+// one still held by values that are in a hole in their ranges, like a loop variable only read after the loop while
+// the body runs, is only given to a value that hints at it & fits in the holes
+static bool assign_slots(Lowering* l, Liveness* live) {
+    Ir* ir = l->ir;
+    int* first_at = lower_alloc(l->pos_count + 1, sizeof(int));
+    IrValue* next = lower_alloc(ir->count, sizeof(IrValue));
+    for (int i = 0; i <= l->pos_count; i++) {
+        first_at[i] = -1;
+    }
+    int value_count = 0;
+    for (IrValue v = ir->count - 1; v >= 0; v--) {
+        l->slot[v] = -1;
+        if (!needs_slot(l, v) || live->count[v] == 0) continue;
+        int start = live->ranges[live->first[v]].from;
+        next[v] = first_at[start];
+        first_at[start] = v;
+        value_count++;
+    }
+
+    EndHeap active = {
+        .ends = lower_alloc(value_count, sizeof(int)),
+        .values = lower_alloc(value_count, sizeof(IrValue)),
+        .count = 0,
+    };
+    // values of each slot that haven't ended, chained through holder_next
+    IrValue* holders = lower_alloc(value_count, sizeof(IrValue));
+    int* holder_count = lower_alloc(value_count, sizeof(int));
+    IrValue* holder_next = lower_alloc(ir->count, sizeof(IrValue));
+    bool* ended = lower_alloc(ir->count, sizeof(bool));
+    // slots without holders, ones that got one since they were pushed are skipped when popped
+    int* free_stack = lower_alloc(value_count, sizeof(int));
+    int free_count = 0;
+    l->slot_count = 0;
+
+    for (int at = 0; at <= l->pos_count; at++) {
+        while (active.count > 0 && active.ends[0] <= at) {
+            IrValue done = heap_pop(&active);
+            ended[done] = true;
+            int slot = l->slot[done];
+            if (--holder_count[slot] == 0) free_stack[free_count++] = slot;
+        }
+
+        for (IrValue v = first_at[at]; v != -1; v = next[v]) {
+            int slot = slot_hint(l, v);
+            if (slot != -1) {
+                IrValue* link = &holders[slot];
+                while (*link != -1) {
+                    if (ended[*link]) {
+                        *link = holder_next[*link];
+                        continue;
+                    }
+                    if (ranges_intersect(live, *link, v)) {
+                        slot = -1;
+                        break;
+                    }
+                    link = &holder_next[*link];
+                }
+            }
+            while (slot == -1 && free_count > 0) {
+                int top = free_stack[--free_count];
+                if (holder_count[top] == 0) slot = top;
+            }
+            if (slot == -1) {
+                slot = l->slot_count++;
+                holders[slot] = -1;
+            }
+
+            l->slot[v] = slot;
+            holder_count[slot]++;
+            holder_next[v] = holders[slot];
+            holders[slot] = v;
+            heap_push(&active, live->ranges[live->first[v] + live->count[v] - 1].to, v);
+        }
+    }
+
+    free(first_at);
+    free(next);
+    free(active.ends);
+    free(active.values);
+    free(holders);
+    free(holder_count);
+    free(holder_next);
+    free(ended);
+    free(free_stack);
+    return l->slot_count <= 0xFFFF;
+}
+
+static TokenType binary_token(IrOp op) {
+    switch (op) {
+        case IR_IADD:
+        case IR_SCONCAT:
+        case IR_ARRAPPEND:
+            return TOK_PLUS;
+        case IR_ISUB: return TOK_MINUS;
+        case IR_IMUL: return TOK_MULT;
+        case IR_IDIV: return TOK_DIV;
+        case IR_IMOD: return TOK_MODULO;
+        case IR_IGT: return TOK_GREATER;
+        case IR_IGTE: return TOK_GREATER_EQUALS;
+        case IR_ILT: return TOK_LESS;
+        case IR_ILTE: return TOK_LESS_EQUALS;
+        case IR_IEQ:
+        case IR_BEQ:
+            return TOK_EQUALS;
+        case IR_INEQ:
+        case IR_BNEQ:
+            return TOK_NOT_EQUALS;
+        default: return TOK_UNKNOWN;
+    }
+}
+
+static void emit_op(Lowering* l, IrValue v);
+
+// pushes v, a constant is pushed again at every use
+static void emit_value(Lowering* l, IrValue v) {
+    if (l->slot[v] != -1) {
+        emit_load(l->b, l->ir->instrs[v].type, l->slot[v]);
+    } else {
+        emit_op(l, v);
+    }
+}
+
+static void emit_op(Lowering* l, IrValue v) {
+    Ir* ir = l->ir;
+    BytecodeEmitter* b = l->b;
+    IrInstr* instr = &ir->instrs[v];
+    switch (instr->op) {
+        case IR_CONST_INT:
+            emit_push_int(b, instr->int_val);
+            return;
+        case IR_CONST_BOOL:
+            emit_push_bool(b, instr->bool_val);
+            return;
+        case IR_CONST_STRING:
+            emit_push_string(b, instr->string.string_val, instr->string.len);
+            return;
+        case IR_INEG:
+        case IR_NOT:
+            emit_value(l, ir_arg(ir, v, 0));
+            emit_byte(b, instr->op == IR_INEG ? OP_INEG : OP_NOT);
+            return;
+        case IR_ARRAY:
+            for (int i = 0; i < instr->args_count; i++) {
+                emit_value(l, ir_arg(ir, v, i));
+            }
+            emit_byte(b, OP_PUSH_ARRAY);
+            emit_byte(b, (instr->args_count >> 8) & 0xFF);
+            emit_byte(b, instr->args_count & 0xFF);
+            return;
+        case IR_ARRLOADIDX:
+            emit_value(l, ir_arg(ir, v, 0));
+            emit_value(l, ir_arg(ir, v, 1));
+            emit_byte(b, instr->unchecked ? OP_ARRLOADIDX_NC : OP_ARRLOADIDX);
+            return;
+        case IR_IDIV:
+        case IR_IMOD:
+            if (!instr->unchecked) break;
+            emit_value(l, ir_arg(ir, v, 0));
+            emit_value(l, ir_arg(ir, v, 1));
+            emit_byte(b, instr->op == IR_IDIV ? OP_IDIV_NC : OP_IMOD_NC);
+            return;
+        case IR_ISHR:
+        case IR_IAND:
+            emit_value(l, ir_arg(ir, v, 0));
+            emit_value(l, ir_arg(ir, v, 1));
+            emit_byte(b, instr->op == IR_ISHR ? OP_ISHR : OP_IAND);
+            return;
+        default:
+            break;
+    }
+
+    IrValue left = ir_arg(ir, v, 0);
+    IrValue right = ir_arg(ir, v, 1);
+    if (instr->op == IR_IADD && l->slot[left] != -1 && l->slot[right] != -1) {
+        emit_iload_iload_iadd(b, l->slot[left], l->slot[right]);
+        return;
+    }
+    if (instr->op == IR_ILT && l->slot[left] != -1 && ir->instrs[right].op == IR_CONST_INT &&
+        emit_iload_push_ilt(b, l->slot[left], ir->instrs[right].int_val)) {
+        return;
+    }
+    emit_value(l, left);
+    emit_value(l, right);
+    emit_binary_op(b, binary_token(instr->op), ir->instrs[left].type);
+}
+
+// computes v, whose op has to be emitted, into slot. an int add, sub or mul with an operand already in that slot uses
+// the compound ops instead of loading it
+static void emit_op_store(Lowering* l, IrValue v, int slot, VarType type) {
+    Ir* ir = l->ir;
+    BytecodeEmitter* b = l->b;
+    IrInstr* instr = &ir->instrs[v];
+    if (instr->op == IR_IADD || instr->op == IR_ISUB || instr->op == IR_IMUL) {
+        TokenType op = instr->op == IR_IADD ? TOK_PLUS_EQUALS : instr->op == IR_ISUB ? TOK_MINUS_EQUALS : TOK_MULT_EQUALS;
+        IrValue left = ir_arg(ir, v, 0);
+        IrValue right = ir_arg(ir, v, 1);
+        IrValue other = -1;
+        if (l->slot[left] == slot) {
+            other = right;
+        } else if (instr->op != IR_ISUB && l->slot[right] == slot) {
+            // the operand in the slot is only loaded, so it doesn't matter that the other one now runs first
+            other = left;
+        }
+        if (other != -1) {
+            if (ir->instrs[other].op == IR_CONST_INT && emit_iinc(b, op, slot, ir->instrs[other].int_val)) return;
+            emit_value(l, other);
+            emit_icompound_assignment(b, op, slot);
+            return;
+        }
+    }
+    emit_op(l, v);
+    emit_store(b, type, slot);
+}
+
+static bool reads_slot(Lowering* l, IrValue v, int slot) {
+    if (l->slot[v] != -1) return l->slot[v] == slot;
+    Ir* ir = l->ir;
+    for (int i = 0; i < ir->instrs[v].args_count; i++) {
+        if (reads_slot(l, ir_arg(ir, v, i), slot)) return true;
+    }
+    return false;
+}
+
+typedef struct {
+    IrValue src;
+    int slot;
+    VarType type;
+} PhiCopy;
+
+// the copies into to's phis at the end of from happen all at once, so each is emitted once no other copy still has to
+// read the slot it writes. the rest form cycles, those are all pushed before any is stored
+static void emit_phi_copies(Lowering* l, int from, int to) {
+    Ir* ir = l->ir;
+    IrBlock* block = &ir->blocks[to];
+    int pred = block->preds[0] == from ? 0 : 1;
+
+    PhiCopy* copies = lower_alloc(block->count, sizeof(PhiCopy));
+    int count = 0;
+    for (int i = 0; i < block->count; i++) {
+        IrValue phi = block->instrs[i];
+        if (!is_live(ir, phi) || ir->instrs[phi].op != IR_PHI) continue;
+        IrValue src = ir_arg(ir, phi, pred);
+        if (ir->instrs[src].op == IR_UNDEF || l->slot[src] == l->slot[phi]) continue;
+        copies[count].src = src;
+        copies[count].slot = l->slot[phi];
+        copies[count].type = ir->instrs[phi].type;
+        count++;
+    }
+
+    while (count > 0) {
+        int ready = -1;
+        for (int i = 0; i < count && ready == -1; i++) {
+            ready = i;
+            for (int j = 0; j < count; j++) {
+                if (j != i && reads_slot(l, copies[j].src, copies[i].slot)) {
+                    ready = -1;
+                    break;
+                }
+            }
+        }
+
+        if (ready == -1) {
+            for (int i = 0; i < count; i++) {
+                emit_value(l, copies[i].src);
+            }
+            for (int i = count - 1; i >= 0; i--) {
+                emit_store(l->b, copies[i].type, copies[i].slot);
+            }
+            break;
+        }
+
+        PhiCopy copy = copies[ready];
+        if (l->slot[copy.src] != -1 || ir_is_const(ir, copy.src)) {
+            emit_value(l, copy.src);
+            emit_store(l->b, copy.type, copy.slot);
+        } else {
+            emit_op_store(l, copy.src, copy.slot, copy.type);
+        }
+        copies[ready] = copies[--count];
+    }
+    free(copies);
+}
+
+typedef struct {
+    int at;
+    // block the jump lands on, block_count for the end of the code
+    int target;
+} JumpPatch;
+
+static void emit_blocks(Lowering* l) {
+    Ir* ir = l->ir;
+    BytecodeEmitter* b = l->b;
+    int* block_offsets = lower_alloc(ir->block_count + 1, sizeof(int));
+    // at most two jumps per block
+    JumpPatch* patches = lower_alloc(ir->block_count * 2, sizeof(JumpPatch));
+    int patch_count = 0;
+
+    for (int bi = 0; bi < ir->block_count; bi++) {
+        IrBlock* block = &ir->blocks[bi];
+        block_offsets[bi] = b->code_size;
+        // jumps may land here, nothing before can be fused with what comes after
+        b->fusable_cmp_end = -1;
+
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            if (!is_live(ir, v) || l->is_inline[v]) continue;
+            IrInstr* instr = &ir->instrs[v];
+            if (instr->op == IR_PHI || instr->op == IR_UNDEF || ir_is_const(ir, v)) continue;
+
+            if (instr->op == IR_RESULT) {
+                emit_value(l, ir_arg(ir, v, 0));
+                emit_byte(b, OP_RESULT);
+            } else if (instr->op == IR_ARRSTOREIDX) {
+                for (int a = 0; a < 3; a++) {
+                    emit_value(l, ir_arg(ir, v, a));
+                }
+                emit_byte(b, instr->unchecked ? OP_ARRSTOREIDX_NC : OP_ARRSTOREIDX);
+            } else if (l->slot[v] != -1) {
+                emit_op_store(l, v, l->slot[v], instr->type);
+            } else {
+                // kept for what it does, its value isn't needed
+                emit_op(l, v);
+                emit_byte(b, OP_POP);
+            }
+        }
+
+        int next = bi + 1;
+        switch (block->term) {
+            case IR_EXIT:
+                if (next < ir->block_count) {
+                    patches[patch_count++] = (JumpPatch) {.at = emit_jmp(b, 0), .target = ir->block_count};
+                }
+                break;
+            case IR_JMP:
+                emit_phi_copies(l, bi, block->succs[0]);
+                if (block->succs[0] != next) {
+                    patches[patch_count++] = (JumpPatch) {.at = emit_jmp(b, 0), .target = block->succs[0]};
+                }
+                break;
+            case IR_BRANCH:
+                emit_value(l, block->cond);
+                if (block->succs[0] == next) {
+                    patches[patch_count++] = (JumpPatch) {.at = emit_jmpn(b, 0), .target = block->succs[1]};
+                } else if (block->succs[1] == next) {
+                    patches[patch_count++] = (JumpPatch) {.at = emit_jmpt(b, 0), .target = block->succs[0]};
+                } else {
+                    patches[patch_count++] = (JumpPatch) {.at = emit_jmpn(b, 0), .target = block->succs[1]};
+                    patches[patch_count++] = (JumpPatch) {.at = emit_jmp(b, 0), .target = block->succs[0]};
+                }
+                break;
+        }
+    }
+    block_offsets[ir->block_count] = b->code_size;
+
+    for (int i = 0; i < patch_count; i++) {
+        patch_int(b, block_offsets[patches[i].target] - (patches[i].at + 2), patches[i].at);
+    }
+    free(block_offsets);
+    free(patches);
+}
+
+static void lowering_init(Lowering* l, Ir* ir, BytecodeEmitter* b) {
+    l->ir = ir;
+    l->b = b;
+    l->uses = lower_alloc(ir->count, sizeof(int));
+    l->use_block = lower_alloc(ir->count, sizeof(int));
+    l->use_by = lower_alloc(ir->count, sizeof(IrValue));
+    l->phi_user = lower_alloc(ir->count, sizeof(IrValue));
+    l->tree_sensitive = lower_alloc(ir->count, sizeof(bool));
+    l->is_inline = lower_alloc(ir->count, sizeof(bool));
+    l->root = lower_alloc(ir->count, sizeof(IrValue));
+    l->pos = lower_alloc(ir->count, sizeof(int));
+    l->start_pos = lower_alloc(ir->block_count, sizeof(int));
+    l->end_pos = lower_alloc(ir->block_count, sizeof(int));
+    l->slot = lower_alloc(ir->count, sizeof(int));
+    l->undef_used = false;
+    l->code = NULL;
+    l->reg = NULL;
+    for (IrValue v = 0; v < ir->count; v++) {
+        l->phi_user[v] = -1;
+        l->root[v] = -1;
+    }
+}
+
+static void free_lowering(Lowering* l) {
+    free(l->uses);
+    free(l->use_block);
+    free(l->use_by);
+    free(l->phi_user);
+    free(l->tree_sensitive);
+    free(l->is_inline);
+    free(l->root);
+    free(l->pos);
+    free(l->start_pos);
+    free(l->end_pos);
+    free(l->slot);
+    free(l->reg);
+}
+
+// gives a slot to every value that needs one, once the inline values are chosen. false if that can't be done
+static bool allocate_slots(Lowering* l) {
+    Ir* ir = l->ir;
+    number_positions(l);
+
+    Liveness live = {
+        .ranges = NULL,
+        .range_count = 0,
+        .range_capacity = 0,
+        .first = lower_alloc(ir->count, sizeof(int)),
+        .count = lower_alloc(ir->count, sizeof(int)),
+        .use_start = lower_alloc(ir->count + 1, sizeof(int)),
+        .live_in = lower_alloc(ir->block_count, sizeof(IrValue)),
+        .live_out = lower_alloc(ir->block_count, sizeof(IrValue)),
+        .worklist = lower_alloc(ir->block_count * 2, sizeof(int)),
+    };
+    for (int b = 0; b < ir->block_count; b++) {
+        live.live_in[b] = -1;
+        live.live_out[b] = -1;
+    }
+    collect_uses(l, &live);
+    for (IrValue v = 0; v < ir->count; v++) {
+        if (needs_slot(l, v)) compute_ranges(l, &live, v);
+    }
+
+    bool allocated = !l->undef_used && assign_slots(l, &live);
+
+    free(live.ranges);
+    free(live.first);
+    free(live.count);
+    free(live.use_start);
+    free(live.use_blocks);
+    free(live.use_positions);
+    free(live.live_in);
+    free(live.live_out);
+    free(live.worklist);
+    return allocated;
+}
+
+int ir_lower(Ir* ir, BytecodeEmitter* b) {
+    Lowering l;
+    lowering_init(&l, ir, b);
+    count_uses(&l);
+    choose_inline(&l);
+
+    int num_locals = -1;
+    if (allocate_slots(&l)) {
+        emit_blocks(&l);
+        num_locals = l.slot_count;
+    }
+    free_lowering(&l);
+    return num_locals;
+}
+
+// an int comparison only its own block's branch reads is never stored, the branch compares & jumps in one instruction
+static void choose_fused_compares(Lowering* l) {
+    Ir* ir = l->ir;
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        if (block->term != IR_BRANCH) continue;
+        IrValue cond = block->cond;
+        IrOp op = ir->instrs[cond].op;
+        if (!is_live(ir, cond) || op < IR_IGT || op > IR_INEQ || ir->instrs[cond].block != b || l->uses[cond] != 1) continue;
+        l->is_inline[cond] = true;
+        l->root[cond] = ROOT_END;
+    }
+}
+
+static bool is_string_type(VarType type) {
+    return type.base_type == VALUE_STRING && type.nested == -1;
+}
+
+// constants get the registers of their index in the pool, the values' come after those. only strings need their
+// references dropped when overwritten, so a slot shared by strings & other values is split in two & no instruction that
+// writes ints has to check what it overwrites
+static void assign_registers(Lowering* l, BytecodeEmitter* pool) {
+    Ir* ir = l->ir;
+    l->reg = lower_alloc(ir->count, sizeof(int));
+    int bool_consts[2] = {-1, -1};
+    for (IrValue v = 0; v < ir->count; v++) {
+        l->reg[v] = -1;
+        if (!is_live(ir, v) || l->uses[v] == 0) continue;
+        IrInstr* instr = &ir->instrs[v];
+        if (instr->op == IR_CONST_INT) {
+            l->reg[v] = add_const(pool, (StackValue) {.type = instr->type, .int_val = instr->int_val});
+        } else if (instr->op == IR_CONST_BOOL) {
+            if (bool_consts[instr->bool_val] == -1) {
+                bool_consts[instr->bool_val] = add_const(pool, (StackValue) {.type = instr->type, .bool_val = instr->bool_val});
+            }
+            l->reg[v] = bool_consts[instr->bool_val];
+        } else if (instr->op == IR_CONST_STRING) {
+            l->reg[v] = add_string_const(pool, instr->string.string_val, instr->string.len);
+        }
+    }
+
+    // bit 0 for anything but a string, bit 1 for strings
+    int* kinds = lower_alloc(l->slot_count, sizeof(int));
+    int* string_slot = lower_alloc(l->slot_count, sizeof(int));
+    for (IrValue v = 0; v < ir->count; v++) {
+        if (needs_slot(l, v)) kinds[l->slot[v]] |= is_string_type(ir->instrs[v].type) ? 2 : 1;
+    }
+    int slots = l->slot_count;
+    for (int i = 0; i < l->slot_count; i++) {
+        string_slot[i] = kinds[i] == 3 ? slots++ : i;
+    }
+    int base = pool->const_count;
+    for (IrValue v = 0; v < ir->count; v++) {
+        if (!needs_slot(l, v)) continue;
+        int slot = l->slot[v];
+        l->reg[v] = base + (is_string_type(ir->instrs[v].type) ? string_slot[slot] : slot);
+    }
+    l->scratch = base + slots;
+    l->string_scratch = base + slots + 1;
+    l->code->reg_count = base + slots + 2;
+    free(kinds);
+    free(string_slot);
+}
+
+static RegOp reg_binary_op(IrInstr* instr) {
+    switch (instr->op) {
+        case IR_IADD: return REG_IADD;
+        case IR_ISUB: return REG_ISUB;
+        case IR_IMUL: return REG_IMUL;
+        case IR_IDIV: return instr->unchecked ? REG_IDIV_NC : REG_IDIV;
+        case IR_IMOD: return instr->unchecked ? REG_IMOD_NC : REG_IMOD;
+        case IR_ISHR: return REG_ISHR;
+        case IR_IAND: return REG_IAND;
+        case IR_IGT: return REG_IGT;
+        case IR_IGTE: return REG_IGTE;
+        case IR_ILT: return REG_ILT;
+        case IR_ILTE: return REG_ILTE;
+        case IR_IEQ: return REG_IEQ;
+        case IR_INEQ: return REG_INEQ;
+        case IR_BEQ: return REG_BEQ;
+        case IR_BNEQ: return REG_BNEQ;
+        case IR_SCONCAT: return REG_SCONCAT;
+        default: return REG_OP_COUNT;
+    }
+}
+
+static int arg_reg(Lowering* l, IrValue v, int i) {
+    return l->reg[ir_arg(l->ir, v, i)];
+}
+
+static void emit_reg_instr(Lowering* l, IrValue v) {
+    Ir* ir = l->ir;
+    RegCode* code = l->code;
+    IrInstr* instr = &ir->instrs[v];
+    if (instr->op == IR_RESULT) {
+        reg_emit(code, REG_RESULT, arg_reg(l, v, 0), 0, 0);
+        return;
+    }
+    if (instr->op == IR_ARRSTOREIDX) {
+        RegOp op = instr->unchecked ? REG_ARRSTOREIDX_NC : REG_ARRSTOREIDX;
+        reg_emit(code, op, arg_reg(l, v, 1), arg_reg(l, v, 0), arg_reg(l, v, 2));
+        return;
+    }
+
+    // kept for what it does when nothing reads it
+    int dst = l->reg[v] != -1 ? l->reg[v] : is_string_type(instr->type) ? l->string_scratch : l->scratch;
+    switch (instr->op) {
+        case IR_INEG:
+        case IR_NOT:
+            reg_emit(code, instr->op == IR_INEG ? REG_INEG : REG_NOT, dst, arg_reg(l, v, 0), 0);
+            return;
+        case IR_ARRAY: {
+            int* elems = lower_alloc(instr->args_count, sizeof(int));
+            for (int i = 0; i < instr->args_count; i++) {
+                elems[i] = arg_reg(l, v, i);
+            }
+            reg_emit(code, REG_ARRAY, dst, instr->args_count, reg_emit_args(code, elems, instr->args_count));
+            free(elems);
+            return;
+        }
+        case IR_ARRLOADIDX:
+            reg_emit(code, instr->unchecked ? REG_ARRLOADIDX_NC : REG_ARRLOADIDX, dst, arg_reg(l, v, 1), arg_reg(l, v, 0));
+            return;
+        case IR_ARRAPPEND:
+            reg_emit(code, REG_ARRAPPEND, dst, arg_reg(l, v, 0), arg_reg(l, v, 1));
+            return;
+        default:
+            reg_emit(code, reg_binary_op(instr), dst, arg_reg(l, v, 0), arg_reg(l, v, 1));
+            return;
+    }
+}
+
+typedef struct {
+    int dst;
+    int src;
+    bool string;
+} RegCopy;
+
+// the copies into to's phis happen all at once, so each is emitted once no other copy still has to read the register it
+// writes. in a cycle, the register one of them writes is saved to the scratch first & read from there instead
+static void emit_reg_phi_copies(Lowering* l, int from, int to) {
+    Ir* ir = l->ir;
+    IrBlock* block = &ir->blocks[to];
+    int pred = block->preds[0] == from ? 0 : 1;
+
+    RegCopy* copies = lower_alloc(block->count, sizeof(RegCopy));
+    int count = 0;
+    for (int i = 0; i < block->count; i++) {
+        IrValue phi = block->instrs[i];
+        if (!is_live(ir, phi) || ir->instrs[phi].op != IR_PHI) continue;
+        IrValue src = ir_arg(ir, phi, pred);
+        if (ir->instrs[src].op == IR_UNDEF || l->reg[src] == l->reg[phi]) continue;
+        copies[count++] = (RegCopy) {.dst = l->reg[phi], .src = l->reg[src], .string = is_string_type(ir->instrs[phi].type)};
+    }
+
+    while (count > 0) {
+        int ready = -1;
+        for (int i = 0; i < count && ready == -1; i++) {
+            ready = i;
+            for (int j = 0; j < count; j++) {
+                if (j != i && copies[j].src == copies[i].dst) {
+                    ready = -1;
+                    break;
+                }
+            }
+        }
+
+        if (ready == -1) {
+            int saved = copies[0].dst;
+            int scratch = copies[0].string ? l->string_scratch : l->scratch;
+            reg_emit(l->code, copies[0].string ? REG_SMOVE : REG_MOVE, scratch, saved, 0);
+            for (int j = 0; j < count; j++) {
+                if (copies[j].src == saved) copies[j].src = scratch;
+            }
+            continue;
+        }
+
+        reg_emit(l->code, copies[ready].string ? REG_SMOVE : REG_MOVE, copies[ready].dst, copies[ready].src, 0);
+        copies[ready] = copies[--count];
+    }
+    free(copies);
+}
+
+static RegOp fused_jmpf(IrOp op) {
+    switch (op) {
+        case IR_IGT: return REG_IGT_JMPF;
+        case IR_IGTE: return REG_IGTE_JMPF;
+        case IR_ILT: return REG_ILT_JMPF;
+        case IR_ILTE: return REG_ILTE_JMPF;
+        case IR_IEQ: return REG_IEQ_JMPF;
+        default: return REG_INEQ_JMPF;
+    }
+}
+
+// jumps when the comparison is true, as a jump when the opposite one is false
+static RegOp fused_jmpt(IrOp op) {
+    switch (op) {
+        case IR_IGT: return REG_ILTE_JMPF;
+        case IR_IGTE: return REG_ILT_JMPF;
+        case IR_ILT: return REG_IGTE_JMPF;
+        case IR_ILTE: return REG_IGT_JMPF;
+        case IR_IEQ: return REG_INEQ_JMPF;
+        default: return REG_IEQ_JMPF;
+    }
+}
+
+// jumps to whichever of if_true & if_false isn't next, returns how many patches it added
+static int emit_reg_branch(Lowering* l, IrValue cond, int if_true, int if_false, int next, JumpPatch* patches) {
+    Ir* ir = l->ir;
+    RegCode* code = l->code;
+    bool fused = l->is_inline[cond];
+    int left = fused ? arg_reg(l, cond, 0) : l->reg[cond];
+    int right = fused ? arg_reg(l, cond, 1) : 0;
+    RegOp jmpf = fused ? fused_jmpf(ir->instrs[cond].op) : REG_JMPF;
+    RegOp jmpt = fused ? fused_jmpt(ir->instrs[cond].op) : REG_JMPT;
+
+    if (if_true == next) {
+        patches[0] = (JumpPatch) {.at = reg_emit(code, jmpf, 0, left, right), .target = if_false};
+        return 1;
+    }
+    if (if_false == next) {
+        patches[0] = (JumpPatch) {.at = reg_emit(code, jmpt, 0, left, right), .target = if_true};
+        return 1;
+    }
+    patches[0] = (JumpPatch) {.at = reg_emit(code, jmpf, 0, left, right), .target = if_false};
+    patches[1] = (JumpPatch) {.at = reg_emit(code, REG_JMP, 0, 0, 0), .target = if_true};
+    return 2;
+}
+
+// a block that does nothing but branch, like the header of a loop whose condition only reads phis & values from before
+// the loop. a jump to it can branch right away instead, which is what takes the jump back to the header out of a loop
+static bool only_branches(Lowering* l, int b) {
+    Ir* ir = l->ir;
+    IrBlock* block = &ir->blocks[b];
+    if (block->term != IR_BRANCH) return false;
+    for (int i = 0; i < block->count; i++) {
+        IrValue v = block->instrs[i];
+        if (!is_live(ir, v) || l->is_inline[v]) continue;
+        IrOp op = ir->instrs[v].op;
+        if (op != IR_PHI && op != IR_UNDEF && !ir_is_const(ir, v)) return false;
+    }
+    return true;
+}
+
+static void emit_reg_blocks(Lowering* l) {
+    Ir* ir = l->ir;
+    RegCode* code = l->code;
+    int* block_starts = lower_alloc(ir->block_count + 1, sizeof(int));
+    // at most two jumps per block
+    JumpPatch* patches = lower_alloc(ir->block_count * 2, sizeof(JumpPatch));
+    int patch_count = 0;
+
+    for (int bi = 0; bi < ir->block_count; bi++) {
+        IrBlock* block = &ir->blocks[bi];
+        block_starts[bi] = code->count;
+
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            if (!is_live(ir, v) || l->is_inline[v]) continue;
+            IrOp op = ir->instrs[v].op;
+            if (op == IR_PHI || op == IR_UNDEF || ir_is_const(ir, v)) continue;
+            emit_reg_instr(l, v);
+        }
+
+        int next = bi + 1;
+        switch (block->term) {
+            case IR_EXIT:
+                if (next < ir->block_count) {
+                    patches[patch_count++] = (JumpPatch) {.at = reg_emit(code, REG_JMP, 0, 0, 0), .target = ir->block_count};
+                }
+                break;
+            case IR_JMP: {
+                int succ = block->succs[0];
+                emit_reg_phi_copies(l, bi, succ);
+                if (succ == next) break;
+                if (only_branches(l, succ)) {
+                    IrBlock* target = &ir->blocks[succ];
+                    patch_count += emit_reg_branch(l, target->cond, target->succs[0], target->succs[1], next, &patches[patch_count]);
+                } else {
+                    patches[patch_count++] = (JumpPatch) {.at = reg_emit(code, REG_JMP, 0, 0, 0), .target = succ};
+                }
+                break;
+            }
+            case IR_BRANCH:
+                patch_count += emit_reg_branch(l, block->cond, block->succs[0], block->succs[1], next, &patches[patch_count]);
+                break;
+        }
+    }
+    block_starts[ir->block_count] = code->count;
+
+    for (int i = 0; i < patch_count; i++) {
+        code->instrs[patches[i].at].a = block_starts[patches[i].target];
+    }
+    free(block_starts);
+    free(patches);
+}
+
+bool ir_lower_regs(Ir* ir, RegCode* code) {
+    // only for its constant pool, which the register code takes over
+    BytecodeEmitter pool;
+    bytecode_init(&pool);
+
+    Lowering l;
+    lowering_init(&l, ir, &pool);
+    l.code = code;
+    count_uses(&l);
+    choose_fused_compares(&l);
+
+    bool lowered = allocate_slots(&l);
+    if (lowered) {
+        assign_registers(&l, &pool);
+        emit_reg_blocks(&l);
+        code->constants = pool.constants;
+        code->const_count = pool.const_count;
+    } else {
+        for (int i = 0; i < pool.const_count; i++) {
+            if (is_string_type(pool.constants[i].type)) decrement_ref(pool.constants[i].string_val);
+        }
+        free(pool.constants);
+    }
+    free_lowering(&l);
+    free_bytecode_emitter(&pool);
+    free(pool.code);
+    return lowered;
+}
@@ -0,0 +1,17 @@
+#ifndef GRBLANG_IR_LOWER_H
+#define GRBLANG_IR_LOWER_H
+
+#include "bytecode_emit.h"
+#include "ir.h"
+#include "reg_vm.h"
+
+// emits stack bytecode for ir into b. a value used once, right where it's computed, is left on the stack for its user,
+// everything else that's used later gets a local slot shared with values whose live ranges don't overlap. returns the
+// number of slots, or -1 without emitting anything if more are needed than a slot operand can address or something
+// may read a variable that was never assigned
+int ir_lower(Ir* ir, BytecodeEmitter* b);
+// the same for the register vm, with the slots as registers & nothing left on a stack. returns false without emitting
+// anything when ir_lower would return -1
+bool ir_lower_regs(Ir* ir, RegCode* code);
+
+#endif //GRBLANG_IR_LOWER_H
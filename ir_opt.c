@@ -0,0 +1,935 @@
+#include "ir_opt.h"
+#include "ir.h"
+#include "ir_range.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void replace_value(Ir* ir, IrValue v, IrValue with) {
+    ir->instrs[v].replaced_by = with;
+    ir->instrs[v].removed = true;
+}
+
+// a phi whose args are all the same value, itself or undef is just that value
+static void simplify_phis(Ir* ir) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (IrValue v = 0; v < ir->count; v++) {
+            IrInstr* instr = &ir->instrs[v];
+            if (instr->removed || instr->op != IR_PHI) continue;
+
+            IrValue same = -1;
+            bool trivial = true;
+            for (int i = 0; i < instr->args_count; i++) {
+                IrValue arg = ir_arg(ir, v, i);
+                if (arg == -1 || arg == v || ir->instrs[arg].op == IR_UNDEF) continue;
+                if (same != -1 && arg != same) {
+                    trivial = false;
+                    break;
+                }
+                same = arg;
+            }
+            if (trivial && same != -1) {
+                replace_value(ir, v, same);
+                changed = true;
+            }
+        }
+    }
+}
+
+static bool int_const(Ir* ir, IrValue v, int* out) {
+    if (ir->instrs[v].op != IR_CONST_INT) return false;
+    *out = ir->instrs[v].int_val;
+    return true;
+}
+
+static bool bool_const(Ir* ir, IrValue v, bool* out) {
+    if (ir->instrs[v].op != IR_CONST_BOOL) return false;
+    *out = ir->instrs[v].bool_val;
+    return true;
+}
+
+static void fold_to_int(Ir* ir, IrValue v, int val) {
+    ir->instrs[v].op = IR_CONST_INT;
+    ir->instrs[v].args_count = 0;
+    ir->instrs[v].int_val = val;
+}
+
+static void fold_to_bool(Ir* ir, IrValue v, bool val) {
+    ir->instrs[v].op = IR_CONST_BOOL;
+    ir->instrs[v].args_count = 0;
+    ir->instrs[v].bool_val = val;
+}
+
+// folds v into a constant in place or replaces it with one of its operands. returns false if it's left as is. the vm
+// wraps on overflow, so folding does too, & a division that would error at runtime is never folded
+static bool fold(Ir* ir, IrValue v) {
+    IrInstr* instr = &ir->instrs[v];
+    int a = 0, b = 0;
+    bool x, y;
+    switch (instr->op) {
+        case IR_IADD: {
+            IrValue l = ir_arg(ir, v, 0), r = ir_arg(ir, v, 1);
+            bool lc = int_const(ir, l, &a), rc = int_const(ir, r, &b);
+            if (lc && rc) fold_to_int(ir, v, (int) ((uint32_t) a + (uint32_t) b));
+            else if (rc && b == 0) replace_value(ir, v, l);
+            else if (lc && a == 0) replace_value(ir, v, r);
+            else return false;
+            return true;
+        }
+        case IR_ISUB: {
+            IrValue l = ir_arg(ir, v, 0), r = ir_arg(ir, v, 1);
+            bool lc = int_const(ir, l, &a), rc = int_const(ir, r, &b);
+            if (lc && rc) fold_to_int(ir, v, (int) ((uint32_t) a - (uint32_t) b));
+            else if (rc && b == 0) replace_value(ir, v, l);
+            else if (l == r) fold_to_int(ir, v, 0);
+            else return false;
+            return true;
+        }
+        case IR_IMUL: {
+            IrValue l = ir_arg(ir, v, 0), r = ir_arg(ir, v, 1);
+            bool lc = int_const(ir, l, &a), rc = int_const(ir, r, &b);
+            if (lc && rc) fold_to_int(ir, v, (int) ((uint32_t) a * (uint32_t) b));
+            else if (rc && b == 1) replace_value(ir, v, l);
+            else if (lc && a == 1) replace_value(ir, v, r);
+            else return false;
+            return true;
+        }
+        case IR_IDIV:
+        case IR_IMOD: {
+            IrValue l = ir_arg(ir, v, 0), r = ir_arg(ir, v, 1);
+            bool lc = int_const(ir, l, &a), rc = int_const(ir, r, &b);
+            if (!rc || b == 0 || (b == -1 && (!lc || a == INT_MIN))) return false;
+            if (lc) fold_to_int(ir, v, instr->op == IR_IDIV ? a / b : a % b);
+            else if (b == 1 && instr->op == IR_IDIV) replace_value(ir, v, l);
+            else if (b == 1) fold_to_int(ir, v, 0);
+            else return false;
+            return true;
+        }
+        case IR_ISHR:
+        case IR_IAND:
+            if (!int_const(ir, ir_arg(ir, v, 0), &a) || !int_const(ir, ir_arg(ir, v, 1), &b)) return false;
+            fold_to_int(ir, v, instr->op == IR_ISHR ? a >> (b & 31) : a & b);
+            return true;
+        case IR_INEG:
+            if (!int_const(ir, ir_arg(ir, v, 0), &a)) return false;
+            fold_to_int(ir, v, (int) (0u - (uint32_t) a));
+            return true;
+        case IR_IGT:
+        case IR_IGTE:
+        case IR_ILT:
+        case IR_ILTE:
+        case IR_IEQ:
+        case IR_INEQ: {
+            IrValue l = ir_arg(ir, v, 0), r = ir_arg(ir, v, 1);
+            if (int_const(ir, l, &a) && int_const(ir, r, &b)) {
+                switch (instr->op) {
+                    case IR_IGT: fold_to_bool(ir, v, a > b); break;
+                    case IR_IGTE: fold_to_bool(ir, v, a >= b); break;
+                    case IR_ILT: fold_to_bool(ir, v, a < b); break;
+                    case IR_ILTE: fold_to_bool(ir, v, a <= b); break;
+                    case IR_IEQ: fold_to_bool(ir, v, a == b); break;
+                    default: fold_to_bool(ir, v, a != b); break;
+                }
+                return true;
+            }
+            if (l != r) return false;
+            fold_to_bool(ir, v, instr->op == IR_IGTE || instr->op == IR_ILTE || instr->op == IR_IEQ);
+            return true;
+        }
+        case IR_BEQ:
+        case IR_BNEQ:
+            if (!bool_const(ir, ir_arg(ir, v, 0), &x) || !bool_const(ir, ir_arg(ir, v, 1), &y)) return false;
+            fold_to_bool(ir, v, instr->op == IR_BEQ ? x == y : x != y);
+            return true;
+        case IR_NOT: {
+            IrValue r = ir_arg(ir, v, 0);
+            if (bool_const(ir, r, &x)) fold_to_bool(ir, v, !x);
+            else if (ir->instrs[r].op == IR_NOT) replace_value(ir, v, ir_arg(ir, r, 0));
+            else return false;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// whether two instructions computing the same op over the same values always give the same value. arrays have an
+// identity & loads or appends depend on what's been stored, so those never are
+static bool is_numberable(IrOp op) {
+    switch (op) {
+        case IR_UNDEF:
+        case IR_ARRAY:
+        case IR_ARRLOADIDX:
+        case IR_ARRSTOREIDX:
+        case IR_ARRAPPEND:
+        case IR_RESULT:
+            return false;
+        default:
+            return true;
+    }
+}
+
+static bool is_commutative(IrOp op) {
+    return op == IR_IADD || op == IR_IMUL || op == IR_IAND || op == IR_IEQ || op == IR_INEQ || op == IR_BEQ || op == IR_BNEQ;
+}
+
+// args of a commutative op are compared in sorted order, so a + b & b + a get the same number. the instruction itself
+// isn't reordered as its operands may have to run in the order they were written
+static void key_args(Ir* ir, IrValue v, IrValue* args) {
+    for (int i = 0; i < ir->instrs[v].args_count; i++) {
+        args[i] = ir_arg(ir, v, i);
+    }
+    if (is_commutative(ir->instrs[v].op) && args[0] > args[1]) {
+        IrValue tmp = args[0];
+        args[0] = args[1];
+        args[1] = tmp;
+    }
+}
+
+static uint32_t hash_value(Ir* ir, IrValue v) {
+    IrInstr* instr = &ir->instrs[v];
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ (uint32_t) instr->op) * 16777619u;
+    hash = (hash ^ (uint32_t) instr->type.base_type) * 16777619u;
+    hash = (hash ^ (uint32_t) instr->type.nested) * 16777619u;
+    switch (instr->op) {
+        case IR_CONST_INT: hash = (hash ^ (uint32_t) instr->int_val) * 16777619u; break;
+        case IR_CONST_BOOL: hash = (hash ^ (uint32_t) instr->bool_val) * 16777619u; break;
+        case IR_CONST_STRING:
+            for (int i = 0; i < instr->string.len; i++) {
+                hash = (hash ^ (uint8_t) instr->string.string_val[i]) * 16777619u;
+            }
+            break;
+        case IR_PHI: hash = (hash ^ (uint32_t) instr->block) * 16777619u; break;
+        default: break;
+    }
+
+    IrValue args[2];
+    if (instr->op != IR_PHI && instr->args_count <= 2) {
+        key_args(ir, v, args);
+        for (int i = 0; i < instr->args_count; i++) {
+            hash = (hash ^ (uint32_t) args[i]) * 16777619u;
+        }
+    } else {
+        for (int i = 0; i < instr->args_count; i++) {
+            hash = (hash ^ (uint32_t) ir_arg(ir, v, i)) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static bool same_value(Ir* ir, IrValue a, IrValue b) {
+    IrInstr* x = &ir->instrs[a];
+    IrInstr* y = &ir->instrs[b];
+    if (x->op != y->op || x->args_count != y->args_count) return false;
+    if (x->type.base_type != y->type.base_type || x->type.nested != y->type.nested) return false;
+    switch (x->op) {
+        case IR_CONST_INT: return x->int_val == y->int_val;
+        case IR_CONST_BOOL: return x->bool_val == y->bool_val;
+        case IR_CONST_STRING:
+            return x->string.len == y->string.len && memcmp(x->string.string_val, y->string.string_val, x->string.len) == 0;
+        case IR_PHI:
+            if (x->block != y->block) return false;
+            for (int i = 0; i < x->args_count; i++) {
+                if (ir_arg(ir, a, i) != ir_arg(ir, b, i)) return false;
+            }
+            return true;
+        default: {
+            IrValue x_args[2], y_args[2];
+            key_args(ir, a, x_args);
+            key_args(ir, b, y_args);
+            for (int i = 0; i < x->args_count; i++) {
+                if (x_args[i] != y_args[i]) return false;
+            }
+            return true;
+        }
+    }
+}
+
+// numbers values in a scoped hash table while walking the dominator tree, a value is only replaced by one from a
+// block that dominates it. every dominator subtree is a contiguous run of blocks in layout order, so walking the blocks
+// in order & closing the scopes of blocks that don't dominate the next one walks the tree
+static void gvn(Ir* ir) {
+    int* idom = ir_idoms(ir);
+
+    int bucket_count = 16;
+    while (bucket_count < ir->count * 2) bucket_count *= 2;
+    IrValue* buckets = malloc(sizeof(IrValue) * bucket_count);
+    IrValue* chain = malloc(sizeof(IrValue) * (ir->count > 0 ? ir->count : 1));
+    // values in the order they went in, each scope removes what it added when it closes
+    IrValue* added = malloc(sizeof(IrValue) * (ir->count > 0 ? ir->count : 1));
+    // the bucket each went in, a phi's hash changes once its back edge arg is replaced
+    uint32_t* added_buckets = malloc(sizeof(uint32_t) * (ir->count > 0 ? ir->count : 1));
+    int added_count = 0;
+    int* scope_blocks = malloc(sizeof(int) * (ir->block_count > 0 ? ir->block_count : 1));
+    int* scope_marks = malloc(sizeof(int) * (ir->block_count > 0 ? ir->block_count : 1));
+    int scope_depth = 0;
+    if (!buckets || !chain || !added || !added_buckets || !scope_blocks || !scope_marks) {
+        fprintf(stderr, "failed to malloc gvn table\n");
+        exit(1);
+    }
+    for (int i = 0; i < bucket_count; i++) {
+        buckets[i] = -1;
+    }
+
+    for (int b = 0; b < ir->block_count; b++) {
+        while (scope_depth > 0 && scope_blocks[scope_depth - 1] != idom[b]) {
+            scope_depth--;
+            while (added_count > scope_marks[scope_depth]) {
+                added_count--;
+                buckets[added_buckets[added_count]] = chain[added[added_count]];
+            }
+        }
+        scope_blocks[scope_depth] = b;
+        scope_marks[scope_depth] = added_count;
+        scope_depth++;
+
+        IrBlock* block = &ir->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            if (ir->instrs[v].removed) continue;
+            if (fold(ir, v) && ir->instrs[v].removed) continue;
+            if (!is_numberable(ir->instrs[v].op)) continue;
+
+            uint32_t bucket = hash_value(ir, v) & (bucket_count - 1);
+            IrValue found = buckets[bucket];
+            while (found != -1 && !same_value(ir, found, v)) {
+                found = chain[found];
+            }
+            if (found != -1) {
+                replace_value(ir, v, found);
+                continue;
+            }
+            chain[v] = buckets[bucket];
+            buckets[bucket] = v;
+            added[added_count] = v;
+            added_buckets[added_count] = bucket;
+            added_count++;
+        }
+    }
+
+    free(idom);
+    free(buckets);
+    free(chain);
+    free(added);
+    free(added_buckets);
+    free(scope_blocks);
+    free(scope_marks);
+}
+
+// only the last expression statement to run is the program's result, so one that's always followed by another before
+// the program exits is dead. which blocks always reach one is found optimistically, a path that loops forever never
+// exits & can't show a result either
+static void remove_dead_results(Ir* ir) {
+    int n = ir->block_count;
+    bool* has_result = calloc(n > 0 ? n : 1, sizeof(bool));
+    // every path from the end of the block reaches a result
+    bool* reaches_result = malloc(sizeof(bool) * (n > 0 ? n : 1));
+    if (!has_result || !reaches_result) {
+        fprintf(stderr, "failed to malloc result analysis\n");
+        exit(1);
+    }
+    for (int b = 0; b < n; b++) {
+        IrBlock* block = &ir->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrInstr* instr = &ir->instrs[block->instrs[i]];
+            if (!instr->removed && instr->op == IR_RESULT) has_result[b] = true;
+        }
+        reaches_result[b] = block->term != IR_EXIT;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = n - 1; b >= 0; b--) {
+            IrBlock* block = &ir->blocks[b];
+            if (!reaches_result[b]) continue;
+            int succ_count = block->term == IR_BRANCH ? 2 : 1;
+            for (int i = 0; i < succ_count; i++) {
+                int succ = block->succs[i];
+                if (!has_result[succ] && !reaches_result[succ]) {
+                    reaches_result[b] = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int b = 0; b < n; b++) {
+        IrBlock* block = &ir->blocks[b];
+        bool overwritten = reaches_result[b];
+        for (int i = block->count - 1; i >= 0; i--) {
+            IrInstr* instr = &ir->instrs[block->instrs[i]];
+            if (instr->removed || instr->op != IR_RESULT) continue;
+            if (overwritten) instr->removed = true;
+            overwritten = true;
+        }
+    }
+
+    free(has_result);
+    free(reaches_result);
+}
+
+// an array store is dead if the same element of the same array is stored to again before anything can read it or
+// error. both stores would error the same way on a bad index, as nothing in between can change the array's length
+static void remove_dead_stores(Ir* ir) {
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrValue store = block->instrs[i];
+            if (ir->instrs[store].removed || ir->instrs[store].op != IR_ARRSTOREIDX) continue;
+
+            for (int j = i + 1; j < block->count; j++) {
+                IrValue next = block->instrs[j];
+                IrInstr* instr = &ir->instrs[next];
+                if (instr->removed) continue;
+                IrOp op = instr->op;
+                if (op != IR_ARRSTOREIDX && op != IR_ARRLOADIDX && op != IR_ARRAPPEND && op != IR_RESULT &&
+                    op != IR_IDIV && op != IR_IMOD) {
+                    continue;
+                }
+                if (op == IR_ARRSTOREIDX && ir_arg(ir, next, 0) == ir_arg(ir, store, 0) &&
+                    ir_arg(ir, next, 1) == ir_arg(ir, store, 1)) {
+                    ir->instrs[store].removed = true;
+                }
+                break;
+            }
+        }
+    }
+}
+
+// whether v has to run even if nothing uses its value, because it changes an array or may error at runtime
+static bool is_root(Ir* ir, IrValue v) {
+    switch (ir->instrs[v].op) {
+        case IR_RESULT:
+        case IR_ARRSTOREIDX:
+        case IR_ARRAPPEND:
+        case IR_ARRLOADIDX:
+            return true;
+        case IR_IDIV:
+        case IR_IMOD: {
+            int divisor;
+            return !int_const(ir, ir_arg(ir, v, 1), &divisor) || divisor == 0 || divisor == -1;
+        }
+        default:
+            return false;
+    }
+}
+
+static void remove_dead_values(Ir* ir) {
+    bool* live = calloc(ir->count > 0 ? ir->count : 1, sizeof(bool));
+    IrValue* worklist = malloc(sizeof(IrValue) * (ir->count > 0 ? ir->count : 1));
+    int worklist_count = 0;
+    if (!live || !worklist) {
+        fprintf(stderr, "failed to malloc dce worklist\n");
+        exit(1);
+    }
+
+    for (IrValue v = 0; v < ir->count; v++) {
+        if (ir->instrs[v].removed || !is_root(ir, v)) continue;
+        live[v] = true;
+        worklist[worklist_count++] = v;
+    }
+    for (int b = 0; b < ir->block_count; b++) {
+        if (ir->blocks[b].term != IR_BRANCH) continue;
+        IrValue cond = ir_resolve(ir, ir->blocks[b].cond);
+        if (live[cond]) continue;
+        live[cond] = true;
+        worklist[worklist_count++] = cond;
+    }
+
+    while (worklist_count > 0) {
+        IrValue v = worklist[--worklist_count];
+        for (int i = 0; i < ir->instrs[v].args_count; i++) {
+            IrValue arg = ir_arg(ir, v, i);
+            if (arg == -1 || live[arg]) continue;
+            live[arg] = true;
+            worklist[worklist_count++] = arg;
+        }
+    }
+
+    for (IrValue v = 0; v < ir->count; v++) {
+        if (!live[v]) ir->instrs[v].removed = true;
+    }
+
+    free(live);
+    free(worklist);
+}
+
+// x / 2^k & x % 2^k become a shift & a mask when x can't be negative, as those round towards negative infinity where
+// the division rounds towards 0
+static void reduce_strength(Ir* ir, IrRanges* ranges) {
+    VarType int_type = {.base_type = VALUE_INT, .nested = -1};
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            IrInstr* instr = &ir->instrs[v];
+            int c;
+            if (instr->removed || (instr->op != IR_IDIV && instr->op != IR_IMOD)) continue;
+            if (!int_const(ir, ir_arg(ir, v, 1), &c) || c <= 1 || (c & (c - 1)) != 0) continue;
+            // constants added by this pass come after those the ranges are for, they're never the left operand
+            if (ir_range_at(ranges, ir_arg(ir, v, 0), b).lo < 0) continue;
+
+            int shift = 0;
+            while ((1 << shift) != c) shift++;
+            bool is_div = instr->op == IR_IDIV;
+            // the instruction is reused in place, so its constant is added after it, which is fine as constants are
+            // pushed wherever they're used
+            IrValue operand = ir_add_instr(ir, b, IR_CONST_INT, int_type, NULL, 0);
+            ir->instrs[operand].int_val = is_div ? shift : c - 1;
+            instr = &ir->instrs[v];
+            instr->op = is_div ? IR_ISHR : IR_IAND;
+            ir->args[instr->args_start + 1] = operand;
+        }
+    }
+}
+
+// marks divisions that can't divide by 0 or overflow & array accesses with an index that's always in bounds as
+// unchecked
+static void elide_checks(Ir* ir, IrRanges* ranges) {
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IrValue v = block->instrs[i];
+            IrInstr* instr = &ir->instrs[v];
+            if (instr->removed) continue;
+            switch (instr->op) {
+                case IR_IDIV:
+                case IR_IMOD: {
+                    IrRange x = ir_range_at(ranges, ir_arg(ir, v, 0), b);
+                    IrRange d = ir_range_at(ranges, ir_arg(ir, v, 1), b);
+                    if (x.lo > x.hi || d.lo > d.hi || (d.lo <= 0 && d.hi >= 0)) break;
+                    if (d.lo <= -1 && d.hi >= -1 && x.lo == INT_MIN) break;
+                    instr->unchecked = true;
+                    break;
+                }
+                case IR_ARRLOADIDX:
+                case IR_ARRSTOREIDX: {
+                    IrRange idx = ir_range_at(ranges, ir_arg(ir, v, 0), b);
+                    if (idx.lo > idx.hi || idx.lo < 0 || idx.hi >= ranges->min_lens[ir_arg(ir, v, 1)]) break;
+                    instr->unchecked = true;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// whether v is the same every time it's computed as long as its operands are & can't error, so computing it once
+// before a loop instead of on every iteration is the same
+static bool is_invariant_op(Ir* ir, IrValue v) {
+    switch (ir->instrs[v].op) {
+        // pushed wherever they're used anyway, but hoisted they can be numbered with each other
+        case IR_CONST_INT:
+        case IR_CONST_BOOL:
+        case IR_CONST_STRING:
+        case IR_IADD:
+        case IR_ISUB:
+        case IR_IMUL:
+        case IR_ISHR:
+        case IR_IAND:
+        case IR_INEG:
+        case IR_IGT:
+        case IR_IGTE:
+        case IR_ILT:
+        case IR_ILTE:
+        case IR_IEQ:
+        case IR_INEQ:
+        case IR_BEQ:
+        case IR_BNEQ:
+        case IR_NOT:
+        case IR_SCONCAT:
+            return true;
+        case IR_IDIV:
+        case IR_IMOD:
+            return !is_root(ir, v);
+        default:
+            return false;
+    }
+}
+
+// moves values computed from nothing that changes in a loop to the end of the block the loop is entered from.
+// a loop's blocks run from its header to its back edge & inner loops come after outer ones, so going over the headers
+// backwards hoists out of inner loops first & what lands in an inner loop's entry block can move on out of the outer
+// one. a value is also hoisted out of a branch the loop may never take, which is fine as it can't error
+static void hoist_invariants(Ir* ir) {
+    for (int header = ir->block_count - 1; header >= 0; header--) {
+        IrBlock* header_block = &ir->blocks[header];
+        if (header_block->pred_count != 2 || header_block->preds[1] < header) continue;
+        int entry = header_block->preds[0];
+        int latch = header_block->preds[1];
+
+        for (int b = header; b <= latch; b++) {
+            IrBlock* block = &ir->blocks[b];
+            int kept = 0;
+            for (int i = 0; i < block->count; i++) {
+                IrValue v = block->instrs[i];
+                bool invariant = !ir->instrs[v].removed && is_invariant_op(ir, v);
+                for (int a = 0; a < ir->instrs[v].args_count && invariant; a++) {
+                    IrValue arg = ir_arg(ir, v, a);
+                    int arg_block = ir->instrs[arg].block;
+                    invariant = ir_is_const(ir, arg) || arg_block < header || arg_block > latch;
+                }
+                if (invariant) {
+                    ir_append(ir, entry, v);
+                } else {
+                    block->instrs[kept++] = v;
+                }
+            }
+            block->count = kept;
+        }
+    }
+}
+
+// a loop's body is copied at most this many instructions' worth, and a program grows by at most this many overall
+#define UNROLL_MAX_BODY 64
+#define UNROLL_MAX_GROWTH 4096
+
+typedef struct {
+    int header;
+    int latch;
+    int factor;
+    // the counter phi, the value it's compared against & how much it goes up by on every iteration
+    IrValue counter;
+    IrValue bound;
+    int step;
+    // the bound may be too close to INT_MIN to move back by the copies' steps, so that's checked before the loop
+    bool guarded;
+} UnrollLoop;
+
+// whether cond keeps the loop running while counter, which goes up by a constant, stays below bound. the counter is
+// always what's on the left of < & <=, or the right of > & >=
+static bool counted_cond(Ir* ir, IrValue cond, int header, UnrollLoop* loop) {
+    IrOp op = ir->instrs[cond].op;
+    int counter_arg;
+    if (op == IR_ILT || op == IR_ILTE) {
+        counter_arg = 0;
+    } else if (op == IR_IGT || op == IR_IGTE) {
+        counter_arg = 1;
+    } else {
+        return false;
+    }
+    IrValue counter = ir_arg(ir, cond, counter_arg);
+    IrValue bound = ir_arg(ir, cond, 1 - counter_arg);
+    IrInstr* counter_instr = &ir->instrs[counter];
+    if (counter_instr->op != IR_PHI || counter_instr->block != header) return false;
+    if (!ir_is_const(ir, bound) && ir->instrs[bound].block >= header) return false;
+
+    IrValue next = ir_arg(ir, counter, 1);
+    if (ir->instrs[next].op != IR_IADD) return false;
+    int step_arg = ir_arg(ir, next, 0) == counter ? 1 : 0;
+    int step;
+    if (ir_arg(ir, next, 1 - step_arg) != counter || !int_const(ir, ir_arg(ir, next, step_arg), &step) || step <= 0) return false;
+
+    loop->counter = counter;
+    loop->bound = bound;
+    loop->step = step;
+    return true;
+}
+
+// finds the innermost loops whose header only has phis & a comparison of a counter against a bound set before the
+// loop, & picks how many times to unroll each one
+static int find_unroll_loops(Ir* ir, IrRanges* ranges, int factor, UnrollLoop** loops_out) {
+    UnrollLoop* loops = malloc(sizeof(UnrollLoop) * (ir->block_count > 0 ? ir->block_count : 1));
+    if (!loops) {
+        fprintf(stderr, "failed to malloc unroll loops\n");
+        exit(1);
+    }
+    int count = 0;
+    int growth = 0;
+
+    for (int header = 0; header < ir->block_count; header++) {
+        IrBlock* header_block = &ir->blocks[header];
+        if (header_block->pred_count != 2 || header_block->preds[1] < header) continue;
+        int latch = header_block->preds[1];
+        if (header_block->term != IR_BRANCH || header_block->succs[0] != header + 1 || header_block->succs[1] != latch + 1) continue;
+
+        bool inner = true;
+        int size = 0;
+        for (int b = header + 1; b <= latch && inner; b++) {
+            IrBlock* block = &ir->blocks[b];
+            inner = block->pred_count != 2 || block->preds[1] < b;
+            for (int i = 0; i < block->count; i++) {
+                if (!ir->instrs[block->instrs[i]].removed) size++;
+            }
+        }
+        if (!inner) continue;
+
+        IrValue cond = ir_resolve(ir, header_block->cond);
+        bool simple_header = true;
+        for (int i = 0; i < header_block->count && simple_header; i++) {
+            IrValue v = header_block->instrs[i];
+            simple_header = ir->instrs[v].removed || ir->instrs[v].op == IR_PHI || v == cond;
+        }
+        UnrollLoop loop = {.header = header, .latch = latch};
+        if (!simple_header || ir->instrs[cond].block != header || !counted_cond(ir, cond, header, &loop)) continue;
+
+        int loop_factor = factor;
+        if (size * loop_factor > UNROLL_MAX_BODY) loop_factor = UNROLL_MAX_BODY / (size > 0 ? size : 1);
+        if (loop_factor < 2 || loop.step > INT_MAX / (loop_factor - 1)) continue;
+        if (growth + size * (loop_factor - 1) + header_block->count > UNROLL_MAX_GROWTH) continue;
+
+        // the unrolled loop runs while the counter is (factor - 1) steps below the bound, which has to fit in an int,
+        // & is skipped when it would never run
+        long long distance = (long long) loop.step * (loop_factor - 1);
+        IrRange bound = ir_range_at(ranges, loop.bound, header);
+        IrRange start = ir_range_at(ranges, ir_arg(ir, loop.counter, 0), header);
+        if (bound.lo > bound.hi || bound.hi - distance < INT_MIN) continue;
+        bool strict = ir->instrs[cond].op == IR_ILT || ir->instrs[cond].op == IR_IGT;
+        if (start.lo > bound.hi - distance - (strict ? 1 : 0)) continue;
+        loop.guarded = bound.lo - distance < INT_MIN;
+
+        loop.factor = loop_factor;
+        loops[count++] = loop;
+        growth += size * (loop_factor - 1) + header_block->count;
+    }
+
+    *loops_out = loops;
+    return count;
+}
+
+static IrValue unroll_lookup(IrValue* map, int map_count, IrValue v) {
+    return v >= 0 && v < map_count && map[v] != -1 ? map[v] : v;
+}
+
+static void set_jmp(Ir* ir, int from, int to) {
+    ir->blocks[from].term = IR_JMP;
+    ir->blocks[from].succs[0] = to;
+}
+
+// puts factor copies of the loop's body behind a new header before it, which checks the counter is far enough from
+// the bound for all of them to run. the original loop is left after it to run whatever iterations are left over.
+// a guarded loop goes around the unrolled one straight to the original when the bound can't be moved back, through
+// a join block with phis for where the original starts from
+static void unroll_loop(Ir* ir, UnrollLoop* loop, IrValue* map, int map_count, IrValue** scratch, int* scratch_capacity) {
+    VarType int_type = {.base_type = VALUE_INT, .nested = -1};
+    VarType bool_type = {.base_type = VALUE_BOOL, .nested = -1};
+    int body_count = loop->latch - loop->header;
+    int inserted = 2 + loop->factor * body_count + (loop->guarded ? 4 : 0);
+    ir_insert_blocks(ir, loop->header, inserted);
+
+    // guard, then checked, unrolled, the copies, leftover, then unchecked & join
+    int guard = loop->header;
+    int unrolled = guard + (loop->guarded ? 2 : 0);
+    int first_copy = unrolled + 1;
+    int leftover = first_copy + loop->factor * body_count;
+    int header = loop->header + inserted;
+    int latch = loop->latch + inserted;
+    int entry = ir->blocks[header].preds[0];
+
+    IrBlock* entry_block = &ir->blocks[entry];
+    for (int s = 0; s < 2; s++) {
+        if (entry_block->succs[s] == header) entry_block->succs[s] = guard;
+    }
+    int unrolled_entry = entry;
+    int join = header;
+    if (loop->guarded) {
+        int checked = guard + 1;
+        int unchecked = leftover + 1;
+        join = leftover + 2;
+        ir->blocks[guard].preds[ir->blocks[guard].pred_count++] = entry;
+        ir->blocks[checked].preds[ir->blocks[checked].pred_count++] = guard;
+        ir->blocks[unchecked].preds[ir->blocks[unchecked].pred_count++] = guard;
+        set_jmp(ir, checked, unrolled);
+        set_jmp(ir, unchecked, join);
+        set_jmp(ir, join, header);
+        ir->blocks[join].preds[ir->blocks[join].pred_count++] = leftover;
+        ir->blocks[join].preds[ir->blocks[join].pred_count++] = unchecked;
+        ir->blocks[header].preds[0] = join;
+        unrolled_entry = checked;
+    } else {
+        ir->blocks[header].preds[0] = leftover;
+    }
+    ir->blocks[unrolled].preds[ir->blocks[unrolled].pred_count++] = unrolled_entry;
+    ir->blocks[unrolled].preds[ir->blocks[unrolled].pred_count++] = leftover - 1;
+    ir->blocks[leftover].preds[ir->blocks[leftover].pred_count++] = unrolled;
+    set_jmp(ir, leftover, join);
+
+    // the bound moved back by the steps the copies after the first one take. a guarded loop only moves it in checked,
+    // past the guard's test that it can be
+    IrValue bound;
+    int distance = loop->step * (loop->factor - 1);
+    int bound_val;
+    int bound_block = loop->guarded ? guard + 1 : entry;
+    if (int_const(ir, loop->bound, &bound_val)) {
+        bound = ir_add_instr(ir, bound_block, IR_CONST_INT, int_type, NULL, 0);
+        ir->instrs[bound].int_val = bound_val - distance;
+    } else {
+        IrValue args[2] = {loop->bound, ir_add_instr(ir, bound_block, IR_CONST_INT, int_type, NULL, 0)};
+        ir->instrs[args[1]].int_val = distance;
+        bound = ir_add_instr(ir, bound_block, IR_ISUB, int_type, args, 2);
+    }
+    if (loop->guarded) {
+        IrValue args[2] = {loop->bound, ir_add_instr(ir, guard, IR_CONST_INT, int_type, NULL, 0)};
+        ir->instrs[args[1]].int_val = INT_MIN + distance;
+        ir->blocks[guard].term = IR_BRANCH;
+        ir->blocks[guard].cond = ir_add_instr(ir, guard, IR_IGTE, bool_type, args, 2);
+        ir->blocks[guard].succs[0] = guard + 1;
+        ir->blocks[guard].succs[1] = leftover + 1;
+    }
+
+    // each header phi gets one in the new header, which the original one starts from once the unrolled loop is done
+    IrBlock* header_block = &ir->blocks[header];
+    IrValue* phis = malloc(sizeof(IrValue) * (header_block->count > 0 ? header_block->count * 3 : 1));
+    if (!phis) {
+        fprintf(stderr, "failed to malloc unroll phis\n");
+        exit(1);
+    }
+    int phi_count = 0;
+    for (int i = 0; i < header_block->count; i++) {
+        IrValue v = header_block->instrs[i];
+        if (!ir->instrs[v].removed && ir->instrs[v].op == IR_PHI) phis[phi_count++] = v;
+    }
+    IrValue* unrolled_phis = phis + phi_count;
+    IrValue* next = phis + phi_count * 2;
+    for (int i = 0; i < phi_count; i++) {
+        IrValue start = ir_arg(ir, phis[i], 0);
+        IrValue args[2] = {start, -1};
+        unrolled_phis[i] = ir_add_instr(ir, unrolled, IR_PHI, ir->instrs[phis[i]].type, args, 2);
+        map[phis[i]] = unrolled_phis[i];
+        IrValue resume = unrolled_phis[i];
+        if (loop->guarded) {
+            IrValue join_args[2] = {unrolled_phis[i], start};
+            resume = ir_add_instr(ir, join, IR_PHI, ir->instrs[phis[i]].type, join_args, 2);
+        }
+        ir->args[ir->instrs[phis[i]].args_start] = resume;
+    }
+    IrValue cond = ir_resolve(ir, ir->blocks[header].cond);
+    IrValue cond_args[2] = {ir_arg(ir, cond, 0), ir_arg(ir, cond, 1)};
+    int counter_arg = cond_args[0] == loop->counter ? 0 : 1;
+    cond_args[counter_arg] = map[loop->counter];
+    cond_args[1 - counter_arg] = bound;
+    IrValue unrolled_cond = ir_add_instr(ir, unrolled, ir->instrs[cond].op, ir->instrs[cond].type, cond_args, 2);
+    ir->blocks[unrolled].term = IR_BRANCH;
+    ir->blocks[unrolled].cond = unrolled_cond;
+    ir->blocks[unrolled].succs[0] = first_copy;
+    ir->blocks[unrolled].succs[1] = leftover;
+
+    for (int copy = 0; copy < loop->factor; copy++) {
+        int offset = first_copy + copy * body_count - (header + 1);
+        for (int b = header + 1; b <= latch; b++) {
+            int to = b + offset;
+            IrBlock* from_block = &ir->blocks[b];
+            IrBlock* to_block = &ir->blocks[to];
+            to_block->pred_count = from_block->pred_count;
+            for (int p = 0; p < from_block->pred_count; p++) {
+                int pred = from_block->preds[p];
+                if (pred == header) {
+                    to_block->preds[p] = copy == 0 ? unrolled : first_copy + copy * body_count - 1;
+                } else {
+                    to_block->preds[p] = pred + offset;
+                }
+            }
+            to_block->term = from_block->term;
+            for (int s = 0; s < 2; s++) {
+                int succ = from_block->succs[s];
+                if (succ == header) {
+                    to_block->succs[s] = copy + 1 < loop->factor ? first_copy + (copy + 1) * body_count : unrolled;
+                } else if (succ != -1) {
+                    to_block->succs[s] = succ + offset;
+                }
+            }
+
+            for (int i = 0; i < ir->blocks[b].count; i++) {
+                IrValue v = ir->blocks[b].instrs[i];
+                IrInstr instr = ir->instrs[v];
+                if (instr.removed) continue;
+                if (instr.args_count > *scratch_capacity) {
+                    *scratch_capacity = instr.args_count * 2;
+                    *scratch = realloc(*scratch, sizeof(IrValue) * *scratch_capacity);
+                    if (!*scratch) {
+                        fprintf(stderr, "failed to realloc unroll args\n");
+                        exit(1);
+                    }
+                }
+                for (int a = 0; a < instr.args_count; a++) {
+                    (*scratch)[a] = unroll_lookup(map, map_count, ir_arg(ir, v, a));
+                }
+                IrValue cloned = ir_add_instr(ir, to, instr.op, instr.type, *scratch, instr.args_count);
+                IrInstr* cloned_instr = &ir->instrs[cloned];
+                switch (instr.op) {
+                    case IR_CONST_INT: cloned_instr->int_val = instr.int_val; break;
+                    case IR_CONST_BOOL: cloned_instr->bool_val = instr.bool_val; break;
+                    case IR_CONST_STRING: cloned_instr->string = instr.string; break;
+                    default: break;
+                }
+                cloned_instr->unchecked = instr.unchecked;
+                map[v] = cloned;
+            }
+            if (from_block->term == IR_BRANCH) {
+                ir->blocks[to].cond = unroll_lookup(map, map_count, ir_resolve(ir, from_block->cond));
+            }
+        }
+
+        // the phis move on all at once, as one may be what another one is set to on the back edge
+        for (int i = 0; i < phi_count; i++) {
+            next[i] = unroll_lookup(map, map_count, ir_arg(ir, phis[i], 1));
+        }
+        for (int i = 0; i < phi_count; i++) {
+            if (copy + 1 < loop->factor) {
+                map[phis[i]] = next[i];
+            } else {
+                ir->args[ir->instrs[unrolled_phis[i]].args_start + 1] = next[i];
+            }
+        }
+    }
+    free(phis);
+}
+
+void ir_unroll_loops(Ir* ir, int factor) {
+    if (factor < 2) return;
+    IrRanges ranges;
+    ir_ranges_compute(&ranges, ir);
+    UnrollLoop* loops;
+    int count = find_unroll_loops(ir, &ranges, factor, &loops);
+    free_ir_ranges(&ranges);
+
+    // every value the copies are made from is from before any of them
+    int map_count = ir->count;
+    IrValue* map = malloc(sizeof(IrValue) * (map_count > 0 ? map_count : 1));
+    int scratch_capacity = 8;
+    IrValue* scratch = malloc(sizeof(IrValue) * scratch_capacity);
+    if (!map || !scratch) {
+        fprintf(stderr, "failed to malloc unroll map\n");
+        exit(1);
+    }
+    memset(map, -1, sizeof(IrValue) * map_count);
+    // backwards, so inserting a loop's blocks doesn't move the ones still to go
+    for (int i = count - 1; i >= 0; i--) {
+        unroll_loop(ir, &loops[i], map, map_count, &scratch, &scratch_capacity);
+    }
+    free(map);
+    free(scratch);
+    free(loops);
+}
+
+void ir_optimize_loops(Ir* ir) {
+    IrRanges ranges;
+    ir_ranges_compute(&ranges, ir);
+    elide_checks(ir, &ranges);
+    reduce_strength(ir, &ranges);
+    free_ir_ranges(&ranges);
+    hoist_invariants(ir);
+    // the same value hoisted out of both sides of an if is only needed once
+    gvn(ir);
+    ir_resolve_args(ir);
+}
+
+void ir_optimize(Ir* ir) {
+    simplify_phis(ir);
+    gvn(ir);
+    simplify_phis(ir);
+    remove_dead_results(ir);
+    remove_dead_stores(ir);
+    remove_dead_values(ir);
+    ir_resolve_args(ir);
+}
@@ -0,0 +1,24 @@
+#ifndef GRBLANG_IR_OPT_H
+#define GRBLANG_IR_OPT_H
+
+#include "ir.h"
+
+// removes phis that merge a single value, numbers values over the dominator tree so recomputations reuse the first one
+// (folding constants on the way), & drops expression statements another one always overwrites, array stores another
+// store always overwrites & whatever is left that nothing uses. anything that can error at runtime is kept
+void ir_optimize(Ir* ir);
+
+// runs after ir_optimize. bounds every int (loop counters included) to drop the checks of divisions & array accesses
+// that can't fail & turn divisions & remainders by a power of two of values that can't be negative into shifts & masks,
+// then computes what a loop computes the same way on every iteration once before it instead
+void ir_optimize_loops(Ir* ir);
+
+// how many copies of a counted loop's body ir_unroll_loops makes by default
+#define IR_UNROLL_FACTOR 4
+
+// runs after ir_optimize_loops. a loop that counts up to a bound set before it gets factor copies of its body run in a
+// loop of their own, which only checks the bound once per copies, then the original loop for the iterations left over.
+// only innermost loops are unrolled, with fewer copies for bigger bodies & none once the program has grown too much
+void ir_unroll_loops(Ir* ir, int factor);
+
+#endif //GRBLANG_IR_OPT_H
@@ -0,0 +1,326 @@
+#include "ir_range.h"
+#include "ir.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// passes a range may grow for before it's widened, enough for a short loop to be bounded exactly
+#define WIDEN_AFTER 3
+#define NARROW_PASSES 2
+// dominators looked at for branch conditions, so a long run of ifs doesn't make every lookup walk all of them
+#define MAX_CONDITION_DEPTH 16
+// array lengths only ever shrink towards a fixed point, this is a backstop for one that takes too long to get there
+#define MAX_LEN_PASSES 64
+
+static const IrRange empty_range = {INT_MAX, INT_MIN};
+static const IrRange full_range = {INT_MIN, INT_MAX};
+
+static bool is_empty(IrRange range) {
+    return range.lo > range.hi;
+}
+
+// bounds computed in 64 bits, anything outside of an int wraps in the vm & could end up anywhere
+static IrRange make_range(long long lo, long long hi) {
+    if (lo < INT_MIN || hi > INT_MAX) return full_range;
+    return (IrRange) {.lo = (int) lo, .hi = (int) hi};
+}
+
+static long long min4(long long a, long long b, long long c, long long d) {
+    long long m = a < b ? a : b;
+    m = m < c ? m : c;
+    return m < d ? m : d;
+}
+
+static long long max4(long long a, long long b, long long c, long long d) {
+    long long m = a > b ? a : b;
+    m = m > c ? m : c;
+    return m > d ? m : d;
+}
+
+// v op other is the same as other flipped(op) v
+static IrOp flip_comparison(IrOp op) {
+    switch (op) {
+        case IR_IGT: return IR_ILT;
+        case IR_IGTE: return IR_ILTE;
+        case IR_ILT: return IR_IGT;
+        case IR_ILTE: return IR_IGTE;
+        default: return op;
+    }
+}
+
+static IrOp negate_comparison(IrOp op) {
+    switch (op) {
+        case IR_IGT: return IR_ILTE;
+        case IR_IGTE: return IR_ILT;
+        case IR_ILT: return IR_IGTE;
+        case IR_ILTE: return IR_IGT;
+        case IR_IEQ: return IR_INEQ;
+        default: return IR_IEQ;
+    }
+}
+
+// range narrowed to where cond came out as taken, if cond compares v
+static IrRange narrow(IrRanges* r, IrRange range, IrValue v, IrValue cond, bool taken) {
+    Ir* ir = r->ir;
+    if (ir->instrs[cond].op == IR_NOT) {
+        cond = ir_arg(ir, cond, 0);
+        taken = !taken;
+    }
+    IrOp op = ir->instrs[cond].op;
+    if (op != IR_IGT && op != IR_IGTE && op != IR_ILT && op != IR_ILTE && op != IR_IEQ && op != IR_INEQ) return range;
+
+    IrValue other;
+    if (ir_arg(ir, cond, 0) == v) {
+        other = ir_arg(ir, cond, 1);
+    } else if (ir_arg(ir, cond, 1) == v) {
+        other = ir_arg(ir, cond, 0);
+        op = flip_comparison(op);
+    } else {
+        return range;
+    }
+    if (!taken) op = negate_comparison(op);
+
+    // a comparison that never runs lets nothing past it run either
+    IrRange o = r->ranges[other];
+    if (is_empty(o)) return empty_range;
+    long long lo = range.lo, hi = range.hi;
+    switch (op) {
+        case IR_ILT: if ((long long) o.hi - 1 < hi) hi = (long long) o.hi - 1; break;
+        case IR_ILTE: if (o.hi < hi) hi = o.hi; break;
+        case IR_IGT: if ((long long) o.lo + 1 > lo) lo = (long long) o.lo + 1; break;
+        case IR_IGTE: if (o.lo > lo) lo = o.lo; break;
+        case IR_IEQ:
+            if (o.lo > lo) lo = o.lo;
+            if (o.hi < hi) hi = o.hi;
+            break;
+        default:
+            if (o.lo == o.hi && lo == o.lo) lo++;
+            if (o.lo == o.hi && hi == o.lo) hi--;
+            break;
+    }
+    if (lo > hi) return empty_range;
+    return (IrRange) {.lo = (int) lo, .hi = (int) hi};
+}
+
+IrRange ir_range_at(IrRanges* r, IrValue v, int block) {
+    Ir* ir = r->ir;
+    IrRange range = r->ranges[v];
+    // every path to a block with a single predecessor that branches came down that edge
+    for (int depth = 0; depth < MAX_CONDITION_DEPTH && block > 0 && !is_empty(range); depth++) {
+        IrBlock* b = &ir->blocks[block];
+        if (b->pred_count == 1) {
+            IrBlock* pred = &ir->blocks[b->preds[0]];
+            if (pred->term == IR_BRANCH && pred->succs[0] != pred->succs[1]) {
+                range = narrow(r, range, v, ir_resolve(ir, pred->cond), pred->succs[0] == block);
+            }
+        }
+        block = r->idom[block];
+    }
+    return range;
+}
+
+static IrRange divide_range(IrRange x, IrRange d) {
+    // dividing by 0 errors, so those values never come out
+    if (d.lo == 0) d.lo = 1;
+    if (d.hi == 0) d.hi = -1;
+    if (is_empty(d)) return empty_range;
+    if (d.lo < 0 && d.hi > 0) {
+        long long m = -(long long) x.lo > x.hi ? -(long long) x.lo : x.hi;
+        return make_range(-m, m);
+    }
+    return make_range(min4((long long) x.lo / d.lo, (long long) x.lo / d.hi, (long long) x.hi / d.lo, (long long) x.hi / d.hi),
+        max4((long long) x.lo / d.lo, (long long) x.lo / d.hi, (long long) x.hi / d.lo, (long long) x.hi / d.hi));
+}
+
+// the remainder has the sign of x & is smaller than the divisor
+static IrRange remainder_range(IrRange x, IrRange d) {
+    if (d.lo == 0) d.lo = 1;
+    if (d.hi == 0) d.hi = -1;
+    if (is_empty(d)) return empty_range;
+    long long m = -(long long) d.lo > d.hi ? -(long long) d.lo : d.hi;
+    m--;
+    long long lo = x.lo < -m ? -m : x.lo;
+    long long hi = x.hi > m ? m : x.hi;
+    if (lo > 0) lo = 0;
+    if (hi < 0) hi = 0;
+    return make_range(lo, hi);
+}
+
+static IrRange eval_range(IrRanges* r, IrValue v) {
+    Ir* ir = r->ir;
+    IrInstr* instr = &ir->instrs[v];
+    if (instr->type.base_type != VALUE_INT || instr->type.nested != -1) return full_range;
+    if (instr->op == IR_CONST_INT) return (IrRange) {.lo = instr->int_val, .hi = instr->int_val};
+
+    if (instr->op == IR_PHI) {
+        IrRange range = empty_range;
+        for (int i = 0; i < instr->args_count; i++) {
+            IrValue arg = ir_arg(ir, v, i);
+            if (ir->instrs[arg].op == IR_UNDEF) continue;
+            IrRange in = ir_range_at(r, arg, ir->blocks[instr->block].preds[i]);
+            if (is_empty(in)) continue;
+            if (in.lo < range.lo) range.lo = in.lo;
+            if (in.hi > range.hi) range.hi = in.hi;
+        }
+        return range;
+    }
+
+    switch (instr->op) {
+        case IR_IADD:
+        case IR_ISUB:
+        case IR_IMUL:
+        case IR_IDIV:
+        case IR_IMOD:
+        case IR_ISHR:
+        case IR_IAND:
+        case IR_INEG:
+            break;
+        default:
+            return full_range;
+    }
+    IrRange a = ir_range_at(r, ir_arg(ir, v, 0), instr->block);
+    if (is_empty(a)) return empty_range;
+    if (instr->op == IR_INEG) return make_range(-(long long) a.hi, -(long long) a.lo);
+    IrRange b = ir_range_at(r, ir_arg(ir, v, 1), instr->block);
+    if (is_empty(b)) return empty_range;
+
+    switch (instr->op) {
+        case IR_IADD: return make_range((long long) a.lo + b.lo, (long long) a.hi + b.hi);
+        case IR_ISUB: return make_range((long long) a.lo - b.hi, (long long) a.hi - b.lo);
+        case IR_IMUL:
+            return make_range(min4((long long) a.lo * b.lo, (long long) a.lo * b.hi, (long long) a.hi * b.lo, (long long) a.hi * b.hi),
+                max4((long long) a.lo * b.lo, (long long) a.lo * b.hi, (long long) a.hi * b.lo, (long long) a.hi * b.hi));
+        case IR_IDIV: return divide_range(a, b);
+        case IR_IMOD: return remainder_range(a, b);
+        case IR_ISHR:
+            if (b.lo == b.hi) return make_range(a.lo >> (b.lo & 31), a.hi >> (b.lo & 31));
+            // somewhere between x & its sign
+            return make_range(a.lo < 0 ? a.lo : 0, a.hi >= 0 ? a.hi : -1);
+        default:
+            if (a.lo >= 0 && b.lo >= 0) return make_range(0, a.hi < b.hi ? a.hi : b.hi);
+            if (a.lo >= 0) return make_range(0, a.hi);
+            if (b.lo >= 0) return make_range(0, b.hi);
+            return full_range;
+    }
+}
+
+static int eval_min_len(IrRanges* r, IrValue v) {
+    Ir* ir = r->ir;
+    IrInstr* instr = &ir->instrs[v];
+    switch (instr->op) {
+        case IR_ARRAY:
+            return instr->args_count;
+        case IR_ARRAPPEND: {
+            int len = r->min_lens[ir_arg(ir, v, 0)];
+            return len == INT_MAX ? len : len + 1;
+        }
+        case IR_PHI: {
+            int len = INT_MAX;
+            for (int i = 0; i < instr->args_count; i++) {
+                IrValue arg = ir_arg(ir, v, i);
+                if (ir->instrs[arg].op == IR_UNDEF) continue;
+                if (r->min_lens[arg] < len) len = r->min_lens[arg];
+            }
+            return len;
+        }
+        default:
+            return 0;
+    }
+}
+
+static void compute_min_lens(IrRanges* r) {
+    Ir* ir = r->ir;
+    for (IrValue v = 0; v < ir->count; v++) {
+        r->min_lens[v] = INT_MAX;
+    }
+
+    // every length starts out as large as it can be & shrinks to what its definition allows, with a phi in a loop
+    // settling on the least of what it gets before & around the loop
+    bool changed = true;
+    for (int pass = 0; changed; pass++) {
+        if (pass == MAX_LEN_PASSES) {
+            for (IrValue v = 0; v < ir->count; v++) {
+                r->min_lens[v] = 0;
+            }
+            return;
+        }
+        changed = false;
+        for (int b = 0; b < ir->block_count; b++) {
+            IrBlock* block = &ir->blocks[b];
+            for (int i = 0; i < block->count; i++) {
+                IrValue v = block->instrs[i];
+                if (ir->instrs[v].removed) continue;
+                int len = eval_min_len(r, v);
+                if (len != r->min_lens[v]) {
+                    r->min_lens[v] = len;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+void ir_ranges_compute(IrRanges* r, Ir* ir) {
+    r->ir = ir;
+    r->idom = ir_idoms(ir);
+    r->ranges = malloc(sizeof(IrRange) * (ir->count > 0 ? ir->count : 1));
+    r->min_lens = malloc(sizeof(int) * (ir->count > 0 ? ir->count : 1));
+    if (!r->ranges || !r->min_lens) {
+        fprintf(stderr, "failed to malloc value ranges\n");
+        exit(1);
+    }
+    for (IrValue v = 0; v < ir->count; v++) {
+        r->ranges[v] = empty_range;
+    }
+
+    // ranges only grow from empty until nothing changes, those that keep growing are widened to the end of the int
+    // range in the direction they grow in, so this stops
+    bool changed = true;
+    for (int pass = 0; changed; pass++) {
+        changed = false;
+        for (int b = 0; b < ir->block_count; b++) {
+            IrBlock* block = &ir->blocks[b];
+            for (int i = 0; i < block->count; i++) {
+                IrValue v = block->instrs[i];
+                if (ir->instrs[v].removed) continue;
+                IrRange old = r->ranges[v];
+                IrRange next = eval_range(r, v);
+                if (is_empty(next)) continue;
+                if (!is_empty(old)) {
+                    if (old.lo < next.lo) next.lo = old.lo;
+                    if (old.hi > next.hi) next.hi = old.hi;
+                    if (pass >= WIDEN_AFTER && next.lo < old.lo) next.lo = INT_MIN;
+                    if (pass >= WIDEN_AFTER && next.hi > old.hi) next.hi = INT_MAX;
+                }
+                if (next.lo != old.lo || next.hi != old.hi) {
+                    r->ranges[v] = next;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // everything holds now, so recomputing each range from the others only ever tightens it. this is what bounds a
+    // widened loop counter by the condition that keeps the loop going
+    for (int pass = 0; pass < NARROW_PASSES; pass++) {
+        for (int b = 0; b < ir->block_count; b++) {
+            IrBlock* block = &ir->blocks[b];
+            for (int i = 0; i < block->count; i++) {
+                IrValue v = block->instrs[i];
+                if (!ir->instrs[v].removed) r->ranges[v] = eval_range(r, v);
+            }
+        }
+    }
+
+    compute_min_lens(r);
+}
+
+void free_ir_ranges(IrRanges* r) {
+    free(r->idom);
+    free(r->ranges);
+    free(r->min_lens);
+    r->idom = NULL;
+    r->ranges = NULL;
+    r->min_lens = NULL;
+}
@@ -0,0 +1,30 @@
+#ifndef GRBLANG_IR_RANGE_H
+#define GRBLANG_IR_RANGE_H
+
+#include "ir.h"
+
+// every value an int can take is in [lo, hi], lo > hi for a value that's never computed
+typedef struct {
+    int lo;
+    int hi;
+} IrRange;
+
+typedef struct {
+    Ir* ir;
+    int* idom;
+    // by value, of the ints
+    IrRange* ranges;
+    // by value, how many elements an array has at least. arrays only ever grow, so that holds from where it's defined on
+    int* min_lens;
+} IrRanges;
+
+// bounds every int in ir & the length of every array. loop counters are found by widening what a loop's phis can
+// reach to the whole int range once they keep growing, then narrowing them again with the branches that keep the loop
+// running
+void ir_ranges_compute(IrRanges* r, Ir* ir);
+void free_ir_ranges(IrRanges* r);
+
+// the range of v where it's used in block, narrowed by the comparisons that must have gone a certain way to get there
+IrRange ir_range_at(IrRanges* r, IrValue v, int block);
+
+#endif //GRBLANG_IR_RANGE_H
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# generates the keyword perfect hash in lexer.c: prints the KEYWORD_* defines, keyword_assoc & keywords to paste over
+# the ones there. add a keyword to KEYWORDS & rerun it, the search is seeded so the same list always gives the same
+# tables
+import random
+import sys
+
+# text, token, data type (only meaningful for TOK_TYPE)
+KEYWORDS = [
+    ("var", "TOK_VAR", "DATA_INT"),
+    ("true", "TOK_TRUE", "DATA_INT"),
+    ("false", "TOK_FALSE", "DATA_INT"),
+    ("int", "TOK_TYPE", "DATA_INT"),
+    ("bool", "TOK_TYPE", "DATA_BOOL"),
+    ("string", "TOK_TYPE", "DATA_STRING"),
+    ("if", "TOK_IF", "DATA_INT"),
+    ("else", "TOK_ELSE", "DATA_INT"),
+    ("while", "TOK_WHILE", "DATA_INT"),
+    ("fn", "TOK_FN", "DATA_INT"),
+    ("return", "TOK_RETURN", "DATA_INT"),
+]
+SEED = 1
+TRIES = 10_000_000
+
+
+def slot_sums(assoc):
+    return [assoc[k[0]] + assoc[k[-1]] + len(k) for k, _, _ in KEYWORDS]
+
+
+# keyword_assoc[first] + keyword_assoc[last] + len has to be distinct for every keyword & the sums contiguous, so they
+# index keywords with no gaps once the smallest is subtracted. values are drawn from [0, count] at random until that holds
+def search():
+    rng = random.Random(SEED)
+    chars = sorted({k[0] for k, _, _ in KEYWORDS} | {k[-1] for k, _, _ in KEYWORDS})
+    count = len(KEYWORDS)
+    for _ in range(TRIES):
+        assoc = {c: rng.randint(0, count) for c in chars}
+        sums = slot_sums(assoc)
+        if len(set(sums)) == count and max(sums) - min(sums) == count - 1:
+            return assoc
+    sys.exit("error: no perfect hash found, raise TRIES or try another SEED")
+
+
+def main():
+    assoc = search()
+    sums = slot_sums(assoc)
+    hash_min = min(sums)
+    lens = [len(k) for k, _, _ in KEYWORDS]
+    print("#define KEYWORD_COUNT %d" % len(KEYWORDS))
+    print("#define KEYWORD_HASH_MIN %d" % hash_min)
+    print("#define KEYWORD_MIN_LEN %d" % min(lens))
+    print("#define KEYWORD_MAX_LEN %d" % max(lens))
+    print()
+    print("static const uint8_t keyword_assoc[256] = {")
+    entries = ["['%s'] = %d," % (c, v) for c, v in sorted(assoc.items())]
+    for i in range(0, len(entries), 6):
+        print("    " + " ".join(entries[i:i + 6]))
+    print("};")
+    print()
+    print("static const Keyword keywords[KEYWORD_COUNT] = {")
+    for _, (text, token, data_type) in sorted(zip(sums, KEYWORDS)):
+        print('    {"%s", %d, %s, %s},' % (text, len(text), token, data_type))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
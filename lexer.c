@@ -1,13 +1,88 @@
 #include "lexer.h"
+#include "lexer_scan.h"
 
-#include <errno.h>
 #include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
-#define IS_ALPHA(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || ((c) == '_'))
+typedef enum {
+    CC_OTHER, // anything not valid in the language
+    CC_END, // '\0', treated as eof
+    CC_SPACE,
+    CC_DIGIT,
+    CC_ALPHA,
+    CC_QUOTE,
+    CC_SINGLE, // always a single char token
+    CC_MAYBE_EQ, // single char token, or a different token if followed by `=`
+    CC_DOUBLE, // only valid as the same char twice, ex: &&
+} CharClass;
+
+// [x ... y] ranges are a gnu extension, but both gcc & clang support it
+static const uint8_t char_class[256] = {
+    ['\0'] = CC_END,
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['0' ... '9'] = CC_DIGIT,
+    ['a' ... 'z'] = CC_ALPHA, ['A' ... 'Z'] = CC_ALPHA, ['_'] = CC_ALPHA,
+    ['"'] = CC_QUOTE,
+    ['('] = CC_SINGLE, [')'] = CC_SINGLE, [';'] = CC_SINGLE, [':'] = CC_SINGLE, ['{'] = CC_SINGLE, ['}'] = CC_SINGLE,
+    ['['] = CC_SINGLE, [']'] = CC_SINGLE, [','] = CC_SINGLE, ['%'] = CC_SINGLE,
+    ['+'] = CC_MAYBE_EQ, ['-'] = CC_MAYBE_EQ, ['*'] = CC_MAYBE_EQ, ['/'] = CC_MAYBE_EQ, ['='] = CC_MAYBE_EQ, ['!'] = CC_MAYBE_EQ,
+    ['<'] = CC_MAYBE_EQ, ['>'] = CC_MAYBE_EQ,
+    ['&'] = CC_DOUBLE, ['|'] = CC_DOUBLE,
+};
+
+// token for CC_SINGLE/CC_MAYBE_EQ chars on their own, or for the doubled char for CC_DOUBLE
+static const uint8_t char_token[256] = {
+    ['('] = TOK_LPAREN, [')'] = TOK_RPAREN, [';'] = TOK_SEMICOLON, [':'] = TOK_COLON, ['{'] = TOK_LBRACE, ['}'] = TOK_RBRACE,
+    ['['] = TOK_LBRACKET, [']'] = TOK_RBRACKET, [','] = TOK_COMMA, ['%'] = TOK_MODULO,
+    ['+'] = TOK_PLUS, ['-'] = TOK_MINUS, ['*'] = TOK_MULT, ['/'] = TOK_DIV, ['='] = TOK_ASSIGN, ['!'] = TOK_EXCLAM,
+    ['<'] = TOK_LESS, ['>'] = TOK_GREATER,
+    ['&'] = TOK_AND, ['|'] = TOK_OR,
+};
+
+// token for CC_MAYBE_EQ chars followed by `=`
+static const uint8_t char_eq_token[256] = {
+    ['+'] = TOK_PLUS_EQUALS, ['-'] = TOK_MINUS_EQUALS, ['*'] = TOK_MULT_EQUALS, ['/'] = TOK_DIV_EQUALS, ['='] = TOK_EQUALS,
+    ['!'] = TOK_NOT_EQUALS, ['<'] = TOK_LESS_EQUALS, ['>'] = TOK_GREATER_EQUALS,
+};
+
+typedef struct {
+    const char* text;
+    int len;
+    TokenType type;
+    DataType data_type; // only meaningful for TOK_TYPE
+} Keyword;
+
+// minimal perfect hash over the keywords: keyword_assoc[first] + keyword_assoc[last] + len - KEYWORD_HASH_MIN maps every keyword
+// to a distinct slot in [0, KEYWORD_COUNT). everything from the defines to the end of keywords is printed by keyword_hash.py, so
+// adding a keyword means adding it to the list there & pasting its output over these. chars not in any keyword are 0, which just
+// lands in some slot & fails the length-checked compare
+#define KEYWORD_COUNT 11
+#define KEYWORD_HASH_MIN 9
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 6
+
+static const uint8_t keyword_assoc[256] = {
+    ['b'] = 9, ['e'] = 4, ['f'] = 7, ['g'] = 3, ['i'] = 2, ['l'] = 0,
+    ['n'] = 0, ['r'] = 9, ['s'] = 10, ['t'] = 9, ['v'] = 6, ['w'] = 1,
+};
+
+static const Keyword keywords[KEYWORD_COUNT] = {
+    {"fn", 2, TOK_FN, DATA_INT},
+    {"while", 5, TOK_WHILE, DATA_INT},
+    {"if", 2, TOK_IF, DATA_INT},
+    {"else", 4, TOK_ELSE, DATA_INT},
+    {"bool", 4, TOK_TYPE, DATA_BOOL},
+    {"int", 3, TOK_TYPE, DATA_INT},
+    {"return", 6, TOK_RETURN, DATA_INT},
+    {"false", 5, TOK_FALSE, DATA_INT},
+    {"true", 4, TOK_TRUE, DATA_INT},
+    {"var", 3, TOK_VAR, DATA_INT},
+    {"string", 6, TOK_TYPE, DATA_STRING},
+};
 
 void token_string(Token t, char buffer[50]) {
     switch (t.type) {
@@ -33,7 +108,7 @@ void token_string(Token t, char buffer[50]) {
             sprintf(buffer, "INT(=%d, @%d)", t.value.int_val, t.length);
             break;
         case TOK_STRING:
-            sprintf(buffer, "STRING(=%s, @%d)", t.value.string_val, t.length);
+            snprintf(buffer, 50, "STRING(=%.*s, @%d)", t.length, t.start_literal, t.length);
             break;
         case TOK_LPAREN:
             sprintf(buffer, "LPAREN(@%d)", t.length);
@@ -51,7 +126,7 @@ void token_string(Token t, char buffer[50]) {
             sprintf(buffer, "FALSE(@%d)", t.length);
             break;
         case TOK_IDENT:
-            sprintf(buffer, "IDENT(=%s, @%d)", t.value.ident_val, t.length);
+            snprintf(buffer, 50, "IDENT(=%.*s, @%d)", t.length, t.start_literal, t.length);
             break;
         case TOK_RPAREN:
             sprintf(buffer, "RPAREN(@%d)", t.length);
@@ -91,358 +166,302 @@ void token_string(Token t, char buffer[50]) {
     }
 }
 
+// slides the unconsumed part of the current token to the front of the window & reads as much as fits after it.
+// returns false once the stream is exhausted, the window only grows past its initial size for a single token longer than it
+static bool lex_refill(Lexer* lex) {
+    LexerStream* stream = lex->stream;
+    if (!stream || stream->eof) {
+        return false;
+    }
+
+    size_t keep = lex->len - lex->token_start;
+    if (lex->token_start > 0) {
+        memmove(stream->window, stream->window + lex->token_start, keep);
+        lex->pos -= lex->token_start;
+        lex->token_start = 0;
+    }
+
+    if (keep == stream->capacity) {
+        size_t new_capacity = stream->capacity * 2;
+        char* new_window = realloc(stream->window, new_capacity);
+        if (!new_window) {
+            fprintf(stderr, "failed to realloc lexer stream window\n");
+            exit(1);
+        }
+        stream->window = new_window;
+        stream->capacity = new_capacity;
+    }
+
+    size_t read = fread(stream->window + keep, 1, stream->capacity - keep, stream->file);
+    if (read == 0) {
+        stream->eof = true;
+    }
+
+    lex->src = stream->window;
+    lex->len = keep + read;
+    return read > 0;
+}
+
 void lex_advance(Lexer* lex) {
-    if (lex->pos < strlen(lex->src)) {
+    if (lex->pos < lex->len) {
         lex->pos++;
-        lex->current = lex->src[lex->pos];
-    } else {
-        lex->current = '\0';
     }
+    if (lex->pos >= lex->len && lex->stream) {
+        lex_refill(lex);
+    }
+    lex->current = lex->pos < lex->len ? lex->src[lex->pos] : '\0';
+}
+
+void lex_skip(Lexer* lex, size_t n) {
+    lex->pos += n;
+    if (lex->pos > lex->len) {
+        lex->pos = lex->len;
+    }
+    if (lex->pos >= lex->len && lex->stream) {
+        lex_refill(lex);
+    }
+    lex->current = lex->pos < lex->len ? lex->src[lex->pos] : '\0';
 }
 
-void lexer_init(Lexer* l, const char* src) {
+// skips a run with one of the scan_* kernels. a run can only continue past the end of the window when streaming, in which
+// case lex_skip has already refilled it & the kernel needs to keep going from there
+static void lex_skip_run(Lexer* l, size_t (*kernel)(const char* p, size_t n)) {
+    while (true) {
+        size_t n = kernel(l->src + l->pos, l->len - l->pos);
+        bool hit_end = l->pos + n == l->len;
+        lex_skip(l, n);
+        if (!hit_end || n == 0 || !l->stream) {
+            return;
+        }
+    }
+}
+
+void lexer_init(Lexer* l, const char* src, size_t len) {
     l->src = src;
+    l->len = len;
     l->pos = 0;
-    l->current = src[0];
+    l->token_start = 0;
+    l->stream = NULL;
+    l->arena = NULL;
+    l->current = len > 0 ? src[0] : '\0';
 }
 
-void lex_skip_whitespace(Lexer* l) {
-    while (l->current == ' ' || l->current == '\t' || l->current == '\n' || l->current == '\r') {
-        lex_advance(l);
+void lexer_init_stream(Lexer* l, FILE* file, size_t window_size) {
+    LexerStream* stream = malloc(sizeof(LexerStream));
+    stream->file = file;
+    stream->capacity = window_size > 0 ? window_size : LEXER_DEFAULT_WINDOW;
+    stream->window = malloc(stream->capacity);
+    stream->eof = false;
+    if (!stream->window) {
+        fprintf(stderr, "failed to malloc lexer stream window\n");
+        exit(1);
     }
-}
 
-int lex_parse_int(Lexer* l, const char **start_out, int* length_out) {
-    const char* start = &l->current;
-    char int_str[11];
-    int i = 0;
+    l->src = stream->window;
+    l->len = 0;
+    l->pos = 0;
+    l->token_start = 0;
+    l->stream = stream;
+    l->arena = NULL;
+    lex_refill(l);
+    l->current = l->len > 0 ? l->src[0] : '\0';
+}
 
-    while (IS_DIGIT(l->current) && i < 10) {
-        int_str[i++] = l->current;
-        lex_advance(l);
+void lexer_free(Lexer* l) {
+    if (l->stream) {
+        free(l->stream->window);
+        free(l->stream);
+        l->stream = NULL;
     }
-    int_str[i] = '\0';
+}
 
-    if (start_out) *start_out = start;
-    if (length_out) *length_out = i;
+void lex_skip_whitespace(Lexer* l) {
+    // most tokens are separated by at most a single space, so don't bother calling into the kernel for those
+    if (char_class[(uint8_t) l->current] != CC_SPACE) {
+        return;
+    }
+    lex_advance(l);
+    lex_skip_run(l, scan_whitespace);
+}
 
-    if (i == 0) {
-        return -1;
+int lex_parse_int(Lexer* l, const char **start_out, int* length_out) {
+    l->token_start = l->pos;
+    lex_skip_run(l, scan_digits);
+    const char* start = l->src + l->token_start;
+    size_t i = l->pos - l->token_start;
+
+    long value = 0;
+    bool overflow = i > 10;
+    for (size_t j = 0; j < i && !overflow; j++) {
+        value = value * 10 + (start[j] - '0');
+        overflow = value > INT_MAX;
     }
 
-    errno = 0;
-    char *end;
-    long conv_int = strtol(int_str, &end, 10);
+    if (start_out) *start_out = start;
+    if (length_out) *length_out = (int) i;
 
-    if (conv_int > INT_MAX || errno == ERANGE) {
+    if (i == 0 || overflow) {
         return -1;
     }
 
-    return (int) conv_int;
+    return (int) value;
 }
 
 void lex_parse_string(Lexer* l, char** str_out, const char** start_out, int* len_out) {
+    l->token_start = l->pos;
     lex_advance(l);
-    const char* start = &l->current;
-    int curr_capacity = 256;
-    char* str = malloc(sizeof(char) * curr_capacity);
-    int i = 0;
+    bool escaped = false;
 
-    while (l->current != '"') {
-        if (i >= curr_capacity) {
-            curr_capacity *= 2;
-            char* new_str = realloc(str, sizeof(char) * curr_capacity);
-            if (!new_str) {
-                fprintf(stderr, "failed to realloc str while parsing str\n");
-                exit(1);
-            }
-            str = new_str;
-        }
-        if (l->current == '\\') {
-            lex_advance(l);
-            char esc = l->current;
-            char out;
-            switch (esc) {
-                case 'n': out = '\n'; break;
-                case 't': out = '\t'; break;
-                case 'r': out = '\r'; break;
-                case '\\': out = '\\'; break;
-                case '"': out = '"'; break;
-                case '0': out = '\0'; break;
-                default: out = esc; break;
-            }
-            str[i++] = out;
-            lex_advance(l);
-        } else {
-            str[i++] = l->current;
-            lex_advance(l);
+    while (true) {
+        lex_skip_run(l, scan_string_body);
+        if (l->current != '\\') {
+            break;
         }
+        escaped = true;
+        lex_advance(l);
+        lex_advance(l);
     }
-    str[i] = '\0';
 
     if (l->current != '"') {
         fprintf(stderr, "expected \" after string\n");
         exit(1);
     }
 
-    lex_advance(l);
-    *str_out = str;
-    *start_out = start;
-    *len_out = i;
-}
+    // + 1 to skip the opening quote, this has to be computed after the loop as streaming can move the window
+    const char* start = l->src + l->token_start + 1;
+    int raw_len = (int) (l->src + l->pos - start);
 
-TokenType lex_parse_ident(Lexer* l, char** ident_out, const char** start_out, int* len_out, DataType* type_out) {
-    const char* start = &l->current;
-    char ident_str[256];
+    // when streaming the window will be reused, so the body has to be copied out even without escapes
+    if (!escaped && !l->stream) {
+        lex_advance(l);
+        *str_out = NULL;
+        *start_out = start;
+        *len_out = raw_len;
+        return;
+    }
+
+    // unescaping only ever shrinks the string so raw_len is always enough
+    char* str = l->arena ? arena_alloc(l->arena, raw_len + 1) : malloc(sizeof(char) * (raw_len + 1));
+    if (!str) {
+        fprintf(stderr, "failed to malloc str while parsing str\n");
+        exit(1);
+    }
     int i = 0;
+    for (int j = 0; j < raw_len; j++) {
+        if (start[j] != '\\') {
+            str[i++] = start[j];
+            continue;
+        }
 
-    while (IS_ALPHA(l->current)) {
-        if (i >= 255) { // previous condition was i < 256 in while; this preserves the same behaviour
-            fprintf(stderr, "error: identifiers not allowed to be longer than 256");
-            exit(1);
+        char esc = start[++j];
+        char out;
+        switch (esc) {
+            case 'n': out = '\n'; break;
+            case 't': out = '\t'; break;
+            case 'r': out = '\r'; break;
+            case '\\': out = '\\'; break;
+            case '"': out = '"'; break;
+            case '0': out = '\0'; break;
+            default: out = esc; break;
         }
-        ident_str[i++] = l->current;
-        lex_advance(l);
+        str[i++] = out;
     }
-    ident_str[i] = '\0';
-
-    if (start_out) *start_out = start;
-    if (len_out) *len_out = i;
+    str[i] = '\0';
+    lex_advance(l);
 
-    switch (strlen(ident_str)) {
-        case 2:
-            if (strcmp(ident_str, "if") == 0) {
-                return TOK_IF;
-            }
-            if (strcmp(ident_str, "fn") == 0) {
-                return TOK_FN;
-            }
-        case 3:
-            if (strcmp(ident_str, "var") == 0) {
-                return TOK_VAR;
-            }
+    *str_out = str;
+    *start_out = str;
+    *len_out = i;
+}
 
-            if (strcmp(ident_str, "int") == 0) {
-                *type_out = DATA_INT;
-                return TOK_TYPE;
-            }
-            break;
-        case 4:
-            if (strcmp(ident_str, "true") == 0) {
-                return TOK_TRUE;
-            }
+TokenType lex_parse_ident(Lexer* l, const char** start_out, int* len_out, DataType* type_out) {
+    l->token_start = l->pos;
+    lex_skip_run(l, scan_ident);
+    const char* start = l->src + l->token_start;
+    int i = (int) (l->pos - l->token_start);
 
-            if (strcmp(ident_str, "bool") == 0) {
-                *type_out = DATA_BOOL;
-                return TOK_TYPE;
-            }
+    if (start_out) *start_out = start;
+    if (len_out) *len_out = i;
 
-            if (strcmp(ident_str, "else") == 0) {
-                return TOK_ELSE;
-            }
-            break;
-        case 5:
-            if (strcmp(ident_str, "false") == 0) {
-                return TOK_FALSE;
-            }
-            if (strcmp(ident_str, "while") == 0) {
-                return TOK_WHILE;
-            }
-            break;
-        case 6:
-            if (strcmp(ident_str, "return") == 0) {
-                return TOK_RETURN;
-            }
-            if (strcmp(ident_str, "string") == 0) {
-                *type_out = DATA_STRING;
-                return TOK_TYPE;
-            }
-            break;
+    if (i < KEYWORD_MIN_LEN || i > KEYWORD_MAX_LEN) {
+        return TOK_IDENT;
+    }
 
-        default: break;
+    unsigned int slot = keyword_assoc[(uint8_t) start[0]] + keyword_assoc[(uint8_t) start[i - 1]] + i - KEYWORD_HASH_MIN;
+    if (slot < KEYWORD_COUNT && keywords[slot].len == i && memcmp(keywords[slot].text, start, i) == 0) {
+        if (keywords[slot].type == TOK_TYPE) {
+            *type_out = keywords[slot].data_type;
+        }
+        return keywords[slot].type;
     }
 
-    if (ident_out) *ident_out = strdup(ident_str);
     return TOK_IDENT;
 }
 
 Token lex_next(Lexer* l) {
     Token t;
+    // nothing before the current position is needed anymore, so whitespace can be dropped from the window while skipping it
+    l->token_start = l->pos;
     lex_skip_whitespace(l);
+    l->token_start = l->pos;
 
-    t.start_literal = &l->current;
     t.length = 1;
 
-    switch (l->current) {
-        // TODO: abstract out x token plus equals = other token into a function
-        case '+':
-            t.type = TOK_PLUS;
-            lex_advance(l);
-
-            if (l->current == '=') {
-                t.type = TOK_PLUS_EQUALS;
-                t.length++;
-                lex_advance(l);
-            }
-
-            return t;
-        case '-':
-            t.type = TOK_MINUS;
-            lex_advance(l);
-
-            if (l->current == '=') {
-                t.type = TOK_MINUS_EQUALS;
-                t.length++;
-                lex_advance(l);
-            }
-
-            return t;
-        case '*':
-            t.type = TOK_MULT;
-            lex_advance(l);
-
-            if (l->current == '=') {
-                t.type = TOK_MULT_EQUALS;
-                t.length++;
-                lex_advance(l);
-            }
-
-            return t;
-        case '/':
-            t.type = TOK_DIV;
+    uint8_t c = (uint8_t) l->current;
+    switch (char_class[c]) {
+        case CC_SINGLE:
+            t.type = char_token[c];
             lex_advance(l);
-
-            if (l->current == '=') {
-                t.type = TOK_DIV_EQUALS;
-                t.length++;
-                lex_advance(l);
-            }
-
-            return t;
-        case '(':
-            t.type = TOK_LPAREN;
-            break;
-        case ')':
-            t.type = TOK_RPAREN;
             break;
-        case '=':
-            t.type = TOK_ASSIGN;
+        case CC_MAYBE_EQ:
+            t.type = char_token[c];
             lex_advance(l);
 
             if (l->current == '=') {
-                t.type = TOK_EQUALS;
+                t.type = char_eq_token[c];
                 t.length++;
                 lex_advance(l);
             }
-
-            return t;
-        case ';':
-            t.type = TOK_SEMICOLON;
             break;
-        case '!':
-            t.type = TOK_EXCLAM;
+        case CC_DOUBLE:
             lex_advance(l);
-
-            if (l->current == '=') {
-                t.type = TOK_NOT_EQUALS;
-                t.length++;
-                lex_advance(l);
-            }
-
-            return t;
-        case '<':
-            t.type = TOK_LESS;
-            lex_advance(l);
-
-            if (l->current == '=') {
-                t.type = TOK_LESS_EQUALS;
-                t.length++;
-                lex_advance(l);
-            }
-
-            return t;
-        case '>':
-            t.type = TOK_GREATER;
-            lex_advance(l);
-
-            if (l->current == '=') {
-                t.type = TOK_GREATER_EQUALS;
-                t.length++;
-                lex_advance(l);
-            }
-
-            return t;
-        case ':':
-            t.type = TOK_COLON;
-            break;
-        case '{':
-            t.type = TOK_LBRACE;
-            break;
-        case '}':
-            t.type = TOK_RBRACE;
-            break;
-        case '[':
-            t.type = TOK_LBRACKET;
-            break;
-        case ']':
-            t.type = TOK_RBRACKET;
-            break;
-        case ',':
-            t.type = TOK_COMMA;
-            break;
-        case '%':
-            t.type = TOK_MODULO;
-            break;
-        case '&':
-            lex_advance(l);
-            if (l->current != '&') {
-                fprintf(stderr, "error: expected second & after &");
+            if ((uint8_t) l->current != c) {
+                fprintf(stderr, "error: expected second %c after %c", c, c);
                 exit(1);
             }
-            t.type = TOK_AND;
+            t.type = char_token[c];
             t.length++;
             lex_advance(l);
-
-            return t;
-        case '|':
-            lex_advance(l);
-            if (l->current != '|') {
-                fprintf(stderr, "error: expected second | after |");
-                exit(1);
-            }
-            t.type = TOK_OR;
-            t.length++;
-            lex_advance(l);
-
-            return t;
-        case '\0':
+            break;
+        case CC_END:
             t.type = TOK_EOF;
             t.length = 0;
             break;
-        default:
-            if (IS_DIGIT(l->current)) {
-                t.value.int_val = lex_parse_int(l, &t.start_literal, &t.length);
-                if (t.value.int_val == -1) {
-                    t.type = TOK_ERROR;
-                } else {
-                    t.type = TOK_INT;
-                }
-                return t;
-            }
-            if (IS_ALPHA(l->current)) {
-                t.type = lex_parse_ident(l, &t.value.ident_val, &t.start_literal, &t.length, &t.value.type_val);
-                return t;
+        case CC_DIGIT:
+            t.value.int_val = lex_parse_int(l, &t.start_literal, &t.length);
+            if (t.value.int_val == -1) {
+                t.type = TOK_ERROR;
+            } else {
+                t.type = TOK_INT;
             }
-            if (l->current == '"') {
-                t.type = TOK_STRING;
-                lex_parse_string(l, &t.value.string_val, &t.start_literal, &t.length);
-                return t;
+            return t;
+        case CC_ALPHA:
+            t.type = lex_parse_ident(l, &t.start_literal, &t.length, &t.value.type_val);
+            if (t.type == TOK_IDENT) {
+                t.value.ident_val = intern(t.start_literal, t.length);
             }
-
+            return t;
+        case CC_QUOTE:
+            t.type = TOK_STRING;
+            lex_parse_string(l, &t.value.string_val, &t.start_literal, &t.length);
+            return t;
+        default:
             t.type = TOK_UNKNOWN;
+            lex_advance(l);
             break;
     }
 
-    lex_advance(l);
+    // only taken once the token is done, as advancing can move the window when streaming
+    t.start_literal = l->src + l->token_start;
     return t;
 }
@@ -1,12 +1,36 @@
 #ifndef GRBLANG_LEXER_H
 #define GRBLANG_LEXER_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "interner.h"
+
+#define LEXER_DEFAULT_WINDOW (64 * 1024)
+
+// state for lexing from a FILE* through a fixed size window rather than having the whole source in memory
+typedef struct {
+    FILE* file;
+    char* window;
+    size_t capacity;
+    bool eof;
+} LexerStream;
 
 typedef struct {
+    // when streaming this is the window, so it moves & is overwritten as the file is read
     const char* src;
+    // length of src, the lexer never reads at or past this so src does not need to be nul terminated
+    size_t len;
     size_t pos;
+    // start of the token being lexed, everything before it can be dropped from the window
+    size_t token_start;
     char current;
+    // NULL unless initialised with lexer_init_stream
+    LexerStream* stream;
+    // strings the lexer has to copy are allocated from this if set (the parser sets it to its own arena), otherwise they're malloc'd
+    Arena* arena;
 } Lexer;
 
 typedef enum {
@@ -61,13 +85,17 @@ typedef enum {
     DATA_STRING,
 } DataType;
 
+// start_literal & length are a slice into the source buffer, so the source must outlive any token (or ast node) made from it.
+// when streaming, the slice is only valid until the next call to lex_next, which is why strings are always copied in that mode
 typedef struct {
     TokenType type;
     const char* start_literal;
     int length;
     union {
         int int_val;
-        char* ident_val;
+        SymbolId ident_val;
+        // only set for strings containing escapes (or any string when streaming), in which case it's the copy start_literal/length point into instead of the source.
+        // owned by the caller unless the lexer has an arena
         char* string_val;
         DataType type_val;
         // TODO: more as needed
@@ -77,11 +105,18 @@ typedef struct {
 void token_string(Token t, char buffer[50]);
 
 void lex_advance(Lexer* l);
-void lexer_init(Lexer* l, const char* src);
+// advances n chars at once, clamped to the end of the source
+void lex_skip(Lexer* l, size_t n);
+void lexer_init(Lexer* l, const char* src, size_t len);
+// lexes file through a window of window_size bytes (LEXER_DEFAULT_WINDOW if 0), file is not closed by the lexer
+void lexer_init_stream(Lexer* l, FILE* file, size_t window_size);
+// only needed for lexers made with lexer_init_stream
+void lexer_free(Lexer* l);
 void lex_skip_whitespace(Lexer* l);
 int lex_parse_int(Lexer* l, const char** start_out, int* len_out);
-// returns token type, if TOK_IDENT is returned, then ident_out has been set to the identifier, otherwise it has found a keyword and has not set ident_out. start_out and len_out are set in both cases
-TokenType lex_parse_ident(Lexer* l, char** ident_out, const char** start_out, int* len_out, DataType* type_out);
+// returns token type, start_out and len_out are set for both identifiers & keywords. identifiers are interned by lex_next, not by this
+TokenType lex_parse_ident(Lexer* l, const char** start_out, int* len_out, DataType* type_out);
+// start_out/len_out are set to the string body, str_out is only set (to an unescaped copy, see Lexer.arena) if the body contains escapes, otherwise it's set to NULL
 void lex_parse_string(Lexer* l, char** str_out, const char** start_out, int* len_out);
 
 Token lex_next(Lexer* l);
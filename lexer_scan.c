@@ -0,0 +1,232 @@
+#include "lexer_scan.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GRBLANG_SCAN_X86
+#include <immintrin.h>
+#endif
+
+#define IS_WHITESPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define IS_ALPHA(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || ((c) == '_'))
+#define IS_STRING_BODY(c) ((c) != '"' && (c) != '\\' && (c) != '\0')
+
+typedef struct {
+    size_t (*whitespace)(const char* p, size_t n);
+    size_t (*ident)(const char* p, size_t n);
+    size_t (*digits)(const char* p, size_t n);
+    size_t (*string_body)(const char* p, size_t n);
+} ScanKernels;
+
+static size_t scalar_whitespace(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && IS_WHITESPACE(p[i])) i++;
+    return i;
+}
+
+static size_t scalar_ident(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && IS_ALPHA(p[i])) i++;
+    return i;
+}
+
+static size_t scalar_digits(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && IS_DIGIT(p[i])) i++;
+    return i;
+}
+
+static size_t scalar_string_body(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && IS_STRING_BODY(p[i])) i++;
+    return i;
+}
+
+static const ScanKernels scalar_kernels = {
+    scalar_whitespace,
+    scalar_ident,
+    scalar_digits,
+    scalar_string_body,
+};
+
+#ifdef GRBLANG_SCAN_X86
+
+// the vector kernels all build a mask of the bytes that are *in* the run, then the run ends at the first zero bit.
+// sse2/avx2 only have signed byte compares, so range checks are done by biasing the range to start at -128 and
+// then checking against -128 + range width
+#define SSE_RANGE(v, lo, width) _mm_cmplt_epi8(_mm_add_epi8((v), _mm_set1_epi8((char) (128 - (lo)))), _mm_set1_epi8((char) (-128 + (width))))
+#define AVX_RANGE(v, lo, width) _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (-128 + (width))), _mm256_add_epi8((v), _mm256_set1_epi8((char) (128 - (lo)))))
+
+static inline __m128i sse_whitespace_mask(__m128i v) {
+    __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    return _mm_or_si128(ws, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+}
+
+static inline __m128i sse_ident_mask(__m128i v) {
+    // | 0x20 folds uppercase into lowercase, nothing outside of A-Z lands in a-z by doing so
+    __m128i alpha = SSE_RANGE(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 26);
+    return _mm_or_si128(alpha, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+static inline __m128i sse_digit_mask(__m128i v) {
+    return SSE_RANGE(v, '0', 10);
+}
+
+static inline __m128i sse_string_body_mask(__m128i v) {
+    __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return _mm_xor_si128(stop, _mm_set1_epi8((char) 0xFF));
+}
+
+#define SSE_KERNEL(name, mask_fn, scalar_fn) \
+    static size_t name(const char* p, size_t n) { \
+        size_t i = 0; \
+        while (i + 16 <= n) { \
+            __m128i v = _mm_loadu_si128((const __m128i*) (p + i)); \
+            unsigned int out = ~(unsigned int) _mm_movemask_epi8(mask_fn(v)) & 0xFFFF; \
+            if (out) return i + __builtin_ctz(out); \
+            i += 16; \
+        } \
+        return i + scalar_fn(p + i, n - i); \
+    }
+
+SSE_KERNEL(sse2_whitespace, sse_whitespace_mask, scalar_whitespace)
+SSE_KERNEL(sse2_ident, sse_ident_mask, scalar_ident)
+SSE_KERNEL(sse2_digits, sse_digit_mask, scalar_digits)
+SSE_KERNEL(sse2_string_body, sse_string_body_mask, scalar_string_body)
+
+static const ScanKernels sse2_kernels = {
+    sse2_whitespace,
+    sse2_ident,
+    sse2_digits,
+    sse2_string_body,
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i avx_whitespace_mask(__m256i v) {
+    __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    return _mm256_or_si256(ws, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+}
+
+static inline AVX2 __m256i avx_ident_mask(__m256i v) {
+    __m256i alpha = AVX_RANGE(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 26);
+    return _mm256_or_si256(alpha, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+static inline AVX2 __m256i avx_digit_mask(__m256i v) {
+    return AVX_RANGE(v, '0', 10);
+}
+
+static inline AVX2 __m256i avx_string_body_mask(__m256i v) {
+    __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+    stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    return _mm256_xor_si256(stop, _mm256_set1_epi8((char) 0xFF));
+}
+
+// tails shorter than a full avx register still get one sse2 pass before falling back to scalar
+#define AVX_KERNEL(name, mask_fn, tail_fn) \
+    static AVX2 size_t name(const char* p, size_t n) { \
+        size_t i = 0; \
+        while (i + 32 <= n) { \
+            __m256i v = _mm256_loadu_si256((const __m256i*) (p + i)); \
+            unsigned int out = ~(unsigned int) _mm256_movemask_epi8(mask_fn(v)); \
+            if (out) return i + __builtin_ctz(out); \
+            i += 32; \
+        } \
+        return i + tail_fn(p + i, n - i); \
+    }
+
+AVX_KERNEL(avx2_whitespace, avx_whitespace_mask, sse2_whitespace)
+AVX_KERNEL(avx2_ident, avx_ident_mask, sse2_ident)
+AVX_KERNEL(avx2_digits, avx_digit_mask, sse2_digits)
+AVX_KERNEL(avx2_string_body, avx_string_body_mask, sse2_string_body)
+
+static const ScanKernels avx2_kernels = {
+    avx2_whitespace,
+    avx2_ident,
+    avx2_digits,
+    avx2_string_body,
+};
+
+#endif // GRBLANG_SCAN_X86
+
+static const ScanKernels* kernels = NULL;
+static ScanLevel current_level = SCAN_SCALAR;
+
+ScanLevel scan_best_level(void) {
+#ifdef GRBLANG_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SCAN_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SCAN_SSE2;
+    }
+#endif
+    return SCAN_SCALAR;
+}
+
+bool scan_set_level(ScanLevel level) {
+    if (level > scan_best_level()) {
+        return false;
+    }
+
+    switch (level) {
+#ifdef GRBLANG_SCAN_X86
+        case SCAN_AVX2:
+            kernels = &avx2_kernels;
+            break;
+        case SCAN_SSE2:
+            kernels = &sse2_kernels;
+            break;
+#endif
+        default:
+            kernels = &scalar_kernels;
+            break;
+    }
+    current_level = level;
+    return true;
+}
+
+ScanLevel scan_get_level(void) {
+    if (!kernels) {
+        scan_set_level(scan_best_level());
+    }
+    return current_level;
+}
+
+const char* scan_level_string(ScanLevel level) {
+    switch (level) {
+        case SCAN_SCALAR: return "scalar";
+        case SCAN_SSE2: return "sse2";
+        case SCAN_AVX2: return "avx2";
+        default: return "unknown";
+    }
+}
+
+// kernels are picked lazily on first use so nothing has to remember to initialise them
+static inline const ScanKernels* get_kernels(void) {
+    if (!kernels) {
+        scan_set_level(scan_best_level());
+    }
+    return kernels;
+}
+
+size_t scan_whitespace(const char* p, size_t n) {
+    return get_kernels()->whitespace(p, n);
+}
+
+size_t scan_ident(const char* p, size_t n) {
+    return get_kernels()->ident(p, n);
+}
+
+size_t scan_digits(const char* p, size_t n) {
+    return get_kernels()->digits(p, n);
+}
+
+size_t scan_string_body(const char* p, size_t n) {
+    return get_kernels()->string_body(p, n);
+}
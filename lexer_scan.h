@@ -0,0 +1,31 @@
+#ifndef GRBLANG_LEXER_SCAN_H
+#define GRBLANG_LEXER_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// scanning kernels used by the lexer to skip over whole runs of bytes at once instead of going through lex_advance per byte.
+// every kernel returns how many bytes from the start of p (never more than n) belong to the run, so they never read past p + n
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+} ScanLevel;
+
+// the best level supported by the running cpu, this is what the lexer uses unless scan_set_level is called
+ScanLevel scan_best_level(void);
+// returns false & leaves the current level alone if the cpu doesn't support level
+bool scan_set_level(ScanLevel level);
+ScanLevel scan_get_level(void);
+const char* scan_level_string(ScanLevel level);
+
+// ' ', '\t', '\n', '\r'
+size_t scan_whitespace(const char* p, size_t n);
+// [a-zA-Z_]
+size_t scan_ident(const char* p, size_t n);
+// [0-9]
+size_t scan_digits(const char* p, size_t n);
+// anything but '"', '\\' and '\0'
+size_t scan_string_body(const char* p, size_t n);
+
+#endif //GRBLANG_LEXER_SCAN_H
@@ -4,9 +4,19 @@
 #include <string.h>
 
 #include "bytecode_emit.h"
+#include "bytecode_opt.h"
+#include "cfg.h"
+#include "flat_ast.h"
+#include "interner.h"
+#include "ir.h"
+#include "ir_lower.h"
+#include "ir_opt.h"
 #include "lexer.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "reg_vm.h"
 #include "resolver.h"
+#include "source.h"
 #include "stack.h"
 #include "type_checker.h"
 #include "util.h"
@@ -26,22 +36,66 @@ void print_lexer(Lexer* l) {
 }
 
 int main(int argc, char* argv[]) {
-    long src_len;
-    if (argc != 2 && argc != 3) {
+    if (argc < 2) {
         fprintf(stderr, "error: invalid number of arguments\n");
         exit(1);
     }
     bool print_debug = false;
-    if (argc == 3 && strcmp(argv[2], "-p") == 0) {
-        print_debug = true;
+    // run the front end passes over the flat ast rather than the tree
+    bool use_flat = false;
+    bool peephole = true;
+    // build & optimize the ssa ir, then lower that instead of generating straight from the ast
+    bool use_ssa = true;
+    // bound ints to drop checks, reduce divisions by powers of two, hoist loop invariants & unroll, on the ssa ir
+    bool loop_opts = true;
+    // copies of a counted loop's body, 1 turns unrolling off
+    int unroll = IR_UNROLL_FACTOR;
+    // run the fixed width word encoding of the bytecode
+    bool use_words = false;
+    // lower the ssa ir for the register vm instead, when it can be
+    bool use_regs = false;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0) {
+            print_debug = true;
+        } else if (strcmp(argv[i], "--flat") == 0) {
+            use_flat = true;
+        } else if (strcmp(argv[i], "--no-peephole") == 0) {
+            peephole = false;
+        } else if (strcmp(argv[i], "--no-ssa") == 0) {
+            use_ssa = false;
+        } else if (strcmp(argv[i], "--no-loop-opt") == 0) {
+            loop_opts = false;
+        } else if (strcmp(argv[i], "--words") == 0) {
+            use_words = true;
+        } else if (strcmp(argv[i], "--reg") == 0) {
+            use_regs = true;
+        } else if (strncmp(argv[i], "--unroll=", 9) == 0) {
+            char* end;
+            long factor = strtol(argv[i] + 9, &end, 10);
+            if (end == argv[i] + 9 || *end != '\0' || factor < 1 || factor > 64) {
+                fprintf(stderr, "error: `%s` needs an unroll factor from 1 to 64\n", argv[i]);
+                exit(1);
+            }
+            unroll = (int) factor;
+        } else {
+            fprintf(stderr, "error: unknown argument `%s`\n", argv[i]);
+            exit(1);
+        }
     }
-    char* src = read_file(argv[1], &src_len);
-    if (print_debug) {
-        printf("from: %s\n", src);
+    Source src;
+    if (!source_open(argv[1], &src)) {
+        exit(1);
+    }
+    if (print_debug && src.data) {
+        printf("from: %.*s\n", (int) src.len, src.data);
     }
 
     Lexer l;
-    lexer_init(&l, src);
+    if (src.stream) {
+        lexer_init_stream(&l, src.stream, LEXER_DEFAULT_WINDOW);
+    } else {
+        lexer_init(&l, src.data, src.len);
+    }
 
     Parser p;
     parser_init(&p, &l);
@@ -49,36 +103,112 @@ int main(int argc, char* argv[]) {
     ASTNode* node = parse_program(&p);
     Resolver r;
     resolver_init(&r);
-    resolve(node, &r);
+    FlatAst flat;
+    if (use_flat) {
+        flat_ast_init(&flat);
+        flat_ast_build(&flat, node);
+        flat_resolve(&flat, &r);
+    } else {
+        resolve(node, &r);
+    }
 
     if (print_debug) {
-        print_ast(node, 0, true);
+        if (use_flat) {
+            flat_ast_print(&flat, flat.root, 0, true);
+        } else {
+            print_ast(node, 0, true);
+        }
     }
 
-    // type_check(node, &r);
-
-    // BytecodeEmitter b;
-    // bytecode_init(&b);
-    // bytecode_gen(node, &b, &r);
-
-    // free_ast(node);
-
-    // int num_locals = r.count;
-
-    // free_resolver(&r);
-
-    // VM vm;
-    // vm_init(&vm, &b, num_locals);
-    // vm_run(&vm);
-
-    // char buffer[500];
-    // size_t printed = 0;
-    // stack_value_string(vm.stack.data[vm.stack.top], true, buffer, sizeof(buffer), &printed);
-    // print_visible(buffer);
-    // printf("\n");
+    if (use_flat) {
+        flat_type_check(&flat, &r);
+    } else {
+        type_check(node, &r);
+        optimize_ast(node, &p.arena);
+    }
 
-    // vm_free(&vm);
-    free(src);
+    int num_locals = r.num_locals;
+
+    BytecodeEmitter b;
+    bytecode_init(&b);
+    RegCode reg_code;
+    bool lowered_regs = false;
+    if (use_flat) {
+        flat_bytecode_gen(&flat, &b);
+        flat_ast_free(&flat);
+    } else {
+        Ir ir;
+        ir_init(&ir);
+        int ssa_locals = -1;
+        if (use_ssa && ir_build(&ir, node, r.num_locals)) {
+            ir_optimize(&ir);
+            if (loop_opts) {
+                ir_optimize_loops(&ir);
+                ir_unroll_loops(&ir, unroll);
+            }
+            if (print_debug) {
+                ir_print(&ir);
+            }
+            if (use_regs) {
+                reg_code_init(&reg_code);
+                lowered_regs = ir_lower_regs(&ir, &reg_code);
+                if (!lowered_regs) {
+                    free_reg_code(&reg_code);
+                }
+            }
+            if (!lowered_regs) {
+                ssa_locals = ir_lower(&ir, &b);
+            }
+        }
+        free_ir(&ir);
+        if (ssa_locals != -1) {
+            num_locals = ssa_locals;
+        } else if (!lowered_regs) {
+            bytecode_gen(node, &b, &r);
+        }
+    }
+    if (peephole) {
+        peephole_optimize(&b);
+    }
+    cfg_optimize(&b);
+
+    free_bytecode_emitter(&b);
+    parser_free(&p);
+
+    free_resolver(&r);
+
+    char buffer[500];
+    size_t printed = 0;
+    if (lowered_regs) {
+        if (print_debug) {
+            reg_code_print(&reg_code);
+        }
+        free(b.code);
+        free(b.constants);
+        RegVM reg_vm;
+        reg_vm_init(&reg_vm, &reg_code);
+        reg_vm_run(&reg_vm);
+        stack_value_string(reg_vm.result, true, buffer, sizeof(buffer), &printed);
+        reg_vm_free(&reg_vm);
+    } else {
+        VM vm;
+        if (use_words) {
+            int word_count;
+            uint32_t* words = bytecode_emit_words(&b, &word_count);
+            vm_init_words(&vm, &b, words, word_count, num_locals);
+            free(words);
+        } else {
+            vm_init(&vm, &b, num_locals);
+        }
+        vm_run(&vm);
+        stack_value_string(vm.result, true, buffer, sizeof(buffer), &printed);
+        vm_free(&vm);
+    }
+    print_visible(buffer);
+    printf("\n");
+    lexer_free(&l);
+    free_interner();
+    source_close(&src);
 
     return 0;
 }
@@ -0,0 +1,296 @@
+#include "optimizer.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+
+static bool is_int_type(VarType type) {
+    return type.base_type == VALUE_INT && type.nested == -1;
+}
+
+static bool is_int_const(ASTNode* node, int val) {
+    return node->type == AST_INT && node->int_val == val;
+}
+
+static bool is_bool_const(ASTNode* node, bool val) {
+    return node->type == AST_BOOL && node->bool_val == val;
+}
+
+// whether evaluating node can neither fail nor change anything, so it can be dropped when its value isn't needed
+static bool is_pure(ASTNode* node) {
+    switch (node->type) {
+        case AST_INT:
+        case AST_BOOL:
+        case AST_STRING:
+        case AST_VAR_REF:
+            return true;
+        case AST_UNARY_OP:
+            return is_pure(node->unary_op.right);
+        case AST_BINARY_OP:
+            if (node->binary_op.op == TOK_DIV || node->binary_op.op == TOK_MODULO) return false;
+            return is_pure(node->binary_op.left) && is_pure(node->binary_op.right);
+        default:
+            return false;
+    }
+}
+
+static void set_int(ASTNode* node, int val) {
+    VarType int_type = {.base_type = VALUE_INT, .nested = -1};
+    node->type = AST_INT;
+    node->int_val = val;
+    node->var_type = int_type;
+}
+
+static void set_bool(ASTNode* node, bool val) {
+    VarType bool_type = {.base_type = VALUE_BOOL, .nested = -1};
+    node->type = AST_BOOL;
+    node->bool_val = val;
+    node->var_type = bool_type;
+}
+
+// arithmetic wraps like it does in the vm. returns false for anything the vm would error on (or is undefined in c), which
+// keeps the instruction so the error still happens at runtime
+static bool fold_int_op(TokenType op, int l, int r, ASTNode* node) {
+    switch (op) {
+        case TOK_PLUS: set_int(node, (int) ((unsigned) l + (unsigned) r)); return true;
+        case TOK_MINUS: set_int(node, (int) ((unsigned) l - (unsigned) r)); return true;
+        case TOK_MULT: set_int(node, (int) ((unsigned) l * (unsigned) r)); return true;
+        case TOK_DIV:
+            if (r == 0 || (l == INT_MIN && r == -1)) return false;
+            set_int(node, l / r);
+            return true;
+        case TOK_MODULO:
+            if (r == 0 || (l == INT_MIN && r == -1)) return false;
+            set_int(node, l % r);
+            return true;
+        case TOK_GREATER: set_bool(node, l > r); return true;
+        case TOK_LESS: set_bool(node, l < r); return true;
+        case TOK_GREATER_EQUALS: set_bool(node, l >= r); return true;
+        case TOK_LESS_EQUALS: set_bool(node, l <= r); return true;
+        case TOK_EQUALS: set_bool(node, l == r); return true;
+        case TOK_NOT_EQUALS: set_bool(node, l != r); return true;
+        default: return false;
+    }
+}
+
+static bool fold_bool_op(TokenType op, bool l, bool r, ASTNode* node) {
+    switch (op) {
+        case TOK_AND: set_bool(node, l && r); return true;
+        case TOK_OR: set_bool(node, l || r); return true;
+        case TOK_EQUALS: set_bool(node, l == r); return true;
+        case TOK_NOT_EQUALS: set_bool(node, l != r); return true;
+        default: return false;
+    }
+}
+
+// returns what should replace node, which is node itself unless an identity dropped it for one of its operands
+static ASTNode* fold_expr(ASTNode* node, Arena* a);
+
+static ASTNode* fold_binary(ASTNode* node, Arena* a) {
+    ASTNode* left = node->binary_op.left = fold_expr(node->binary_op.left, a);
+    ASTNode* right = node->binary_op.right = fold_expr(node->binary_op.right, a);
+    TokenType op = node->binary_op.op;
+
+    if (left->type == AST_INT && right->type == AST_INT) {
+        fold_int_op(op, left->int_val, right->int_val, node);
+        return node;
+    }
+    if (left->type == AST_BOOL && right->type == AST_BOOL) {
+        fold_bool_op(op, left->bool_val, right->bool_val, node);
+        return node;
+    }
+    if (left->type == AST_STRING && right->type == AST_STRING && op == TOK_PLUS) {
+        int len = left->string.len + right->string.len;
+        char* str = arena_alloc(a, len > 0 ? len : 1);
+        memcpy(str, left->string.string_val, left->string.len);
+        memcpy(str + left->string.len, right->string.string_val, right->string.len);
+        VarType string_type = node->var_type;
+        node->type = AST_STRING;
+        node->string.string_val = str;
+        node->string.len = len;
+        node->var_type = string_type;
+        return node;
+    }
+
+    if (is_int_type(node->var_type)) {
+        switch (op) {
+            case TOK_PLUS:
+                if (is_int_const(right, 0)) return left;
+                if (is_int_const(left, 0)) return right;
+                break;
+            case TOK_MINUS:
+                if (is_int_const(right, 0)) return left;
+                break;
+            case TOK_MULT:
+                if (is_int_const(right, 1)) return left;
+                if (is_int_const(left, 1)) return right;
+                if ((is_int_const(right, 0) && is_pure(left)) || (is_int_const(left, 0) && is_pure(right))) {
+                    set_int(node, 0);
+                }
+                break;
+            case TOK_DIV:
+                if (is_int_const(right, 1)) return left;
+                break;
+            default:
+                break;
+        }
+        return node;
+    }
+
+    // the right side of && & || only runs when the left doesn't decide the result, so a constant left drops it either way
+    if (op == TOK_AND) {
+        if (is_bool_const(left, true) || is_bool_const(right, true)) return is_bool_const(left, true) ? right : left;
+        if (is_bool_const(left, false) || (is_bool_const(right, false) && is_pure(left))) set_bool(node, false);
+    } else if (op == TOK_OR) {
+        if (is_bool_const(left, false) || is_bool_const(right, false)) return is_bool_const(left, false) ? right : left;
+        if (is_bool_const(left, true) || (is_bool_const(right, true) && is_pure(left))) set_bool(node, true);
+    }
+    return node;
+}
+
+static ASTNode* fold_unary(ASTNode* node, Arena* a) {
+    ASTNode* right = node->unary_op.right = fold_expr(node->unary_op.right, a);
+
+    if (node->unary_op.op == TOK_MINUS) {
+        if (right->type == AST_INT) {
+            set_int(node, (int) -(unsigned) right->int_val);
+        } else if (right->type == AST_UNARY_OP && right->unary_op.op == TOK_MINUS) {
+            return right->unary_op.right;
+        }
+    } else if (node->unary_op.op == TOK_EXCLAM) {
+        if (right->type == AST_BOOL) {
+            set_bool(node, !right->bool_val);
+        } else if (right->type == AST_UNARY_OP && right->unary_op.op == TOK_EXCLAM) {
+            return right->unary_op.right;
+        }
+    }
+    return node;
+}
+
+static void fold_block(ASTNode*** statements, int* count, Arena* a);
+
+static ASTNode* fold_expr(ASTNode* node, Arena* a) {
+    if (!node) return node;
+
+    switch (node->type) {
+        case AST_BINARY_OP:
+            return fold_binary(node, a);
+        case AST_UNARY_OP:
+            return fold_unary(node, a);
+        case AST_ARRAY:
+            for (int i = 0; i < node->array_literal.len; i++) {
+                node->array_literal.arr[i] = fold_expr(node->array_literal.arr[i], a);
+            }
+            break;
+        case AST_ARRAY_INDEX:
+            node->array_index.array_expr = fold_expr(node->array_index.array_expr, a);
+            node->array_index.index_expr = fold_expr(node->array_index.index_expr, a);
+            break;
+        case AST_FUNCTION_CALL:
+            for (int i = 0; i < node->function_call.args_len; i++) {
+                node->function_call.args[i] = fold_expr(node->function_call.args[i], a);
+            }
+            break;
+        // statements, nothing replaces these
+        case AST_PROGRAM:
+            fold_block(&node->program.statements, &node->program.count, a);
+            break;
+        case AST_VAR_DECL:
+            node->var_decl.value = fold_expr(node->var_decl.value, a);
+            break;
+        case AST_VAR_ASSIGN:
+            node->var_assign.value = fold_expr(node->var_assign.value, a);
+            break;
+        case AST_COMPOUND_ASSIGNMENT:
+            node->compound_assignment.value = fold_expr(node->compound_assignment.value, a);
+            break;
+        case AST_ARRAY_INDEX_ASSIGN:
+            // the emitter reads the array & index straight out of arr_index_expr, so that has to stay an AST_ARRAY_INDEX
+            fold_expr(node->array_assign_expr.arr_index_expr, a);
+            node->array_assign_expr.value = fold_expr(node->array_assign_expr.value, a);
+            break;
+        case AST_IF:
+            node->if_stmt.condition = fold_expr(node->if_stmt.condition, a);
+            fold_block(&node->if_stmt.success_statements, &node->if_stmt.success_count, a);
+            if (node->if_stmt.fail_statements) {
+                fold_block(&node->if_stmt.fail_statements, &node->if_stmt.fail_count, a);
+            }
+            break;
+        case AST_WHILE:
+            node->while_stmt.condition = fold_expr(node->while_stmt.condition, a);
+            fold_block(&node->while_stmt.statements, &node->while_stmt.statements_count, a);
+            break;
+        case AST_FUNCTION_DECL:
+            fold_block(&node->function_decl.stmts, &node->function_decl.stmts_len, a);
+            break;
+        case AST_RETURN_STMT:
+            node->return_stmt.expr = fold_expr(node->return_stmt.expr, a);
+            break;
+        default:
+            break;
+    }
+    return node;
+}
+
+// an if with a constant condition is replaced by the branch that runs, & a while that never runs by nothing. returns
+// false if node stays as is
+static bool prune_statement(ASTNode* node, ASTNode*** out, int* out_count) {
+    if (node->type == AST_IF && node->if_stmt.condition->type == AST_BOOL) {
+        if (node->if_stmt.condition->bool_val) {
+            *out = node->if_stmt.success_statements;
+            *out_count = node->if_stmt.success_count;
+        } else {
+            *out = node->if_stmt.fail_statements;
+            *out_count = node->if_stmt.fail_statements ? node->if_stmt.fail_count : 0;
+        }
+        return true;
+    }
+    if (node->type == AST_WHILE && is_bool_const(node->while_stmt.condition, false)) {
+        *out = NULL;
+        *out_count = 0;
+        return true;
+    }
+    return false;
+}
+
+// the branch's variables already have slots of their own from the resolver, so splicing its statements into the
+// enclosing block doesn't need any renaming
+static void fold_block(ASTNode*** statements, int* count, Arena* a) {
+    int new_count = 0;
+    bool pruned = false;
+    for (int i = 0; i < *count; i++) {
+        fold_expr((*statements)[i], a);
+
+        ASTNode** branch;
+        int branch_count;
+        if (prune_statement((*statements)[i], &branch, &branch_count)) {
+            new_count += branch_count;
+            pruned = true;
+        } else {
+            new_count++;
+        }
+    }
+    if (!pruned) return;
+
+    ASTNode** new_statements = arena_alloc(a, sizeof(ASTNode*) * (new_count > 0 ? new_count : 1));
+    int n = 0;
+    for (int i = 0; i < *count; i++) {
+        ASTNode** branch;
+        int branch_count;
+        if (prune_statement((*statements)[i], &branch, &branch_count)) {
+            for (int j = 0; j < branch_count; j++) {
+                new_statements[n++] = branch[j];
+            }
+        } else {
+            new_statements[n++] = (*statements)[i];
+        }
+    }
+    *statements = new_statements;
+    *count = new_count;
+}
+
+void optimize_ast(ASTNode* node, Arena* a) {
+    fold_expr(node, a);
+}
@@ -0,0 +1,12 @@
+#ifndef GRBLANG_OPTIMIZER_H
+#define GRBLANG_OPTIMIZER_H
+
+#include "arena.h"
+#include "parser.h"
+
+// folds constant subtrees, applies identities like x * 1 & x && true, and drops if/while branches whose condition is
+// constant. runs after type_check as it relies on var_type, new nodes & strings come from a (the parser's arena).
+// anything that would error at runtime, like dividing by a constant 0, is left for the vm to report
+void optimize_ast(ASTNode* node, Arena* a);
+
+#endif //GRBLANG_OPTIMIZER_H
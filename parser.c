@@ -1,7 +1,9 @@
 #include "parser.h"
+#include "arena.h"
 #include "lexer.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +27,18 @@ VarType data_to_var_type(DataType tt) {
 
 void parser_init(Parser* p, Lexer* l) {
     p->lexer = l;
+    arena_init(&p->arena, ARENA_DEFAULT_CHUNK_SIZE);
+    l->arena = &p->arena;
+
+    p->scratch_count = 0;
+    p->scratch_capacity = 256;
+    p->scratch = malloc(sizeof(ASTNode*) * p->scratch_capacity);
+    p->params_capacity = 32;
+    p->params_scratch = malloc(sizeof(FunctionParam) * p->params_capacity);
+    if (!p->scratch || !p->params_scratch) {
+        fprintf(stderr, "failed to malloc parser scratch buffers\n");
+        exit(1);
+    }
 
     p->curr.type = TOK_EOF;
     p->peek = lex_next(p->lexer);
@@ -36,6 +50,40 @@ void parser_next(Parser* p) {
     p->peek = lex_next(p->lexer);
 }
 
+void parser_free(Parser* p) {
+    arena_free(&p->arena);
+    free(p->scratch);
+    free(p->params_scratch);
+    p->scratch = NULL;
+    p->params_scratch = NULL;
+    if (p->lexer->arena == &p->arena) {
+        p->lexer->arena = NULL;
+    }
+}
+
+static void scratch_push(Parser* p, ASTNode* node) {
+    if (p->scratch_count >= p->scratch_capacity) {
+        p->scratch_capacity *= 2;
+        ASTNode** new_scratch = realloc(p->scratch, sizeof(ASTNode*) * p->scratch_capacity);
+        if (!new_scratch) {
+            fprintf(stderr, "failed to realloc parser scratch\n");
+            exit(1);
+        }
+        p->scratch = new_scratch;
+    }
+    p->scratch[p->scratch_count++] = node;
+}
+
+// copies everything pushed since base into an exactly sized arena array & pops it off the scratch stack
+static ASTNode** scratch_pop(Parser* p, int base, int* count_out) {
+    int count = p->scratch_count - base;
+    ASTNode** out = arena_alloc(&p->arena, sizeof(ASTNode*) * count);
+    memcpy(out, p->scratch + base, sizeof(ASTNode*) * count);
+    p->scratch_count = base;
+    *count_out = count;
+    return out;
+}
+
 char* op_string(TokenType op) {
     switch (op) {
         case TOK_EQUALS: return "==";
@@ -116,7 +164,7 @@ void print_ast(ASTNode* node, int indent, bool newline) {
             }
             break;
         case AST_STRING:
-            printf("AST_STRING(%s)", node->string.string_val);
+            printf("AST_STRING(%.*s)", node->string.len, node->string.string_val);
             if (newline) {
                 printf("\n");
             }
@@ -130,7 +178,7 @@ void print_ast(ASTNode* node, int indent, bool newline) {
             print_ast(node->binary_op.right, indent + 1, false);
             break;
         case AST_COMPOUND_ASSIGNMENT: {
-            printf("AST_COMPOUND_ASSIGN(slot=%d,%s%s", node->compound_assignment.slot, node->compound_assignment.name, op_string(node->compound_assignment.op));
+            printf("AST_COMPOUND_ASSIGN(slot=%d,%s%s", node->compound_assignment.slot, symbol_name(node->compound_assignment.name), op_string(node->compound_assignment.op));
             print_ast(node->compound_assignment.value, 0, false);
             char buffer[50];
             var_type_string(node->var_type, buffer);
@@ -192,7 +240,7 @@ void print_ast(ASTNode* node, int indent, bool newline) {
             }
             break;
         case AST_VAR_ASSIGN: {
-            printf("AST_VAR_ASSIGN(slot=%d,%s=", node->var_assign.slot, node->var_assign.name);
+            printf("AST_VAR_ASSIGN(slot=%d,%s=", node->var_assign.slot, symbol_name(node->var_assign.name));
             print_ast(node->var_assign.value, 0, false);
             char buffer[50];
             var_type_string(node->var_type, buffer);
@@ -203,7 +251,7 @@ void print_ast(ASTNode* node, int indent, bool newline) {
             break;
         }
         case AST_VAR_DECL: {
-            printf("AST_VAR_DECL(slot=%d,%s=", node->var_assign.slot,node->var_decl.name);
+            printf("AST_VAR_DECL(slot=%d,%s=", node->var_assign.slot,symbol_name(node->var_decl.name));
             print_ast(node->var_decl.value, 0, false);
             char buffer[50];
             var_type_string(node->var_type, buffer);
@@ -216,7 +264,7 @@ void print_ast(ASTNode* node, int indent, bool newline) {
         case AST_VAR_REF: {
             char buffer[50];
             var_type_string(node->var_type, buffer);
-            printf("AST_VAR_REF(slot=%d,%s;t=%s(%d))", node->var_ref.slot, node->var_ref.name, buffer, node->var_type.base_type);
+            printf("AST_VAR_REF(slot=%d,%s;t=%s(%d))", node->var_ref.slot, symbol_name(node->var_ref.name), buffer, node->var_type.base_type);
             if (newline) {
                 printf("\n");
             }
@@ -259,7 +307,7 @@ void print_ast(ASTNode* node, int indent, bool newline) {
             break;
         }
         case AST_FUNCTION_CALL: {
-            printf("AST_FUNCTION_CALL(slot=%d, %s(", node->function_call.slot, node->function_call.name);
+            printf("AST_FUNCTION_CALL(slot=%d, %s(", node->function_call.slot, symbol_name(node->function_call.name));
             for (int i = 0; i < node->function_call.args_len; i++) {
                 print_ast(node->function_call.args[i], indent, false);
                 if (i != node->function_call.args_len - 1) {
@@ -273,10 +321,10 @@ void print_ast(ASTNode* node, int indent, bool newline) {
             break;
         }
         case AST_FUNCTION_DECL: {
-            printf("AST_FUNCTION_DECL(slot=%d, %s(", node->function_decl.slot, node->function_decl.name);
+            printf("AST_FUNCTION_DECL(slot=%d, %s(", node->function_decl.slot, symbol_name(node->function_decl.name));
             for (int i = 0; i < node->function_decl.params_len; i++) {
                 FunctionParam param = node->function_decl.params[i];
-                printf("%s(%d) %s", base_type_string(param.type.base_type), param.type.nested, param.name);
+                printf("%s(%d) %s", base_type_string(param.type.base_type), param.type.nested, symbol_name(param.name));
                 if (i != node->function_decl.params_len - 1) {
                     printf(", ");
                 }
@@ -307,29 +355,29 @@ void print_ast(ASTNode* node, int indent, bool newline) {
     }
 }
 
-ASTNode* make_int(int value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+ASTNode* make_int(Arena* a, int value) {
+    ASTNode *node = arena_alloc(a, sizeof(ASTNode));
     node->type = AST_INT;
     node->int_val = value;
     return node;
 }
 
-ASTNode* make_true_bool() {
-    ASTNode *node = malloc(sizeof(ASTNode));
+ASTNode* make_true_bool(Arena* a) {
+    ASTNode *node = arena_alloc(a, sizeof(ASTNode));
     node->type = AST_BOOL;
     node->bool_val = true;
     return node;
 }
 
-ASTNode* make_false_bool() {
-    ASTNode *node = malloc(sizeof(ASTNode));
+ASTNode* make_false_bool(Arena* a) {
+    ASTNode *node = arena_alloc(a, sizeof(ASTNode));
     node->type = AST_BOOL;
     node->bool_val = false;
     return node;
 }
 
-ASTNode* make_string(char* str_val, int len) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_string(Arena* a, const char* str_val, int len) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_STRING;
     node->string.string_val = str_val;
@@ -338,8 +386,8 @@ ASTNode* make_string(char* str_val, int len) {
     return node;
 }
 
-ASTNode* make_arr_literal(ASTNode** exprs, int len) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_arr_literal(Arena* a, ASTNode** exprs, int len) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_ARRAY;
     node->array_literal.arr = exprs;
@@ -348,8 +396,8 @@ ASTNode* make_arr_literal(ASTNode** exprs, int len) {
     return node;
 }
 
-ASTNode* make_arr_index(ASTNode* var_ref, ASTNode* index_expr) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_arr_index(Arena* a, ASTNode* var_ref, ASTNode* index_expr) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_ARRAY_INDEX;
     node->array_index.array_expr = var_ref;
@@ -358,8 +406,8 @@ ASTNode* make_arr_index(ASTNode* var_ref, ASTNode* index_expr) {
     return node;
 }
 
-ASTNode* make_arr_index_assign(ASTNode* arr_index, ASTNode* value) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_arr_index_assign(Arena* a, ASTNode* arr_index, ASTNode* value) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_ARRAY_INDEX_ASSIGN;
     node->array_assign_expr.arr_index_expr = arr_index;
@@ -368,8 +416,8 @@ ASTNode* make_arr_index_assign(ASTNode* arr_index, ASTNode* value) {
     return node;
 }
 
-ASTNode* make_binary_op(TokenType op, ASTNode* left, ASTNode* right) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_binary_op(Arena* a, TokenType op, ASTNode* left, ASTNode* right) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
     node->type = AST_BINARY_OP;
     node->binary_op.op = op;
     node->binary_op.left = left;
@@ -377,8 +425,8 @@ ASTNode* make_binary_op(TokenType op, ASTNode* left, ASTNode* right) {
     return node;
 }
 
-ASTNode* make_compound_assignment(TokenType op, char* name, ASTNode* value) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_compound_assignment(Arena* a, TokenType op, SymbolId name, ASTNode* value) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
     node->type = AST_COMPOUND_ASSIGNMENT;
     node->compound_assignment.op = op;
     node->compound_assignment.name = name;
@@ -386,31 +434,25 @@ ASTNode* make_compound_assignment(TokenType op, char* name, ASTNode* value) {
     return node;
 }
 
-ASTNode* make_unary_op(TokenType op, ASTNode* right) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_unary_op(Arena* a, TokenType op, ASTNode* right) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
     node->type = AST_UNARY_OP;
     node->unary_op.op = op;
     node->unary_op.right = right;
     return node;
 }
 
-ASTNode* make_program(ASTNode** statements, int count) {
-    ASTNode** new_statements = realloc(statements, count * sizeof(ASTNode*));
-    if (!new_statements) {
-        fprintf(stderr, "failed to realloc statements arr in make_program");
-        exit(1);
-    }
-
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_program(Arena* a, ASTNode** statements, int count) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
     node->type = AST_PROGRAM;
-    node->program.statements = new_statements;
+    node->program.statements = statements;
     node->program.count = count;
 
     return node;
 }
 
-ASTNode* make_var_decl(char* name, ASTNode* value, VarType type) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_var_decl(Arena* a, SymbolId name, ASTNode* value, VarType type) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_VAR_DECL;
     node->var_decl.name = name;
@@ -421,8 +463,8 @@ ASTNode* make_var_decl(char* name, ASTNode* value, VarType type) {
     return node;
 }
 
-ASTNode* make_var_assign(char* name, ASTNode* value) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_var_assign(Arena* a, SymbolId name, ASTNode* value) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_VAR_ASSIGN;
     node->var_assign.name = name;
@@ -431,8 +473,8 @@ ASTNode* make_var_assign(char* name, ASTNode* value) {
     return node;
 }
 
-ASTNode* make_var_ref(char* name) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_var_ref(Arena* a, SymbolId name) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_VAR_REF;
     node->var_ref.name = name;
@@ -441,8 +483,8 @@ ASTNode* make_var_ref(char* name) {
 }
 
 
-ASTNode* make_if_statement(ASTNode* condition, ASTNode** success_statements, int success_count, ASTNode** fail_statements, int fail_count) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_if_statement(Arena* a, ASTNode* condition, ASTNode** success_statements, int success_count, ASTNode** fail_statements, int fail_count) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_IF;
     node->if_stmt.condition = condition;
@@ -454,8 +496,8 @@ ASTNode* make_if_statement(ASTNode* condition, ASTNode** success_statements, int
     return node;
 }
 
-ASTNode* make_while_statement(ASTNode* condition, ASTNode** statements, int statements_count) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_while_statement(Arena* a, ASTNode* condition, ASTNode** statements, int statements_count) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_WHILE;
     node->while_stmt.condition = condition;
@@ -465,50 +507,33 @@ ASTNode* make_while_statement(ASTNode* condition, ASTNode** statements, int stat
     return node;
 }
 
-ASTNode* make_function_call(ASTNode** args, int args_len, char* value) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_function_call(Arena* a, ASTNode** args, int args_len, SymbolId value) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_FUNCTION_CALL;
-    ASTNode** new_args = realloc(args, sizeof(ASTNode*) * args_len);
-    if (!new_args) {
-        fprintf(stderr, "failed to realloc arguments array when making function call\n");
-        exit(1);
-    }
-
-    node->function_call.args = new_args;
+    node->function_call.args = args;
     node->function_call.args_len = args_len;
     node->function_call.name = value;
 
     return node;
 }
 
-ASTNode* make_function_decl(ASTNode** stmts, int stmts_len, FunctionParam* params, int param_len, VarType return_type, char* name) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_function_decl(Arena* a, ASTNode** stmts, int stmts_len, FunctionParam* params, int param_len, VarType return_type, SymbolId name) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_FUNCTION_DECL;
     node->function_decl.return_type = return_type;
     node->function_decl.name = name;
     node->function_decl.stmts_len = stmts_len;
     node->function_decl.params_len = param_len;
-    ASTNode** new_stmts = realloc(stmts, stmts_len * sizeof(ASTNode*));
-    if (!new_stmts) {
-        fprintf(stderr, "failed to realloc stmts when making function decl\n");
-        exit(1);
-    }
-    node->function_decl.stmts = new_stmts;
-
-    FunctionParam* new_params = realloc(params, param_len * sizeof(FunctionParam));
-    if (!new_params) {
-        fprintf(stderr, "failed to realloc params when making function decl\n");
-        exit(1);
-    }
-    node->function_decl.params = new_params;
+    node->function_decl.stmts = stmts;
+    node->function_decl.params = params;
 
     return node;
 }
 
-ASTNode* make_return_stmt(ASTNode* expr) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* make_return_stmt(Arena* a, ASTNode* expr) {
+    ASTNode* node = arena_alloc(a, sizeof(ASTNode));
 
     node->type = AST_RETURN_STMT;
     node->return_stmt.expr = expr;
@@ -518,37 +543,38 @@ ASTNode* make_return_stmt(ASTNode* expr) {
 
 ASTNode* parse_primary(Parser* p) {
     if (p->curr.type == TOK_INT) {
-        ASTNode* n = make_int(p->curr.value.int_val);
+        ASTNode* n = make_int(&p->arena, p->curr.value.int_val);
         parser_next(p);
         return n;
     }
 
     if (p->curr.type == TOK_TRUE) {
-        ASTNode* n = make_true_bool();
+        ASTNode* n = make_true_bool(&p->arena);
         parser_next(p);
         return n;
     }
 
     if (p->curr.type == TOK_FALSE) {
-        ASTNode* n = make_false_bool();
+        ASTNode* n = make_false_bool(&p->arena);
         parser_next(p);
         return n;
     }
 
     if (p->curr.type == TOK_STRING) {
-        ASTNode* n = make_string(p->curr.value.string_val, p->curr.length);
+        // either a slice of the source or, when the lexer had to copy it, already in the arena
+        ASTNode* n = make_string(&p->arena, p->curr.start_literal, p->curr.length);
         parser_next(p);
         return n;
     }
 
     if (p->curr.type == TOK_IDENT) {
-        char* name = p->curr.value.ident_val;
+        SymbolId name = p->curr.value.ident_val;
         parser_next(p);
         if (p->curr.type == TOK_LPAREN) {
             return parse_function_call(p, name);
         }
 
-        ASTNode* node = make_var_ref(name);
+        ASTNode* node = make_var_ref(&p->arena, name);
 
         while (p->curr.type == TOK_LBRACKET) {
             parser_next(p);
@@ -558,14 +584,14 @@ ASTNode* parse_primary(Parser* p) {
                 exit(1);
             }
             parser_next(p);
-            node = make_arr_index(node, index_expr);
+            node = make_arr_index(&p->arena, node, index_expr);
         }
 
         if (p->curr.type == TOK_ASSIGN) {
             parser_next(p);
             ASTNode* value = parse_expr(p);
 
-            return make_arr_index_assign(node, value);
+            return make_arr_index_assign(&p->arena, node, value);
         } else {
             return node;
         }
@@ -598,77 +624,69 @@ ASTNode* parse_unary(Parser* p) {
         TokenType op = p->curr.type;
         parser_next(p);
         ASTNode* right = parse_unary(p);
-        return make_unary_op(op, right);
+        return make_unary_op(&p->arena, op, right);
     }
 
     return parse_primary(p);
 }
 
-ASTNode* parse_logical_or(Parser* p) {
-    ASTNode* left = parse_logical_and(p);
-
-    while (p->curr.type == TOK_OR) {
-        parser_next(p);
-        ASTNode* right = parse_logical_and(p);
-        left = make_binary_op(TOK_OR, left, right);
-    }
-
-    return left;
-}
-
-ASTNode* parse_logical_and(Parser* p) {
-    ASTNode* left = parse_comparison(p);
-
-    while (p->curr.type == TOK_AND) {
-        parser_next(p);
-        ASTNode* right = parse_comparison(p);
-        left = make_binary_op(TOK_AND, left, right);
-    }
-
-    return left;
-}
-
-ASTNode* parse_comparison(Parser* p) {
-    ASTNode* left = parse_addsub(p);
-
-    if (p->curr.type == TOK_LESS || p->curr.type == TOK_GREATER || p->curr.type == TOK_EQUALS || p->curr.type == TOK_NOT_EQUALS || p->curr.type == TOK_GREATER_EQUALS || p->curr.type == TOK_LESS_EQUALS) {
-        TokenType op = p->curr.type;
-        parser_next(p);
-        ASTNode* right = parse_addsub(p);
-        return make_binary_op(op, left, right);
-    }
-
-    return left;
-}
-
-ASTNode* parse_muldiv(Parser* p) {
+// binding powers of the binary operators, higher binds tighter
+typedef enum {
+    BP_NONE,
+    BP_OR,
+    BP_AND,
+    BP_COMPARISON,
+    BP_ADDSUB,
+    BP_MULDIV,
+} BindingPower;
+
+// BP_NONE for anything that isn't a binary operator, a new operator only needs an entry here (& support in the later passes)
+static const uint8_t binding_power[TOK_EOF + 1] = {
+    [TOK_OR] = BP_OR,
+    [TOK_AND] = BP_AND,
+    [TOK_LESS] = BP_COMPARISON,
+    [TOK_GREATER] = BP_COMPARISON,
+    [TOK_EQUALS] = BP_COMPARISON,
+    [TOK_NOT_EQUALS] = BP_COMPARISON,
+    [TOK_GREATER_EQUALS] = BP_COMPARISON,
+    [TOK_LESS_EQUALS] = BP_COMPARISON,
+    [TOK_PLUS] = BP_ADDSUB,
+    [TOK_MINUS] = BP_ADDSUB,
+    [TOK_MULT] = BP_MULDIV,
+    [TOK_DIV] = BP_MULDIV,
+    [TOK_MODULO] = BP_MULDIV,
+};
+
+ASTNode* parse_binary(Parser* p, int min_bp) {
     ASTNode* left = parse_unary(p);
 
-    while (p->curr.type == TOK_MULT || p->curr.type == TOK_DIV || p->curr.type == TOK_MODULO) {
+    // comparisons don't associate, `a < b < c` is an error rather than `(a < b) < c`
+    bool compared = false;
+    for (;;) {
         TokenType op = p->curr.type;
-        parser_next(p);
-        ASTNode* right = parse_unary(p);
-        left = make_binary_op(op, left, right);
-    }
-
-    return left;
-}
-
-ASTNode* parse_addsub(Parser* p) {
-    ASTNode* left = parse_muldiv(p);
+        int bp = binding_power[op];
+        if (bp == BP_NONE || bp < min_bp) {
+            break;
+        }
+        if (bp == BP_COMPARISON) {
+            if (compared) {
+                fprintf(stderr, "comparison operators can't be chained, use && to combine them\n");
+                exit(1);
+            }
+            compared = true;
+        }
 
-    while (p->curr.type == TOK_PLUS || p->curr.type == TOK_MINUS) {
-        TokenType op = p->curr.type;
         parser_next(p);
-        ASTNode* right = parse_muldiv(p);
-        left = make_binary_op(op, left, right);
+        // everything else is left associative, so the right side only takes operators that bind tighter
+        ASTNode* right = parse_binary(p, bp + 1);
+        left = make_binary_op(&p->arena, op, left, right);
     }
 
     return left;
 }
 
 ASTNode* parse_expr(Parser* p) {
-    return parse_logical_or(p);
+    return parse_binary(p, BP_OR);
 }
 
 VarType parse_type(Parser* p) {
@@ -701,7 +719,7 @@ ASTNode* parse_var_decl(Parser* p) {
         fprintf(stderr, "expected identifier after type in var declaration\n");
         exit(1);
     }
-    char* name = p->curr.value.ident_val;
+    SymbolId name = p->curr.value.ident_val;
     parser_next(p);
 
     if (p->curr.type != TOK_ASSIGN) {
@@ -711,7 +729,7 @@ ASTNode* parse_var_decl(Parser* p) {
     parser_next(p);
 
     ASTNode* val = parse_expr(p);
-    return make_var_decl(name, val, var_type);
+    return make_var_decl(&p->arena, name, val, var_type);
 }
 
 
@@ -719,7 +737,7 @@ ASTNode* parse_statement(Parser *p) {
     if (p->curr.type == TOK_RETURN) {
         parser_next(p);
         ASTNode* expr = parse_expr(p);
-        return make_return_stmt(expr);
+        return make_return_stmt(&p->arena, expr);
     }
 
     if (p->curr.type == TOK_FN) {
@@ -731,21 +749,21 @@ ASTNode* parse_statement(Parser *p) {
     }
 
     if (p->curr.type == TOK_IDENT && p->peek.type == TOK_ASSIGN) {
-        char* name = p->curr.value.ident_val;
+        SymbolId name = p->curr.value.ident_val;
         parser_next(p);
         parser_next(p);
 
         ASTNode* val = parse_expr(p);
-        return make_var_assign(name, val);
+        return make_var_assign(&p->arena, name, val);
     }
 
     if (p->curr.type == TOK_IDENT && (p->peek.type == TOK_PLUS_EQUALS || p->peek.type == TOK_MINUS_EQUALS || p->peek.type == TOK_MULT_EQUALS || p->peek.type == TOK_DIV_EQUALS)) {
-        char* name = p->curr.value.ident_val;
+        SymbolId name = p->curr.value.ident_val;
         parser_next(p);
         TokenType op = p->curr.type; // we are at the assignment token as parse_expr skips
         parser_next(p);
         ASTNode* value = parse_expr(p);
-        return make_compound_assignment(op, name, value);
+        return make_compound_assignment(&p->arena, op, name, value);
     }
 
     if (p->curr.type == TOK_IF) {
@@ -760,29 +778,18 @@ ASTNode* parse_statement(Parser *p) {
 }
 
 ASTNode* parse_program(Parser *p) {
-    int capacity = 128, count = 0;
+    int count = 0;
     ASTNode** statements;
-    parse_block(p, capacity, TOK_EOF, &statements, &count);
+    parse_block(p, TOK_EOF, &statements, &count);
 
-    return make_program(statements, count);
+    return make_program(&p->arena, statements, count);
 }
 
-void parse_block(Parser* p, int initial_capacity, TokenType end_tok, ASTNode*** statements_out, int* count_out) {
-    int count = 0;
-    int capacity = initial_capacity;
-    ASTNode** statements = malloc(sizeof(ASTNode*) * capacity);
+void parse_block(Parser* p, TokenType end_tok, ASTNode*** statements_out, int* count_out) {
+    // nested blocks push on top of this one & pop themselves before returning
+    int base = p->scratch_count;
     while (p->curr.type != end_tok) {
-        if (count >= capacity) {
-            capacity *= 2;
-            ASTNode** new_statements = realloc(statements, sizeof(ASTNode*) * capacity);
-            if (!new_statements) {
-                fprintf(stderr, "failed to realloc statements arr\n");
-                exit(1);
-            }
-            statements = new_statements;
-        }
-
-        statements[count++] = parse_statement(p);
+        scratch_push(p, parse_statement(p));
         if (p->curr.type != TOK_SEMICOLON) {
             printf("%d", p->curr.type);
             fprintf(stderr, "semicolon expected after statement\n");
@@ -791,8 +798,7 @@ void parse_block(Parser* p, int initial_capacity, TokenType end_tok, ASTNode***
         parser_next(p);
     }
 
-    *statements_out = statements;
-    *count_out = count;
+    *statements_out = scratch_pop(p, base, count_out);
 }
 
 ASTNode* parse_if_stmt(Parser* p) {
@@ -803,9 +809,9 @@ ASTNode* parse_if_stmt(Parser* p) {
         exit(1);
     }
     parser_next(p);
-    int success_capacity = 128, success_count = 0;
+    int success_count = 0;
     ASTNode** success_statements;
-    parse_block(p, success_capacity, TOK_RBRACE, &success_statements, &success_count);
+    parse_block(p, TOK_RBRACE, &success_statements, &success_count);
     if (p->curr.type != TOK_RBRACE) {
         fprintf(stderr, "expected rbrace after if block in if statement\n");
         exit(1);
@@ -813,7 +819,7 @@ ASTNode* parse_if_stmt(Parser* p) {
     parser_next(p);
 
     if (p->curr.type != TOK_ELSE) {
-        return make_if_statement(condition, success_statements, success_count, NULL, -1);
+        return make_if_statement(&p->arena, condition, success_statements, success_count, NULL, -1);
     }
     parser_next(p);
     if (p->curr.type != TOK_LBRACE) {
@@ -822,16 +828,16 @@ ASTNode* parse_if_stmt(Parser* p) {
     }
     parser_next(p);
 
-    int fail_capacity = 128, fail_count = 0;
+    int fail_count = 0;
     ASTNode** fail_statements;
-    parse_block(p, fail_capacity, TOK_RBRACE, &fail_statements, &fail_count);
+    parse_block(p, TOK_RBRACE, &fail_statements, &fail_count);
     if (p->curr.type != TOK_RBRACE) {
         fprintf(stderr, "expected rbrace after else body in if statement\n");
         exit(1);
     }
     parser_next(p);
 
-    return make_if_statement(condition, success_statements, success_count, fail_statements, fail_count);
+    return make_if_statement(&p->arena, condition, success_statements, success_count, fail_statements, fail_count);
 }
 
 ASTNode* parse_while_stmt(Parser* p) {
@@ -842,40 +848,30 @@ ASTNode* parse_while_stmt(Parser* p) {
         exit(1);
     }
     parser_next(p);
-    int statements_capacity = 128, statements_count = 0;
+    int statements_count = 0;
     ASTNode** statements;
-    parse_block(p, statements_capacity, TOK_RBRACE, &statements, &statements_count);
+    parse_block(p, TOK_RBRACE, &statements, &statements_count);
     if (p->curr.type != TOK_RBRACE) {
         fprintf(stderr, "expected rbrace after while statement block\n");
     }
     parser_next(p);
 
-    return make_while_statement(condition, statements, statements_count);
+    return make_while_statement(&p->arena, condition, statements, statements_count);
 }
 
-ASTNode* parse_function_call(Parser* p, char* name) {
+ASTNode* parse_function_call(Parser* p, SymbolId name) {
     parser_next(p);
-    int capacity = 32;
+    int base = p->scratch_count;
     int size = 0;
-    ASTNode** args = malloc(sizeof(ASTNode*) * capacity);
 
     while (p->curr.type != TOK_RPAREN) {
         ASTNode* arg = parse_expr(p);
 
-        if (size >= capacity) {
-            capacity *= 2;
-            ASTNode** new_args = realloc(args, sizeof(ASTNode*) * capacity);
-            if (!new_args) {
-                fprintf(stderr, "failed to realloc when parsing function call\n");
-                exit(1);
-            }
-            args = new_args;
-        }
-
         if (p->curr.type == TOK_RPAREN) {
-            args[size++] = arg;
+            scratch_push(p, arg);
             parser_next(p);
-            return make_function_call(args, size, name);
+            ASTNode** args = scratch_pop(p, base, &size);
+            return make_function_call(&p->arena, args, size, name);
         }
 
         if (p->curr.type != TOK_COMMA) {
@@ -883,7 +879,7 @@ ASTNode* parse_function_call(Parser* p, char* name) {
             exit(1);
         }
 
-        args[size++] = arg;
+        scratch_push(p, arg);
     }
 
     if (p->curr.type != TOK_RPAREN) {
@@ -892,7 +888,8 @@ ASTNode* parse_function_call(Parser* p, char* name) {
     }
     parser_next(p);
 
-    return make_function_call(args, size, name);
+    ASTNode** args = scratch_pop(p, base, &size);
+    return make_function_call(&p->arena, args, size, name);
 }
 
 ASTNode* parse_fn_decl(Parser* p) {
@@ -903,7 +900,7 @@ ASTNode* parse_fn_decl(Parser* p) {
         fprintf(stderr, "expected identifier after type in function declaration\n");
         exit(1);
     }
-    char* name = p->curr.value.ident_val;
+    SymbolId name = p->curr.value.ident_val;
     parser_next(p);
 
     if (p->curr.type != TOK_LPAREN) {
@@ -912,9 +909,8 @@ ASTNode* parse_fn_decl(Parser* p) {
     }
     parser_next(p);
 
-    int args_capacity = 32;
+    // params can't nest so unlike statements they don't need to be a stack
     int args_size = 0;
-    FunctionParam* args = malloc(sizeof(FunctionParam) * args_capacity);
 
     while (p->curr.type != TOK_RPAREN) {
         VarType type = parse_type(p);
@@ -922,22 +918,22 @@ ASTNode* parse_fn_decl(Parser* p) {
             fprintf(stderr, "expected identifier after type in function declaration arguments\n");
             exit(1);
         }
-        char* arg_name = p->curr.value.ident_val;
+        SymbolId arg_name = p->curr.value.ident_val;
         parser_next(p);
 
-        if (args_size >= args_capacity) {
-            args_capacity *= 2;
-            FunctionParam* new_args = realloc(args, sizeof(FunctionParam) * args_capacity);
-            if (!new_args) {
+        if (args_size >= p->params_capacity) {
+            p->params_capacity *= 2;
+            FunctionParam* new_params = realloc(p->params_scratch, sizeof(FunctionParam) * p->params_capacity);
+            if (!new_params) {
                 fprintf(stderr, "failed to realloc when parsing function decl\n");
                 exit(1);
             }
-            args = new_args;
+            p->params_scratch = new_params;
         }
 
         FunctionParam arg = { .type = type, .name = arg_name};
         if (p->curr.type == TOK_RPAREN) {
-            args[args_size++] = arg;
+            p->params_scratch[args_size++] = arg;
             break;
         }
 
@@ -946,8 +942,10 @@ ASTNode* parse_fn_decl(Parser* p) {
             exit(1);
         }
 
-        args[args_size++] = arg;
+        p->params_scratch[args_size++] = arg;
     }
+    FunctionParam* args = arena_alloc(&p->arena, sizeof(FunctionParam) * args_size);
+    memcpy(args, p->params_scratch, sizeof(FunctionParam) * args_size);
 
     if (p->curr.type != TOK_RPAREN) {
         fprintf(stderr, "expected ) after ( in function decl\n");
@@ -961,107 +959,27 @@ ASTNode* parse_fn_decl(Parser* p) {
     }
     parser_next(p);
 
-    int stmts_capacity = 64;
     int stmts_size = 0;
-    ASTNode** stmts = malloc(sizeof(ASTNode*) * stmts_capacity);
-    parse_block(p, stmts_capacity, TOK_RBRACE, &stmts, &stmts_size);
+    ASTNode** stmts;
+    parse_block(p, TOK_RBRACE, &stmts, &stmts_size);
     if (p->curr.type != TOK_RBRACE) {
         fprintf(stderr, "expected } after function decl block\n");
     }
     parser_next(p);
 
-    return make_function_decl(stmts, stmts_size, args, args_size, return_type, name);
-}
-
-// TODO: add missing ast types to this
-void free_ast(ASTNode* node) {
-    if (!node) return;
-
-    switch (node->type) {
-    case AST_INT:
-    case AST_BOOL:
-        break;
-    case AST_STRING:
-        free(node->string.string_val);
-        break;
-    case AST_BINARY_OP:
-        free_ast(node->binary_op.left);
-        free_ast(node->binary_op.right);
-        break;
-    case AST_COMPOUND_ASSIGNMENT:
-        free(node->compound_assignment.name);
-        free_ast(node->compound_assignment.value);
-        break;
-    case AST_UNARY_OP:
-        free_ast(node->unary_op.right);
-        break;
-    case AST_PROGRAM:
-        for (int i = 0; i < node->program.count; i++) {
-            free_ast(node->program.statements[i]);
-        }
-        free(node->program.statements);
-        break;
-    case AST_IF:
-        free_ast(node->if_stmt.condition);
-
-        for (int i = 0; i < node->if_stmt.success_count; i++) {
-            free_ast(node->if_stmt.success_statements[i]);
-        }
-        free(node->if_stmt.success_statements);
-
-        if (node->if_stmt.fail_statements) {
-            for (int i = 0; i < node->if_stmt.fail_count; i++) {
-                free_ast(node->if_stmt.fail_statements[i]);
-            }
-        }
-        free(node->if_stmt.fail_statements);
-        break;
-    case AST_WHILE:
-        free_ast(node->while_stmt.condition);
-
-        for (int i = 0; i < node->while_stmt.statements_count; i++) {
-            free_ast(node->while_stmt.statements[i]);
-        }
-        free(node->while_stmt.statements);
-        break;
-    case AST_VAR_DECL:
-        free_ast(node->var_decl.value);
-        free(node->var_decl.name);
-        break;
-    case AST_VAR_ASSIGN:
-        free_ast(node->var_assign.value);
-        free(node->var_assign.name);
-        break;
-    case AST_VAR_REF:
-        free(node->var_ref.name);
-        break;
-    default:
-      break;
-    }
-
-    free(node);
+    return make_function_decl(&p->arena, stmts, stmts_size, args, args_size, return_type, name);
 }
 
 ASTNode* parse_array_literal(Parser* p) {
     parser_next(p);
-    int capacity = 128, size = 0;
-    ASTNode** exprs = malloc(sizeof(ASTNode*) * capacity);
+    int base = p->scratch_count;
+    int size = 0;
 
     while (p->curr.type != TOK_RBRACKET) {
         ASTNode* expr = parse_expr(p);
 
         // otherwise will crash on last elem expecting comma :SSSSS
-        if (size >= capacity) {
-            capacity *= 2;
-            ASTNode** new_exprs = realloc(exprs, sizeof(ASTNode*) * capacity);
-            if (!new_exprs) {
-                fprintf(stderr, "failed to reallocate memory in parse_array_literal\n");
-                exit(1);
-            }
-            exprs = new_exprs;
-        }
-
-        exprs[size++] = expr;
+        scratch_push(p, expr);
 
         if (p->curr.type == TOK_RBRACKET) {
             parser_next(p);
@@ -1074,5 +992,6 @@ ASTNode* parse_array_literal(Parser* p) {
         parser_next(p);
     }
 
-    return make_arr_literal(exprs, size);
+    ASTNode** exprs = scratch_pop(p, base, &size);
+    return make_arr_literal(&p->arena, exprs, size);
 }
@@ -2,6 +2,8 @@
 #define GRBLANG_PARSER_H
 #include <stdbool.h>
 
+#include "arena.h"
+#include "interner.h"
 #include "lexer.h"
 
 typedef enum {
@@ -42,7 +44,7 @@ char* base_type_string(BaseType type);
 void var_type_string(VarType type, char buffer[50]);
 
 typedef struct {
-    char* name;
+    SymbolId name;
     VarType type;
 } FunctionParam;
 
@@ -70,23 +72,23 @@ typedef struct ASTNode {
 
         // currently same between var_decl/assign but in future might want to add types to var_decl etc, so keeping as is for now
         struct {
-            char* name;
+            SymbolId name;
             struct ASTNode* value;
             int slot;
         } var_decl;
         struct {
-            char* name;
+            SymbolId name;
             struct ASTNode* value;
             int slot;
         } var_assign;
         struct {
             TokenType op;
-            char* name;
+            SymbolId name;
             int slot;
             struct ASTNode* value;
         } compound_assignment;
         struct {
-            char* name;
+            SymbolId name;
             int slot;
         } var_ref;
 
@@ -105,7 +107,8 @@ typedef struct ASTNode {
         } while_stmt;
 
         struct {
-            char* string_val;
+            // not nul terminated, as it may be a slice of the source
+            const char* string_val;
             int len;
         } string;
 
@@ -126,14 +129,14 @@ typedef struct ASTNode {
         } array_assign_expr;
 
         struct {
-            char* name;
+            SymbolId name;
             struct ASTNode** args;
             int args_len;
             int slot;
         } function_call;
 
         struct {
-            char* name;
+            SymbolId name;
             FunctionParam* params;
             int params_len;
             struct ASTNode** stmts;
@@ -149,11 +152,20 @@ typedef struct ASTNode {
 } ASTNode;
 
 
+// every node, child array & copied string the parser makes lives in its arena, so the whole ast is released by parser_free
 typedef struct {
     Token curr;
     Token peek;
     Lexer* lexer;
     int pos;
+    Arena arena;
+
+    // statements/args/elements are collected here while their count is unknown, then copied into the arena at their final size
+    ASTNode** scratch;
+    int scratch_count;
+    int scratch_capacity;
+    FunctionParam* params_scratch;
+    int params_capacity;
 } Parser;
 
 // convert DATA_XXX DataType to VALUE_XXX VarType
@@ -161,39 +173,38 @@ VarType data_to_var_type(DataType tt);
 
 void parser_init(Parser* p, Lexer* l);
 void parser_next(Parser* p);
+// frees the ast, call once nothing needs it anymore (after resolving, type checking & bytecode generation)
+void parser_free(Parser* p);
 
 char* op_string(TokenType op);
 void print_ast(ASTNode* node, int indent, bool newline);
 
-ASTNode* make_int(int value);
+ASTNode* make_int(Arena* a, int value);
 // separate true and false because i'd just be doubling up checks on tokentype if it was just one make_bool which is wasteful
-ASTNode* make_true_bool();
-ASTNode* make_false_bool();
-ASTNode* make_string(char* str_val, int len);
-ASTNode* make_binary_op(TokenType op, ASTNode* left, ASTNode* right);
-ASTNode* make_compound_assignment(TokenType op, char* name, ASTNode* value);
-ASTNode* make_unary_op(TokenType op, ASTNode* right);
-ASTNode* make_program(ASTNode** statements, int count);
-ASTNode* make_if_statement(ASTNode* condition, ASTNode** success_statements, int success_count, ASTNode** fail_statements, int fail_count);
-ASTNode* make_while_statement(ASTNode* condition, ASTNode** statements, int statements_count);
-ASTNode* make_var_decl(char* name, ASTNode* value, VarType type);
-ASTNode* make_var_assign(char* name, ASTNode* value);
-ASTNode* make_var_ref(char* name);
-ASTNode* make_arr_literal(ASTNode** exprs, int len);
-ASTNode* make_arr_index(ASTNode* var_ref, ASTNode* index_expr);
-ASTNode* make_arr_index_assign(ASTNode* arr_index, ASTNode* value);
-ASTNode* make_function_call(ASTNode** args, int args_len, char* value);
-ASTNode* make_function_decl(ASTNode** stmts, int stmts_len, FunctionParam* params, int param_len, VarType return_type, char* name);
-ASTNode* make_return_stmt(ASTNode* expr);
+ASTNode* make_true_bool(Arena* a);
+ASTNode* make_false_bool(Arena* a);
+ASTNode* make_string(Arena* a, const char* str_val, int len);
+ASTNode* make_binary_op(Arena* a, TokenType op, ASTNode* left, ASTNode* right);
+ASTNode* make_compound_assignment(Arena* a, TokenType op, SymbolId name, ASTNode* value);
+ASTNode* make_unary_op(Arena* a, TokenType op, ASTNode* right);
+ASTNode* make_program(Arena* a, ASTNode** statements, int count);
+ASTNode* make_if_statement(Arena* a, ASTNode* condition, ASTNode** success_statements, int success_count, ASTNode** fail_statements, int fail_count);
+ASTNode* make_while_statement(Arena* a, ASTNode* condition, ASTNode** statements, int statements_count);
+ASTNode* make_var_decl(Arena* a, SymbolId name, ASTNode* value, VarType type);
+ASTNode* make_var_assign(Arena* a, SymbolId name, ASTNode* value);
+ASTNode* make_var_ref(Arena* a, SymbolId name);
+ASTNode* make_arr_literal(Arena* a, ASTNode** exprs, int len);
+ASTNode* make_arr_index(Arena* a, ASTNode* var_ref, ASTNode* index_expr);
+ASTNode* make_arr_index_assign(Arena* a, ASTNode* arr_index, ASTNode* value);
+ASTNode* make_function_call(Arena* a, ASTNode** args, int args_len, SymbolId value);
+ASTNode* make_function_decl(Arena* a, ASTNode** stmts, int stmts_len, FunctionParam* params, int param_len, VarType return_type, SymbolId name);
+ASTNode* make_return_stmt(Arena* a, ASTNode* expr);
 
 ASTNode* parse_compound_assignment(Parser* p);
-ASTNode* parse_logical_or(Parser* p);
-ASTNode* parse_logical_and(Parser* p);
-ASTNode* parse_comparison(Parser* p);
-ASTNode* parse_addsub(Parser* p);
 ASTNode* parse_primary(Parser* p);
 ASTNode* parse_unary(Parser* p);
-ASTNode* parse_muldiv(Parser* p);
+// parses a unary expression followed by any binary operators that bind at least as tightly as min_bp
+ASTNode* parse_binary(Parser* p, int min_bp);
 
 // assumes p.curr == tok_if on call
 ASTNode* parse_if_stmt(Parser* p);
@@ -204,7 +215,7 @@ ASTNode* parse_array_literal(Parser* p);
 // assumes p.curr == tok_var
 ASTNode* parse_var_decl(Parser* p);
 // assumes p.curr == tok_lparen
-ASTNode* parse_function_call(Parser* p, char* ident_name);
+ASTNode* parse_function_call(Parser* p, SymbolId ident_name);
 VarType parse_type(Parser* p);
 // assumes p.curr == tok_fn
 ASTNode* parse_fn_decl(Parser* p);
@@ -214,11 +225,8 @@ ASTNode* parse_fn_decl(Parser* p);
  */
 ASTNode* parse_expr(Parser* p);
 ASTNode* parse_statement(Parser *p);
-void parse_block(Parser* p, int initial_capacity, TokenType end_tok, ASTNode*** statements_out, int* count_out);
+void parse_block(Parser* p, TokenType end_tok, ASTNode*** statements_out, int* count_out);
 // to be used as a general entry point
 ASTNode* parse_program(Parser *p);
 
-// free_ast takes in, ideally the `AST_PROGRAM` node, frees recursively, at the earliest, this should be called after resolving, type checking & bytecode generation
-void free_ast(ASTNode* node);
-
 #endif //GRBLANG_PARSER_H
@@ -0,0 +1,489 @@
+#include "reg_vm.h"
+#include "stack.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the same dispatch as vm_run, see vm.c
+#if defined(GRBLANG_THREADED_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+#define REG_THREADED_DISPATCH
+#endif
+
+#ifdef REG_THREADED_DISPATCH
+#define REG_CASE(op) case op: label_##op:
+#define REG_DISPATCH() do { \
+        instr = ip++; \
+        vm->instruction_count++; \
+        goto *instr->handler; \
+    } while (0)
+#define REG_NEXT() REG_DISPATCH()
+#else
+#define REG_CASE(op) case op:
+#define REG_NEXT() break
+#endif
+
+void reg_code_init(RegCode* code) {
+    code->capacity = 64;
+    code->count = 0;
+    code->instrs = malloc(sizeof(RegInstr) * code->capacity);
+    code->args_capacity = 16;
+    code->args_count = 0;
+    code->args = malloc(sizeof(int) * code->args_capacity);
+    if (!code->instrs || !code->args) {
+        fprintf(stderr, "failed to malloc register code\n");
+        exit(1);
+    }
+    code->constants = NULL;
+    code->const_count = 0;
+    code->reg_count = 0;
+}
+
+void free_reg_code(RegCode* code) {
+    for (int i = 0; i < code->const_count; i++) {
+        if (code->constants[i].type.base_type == VALUE_STRING && code->constants[i].type.nested == -1) {
+            decrement_ref(code->constants[i].string_val);
+        }
+    }
+    free(code->constants);
+    free(code->instrs);
+    free(code->args);
+}
+
+int reg_emit(RegCode* code, RegOp op, int a, int b, int c) {
+    if (code->count == code->capacity) {
+        code->capacity *= 2;
+        RegInstr* new_instrs = realloc(code->instrs, sizeof(RegInstr) * code->capacity);
+        if (!new_instrs) {
+            fprintf(stderr, "failed to realloc register code arr\n");
+            exit(1);
+        }
+        code->instrs = new_instrs;
+    }
+    code->instrs[code->count] = (RegInstr) {.handler = NULL, .op = op, .a = a, .b = b, .c = c};
+    return code->count++;
+}
+
+int reg_emit_args(RegCode* code, int* regs, int count) {
+    while (code->args_count + count > code->args_capacity) {
+        code->args_capacity *= 2;
+        int* new_args = realloc(code->args, sizeof(int) * code->args_capacity);
+        if (!new_args) {
+            fprintf(stderr, "failed to realloc register args arr\n");
+            exit(1);
+        }
+        code->args = new_args;
+    }
+    int start = code->args_count;
+    memcpy(code->args + start, regs, sizeof(int) * count);
+    code->args_count += count;
+    return start;
+}
+
+static const char* reg_op_names[REG_OP_COUNT] = {
+    [REG_MOVE] = "move",
+    [REG_SMOVE] = "smove",
+    [REG_IADD] = "iadd",
+    [REG_ISUB] = "isub",
+    [REG_IMUL] = "imul",
+    [REG_IDIV] = "idiv",
+    [REG_IMOD] = "imod",
+    [REG_IDIV_NC] = "idiv_nc",
+    [REG_IMOD_NC] = "imod_nc",
+    [REG_ISHR] = "ishr",
+    [REG_IAND] = "iand",
+    [REG_INEG] = "ineg",
+    [REG_NOT] = "not",
+    [REG_IGT] = "igt",
+    [REG_IGTE] = "igte",
+    [REG_ILT] = "ilt",
+    [REG_ILTE] = "ilte",
+    [REG_IEQ] = "ieq",
+    [REG_INEQ] = "ineq",
+    [REG_BEQ] = "beq",
+    [REG_BNEQ] = "bneq",
+    [REG_SCONCAT] = "sconcat",
+    [REG_ARRAY] = "array",
+    [REG_ARRLOADIDX] = "arrloadidx",
+    [REG_ARRLOADIDX_NC] = "arrloadidx_nc",
+    [REG_ARRSTOREIDX] = "arrstoreidx",
+    [REG_ARRSTOREIDX_NC] = "arrstoreidx_nc",
+    [REG_ARRAPPEND] = "arrappend",
+    [REG_JMP] = "jmp",
+    [REG_JMPT] = "jmpt",
+    [REG_JMPF] = "jmpf",
+    [REG_IGT_JMPF] = "igt_jmpf",
+    [REG_IGTE_JMPF] = "igte_jmpf",
+    [REG_ILT_JMPF] = "ilt_jmpf",
+    [REG_ILTE_JMPF] = "ilte_jmpf",
+    [REG_IEQ_JMPF] = "ieq_jmpf",
+    [REG_INEQ_JMPF] = "ineq_jmpf",
+    [REG_RESULT] = "result",
+    [REG_HALT] = "halt",
+};
+
+void reg_code_print(RegCode* code) {
+    for (int i = 0; i < code->const_count; i++) {
+        char buffer[100];
+        size_t len = 0;
+        stack_value_string(code->constants[i], false, buffer, sizeof(buffer), &len);
+        printf("r%d = %s\n", i, buffer);
+    }
+    for (int i = 0; i < code->count; i++) {
+        RegInstr* instr = &code->instrs[i];
+        printf("%4d: %s", i, reg_op_names[instr->op]);
+        switch (instr->op) {
+            case REG_JMP:
+                printf(" %d\n", instr->a);
+                break;
+            case REG_JMPT:
+            case REG_JMPF:
+                printf(" %d, r%d\n", instr->a, instr->b);
+                break;
+            case REG_IGT_JMPF:
+            case REG_IGTE_JMPF:
+            case REG_ILT_JMPF:
+            case REG_ILTE_JMPF:
+            case REG_IEQ_JMPF:
+            case REG_INEQ_JMPF:
+                printf(" %d, r%d, r%d\n", instr->a, instr->b, instr->c);
+                break;
+            case REG_RESULT:
+                printf(" r%d\n", instr->a);
+                break;
+            case REG_MOVE:
+            case REG_SMOVE:
+            case REG_INEG:
+            case REG_NOT:
+                printf(" r%d, r%d\n", instr->a, instr->b);
+                break;
+            case REG_ARRAY:
+                printf(" r%d,", instr->a);
+                for (int j = 0; j < instr->b; j++) {
+                    printf(" r%d", code->args[instr->c + j]);
+                }
+                printf("\n");
+                break;
+            default:
+                printf(" r%d, r%d, r%d\n", instr->a, instr->b, instr->c);
+                break;
+        }
+    }
+}
+
+static bool is_string(StackValue v) {
+    return v.type.base_type == VALUE_STRING && v.type.nested == -1;
+}
+
+// a register holds a reference on its string, taken before the old value's is dropped in case they're the same
+static void reg_store(StackValue* reg, StackValue v) {
+    if (is_string(v)) increment_ref(v.string_val);
+    if (is_string(*reg)) decrement_ref(reg->string_val);
+    *reg = v;
+}
+
+// arrays keep their strings for as long as they're around, which like on the stack vm is until the program ends
+static void array_keep(StackValue v) {
+    if (is_string(v)) increment_ref(v.string_val);
+}
+
+void reg_vm_init(RegVM* vm, RegCode* code) {
+    vm->code = *code;
+    // the halt after the last instruction is where jumps to the end of the code land
+    reg_emit(&vm->code, REG_HALT, 0, 0, 0);
+
+    int reg_count = code->reg_count > 0 ? code->reg_count : 1;
+    vm->regs = malloc(sizeof(StackValue) * reg_count);
+    if (!vm->regs) {
+        fprintf(stderr, "failed to malloc registers\n");
+        exit(1);
+    }
+    VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+    for (int i = 0; i < reg_count; i++) {
+        vm->regs[i].type = unknown_type;
+    }
+    for (int i = 0; i < vm->code.const_count; i++) {
+        reg_store(&vm->regs[i], vm->code.constants[i]);
+    }
+    vm->result.type = unknown_type;
+    vm->instruction_count = 0;
+}
+
+static void check_index(StackValue array, int idx) {
+    if (idx < 0 || idx >= array.array_val->len) {
+        fprintf(stderr, "runtime error: idx %d oob on array of len %d\n", idx, array.array_val->len);
+        exit(1);
+    }
+}
+
+void reg_vm_run(RegVM* vm) {
+    VarType int_type = {.base_type = VALUE_INT, .nested = -1};
+    VarType bool_type = {.base_type = VALUE_BOOL, .nested = -1};
+    VarType string_type = {.base_type = VALUE_STRING, .nested = -1};
+    StackValue* r = vm->regs;
+    RegInstr* instrs = vm->code.instrs;
+    RegInstr* ip = instrs;
+    RegInstr* instr;
+#ifdef REG_THREADED_DISPATCH
+    static void* dispatch_table[REG_OP_COUNT] = {
+        [REG_MOVE] = &&label_REG_MOVE,
+        [REG_SMOVE] = &&label_REG_SMOVE,
+        [REG_IADD] = &&label_REG_IADD,
+        [REG_ISUB] = &&label_REG_ISUB,
+        [REG_IMUL] = &&label_REG_IMUL,
+        [REG_IDIV] = &&label_REG_IDIV,
+        [REG_IMOD] = &&label_REG_IMOD,
+        [REG_IDIV_NC] = &&label_REG_IDIV_NC,
+        [REG_IMOD_NC] = &&label_REG_IMOD_NC,
+        [REG_ISHR] = &&label_REG_ISHR,
+        [REG_IAND] = &&label_REG_IAND,
+        [REG_INEG] = &&label_REG_INEG,
+        [REG_NOT] = &&label_REG_NOT,
+        [REG_IGT] = &&label_REG_IGT,
+        [REG_IGTE] = &&label_REG_IGTE,
+        [REG_ILT] = &&label_REG_ILT,
+        [REG_ILTE] = &&label_REG_ILTE,
+        [REG_IEQ] = &&label_REG_IEQ,
+        [REG_INEQ] = &&label_REG_INEQ,
+        [REG_BEQ] = &&label_REG_BEQ,
+        [REG_BNEQ] = &&label_REG_BNEQ,
+        [REG_SCONCAT] = &&label_REG_SCONCAT,
+        [REG_ARRAY] = &&label_REG_ARRAY,
+        [REG_ARRLOADIDX] = &&label_REG_ARRLOADIDX,
+        [REG_ARRLOADIDX_NC] = &&label_REG_ARRLOADIDX_NC,
+        [REG_ARRSTOREIDX] = &&label_REG_ARRSTOREIDX,
+        [REG_ARRSTOREIDX_NC] = &&label_REG_ARRSTOREIDX_NC,
+        [REG_ARRAPPEND] = &&label_REG_ARRAPPEND,
+        [REG_JMP] = &&label_REG_JMP,
+        [REG_JMPT] = &&label_REG_JMPT,
+        [REG_JMPF] = &&label_REG_JMPF,
+        [REG_IGT_JMPF] = &&label_REG_IGT_JMPF,
+        [REG_IGTE_JMPF] = &&label_REG_IGTE_JMPF,
+        [REG_ILT_JMPF] = &&label_REG_ILT_JMPF,
+        [REG_ILTE_JMPF] = &&label_REG_ILTE_JMPF,
+        [REG_IEQ_JMPF] = &&label_REG_IEQ_JMPF,
+        [REG_INEQ_JMPF] = &&label_REG_INEQ_JMPF,
+        [REG_RESULT] = &&label_REG_RESULT,
+        [REG_HALT] = &&label_REG_HALT,
+    };
+    for (int i = 0; i < vm->code.count; i++) {
+        instrs[i].handler = dispatch_table[instrs[i].op];
+    }
+    // the switch is only ever jumped into
+    REG_DISPATCH();
+#endif
+    for (;;) {
+        instr = ip++;
+        vm->instruction_count++;
+
+        switch (instr->op) {
+            REG_CASE(REG_MOVE)
+                r[instr->a] = r[instr->b];
+                REG_NEXT();
+            REG_CASE(REG_SMOVE)
+                reg_store(&r[instr->a], r[instr->b]);
+                REG_NEXT();
+            REG_CASE(REG_IADD)
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = r[instr->b].int_val + r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_ISUB)
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = r[instr->b].int_val - r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_IMUL)
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = r[instr->b].int_val * r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_IDIV) {
+                int a = r[instr->b].int_val;
+                int b = r[instr->c].int_val;
+                if (b == 0) {
+                    fprintf(stderr, "runtime error: division by 0 not allowed\n");
+                    exit(1);
+                }
+                // INT_MIN / -1 overflows like the other ops do, rather than trapping
+                int quotient = b == -1 ? (int) (0u - (uint32_t) a) : a / b;
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = quotient};
+                REG_NEXT();
+            }
+            REG_CASE(REG_IMOD) {
+                int a = r[instr->b].int_val;
+                int b = r[instr->c].int_val;
+                if (b == 0) {
+                    fprintf(stderr, "runtime error: division by 0 not allowed\n");
+                    exit(1);
+                }
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = b == -1 ? 0 : a % b};
+                REG_NEXT();
+            }
+            REG_CASE(REG_IDIV_NC)
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = r[instr->b].int_val / r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_IMOD_NC)
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = r[instr->b].int_val % r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_ISHR)
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = r[instr->b].int_val >> (r[instr->c].int_val & 31)};
+                REG_NEXT();
+            REG_CASE(REG_IAND)
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = r[instr->b].int_val & r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_INEG)
+                r[instr->a] = (StackValue) {.type = int_type, .int_val = -r[instr->b].int_val};
+                REG_NEXT();
+            REG_CASE(REG_NOT)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = !r[instr->b].bool_val};
+                REG_NEXT();
+            REG_CASE(REG_IGT)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = r[instr->b].int_val > r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_IGTE)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = r[instr->b].int_val >= r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_ILT)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = r[instr->b].int_val < r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_ILTE)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = r[instr->b].int_val <= r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_IEQ)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = r[instr->b].int_val == r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_INEQ)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = r[instr->b].int_val != r[instr->c].int_val};
+                REG_NEXT();
+            REG_CASE(REG_BEQ)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = r[instr->b].bool_val == r[instr->c].bool_val};
+                REG_NEXT();
+            REG_CASE(REG_BNEQ)
+                r[instr->a] = (StackValue) {.type = bool_type, .bool_val = r[instr->b].bool_val != r[instr->c].bool_val};
+                REG_NEXT();
+            REG_CASE(REG_SCONCAT) {
+                StringValue* a = r[instr->b].string_val;
+                StringValue* b = r[instr->c].string_val;
+                int len = a->len + b->len;
+                char* result = malloc(len + 1);
+                StringValue* strv = malloc(sizeof(StringValue));
+                if (!result || !strv) {
+                    fprintf(stderr, "runtime error: failed to allocate memory during string concat\n");
+                    exit(1);
+                }
+                memcpy(result, a->string_val, a->len);
+                memcpy(result + a->len, b->string_val, b->len);
+                result[len] = '\0';
+                strv->string_val = result;
+                strv->len = len;
+                // the store below takes the only reference
+                strv->ref_count = 0;
+                reg_store(&r[instr->a], (StackValue) {.type = string_type, .string_val = strv});
+                REG_NEXT();
+            }
+            REG_CASE(REG_ARRAY) {
+                int len = instr->b;
+                int* elems = vm->code.args + instr->c;
+
+                ArrayValue* arrv = malloc(sizeof(ArrayValue));
+                arrv->len = len;
+                arrv->ref_count = 0;
+                arrv->capacity = ((len / 64) + 1) * 64;
+                arrv->arr_val = malloc(sizeof(StackValue) * arrv->capacity);
+                for (int i = 0; i < len; i++) {
+                    arrv->arr_val[i] = r[elems[i]];
+                    array_keep(arrv->arr_val[i]);
+                }
+
+                VarType arr_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+                if (len > 0) {
+                    arr_type = arrv->arr_val[0].type;
+                    arr_type.nested++;
+                }
+                r[instr->a] = (StackValue) {.type = arr_type, .array_val = arrv};
+                REG_NEXT();
+            }
+            REG_CASE(REG_ARRLOADIDX) {
+                StackValue array = r[instr->b];
+                int idx = r[instr->c].int_val;
+                check_index(array, idx);
+                reg_store(&r[instr->a], array.array_val->arr_val[idx]);
+                REG_NEXT();
+            }
+            REG_CASE(REG_ARRLOADIDX_NC)
+                reg_store(&r[instr->a], r[instr->b].array_val->arr_val[r[instr->c].int_val]);
+                REG_NEXT();
+            REG_CASE(REG_ARRSTOREIDX) {
+                StackValue array = r[instr->a];
+                int idx = r[instr->b].int_val;
+                check_index(array, idx);
+                array_keep(r[instr->c]);
+                array.array_val->arr_val[idx] = r[instr->c];
+                REG_NEXT();
+            }
+            REG_CASE(REG_ARRSTOREIDX_NC)
+                array_keep(r[instr->c]);
+                r[instr->a].array_val->arr_val[r[instr->b].int_val] = r[instr->c];
+                REG_NEXT();
+            REG_CASE(REG_ARRAPPEND) {
+                ArrayValue* arrv = r[instr->b].array_val;
+                if (arrv->len + 1 >= arrv->capacity) {
+                    arrv->capacity *= 2;
+                    StackValue* new_arr = realloc(arrv->arr_val, arrv->capacity * sizeof(StackValue));
+                    if (!new_arr) {
+                        fprintf(stderr, "runtime error: failed to reallocate memory for array append\n");
+                        exit(1);
+                    }
+                    arrv->arr_val = new_arr;
+                }
+                array_keep(r[instr->c]);
+                arrv->arr_val[arrv->len++] = r[instr->c];
+                r[instr->a] = r[instr->b];
+                REG_NEXT();
+            }
+            REG_CASE(REG_JMP)
+                ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_JMPT)
+                if (r[instr->b].bool_val) ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_JMPF)
+                if (!r[instr->b].bool_val) ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_IGT_JMPF)
+                if (!(r[instr->b].int_val > r[instr->c].int_val)) ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_IGTE_JMPF)
+                if (!(r[instr->b].int_val >= r[instr->c].int_val)) ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_ILT_JMPF)
+                if (!(r[instr->b].int_val < r[instr->c].int_val)) ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_ILTE_JMPF)
+                if (!(r[instr->b].int_val <= r[instr->c].int_val)) ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_IEQ_JMPF)
+                if (!(r[instr->b].int_val == r[instr->c].int_val)) ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_INEQ_JMPF)
+                if (!(r[instr->b].int_val != r[instr->c].int_val)) ip = instrs + instr->a;
+                REG_NEXT();
+            REG_CASE(REG_RESULT)
+                reg_store(&vm->result, r[instr->a]);
+                REG_NEXT();
+            REG_CASE(REG_HALT)
+                // not one of the program's instructions
+                vm->instruction_count--;
+                return;
+            default:
+                fprintf(stderr, "unknown register opcode: %d at %d\n", instr->op, (int) (instr - instrs));
+                exit(1);
+        }
+    }
+}
+
+void reg_vm_free(RegVM* vm) {
+    for (int i = 0; i < vm->code.reg_count; i++) {
+        if (is_string(vm->regs[i])) decrement_ref(vm->regs[i].string_val);
+    }
+    if (is_string(vm->result)) decrement_ref(vm->result.string_val);
+    free(vm->regs);
+    free_reg_code(&vm->code);
+}
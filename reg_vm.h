@@ -0,0 +1,105 @@
+#ifndef GRBLANG_REG_VM_H
+#define GRBLANG_REG_VM_H
+#include <stdint.h>
+
+#include "stack.h"
+
+// three address instructions over a frame of registers, a is the register written unless noted otherwise. registers
+// [0, const_count) hold the constants, the ones after them the program's values
+typedef enum {
+    REG_MOVE, // a = b, for anything but strings
+    REG_SMOVE, // a = b, a string register
+    REG_IADD, // a = b + c
+    REG_ISUB,
+    REG_IMUL,
+    REG_IDIV,
+    REG_IMOD,
+    // the same as the checked ones, only emitted where the divisor is proven not 0 (nor -1 for INT_MIN)
+    REG_IDIV_NC,
+    REG_IMOD_NC,
+    REG_ISHR,
+    REG_IAND,
+    REG_INEG, // a = -b
+    REG_NOT, // a = !b
+    REG_IGT, // a = b > c
+    REG_IGTE,
+    REG_ILT,
+    REG_ILTE,
+    REG_IEQ,
+    REG_INEQ,
+    REG_BEQ,
+    REG_BNEQ,
+    REG_SCONCAT, // a = b + c, a string register
+    REG_ARRAY, // a = an array of the b registers listed from args[c]
+    REG_ARRLOADIDX, // a = b[c]
+    REG_ARRLOADIDX_NC,
+    REG_ARRSTOREIDX, // a[b] = c
+    REG_ARRSTOREIDX_NC,
+    REG_ARRAPPEND, // appends c to b in place, a = b
+    // jumps to the instruction at index a
+    REG_JMP,
+    REG_JMPT, // if b
+    REG_JMPF, // if !b
+    // if !(b op c), the compare & jump ones
+    REG_IGT_JMPF,
+    REG_IGTE_JMPF,
+    REG_ILT_JMPF,
+    REG_ILTE_JMPF,
+    REG_IEQ_JMPF,
+    REG_INEQ_JMPF,
+    REG_RESULT, // the program's result is a, unless another one runs after it
+    // never emitted, reg_vm_init ends the code with one
+    REG_HALT,
+    REG_OP_COUNT,
+} RegOp;
+
+typedef struct {
+    // the label of its handler, bound by reg_vm_run with threaded dispatch
+    const void* handler;
+    uint8_t op;
+    int a;
+    int b;
+    int c;
+} RegInstr;
+
+typedef struct {
+    RegInstr* instrs;
+    int count;
+    int capacity;
+
+    // the element registers of the array literals
+    int* args;
+    int args_count;
+    int args_capacity;
+
+    StackValue* constants;
+    int const_count;
+    // constants included
+    int reg_count;
+} RegCode;
+
+void reg_code_init(RegCode* code);
+// only for code that never made it to reg_vm_init, which takes everything over
+void free_reg_code(RegCode* code);
+// returns the index of the instruction
+int reg_emit(RegCode* code, RegOp op, int a, int b, int c);
+// returns where in args the registers start
+int reg_emit_args(RegCode* code, int* regs, int count);
+void reg_code_print(RegCode* code);
+
+typedef struct {
+    RegCode code;
+    StackValue* regs;
+    // what the last REG_RESULT ran on
+    StackValue result;
+
+    // instructions dispatched by reg_vm_run, for benchmarking
+    long instruction_count;
+} RegVM;
+
+// takes over code & its constants
+void reg_vm_init(RegVM* vm, RegCode* code);
+void reg_vm_run(RegVM* vm);
+void reg_vm_free(RegVM* vm);
+
+#endif //GRBLANG_REG_VM_H
@@ -8,62 +8,119 @@
 void resolver_init(Resolver* r) {
     r->capacity = 16;
     r->count = 0;
-    r->names = malloc(sizeof(char*) * r->capacity);
-    r->types = malloc(sizeof(VarType) * r->capacity);
+    r->bindings = malloc(sizeof(Binding) * r->capacity);
+
+    r->visible_capacity = 0;
+    r->visible = NULL;
+
+    r->scope_capacity = 16;
+    r->depth = 0;
+    r->scope_starts = malloc(sizeof(int) * r->scope_capacity);
+
+    r->num_locals = 0;
 }
 
 void resolver_resize(Resolver* r) {
     r->capacity *= 2;
-    char** new_names = realloc(r->names, sizeof(char*) * r->capacity);
-    if (!new_names) {
-        fprintf(stderr, "failed to realloc names arr in resolver\n");
+    Binding* new_bindings = realloc(r->bindings, sizeof(Binding) * r->capacity);
+    if (!new_bindings) {
+        fprintf(stderr, "failed to realloc bindings arr in resolver\n");
         exit(1);
     }
-    r->names = new_names;
+    r->bindings = new_bindings;
+}
+
+// symbols can be interned after the resolver is made (streaming lexer), so this grows on demand
+static void resolver_reserve_symbol(Resolver* r, SymbolId name) {
+    if ((int)name < r->visible_capacity) return;
 
-    VarType* new_types = realloc(r->types, sizeof(VarType) * r->capacity);
-    if (!new_types) {
-        fprintf(stderr, "failed to realloc types arr in resolver\n");
+    int new_capacity = r->visible_capacity ? r->visible_capacity : 64;
+    while (new_capacity <= (int)name || new_capacity < symbol_count()) {
+        new_capacity *= 2;
+    }
+    int* new_visible = realloc(r->visible, sizeof(int) * new_capacity);
+    if (!new_visible) {
+        fprintf(stderr, "failed to realloc visible arr in resolver\n");
         exit(1);
     }
-    r->types = new_types;
+    for (int i = r->visible_capacity; i < new_capacity; i++) {
+        new_visible[i] = -1;
+    }
+    r->visible = new_visible;
+    r->visible_capacity = new_capacity;
 }
 
-int resolver_declare(Resolver* r, char* name, VarType type) {
-    for (int i = 0; i < r->count; i++) {
-        if (strcmp(r->names[i], name) == 0) {
-            fprintf(stderr, "variable `%s` already declared\n", name);
+void resolver_enter_scope(Resolver* r) {
+    if (r->depth >= r->scope_capacity) {
+        r->scope_capacity *= 2;
+        int* new_starts = realloc(r->scope_starts, sizeof(int) * r->scope_capacity);
+        if (!new_starts) {
+            fprintf(stderr, "failed to realloc scope arr in resolver\n");
             exit(1);
         }
+        r->scope_starts = new_starts;
+    }
+    r->scope_starts[r->depth++] = r->count;
+}
+
+void resolver_exit_scope(Resolver* r) {
+    int start = r->scope_starts[--r->depth];
+    // unshadow in reverse so a name declared twice in nested scopes ends up back at the outer binding
+    for (int i = r->count - 1; i >= start; i--) {
+        r->visible[r->bindings[i].name] = r->bindings[i].shadowed;
+    }
+    r->count = start;
+}
+
+int resolver_declare(Resolver* r, SymbolId name, VarType type) {
+    resolver_reserve_symbol(r, name);
+
+    int prev = r->visible[name];
+    if (prev != -1 && r->bindings[prev].depth == r->depth) {
+        fprintf(stderr, "variable `%s` already declared\n", symbol_name(name));
+        exit(1);
     }
 
     if (r->count >= r->capacity) {
         resolver_resize(r);
     }
 
-    r->names[r->count] = strdup(name);
-    r->types[r->count] = type;
-    return r->count++;
-}
+    // bindings only live while their scope is open, so the stack index doubles as the slot & slots of closed scopes get reused
+    int index = r->count++;
+    Binding* binding = &r->bindings[index];
+    binding->name = name;
+    binding->type = type;
+    binding->slot = index;
+    binding->depth = r->depth;
+    binding->shadowed = prev;
+    r->visible[name] = index;
 
-int resolver_lookup(Resolver* r, char* name) {
-    int slot = -1;
-    for (int i = 0; i < r->count; i++) {
-        if (strcmp(r->names[i], name) == 0) {
-            slot = i;
-        }
+    if (r->count > r->num_locals) {
+        r->num_locals = r->count;
     }
+    return binding->slot;
+}
 
-    if (slot == -1) {
-        fprintf(stderr, "cannot reassign var `%s` as it doesnt exist\n", name);
+Binding* resolver_lookup(Resolver* r, SymbolId name) {
+    if ((int)name >= r->visible_capacity || r->visible[name] == -1) {
+        return NULL;
     }
+    return &r->bindings[r->visible[name]];
+}
 
-    return slot;
+// statements of an if/else/while body, which get their own scope
+static void resolve_block(ASTNode** statements, int count, Resolver* r) {
+    resolver_enter_scope(r);
+    for (int i = 0; i < count; i++) {
+        resolve(statements[i], r);
+    }
+    resolver_exit_scope(r);
 }
 
 void resolve(ASTNode* node, Resolver* r) {
     if (!node) return;
 
+    Binding* binding;
     switch (node->type) {
         case AST_VAR_DECL:
             resolve(node->var_decl.value, r);
@@ -71,20 +128,22 @@ void resolve(ASTNode* node, Resolver* r) {
             break;
         case AST_VAR_ASSIGN:
             resolve(node->var_assign.value, r);
-            node->var_assign.slot = resolver_lookup(r, node->var_assign.name);
-            if (node->var_assign.slot == -1) {
-                fprintf(stderr, "undefined variable `%s` when trying to reassign\n", node->var_assign.name);
+            binding = resolver_lookup(r, node->var_assign.name);
+            if (!binding) {
+                fprintf(stderr, "undefined variable `%s` when trying to reassign\n", symbol_name(node->var_assign.name));
                 exit(1);
             }
-            node->var_type = r->types[node->var_assign.slot];
+            node->var_assign.slot = binding->slot;
+            node->var_type = binding->type;
             break;
         case AST_VAR_REF:
-            node->var_ref.slot = resolver_lookup(r, node->var_ref.name);
-            if (node->var_ref.slot == -1) {
-                fprintf(stderr, "undefined variable `%s` when trying to reference\n", node->var_ref.name);
+            binding = resolver_lookup(r, node->var_ref.name);
+            if (!binding) {
+                fprintf(stderr, "undefined variable `%s` when trying to reference\n", symbol_name(node->var_ref.name));
                 exit(1);
             }
-            node->var_type = r->types[node->var_ref.slot];
+            node->var_ref.slot = binding->slot;
+            node->var_type = binding->type;
             break;
         case AST_PROGRAM:
             for (int i = 0; i < node->program.count; i++) {
@@ -93,20 +152,14 @@ void resolve(ASTNode* node, Resolver* r) {
             break;
         case AST_IF:
             resolve(node->if_stmt.condition, r);
-            for (int i = 0; i < node->if_stmt.success_count; i++) {
-                resolve(node->if_stmt.success_statements[i], r);
-            }
+            resolve_block(node->if_stmt.success_statements, node->if_stmt.success_count, r);
             if (node->if_stmt.fail_statements) {
-                for (int i = 0; i < node->if_stmt.fail_count; i++) {
-                    resolve(node->if_stmt.fail_statements[i], r);
-                }
+                resolve_block(node->if_stmt.fail_statements, node->if_stmt.fail_count, r);
             }
             break;
         case AST_WHILE:
             resolve(node->while_stmt.condition, r);
-            for (int i = 0; i < node->while_stmt.statements_count; i++) {
-                resolve(node->while_stmt.statements[i], r);
-            }
+            resolve_block(node->while_stmt.statements, node->while_stmt.statements_count, r);
             break;
         case AST_BINARY_OP:
             resolve(node->binary_op.left, r);
@@ -114,12 +167,13 @@ void resolve(ASTNode* node, Resolver* r) {
             break;
         case AST_COMPOUND_ASSIGNMENT:
             resolve(node->compound_assignment.value, r);
-            node->compound_assignment.slot = resolver_lookup(r, node->compound_assignment.name);
-            if (node->compound_assignment.slot == -1) {
-                fprintf(stderr, "undefined variable `%s` when trying to reassign\n", node->var_assign.name);
+            binding = resolver_lookup(r, node->compound_assignment.name);
+            if (!binding) {
+                fprintf(stderr, "undefined variable `%s` when trying to reassign\n", symbol_name(node->compound_assignment.name));
                 exit(1);
             }
-            node->var_type = r->types[node->compound_assignment.slot];
+            node->compound_assignment.slot = binding->slot;
+            node->var_type = binding->type;
             break;
         case AST_UNARY_OP:
             resolve(node->unary_op.right, r);
@@ -141,30 +195,104 @@ void resolve(ASTNode* node, Resolver* r) {
             for (int i = 0; i < node->function_call.args_len; i++) {
                 resolve(node->function_call.args[i], r);
             }
-            node->function_call.slot = resolver_lookup(r, node->function_call.name);
-            if (node->function_call.slot == -1) {
-                fprintf(stderr, "undefined function `%s` when trying to call\n", node->function_call.name);
+            binding = resolver_lookup(r, node->function_call.name);
+            if (!binding) {
+                fprintf(stderr, "undefined function `%s` when trying to call\n", symbol_name(node->function_call.name));
                 exit(1);
             }
-            node->var_type = r->types[node->function_call.slot];
+            node->function_call.slot = binding->slot;
+            node->var_type = binding->type;
             break;
         case AST_FUNCTION_DECL:
+            resolver_enter_scope(r);
+            for (int i = 0; i < node->function_decl.params_len; i++) {
+                resolver_declare(r, node->function_decl.params[i].name, node->function_decl.params[i].type);
+            }
             for (int i = 0; i < node->function_decl.stmts_len; i++) {
                 resolve(node->function_decl.stmts[i], r);
             }
+            resolver_exit_scope(r);
             node->function_decl.slot = resolver_declare(r, node->function_decl.name, node->function_decl.return_type);
             node->var_type = node->function_decl.return_type;
             break;
+        case AST_RETURN_STMT:
+            resolve(node->return_stmt.expr, r);
+            break;
     }
 }
 
-void free_resolver(Resolver* r) {
-    for (int i = 0; i < r->count; i++) {
-        free(r->names[i]);
+// applies every scope event up to & including the ones at pos, returns the index of the next one
+static int apply_scope_events(FlatAst* ast, Resolver* r, int next, NodeIndex pos) {
+    while (next < ast->scopes_count && ast->scopes[next].pos <= pos) {
+        FlatScopeEvent* event = &ast->scopes[next++];
+        if (event->open) {
+            resolver_enter_scope(r);
+            for (int i = 0; i < event->params_len; i++) {
+                FunctionParam* param = &ast->params[event->params_start + i];
+                resolver_declare(r, param->name, param->type);
+            }
+        } else {
+            resolver_exit_scope(r);
+        }
     }
-    free(r->names);
+    return next;
+}
 
-    free(r->types);
+void flat_resolve(FlatAst* ast, Resolver* r) {
+    // post order means every node's subtree is resolved before it, in the same order the recursive resolve visits them.
+    // scopes open & close between nodes, as recorded by flat_ast_build
+    int next_event = 0;
+    for (int i = 0; i < ast->count; i++) {
+        next_event = apply_scope_events(ast, r, next_event, i);
+
+        FlatNodeData* data = &ast->data[i];
+        Binding* binding;
+        switch (ast->kinds[i]) {
+            case AST_VAR_DECL:
+                data->var.slot = resolver_declare(r, data->var.name, data->var.type);
+                break;
+            case AST_VAR_ASSIGN:
+            case AST_COMPOUND_ASSIGNMENT:
+                binding = resolver_lookup(r, data->var.name);
+                if (!binding) {
+                    fprintf(stderr, "undefined variable `%s` when trying to reassign\n", symbol_name(data->var.name));
+                    exit(1);
+                }
+                data->var.slot = binding->slot;
+                data->var.type = binding->type;
+                break;
+            case AST_VAR_REF:
+                binding = resolver_lookup(r, data->var.name);
+                if (!binding) {
+                    fprintf(stderr, "undefined variable `%s` when trying to reference\n", symbol_name(data->var.name));
+                    exit(1);
+                }
+                data->var.slot = binding->slot;
+                data->var.type = binding->type;
+                break;
+            case AST_FUNCTION_CALL:
+                binding = resolver_lookup(r, data->var.name);
+                if (!binding) {
+                    fprintf(stderr, "undefined function `%s` when trying to call\n", symbol_name(data->var.name));
+                    exit(1);
+                }
+                data->var.slot = binding->slot;
+                data->var.type = binding->type;
+                break;
+            case AST_FUNCTION_DECL:
+                data->function_decl.slot = resolver_declare(r, data->function_decl.name, data->function_decl.return_type);
+                break;
+            default:
+                break;
+        }
+    }
+    apply_scope_events(ast, r, next_event, ast->count);
+}
+
+void free_resolver(Resolver* r) {
+    free(r->bindings);
+    free(r->visible);
+    free(r->scope_starts);
 
     // r itself is not free'd here as it's intended to be initalized as a stack value and as such will crash if we try to free it
 }
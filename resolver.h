@@ -1,21 +1,51 @@
 #ifndef GRBLANG_RESOLVER_H
 #define GRBLANG_RESOLVER_H
+#include "flat_ast.h"
+#include "interner.h"
 #include "parser.h"
 
 typedef struct {
-    char** names;
-    VarType* types;
+    SymbolId name;
+    VarType type;
+    int slot;
+    // scope depth it was declared at
+    int depth;
+    // index of the binding of the same name this one shadows, -1 if none
+    int shadowed;
+} Binding;
+
+typedef struct {
+    // innermost visible binding for each symbol, -1 if it isn't in scope. symbol ids are dense so they index this directly
+    int* visible;
+    int visible_capacity;
+
+    // every binding in scope, innermost last. leaving a scope pops its bindings & frees their slots for reuse
+    Binding* bindings;
     int count;
     int capacity;
+
+    // bindings count when each open scope was entered
+    int* scope_starts;
+    int depth;
+    int scope_capacity;
+
+    // the most slots live at once, which is how many locals the vm needs
+    int num_locals;
 } Resolver;
 
 void resolver_init(Resolver* r);
 void resolver_resize(Resolver* r);
 
-int resolver_declare(Resolver* r, char* name, VarType type);
-int resolver_lookup(Resolver* r, char* name);
+void resolver_enter_scope(Resolver* r);
+void resolver_exit_scope(Resolver* r);
+
+// returns the slot for the new variable, errors if name is already declared in the current scope
+int resolver_declare(Resolver* r, SymbolId name, VarType type);
+// returns NULL if name isn't in scope. the binding is only valid until the next declare or scope exit
+Binding* resolver_lookup(Resolver* r, SymbolId name);
 
 void resolve(ASTNode* node, Resolver* r);
+void flat_resolve(FlatAst* ast, Resolver* r);
 
 // this can be used after the bytecode generation step as long as the number of locals is stored in a variable for the vm to use, this is reccomended
 void free_resolver(Resolver* r);
@@ -0,0 +1,79 @@
+// for madvise & fdopen, which plain -std=c11 hides
+#define _DEFAULT_SOURCE
+
+#include "source.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool source_open(const char* filename, Source* out) {
+    return source_open_mode(filename, false, out);
+}
+
+bool source_open_mode(const char* filename, bool force_stream, Source* out) {
+    out->data = NULL;
+    out->len = 0;
+    out->stream = NULL;
+    out->mapped = false;
+
+    if (strcmp(filename, "-") == 0) {
+        out->stream = stdin;
+        return true;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open file");
+        return false;
+    }
+
+    struct stat st;
+    if (!force_stream && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        // mmap doesn't accept a length of 0
+        if (st.st_size == 0) {
+            close(fd);
+            out->data = "";
+            return true;
+        }
+
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // the lexer only ever walks forwards through the source
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            close(fd);
+            out->data = data;
+            out->len = st.st_size;
+            out->mapped = true;
+            return true;
+        }
+    }
+
+    // pipes, fifos & anything else mmap won't take get streamed
+    FILE* f = fdopen(fd, "rb");
+    if (!f) {
+        perror("Failed to open file");
+        close(fd);
+        return false;
+    }
+    out->stream = f;
+    return true;
+}
+
+void source_close(Source* src) {
+    if (src->mapped) {
+        munmap((void*) src->data, src->len);
+    }
+    if (src->stream && src->stream != stdin) {
+        fclose(src->stream);
+    }
+
+    src->data = NULL;
+    src->len = 0;
+    src->stream = NULL;
+    src->mapped = false;
+}
@@ -0,0 +1,24 @@
+#ifndef GRBLANG_SOURCE_H
+#define GRBLANG_SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// a script to be compiled, either mmap'd read-only or (for things that can't be mapped like pipes & stdin) left as a stream
+typedef struct {
+    // not nul terminated, NULL if stream is set
+    const char* data;
+    size_t len;
+    // set instead of data when the source couldn't be mapped, should be lexed with lexer_init_stream
+    FILE* stream;
+    bool mapped;
+} Source;
+
+// filename "-" reads from stdin. returns false (after printing why) if the file couldn't be opened
+bool source_open(const char* filename, Source* out);
+// if force_stream is set regular files are streamed rather than mapped, to keep memory bounded on huge inputs
+bool source_open_mode(const char* filename, bool force_stream, Source* out);
+void source_close(Source* src);
+
+#endif //GRBLANG_SOURCE_H
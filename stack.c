@@ -47,10 +47,17 @@ void stack_value_string(StackValue sv, bool simple, char* buffer, size_t bufsize
 }
 
 void stack_init(Stack* s) {
-    int initial_capacity = 128;
-    s->data = malloc(initial_capacity* sizeof(StackValue));
+    stack_init_sized(s, 128);
+}
+
+void stack_init_sized(Stack* s, int capacity) {
+    s->data = malloc((capacity > 0 ? capacity : 1) * sizeof(StackValue));
+    if (!s->data) {
+        fprintf(stderr, "failed to malloc stack arr\n");
+        exit(1);
+    }
     s->top = -1;
-    s->capacity = initial_capacity;
+    s->capacity = capacity;
 }
 
 void stack_push(Stack* s, StackValue val) {
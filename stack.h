@@ -54,6 +54,8 @@ typedef struct {
 } FunctionValue;
 
 void stack_init(Stack* s);
+// room for exactly capacity values, for when the most the stack will hold is known up front
+void stack_init_sized(Stack* s, int capacity);
 void stack_push(Stack* s, StackValue val);
 StackValue stack_pop(Stack* s);
 StackValue stack_peek(Stack* s);
@@ -7,264 +7,274 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-VarType get_expr_type(ASTNode* node, Resolver* r) {
+VarType binary_op_type(TokenType op, VarType left, VarType right) {
     VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
     VarType int_type = {.base_type = VALUE_INT, .nested = -1};
     VarType bool_type = {.base_type = VALUE_BOOL, .nested = -1};
     VarType string_type = {.base_type = VALUE_STRING, .nested = -1};
-    if (!node) return unknown_type;
 
-    switch (node->type) {
-        case AST_INT:
+    if (left.nested != -1) {
+        return left;
+    }
+    BaseType left_type = left.base_type;
+    BaseType right_type = right.base_type;
+    if (op == TOK_PLUS) {
+        if (left_type == VALUE_INT && right_type == VALUE_INT) {
             return int_type;
-        case AST_BOOL:
-            return bool_type;
-        case AST_STRING:
+        } else if (left_type == VALUE_STRING && right_type == VALUE_STRING) {
             return string_type;
-        case AST_ARRAY:
-            if (node->array_literal.len == 0) {
-                return unknown_type;
-            }
-            VarType first_elem_type = get_expr_type(node->array_literal.arr[0], r);
-            for (int i = 1; i < node->array_literal.len; i++) {
-                VarType elem_type = get_expr_type(node->array_literal.arr[0], r);
-                if (elem_type.base_type != first_elem_type.base_type || elem_type.nested != first_elem_type.nested) {
-                    fprintf(stderr, "error: array elements must be of the same type\n");
-                    exit(1);
-                }
-            }
+        }
+    }
 
-            VarType array_type = first_elem_type;
-            array_type.nested++;
-            return array_type;
-        case AST_BINARY_OP: {
-            TokenType op = node->binary_op.op;
-            VarType left_var_type = get_expr_type(node->binary_op.left, r);
-            if (left_var_type.nested != -1) {
-                return left_var_type;
-            }
-            BaseType left_type = left_var_type.base_type;
-            BaseType right_type = get_expr_type(node->binary_op.right, r).base_type;
-            if (op == TOK_PLUS) {
-                if (left_type == VALUE_INT && right_type == VALUE_INT) {
-                    return int_type;
-                } else if (left_type == VALUE_STRING && right_type == VALUE_STRING) {
-                    return string_type;
-                }
-            }
+    if (op == TOK_MINUS || op == TOK_MULT || op == TOK_DIV || op == TOK_MODULO) {
+        return int_type;
+    } else if (op == TOK_LESS || op == TOK_GREATER || op == TOK_EQUALS || op == TOK_NOT_EQUALS || op == TOK_GREATER_EQUALS || op == TOK_LESS_EQUALS || op == TOK_AND || op == TOK_OR) {
+        return bool_type;
+    }
+    return unknown_type;
+}
+
+VarType unary_op_type(TokenType op) {
+    VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+    VarType int_type = {.base_type = VALUE_INT, .nested = -1};
+    VarType bool_type = {.base_type = VALUE_BOOL, .nested = -1};
+
+    if (op == TOK_MINUS) {
+        return int_type;
+    } else if (op == TOK_EXCLAM) {
+        return bool_type;
+    }
+    return unknown_type;
+}
 
-            if (op == TOK_MINUS || op == TOK_MULT || op == TOK_DIV || op == TOK_MODULO) {
-                return int_type;
-            } else if (op == TOK_LESS || op == TOK_GREATER || op == TOK_EQUALS || op == TOK_NOT_EQUALS || op == TOK_GREATER_EQUALS || op == TOK_LESS_EQUALS || op == TOK_AND || op == TOK_OR) {
-                return bool_type;
+void check_binary_op(TokenType op, VarType left_var_type, VarType right_var_type) {
+    if ((left_var_type.nested != -1 && op == TOK_PLUS) && // is array
+        right_var_type.nested != (left_var_type.nested - 1) || // rhs nested correct
+        right_var_type.base_type != left_var_type.base_type // rhs base correct
+    ) {
+        printf("%d, %d\n", right_var_type.nested, left_var_type.nested - 1);
+        fprintf(stderr, "invalid rhs type %s(nested=%d) for array of type %s(nested=%d) in binop append\n", base_type_string(right_var_type.base_type), right_var_type.nested, base_type_string(left_var_type.base_type), left_var_type.nested);
+        exit(1);
+    }
+    if ((left_var_type.nested != -1 || right_var_type.nested != -1) && op != TOK_PLUS) {
+        fprintf(stderr, "binary operation %s not allowed on array", op_string(op));
+        exit(1);
+    }
+    BaseType left_type = left_var_type.base_type;
+    BaseType right_type = right_var_type.base_type;
+    switch (op) {
+        case TOK_MINUS:
+        case TOK_MULT:
+        case TOK_DIV:
+        case TOK_LESS:
+        case TOK_LESS_EQUALS:
+        case TOK_GREATER:
+        case TOK_GREATER_EQUALS:
+        case TOK_MODULO:
+            if (left_type != VALUE_INT || right_type != VALUE_INT) {
+                fprintf(stderr, "error: cannot use %s operator on %s and %s\n",
+                    op_string(op),
+                    base_type_string(left_type),
+                    base_type_string(right_type)
+                );
+                exit(1);
             }
-            return unknown_type;
-        }
-        case AST_UNARY_OP: {
-            TokenType op = node->unary_op.op;
-            if (op == TOK_MINUS) {
-                return int_type;
-            } else if (op == TOK_EXCLAM) {
-                return bool_type;
+            break;
+        case TOK_PLUS:
+            if (
+                (left_type != VALUE_INT || right_type != VALUE_INT) &&
+                (left_type != VALUE_STRING || right_type != VALUE_STRING)
+            ) {
+                fprintf(stderr, "error: cannot use %s operator on %s and %s\n",
+                    op_string(op),
+                    base_type_string(left_type),
+                    base_type_string(right_type)
+                );
+                exit(1);
             }
-            return unknown_type;
-        }
-        case AST_VAR_REF: {
-            int slot = resolver_lookup(r, node->var_ref.name);
-            if (slot == -1) {
-                return unknown_type;
-            } else {
-                return r->types[slot];
+            break;
+        case TOK_NOT_EQUALS:
+        case TOK_EQUALS:
+            if (
+                (left_type != VALUE_BOOL || right_type != VALUE_BOOL) &&
+                (left_type != VALUE_INT || right_type != VALUE_INT)
+            ) {
+                fprintf(stderr, "error: cannot use %s operator on %s and %s\n",
+                    op_string(op),
+                    base_type_string(left_type),
+                    base_type_string(right_type)
+                );
+                exit(1);
             }
-        }
-        case AST_ARRAY_INDEX: {
-            VarType array_type = get_expr_type(node->array_index.array_expr, r);
-
-            if (array_type.nested < 0) {
-                return unknown_type;
+            break;
+        case TOK_AND:
+        case TOK_OR:
+            if (left_type != VALUE_BOOL || right_type != VALUE_BOOL) {
+                fprintf(stderr, "error: cannot use %s operator on %s and %s\n",
+                    op_string(op),
+                    base_type_string(left_type),
+                    base_type_string(right_type)
+                );
+                exit(1);
             }
-            array_type.nested--;
-            return array_type;
-        }
+
         default:
-            return unknown_type;
+            break;
+    }
+}
+
+void check_unary_op(TokenType op, VarType right_var_type) {
+    if (right_var_type.nested != -1) {
+        fprintf(stderr, "unary operation %s not allowed on array", op_string(op));
+        exit(1);
+    }
+    BaseType right_type = right_var_type.base_type;
+
+    if (op == TOK_EXCLAM && right_type != VALUE_BOOL) {
+        fprintf(stderr, "error: cannot use ! operator on %s\n",
+            base_type_string(right_type)
+        );
+        exit(1);
+    } else if (op == TOK_MINUS && right_type != VALUE_INT) {
+        fprintf(stderr, "error: cannot use unary - operator on %s\n",
+            base_type_string(right_type)
+        );
+        exit(1);
+    }
+}
+
+void check_assign_type(VarType var_type, VarType value_type, SymbolId name, bool declaration) {
+    if (var_type.base_type != value_type.base_type || var_type.nested != value_type.nested) {
+        char value_buffer[50];
+        char var_buffer[50];
+        var_type_string(value_type, value_buffer);
+        var_type_string(var_type, var_buffer);
+        fprintf(stderr, declaration ? "error: cannot assign %s to variable `%s` that was explicitly declared as type %s\n" : "error: cannot assign %s to variable `%s` of type %s\n",
+            value_buffer,
+            symbol_name(name),
+            var_buffer
+        );
+        exit(1);
+    }
+}
+
+void check_condition_type(VarType condition_type, const char* stmt) {
+    if (condition_type.base_type != VALUE_BOOL || condition_type.nested != -1) {
+        fprintf(stderr, "error: cannot use a non-bool as %s condition\n", stmt);
+        exit(1);
+    }
+}
+
+void check_array_index(ASTNodeType array_kind, VarType index_type) {
+    if (array_kind != AST_VAR_REF && array_kind != AST_ARRAY_INDEX) {
+        fprintf(stderr, "error: array expression in array index node must be either variable reference or array index\n");
+        exit(1);
+    }
+
+    if (index_type.base_type != VALUE_INT || index_type.nested != -1) {
+        fprintf(stderr, "error: index expression in array index node must be integer\n");
+        exit(1);
+    }
+}
+
+void check_index_assign_type(VarType type, VarType value_type) {
+    if (value_type.base_type != type.base_type || value_type.nested != type.nested) {
+        char value_buffer[50];
+        char type_buffer[50];
+        var_type_string(value_type, value_buffer);
+        var_type_string(type, type_buffer);
+        fprintf(stderr, "error: cannot assign %s via array index to value of type %s\n",
+            value_buffer,
+            type_buffer
+        );
+        exit(1);
     }
 }
 
 void type_check(ASTNode *node, Resolver* r) {
+    VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+    VarType int_type = {.base_type = VALUE_INT, .nested = -1};
+    VarType bool_type = {.base_type = VALUE_BOOL, .nested = -1};
+    VarType string_type = {.base_type = VALUE_STRING, .nested = -1};
     if (!node) return;
 
+    // children are checked first & every expression caches its type in var_type, so checking (& later emitting) never has
+    // to walk back down a subtree to find out its type. var_type on statements keeps the type of the variable they assign
     switch (node->type) {
-    case AST_BINARY_OP: {
-        type_check(node->binary_op.left, r);
-        type_check(node->binary_op.right, r);
-
-        VarType left_var_type = get_expr_type(node->binary_op.left, r);
-        VarType right_var_type = get_expr_type(node->binary_op.right, r);
-        if ((left_var_type.nested != -1 && node->binary_op.op == TOK_PLUS) && // is array
-            right_var_type.nested != (left_var_type.nested - 1) || // rhs nested correct
-            right_var_type.base_type != left_var_type.base_type // rhs base correct
-        ) {
-            printf("%d, %d\n", right_var_type.nested, left_var_type.nested - 1);
-            fprintf(stderr, "invalid rhs type %s(nested=%d) for array of type %s(nested=%d) in binop append\n", base_type_string(right_var_type.base_type), right_var_type.nested, base_type_string(left_var_type.base_type), left_var_type.nested);
-            exit(1);
+    case AST_INT:
+        node->var_type = int_type;
+        break;
+    case AST_BOOL:
+        node->var_type = bool_type;
+        break;
+    case AST_STRING:
+        node->var_type = string_type;
+        break;
+    case AST_ARRAY: {
+        node->var_type = unknown_type;
+        if (node->array_literal.len == 0) {
+            break;
         }
-        if ((left_var_type.nested != -1 || right_var_type.nested != -1) && node->binary_op.op != TOK_PLUS) {
-            fprintf(stderr, "binary operation %s not allowed on array", op_string(node->binary_op.op));
-            exit(1);
+        for (int i = 0; i < node->array_literal.len; i++) {
+            type_check(node->array_literal.arr[i], r);
         }
-        BaseType left_type = get_expr_type(node->binary_op.left, r).base_type;
-        BaseType right_type = get_expr_type(node->binary_op.right, r).base_type;
-        switch (node->binary_op.op) {
-            case TOK_MINUS:
-            case TOK_MULT:
-            case TOK_DIV:
-            case TOK_LESS:
-            case TOK_LESS_EQUALS:
-            case TOK_GREATER:
-            case TOK_GREATER_EQUALS:
-            case TOK_MODULO:
-                if (left_type != VALUE_INT || right_type != VALUE_INT) {
-                    fprintf(stderr, "error: cannot use %s operator on %s and %s\n",
-                        op_string(node->binary_op.op),
-                        base_type_string(left_type),
-                        base_type_string(right_type)
-                    );
-                    exit(1);
-                }
-                break;
-            case TOK_PLUS:
-                if (
-                    (left_type != VALUE_INT || right_type != VALUE_INT) &&
-                    (left_type != VALUE_STRING || right_type != VALUE_STRING)
-                ) {
-                    fprintf(stderr, "error: cannot use %s operator on %s and %s\n",
-                        op_string(node->binary_op.op),
-                        base_type_string(left_type),
-                        base_type_string(right_type)
-                    );
-                    exit(1);
-                }
-                break;
-            case TOK_NOT_EQUALS:
-            case TOK_EQUALS:
-                if (
-                    (left_type != VALUE_BOOL || right_type != VALUE_BOOL) &&
-                    (left_type != VALUE_INT || right_type != VALUE_INT)
-                ) {
-                    fprintf(stderr, "error: cannot use %s operator on %s and %s\n",
-                        op_string(node->binary_op.op),
-                        base_type_string(left_type),
-                        base_type_string(right_type)
-                    );
-                    exit(1);
-                }
-                break;
-            case TOK_AND:
-            case TOK_OR:
-                if (left_type != VALUE_BOOL || right_type != VALUE_BOOL) {
-                    fprintf(stderr, "error: cannot use %s operator on %s and %s\n",
-                        op_string(node->binary_op.op),
-                        base_type_string(left_type),
-                        base_type_string(right_type)
-                    );
-                    exit(1);
-                }
 
-            default:
-                break;
+        VarType first_elem_type = node->array_literal.arr[0]->var_type;
+        for (int i = 1; i < node->array_literal.len; i++) {
+            VarType elem_type = node->array_literal.arr[i]->var_type;
+            if (elem_type.base_type != first_elem_type.base_type || elem_type.nested != first_elem_type.nested) {
+                fprintf(stderr, "error: array elements must be of the same type\n");
+                exit(1);
+            }
         }
+
+        node->var_type = first_elem_type;
+        node->var_type.nested++;
+        break;
+    }
+    case AST_BINARY_OP: {
+        type_check(node->binary_op.left, r);
+        type_check(node->binary_op.right, r);
+
+        VarType left = node->binary_op.left->var_type;
+        VarType right = node->binary_op.right->var_type;
+        check_binary_op(node->binary_op.op, left, right);
+        node->var_type = binary_op_type(node->binary_op.op, left, right);
         break;
     }
     case AST_UNARY_OP: {
         type_check(node->unary_op.right, r);
-        VarType right_var_type = get_expr_type(node->unary_op.right, r);
-        if (right_var_type.nested != -1) {
-            fprintf(stderr, "unary operation %s not allowed on array", op_string(node->binary_op.op));
-            exit(1);
-        }
-        BaseType right_type = right_var_type.base_type;
-
-        if (node->unary_op.op == TOK_EXCLAM && right_type != VALUE_BOOL) {
-            fprintf(stderr, "error: cannot use ! operator on %s\n",
-                base_type_string(right_type)
-            );
-            exit(1);
-        } else if (node->unary_op.op == TOK_MINUS && right_type != VALUE_INT) {
-            fprintf(stderr, "error: cannot use unary - operator on %s\n",
-                base_type_string(right_type)
-            );
-            exit(1);
-        }
+        check_unary_op(node->unary_op.op, node->unary_op.right->var_type);
+        node->var_type = unary_op_type(node->unary_op.op);
         break;
     }
+    case AST_VAR_REF:
+        // already set by the resolver
+        break;
+    case AST_FUNCTION_CALL:
+        // the emitter can't call functions yet, so calls can't be used as values
+        node->var_type = unknown_type;
+        break;
     case AST_PROGRAM:
         for (int i = 0; i < node->program.count; i++) {
             type_check(node->program.statements[i], r);
         }
         break;
-    case AST_VAR_DECL: {
+    case AST_VAR_DECL:
         type_check(node->var_decl.value, r);
-        VarType var_type = node->var_type;
-        VarType value_type = get_expr_type(node->var_decl.value, r);
-        if (var_type.base_type != value_type.base_type || var_type.nested != value_type.nested) {
-            char value_buffer[50];
-            char var_buffer[50];
-            var_type_string(value_type, value_buffer);
-            var_type_string(var_type, var_buffer);
-            fprintf(stderr, "error: cannot assign %s to variable `%s` that was explicitly declared as type %s\n",
-                value_buffer,
-                node->var_decl.name,
-                var_buffer
-            );
-            exit(1);
-        }
+        check_assign_type(node->var_type, node->var_decl.value->var_type, node->var_decl.name, true);
         break;
-    }
-    case AST_VAR_ASSIGN: {
+    case AST_VAR_ASSIGN:
         type_check(node->var_assign.value, r);
-        VarType var_type = node->var_type;
-        VarType value_type = get_expr_type(node->var_assign.value, r);
-        if (var_type.base_type != value_type.base_type || var_type.nested != value_type.nested) {
-            char value_buffer[50];
-            char var_buffer[50];
-            var_type_string(value_type, value_buffer);
-            var_type_string(var_type, var_buffer);
-            fprintf(stderr, "error: cannot assign %s to variable `%s` of type %s\n",
-                value_buffer,
-                node->var_assign.name,
-                var_buffer
-            );
-            exit(1);
-        }
+        check_assign_type(node->var_type, node->var_assign.value->var_type, node->var_assign.name, false);
         break;
-    }
-    case AST_COMPOUND_ASSIGNMENT: {
+    case AST_COMPOUND_ASSIGNMENT:
         type_check(node->compound_assignment.value, r);
-        VarType var_type = node->var_type;
-        VarType value_type = get_expr_type(node->compound_assignment.value, r);
-        if (var_type.base_type != value_type.base_type || var_type.nested != value_type.nested) {
-            char value_buffer[50];
-            char var_buffer[50];
-            var_type_string(value_type, value_buffer);
-            var_type_string(var_type, var_buffer);
-            fprintf(stderr, "error: cannot assign %s to variable `%s` of type %s\n",
-                value_buffer,
-                node->compound_assignment.name,
-                var_buffer
-            );
-            exit(1);
-        }
+        check_assign_type(node->var_type, node->compound_assignment.value->var_type, node->compound_assignment.name, false);
         break;
-    }
     case AST_IF: {
         type_check(node->if_stmt.condition, r);
-        VarType condition_type = get_expr_type(node->if_stmt.condition, r);
-
-        if (condition_type.base_type != VALUE_BOOL || condition_type.nested != -1) {
-            fprintf(stderr, "error: cannot use a non-bool as if condition\n");
-            exit(1);
-        }
+        check_condition_type(node->if_stmt.condition->var_type, "if");
 
         for (int i = 0; i < node->if_stmt.success_count; i++) {
             type_check(node->if_stmt.success_statements[i], r);
@@ -280,12 +290,7 @@ void type_check(ASTNode *node, Resolver* r) {
     }
     case AST_WHILE: {
         type_check(node->while_stmt.condition, r);
-        VarType condition_type = get_expr_type(node->while_stmt.condition, r);
-
-        if (condition_type.base_type != VALUE_BOOL || condition_type.nested != -1) {
-            fprintf(stderr, "error: cannot use a non-bool as while condition\n");
-            exit(1);
-        }
+        check_condition_type(node->while_stmt.condition->var_type, "while");
 
         for (int i = 0; i < node->while_stmt.statements_count; i++) {
             type_check(node->while_stmt.statements[i], r);
@@ -294,37 +299,105 @@ void type_check(ASTNode *node, Resolver* r) {
     }
     case AST_ARRAY_INDEX: {
         type_check(node->array_index.array_expr, r);
-        if (node->array_index.array_expr->type != AST_VAR_REF && node->array_index.array_expr->type != AST_ARRAY_INDEX) {
-            fprintf(stderr, "error: array expression in array index node must be either variable reference or array index\n");
-            exit(1);
-        }
+        type_check(node->array_index.index_expr, r);
+        check_array_index(node->array_index.array_expr->type, node->array_index.index_expr->var_type);
 
-        VarType index_expr = get_expr_type(node->array_index.index_expr, r);
-        if (index_expr.base_type != VALUE_INT || index_expr.nested != -1) {
-            fprintf(stderr, "error: index expression in array index node must be integer\n");
-            exit(1);
+        node->var_type = node->array_index.array_expr->var_type;
+        if (node->var_type.nested < 0) {
+            node->var_type = unknown_type;
+        } else {
+            node->var_type.nested--;
         }
         break;
     }
     case AST_ARRAY_INDEX_ASSIGN: {
         type_check(node->array_assign_expr.arr_index_expr, r);
-        VarType type = get_expr_type(node->array_assign_expr.arr_index_expr, r);
-
-        VarType value_type = get_expr_type(node->array_assign_expr.value, r);
-        if (value_type.base_type != type.base_type || value_type.nested != type.nested) {
-            char value_buffer[50];
-            char type_buffer[50];
-            var_type_string(value_type, value_buffer);
-            var_type_string(type, type_buffer);
-            fprintf(stderr, "error: cannot assign %s via array index to value of type %s\n",
-                value_buffer,
-                type_buffer
-            );
-            exit(1);
-        }
+        type_check(node->array_assign_expr.value, r);
+        check_index_assign_type(node->array_assign_expr.arr_index_expr->var_type, node->array_assign_expr.value->var_type);
+        // only usable as a statement
+        node->var_type = unknown_type;
         break;
     }
     default:
         break;
     }
 }
+
+void flat_type_check(FlatAst* ast, Resolver* r) {
+    VarType int_type = {.base_type = VALUE_INT, .nested = -1};
+    VarType bool_type = {.base_type = VALUE_BOOL, .nested = -1};
+    VarType string_type = {.base_type = VALUE_STRING, .nested = -1};
+
+    // children come before their parents, so their types are always known by the time a node is reached
+    VarType* types = ast->types;
+    for (NodeIndex i = 0; i < (NodeIndex) ast->count; i++) {
+        FlatNodeData* data = &ast->data[i];
+        switch (ast->kinds[i]) {
+            case AST_INT:
+                types[i] = int_type;
+                break;
+            case AST_BOOL:
+                types[i] = bool_type;
+                break;
+            case AST_STRING:
+                types[i] = string_type;
+                break;
+            case AST_ARRAY: {
+                uint32_t len = ast->child_count[i];
+                if (len == 0) {
+                    break;
+                }
+                VarType first_elem_type = types[flat_child(ast, i, 0)];
+                for (uint32_t j = 1; j < len; j++) {
+                    VarType elem_type = types[flat_child(ast, i, j)];
+                    if (elem_type.base_type != first_elem_type.base_type || elem_type.nested != first_elem_type.nested) {
+                        fprintf(stderr, "error: array elements must be of the same type\n");
+                        exit(1);
+                    }
+                }
+                types[i] = first_elem_type;
+                types[i].nested++;
+                break;
+            }
+            case AST_BINARY_OP: {
+                VarType left = types[flat_child(ast, i, 0)];
+                VarType right = types[flat_child(ast, i, 1)];
+                check_binary_op(data->op, left, right);
+                types[i] = binary_op_type(data->op, left, right);
+                break;
+            }
+            case AST_UNARY_OP:
+                check_unary_op(data->op, types[flat_child(ast, i, 0)]);
+                types[i] = unary_op_type(data->op);
+                break;
+            case AST_VAR_REF:
+                types[i] = data->var.type;
+                break;
+            case AST_VAR_DECL:
+            case AST_VAR_ASSIGN:
+            case AST_COMPOUND_ASSIGNMENT:
+                check_assign_type(data->var.type, types[flat_child(ast, i, 0)], data->var.name, ast->kinds[i] == AST_VAR_DECL);
+                break;
+            case AST_IF:
+                check_condition_type(types[flat_child(ast, i, 0)], "if");
+                break;
+            case AST_WHILE:
+                check_condition_type(types[flat_child(ast, i, 0)], "while");
+                break;
+            case AST_ARRAY_INDEX: {
+                NodeIndex array_expr = flat_child(ast, i, 0);
+                check_array_index(ast->kinds[array_expr], types[flat_child(ast, i, 1)]);
+                if (types[array_expr].nested >= 0) {
+                    types[i] = types[array_expr];
+                    types[i].nested--;
+                }
+                break;
+            }
+            case AST_ARRAY_INDEX_ASSIGN:
+                check_index_assign_type(types[flat_child(ast, i, 0)], types[flat_child(ast, i, 1)]);
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -1,10 +1,25 @@
 #ifndef GRBLANG_TYPE_CHECKER_H
 #define GRBLANG_TYPE_CHECKER_H
 
+#include "flat_ast.h"
 #include "parser.h"
 #include "resolver.h"
 
-VarType get_expr_type(ASTNode* node, Resolver* r);
+VarType binary_op_type(TokenType op, VarType left, VarType right);
+VarType unary_op_type(TokenType op);
+
+// shared between the tree & flat checkers, these exit with an error if the check fails
+void check_binary_op(TokenType op, VarType left_var_type, VarType right_var_type);
+void check_unary_op(TokenType op, VarType right_var_type);
+// declaration only changes the error message
+void check_assign_type(VarType var_type, VarType value_type, SymbolId name, bool declaration);
+// stmt is "if"/"while", for the error message
+void check_condition_type(VarType condition_type, const char* stmt);
+void check_array_index(ASTNodeType array_kind, VarType index_type);
+void check_index_assign_type(VarType type, VarType value_type);
+
+// also fills in var_type on every expression node, which the emitter relies on
 void type_check(ASTNode *node, Resolver* r);
+void flat_type_check(FlatAst* ast, Resolver* r);
 
 #endif
@@ -1,5 +1,6 @@
 #include "vm.h"
 #include "bytecode_emit.h"
+#include "bytecode_opt.h"
 #include "lexer.h"
 #include "parser.h"
 #include "stack.h"
@@ -13,8 +14,189 @@
 #include <string.h>
 #include <sys/types.h>
 
-void vm_init(VM *vm, BytecodeEmitter *b, int num_locals) {
-    stack_init(&vm->stack);
+// direct threading on compilers with labels as values: every handler jumps straight to the next one's through
+// dispatch_table, rather than all of them going back to one shared switch
+#if defined(GRBLANG_THREADED_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+#define VM_THREADED_DISPATCH
+#endif
+
+#ifdef VM_THREADED_DISPATCH
+#define VM_CASE(op) case op: label_##op:
+#define VM_DISPATCH() do { \
+        instr = ip++; \
+        vm->instruction_count++; \
+        goto *instr->handler; \
+    } while (0)
+#define VM_NEXT() VM_DISPATCH()
+#else
+#define VM_CASE(op) case op:
+#define VM_NEXT() break
+#endif
+
+const char* vm_dispatch_name(void) {
+#ifdef VM_THREADED_DISPATCH
+    return "threaded";
+#else
+    return "switch";
+#endif
+}
+
+static bool holds_reference(StackValue value) {
+    return value.type.nested != -1 || value.type.base_type == VALUE_STRING;
+}
+
+// the reference counting stack_push & stack_pop do, for the values on the stack that are strings or arrays
+static inline StackValue retain_value(StackValue value) {
+    if (value.type.nested != -1) {
+        increment_ref_arr(value.array_val);
+    } else if (value.type.base_type == VALUE_STRING) {
+        increment_ref(value.string_val);
+    }
+    return value;
+}
+
+static inline StackValue release_value(StackValue value) {
+    if (value.type.nested != -1) {
+        decrement_ref_arr(value.array_val);
+    } else if (value.type.base_type == VALUE_STRING) {
+        decrement_ref(value.string_val);
+    }
+    return value;
+}
+
+// vm_init sized the stack for the most values the verifier found it can hold, so sp is never checked. the plain ones
+// are for ints & bools, the _REF ones count references like stack_push & stack_pop
+#define PUSH(value) (*sp++ = (value))
+#define POP() (*--sp)
+#define PEEK() (sp[-1])
+#define PUSH_REF(value) (*sp++ = retain_value(value))
+#define POP_REF() release_value(*--sp)
+
+// drops the reference a local holds on a string. slots are reused between scopes, so whatever was stored last may be
+// of any type
+static void release_local(StackValue* local) {
+    if (local->type.base_type == VALUE_STRING && local->type.nested == -1) {
+        decrement_ref(local->string_val);
+    }
+}
+
+static bool is_slot_op(uint8_t op) {
+    switch (op) {
+        case OP_ISTORE:
+        case OP_ILOAD:
+        case OP_BSTORE:
+        case OP_BLOAD:
+        case OP_ARRSTORE:
+        case OP_ARRLOAD:
+        case OP_SSTORE:
+        case OP_SLOAD:
+        case OP_ISTORE_KEEP:
+        case OP_IADDSTORE:
+        case OP_ISUBSTORE:
+        case OP_IMULSTORE:
+        case OP_IDIVSTORE:
+        case OP_IINC:
+        case OP_ILOAD_ILOAD_IADD:
+        case OP_ILOAD_PUSH_ILT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool is_const_op(uint8_t op) {
+    return op == OP_PUSH || op == OP_PUSH_STRING || op == OP_PUSH_W || op == OP_PUSH_STRING_W;
+}
+
+// the operands of bytecode that doesn't come from the emitter could be anything, so they're checked once here instead
+// of on every run of the instruction
+static void check_operands(VM* vm, VmInstr* instr, int offset) {
+    if (is_slot_op(instr->op)) {
+        int slot = instr->op == OP_ILOAD_ILOAD_IADD && instr->b > instr->a ? instr->b : instr->a;
+        if (slot >= vm->locals_size) {
+            fprintf(stderr, "invalid slot `%d` for locals at byte %d\n", slot, offset);
+            exit(1);
+        }
+    } else if (is_const_op(instr->op) && instr->a >= vm->constants_size) {
+        fprintf(stderr, "invalid constant `%d` at byte %d\n", instr->a, offset);
+        exit(1);
+    } else if (is_const_op(instr->op) && holds_reference(vm->constants[instr->a]) != (instr->op == OP_PUSH_STRING || instr->op == OP_PUSH_STRING_W)) {
+        // OP_PUSH doesn't count references, so it can't be pushing a string
+        fprintf(stderr, "invalid constant `%d` for opcode %d at byte %d\n", instr->a, instr->op, offset);
+        exit(1);
+    } else if (instr->op >= OP_HALT) {
+        fprintf(stderr, "unknown opcode: %d at byte %d\n", instr->op, offset);
+        exit(1);
+    }
+}
+
+// every path has to reach an instruction with the same number of values on the stack & none pops more than there
+// are, which is what lets vm_run push & pop without checking. returns the most values the stack holds
+static int verify_stack(VM* vm) {
+    int* depths = malloc(sizeof(int) * (vm->instr_count + 1));
+    // each instruction is queued once, when its depth is first known
+    int* worklist = malloc(sizeof(int) * (vm->instr_count + 1));
+    if (!depths || !worklist) {
+        fprintf(stderr, "failed to malloc stack depths\n");
+        exit(1);
+    }
+    for (int i = 0; i <= vm->instr_count; i++) {
+        depths[i] = -1;
+    }
+
+    int max_depth = 0;
+    int queued = 0;
+    depths[0] = 0;
+    worklist[queued++] = 0;
+    while (queued > 0) {
+        int i = worklist[--queued];
+        VmInstr* instr = &vm->instrs[i];
+        int pops, pushes;
+        bytecode_stack_effect(instr->op, instr->a, &pops, &pushes);
+        if (depths[i] < pops) {
+            fprintf(stderr, "stack underflow at byte %d\n", vm->offsets[i]);
+            exit(1);
+        }
+        int depth = depths[i] - pops + pushes;
+        if (depth > max_depth) {
+            max_depth = depth;
+        }
+        if (instr->op == OP_HALT) continue;
+
+        int succs[2];
+        int succ_count = 0;
+        if (instr->op != OP_JMP) {
+            succs[succ_count++] = i + 1;
+        }
+        if (bytecode_is_jump(instr->op)) {
+            succs[succ_count++] = instr->a;
+        }
+        for (int s = 0; s < succ_count; s++) {
+            int succ = succs[s];
+            if (depths[succ] == -1) {
+                depths[succ] = depth;
+                worklist[queued++] = succ;
+            } else if (depths[succ] != depth) {
+                fprintf(stderr, "stack depths %d & %d meet at byte %d\n", depths[succ], depth, vm->offsets[succ]);
+                exit(1);
+            }
+        }
+    }
+    free(depths);
+    free(worklist);
+    return max_depth;
+}
+
+// checks the decoded instructions once so vm_run doesn't have to, then sizes the stack for them
+static void verify(VM* vm) {
+    for (int i = 0; i < vm->instr_count; i++) {
+        check_operands(vm, &vm->instrs[i], vm->offsets[i]);
+    }
+    stack_init_sized(&vm->stack, verify_stack(vm));
+}
+
+// everything but the instructions, which are left for the caller to decode into the count + 1 entries of instrs
+static void vm_init_common(VM* vm, BytecodeEmitter* b, int num_locals, int count) {
     vm->constants = b->constants;
     vm->constants_size = b->const_count;
     vm->code = b->code;
@@ -22,45 +204,228 @@ void vm_init(VM *vm, BytecodeEmitter *b, int num_locals) {
 
     vm->locals_size = num_locals;
     vm->locals = malloc(num_locals * sizeof(StackValue));
+    VarType unknown_type = {.base_type = VALUE_UNKNOWN, .nested = -1};
+    for (int i = 0; i < num_locals; i++) {
+        vm->locals[i].type = unknown_type;
+    }
+    vm->result.type = unknown_type;
+
+    // the halt after the last instruction is where jumps to the end of the code land
+    vm->instrs = malloc(sizeof(VmInstr) * (count + 1));
+    vm->offsets = malloc(sizeof(int) * (count + 1));
+    if (!vm->instrs || !vm->offsets) {
+        fprintf(stderr, "failed to malloc vm instructions\n");
+        exit(1);
+    }
+    vm->instrs[count] = (VmInstr) {.handler = NULL, .op = OP_HALT, .a = 0, .b = 0};
+    vm->instr_count = count;
 
     vm->pc = 0;
+    vm->instruction_count = 0;
+}
+
+void vm_init(VM *vm, BytecodeEmitter *b, int num_locals) {
+    // operands are decoded once here, with every jump resolved to the index of the instruction it lands on
+    int count;
+    DecodedInstr* decoded = bytecode_decode(b, &count);
+    vm_init_common(vm, b, num_locals, count);
+    for (int i = 0; i < count; i++) {
+        VmInstr* instr = &vm->instrs[i];
+        instr->handler = NULL;
+        instr->op = decoded[i].op;
+        instr->a = decoded[i].target != -1 ? decoded[i].target : decoded[i].a;
+        instr->b = decoded[i].b;
+        vm->offsets[i] = decoded[i].offset;
+    }
+    vm->offsets[count] = b->code_size;
+    free(decoded);
+    verify(vm);
+}
+
+void vm_init_words(VM* vm, BytecodeEmitter* b, const uint32_t* words, int count, int num_locals) {
+    // every instruction is one aligned word, so its index is its word's & jumps resolve without a table
+    vm_init_common(vm, b, num_locals, count);
+    for (int i = 0; i < count; i++) {
+        uint32_t w = words[i];
+        VmInstr* instr = &vm->instrs[i];
+        instr->handler = NULL;
+        instr->op = WORD_OP(w);
+        instr->a = WORD_A(w);
+        instr->b = 0;
+        vm->offsets[i] = i * 4;
+        if (instr->op >= OP_HALT || bytecode_operand_format(instr->op) == OPERAND_JUMP_W) {
+            fprintf(stderr, "unknown opcode: %d at byte %d\n", instr->op, i * 4);
+            exit(1);
+        }
+
+        switch (bytecode_operand_format(instr->op)) {
+            case OPERAND_JUMP:
+                instr->a = i + 1 + WORD_SIGNED_A(w);
+                if (instr->a < 0 || instr->a > count) {
+                    fprintf(stderr, "invalid jump from byte %d to word %d\n", i * 4, instr->a);
+                    exit(1);
+                }
+                break;
+            case OPERAND_I8:
+            case OPERAND_I16:
+                instr->a = WORD_SIGNED_A(w);
+                break;
+            case OPERAND_U16_I8:
+            case OPERAND_U16_I16:
+                instr->a = WORD_AB_A(w);
+                instr->b = WORD_AB_SIGNED_B(w);
+                break;
+            case OPERAND_U16_U16:
+                instr->a = WORD_AB_A(w);
+                instr->b = WORD_AB_B(w);
+                break;
+            default:
+                break;
+        }
+    }
+    vm->offsets[count] = count * 4;
+    verify(vm);
 }
 
 void vm_run(VM* vm) {
     VarType int_type = {.base_type = VALUE_INT, .nested = -1};
     VarType bool_type = {.base_type = VALUE_BOOL, .nested = -1};
     VarType string_type = {.base_type = VALUE_STRING, .nested = -1};
-    while (vm->pc < vm->code_size) {
-        uint8_t instruction = vm->code[vm->pc++];
-
-        switch (instruction) {
-            case OP_PUSH: {
-                uint16_t idx = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
-                StackValue value = vm->constants[idx];
-                stack_push(&vm->stack, value);
-                break;
-            }
-            case OP_PUSH_STRING: {
-                uint16_t idx = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
-                StackValue value = vm->constants[idx];
-                stack_push(&vm->stack, value);
-                break;
-            }
-            case OP_PUSH_TRUE: {
+    VmInstr* ip = vm->instrs + vm->pc;
+    VmInstr* instr;
+    // the next free slot of the stack, only written back to it once vm_run returns
+    StackValue* sp = vm->stack.data + vm->stack.top + 1;
+#ifdef VM_THREADED_DISPATCH
+    // vm_init already rejected unknown opcodes, & wide jumps decode as the short ones
+    static void* dispatch_table[OP_COUNT] = {
+        [OP_PUSH] = &&label_OP_PUSH,
+        [OP_PUSH_TRUE] = &&label_OP_PUSH_TRUE,
+        [OP_PUSH_FALSE] = &&label_OP_PUSH_FALSE,
+        [OP_PUSH_ARRAY] = &&label_OP_PUSH_ARRAY,
+        [OP_IADD] = &&label_OP_IADD,
+        [OP_IADDSTORE] = &&label_OP_IADDSTORE,
+        [OP_ISUB] = &&label_OP_ISUB,
+        [OP_ISUBSTORE] = &&label_OP_ISUBSTORE,
+        [OP_IMUL] = &&label_OP_IMUL,
+        [OP_IMULSTORE] = &&label_OP_IMULSTORE,
+        [OP_IDIV] = &&label_OP_IDIV,
+        [OP_IDIVSTORE] = &&label_OP_IDIVSTORE,
+        [OP_INEG] = &&label_OP_INEG,
+        [OP_IGT] = &&label_OP_IGT,
+        [OP_IGTE] = &&label_OP_IGTE,
+        [OP_ILT] = &&label_OP_ILT,
+        [OP_ILTE] = &&label_OP_ILTE,
+        [OP_IEQ] = &&label_OP_IEQ,
+        [OP_IMOD] = &&label_OP_IMOD,
+        [OP_BEQ] = &&label_OP_BEQ,
+        [OP_INEQ] = &&label_OP_INEQ,
+        [OP_BNEQ] = &&label_OP_BNEQ,
+        [OP_ISTORE] = &&label_OP_ISTORE,
+        [OP_ILOAD] = &&label_OP_ILOAD,
+        [OP_BSTORE] = &&label_OP_BSTORE,
+        [OP_BLOAD] = &&label_OP_BLOAD,
+        [OP_ARRSTORE] = &&label_OP_ARRSTORE,
+        [OP_ARRLOAD] = &&label_OP_ARRLOAD,
+        [OP_NOT] = &&label_OP_NOT,
+        [OP_JMPN] = &&label_OP_JMPN,
+        [OP_JMPT] = &&label_OP_JMPT,
+        [OP_JMP] = &&label_OP_JMP,
+        [OP_PUSH_STRING] = &&label_OP_PUSH_STRING,
+        [OP_SCONCAT] = &&label_OP_SCONCAT,
+        [OP_SSTORE] = &&label_OP_SSTORE,
+        [OP_SLOAD] = &&label_OP_SLOAD,
+        [OP_ARRLOADIDX] = &&label_OP_ARRLOADIDX,
+        [OP_ARRSTOREIDX] = &&label_OP_ARRSTOREIDX,
+        [OP_ARRAPPEND] = &&label_OP_ARRAPPEND,
+        [OP_PUSH_W] = &&label_OP_PUSH_W,
+        [OP_PUSH_STRING_W] = &&label_OP_PUSH_STRING_W,
+        [OP_PUSH_0] = &&label_OP_PUSH_0,
+        [OP_PUSH_1] = &&label_OP_PUSH_1,
+        [OP_PUSH_I8] = &&label_OP_PUSH_I8,
+        [OP_PUSH_I16] = &&label_OP_PUSH_I16,
+        [OP_IINC] = &&label_OP_IINC,
+        [OP_IGT_JMPN] = &&label_OP_IGT_JMPN,
+        [OP_IGTE_JMPN] = &&label_OP_IGTE_JMPN,
+        [OP_ILT_JMPN] = &&label_OP_ILT_JMPN,
+        [OP_ILTE_JMPN] = &&label_OP_ILTE_JMPN,
+        [OP_IEQ_JMPN] = &&label_OP_IEQ_JMPN,
+        [OP_INEQ_JMPN] = &&label_OP_INEQ_JMPN,
+        [OP_ILOAD_ILOAD_IADD] = &&label_OP_ILOAD_ILOAD_IADD,
+        [OP_ILOAD_PUSH_ILT] = &&label_OP_ILOAD_PUSH_ILT,
+        [OP_ISTORE_KEEP] = &&label_OP_ISTORE_KEEP,
+        [OP_POP] = &&label_OP_POP,
+        [OP_ISHR] = &&label_OP_ISHR,
+        [OP_IAND] = &&label_OP_IAND,
+        [OP_IDIV_NC] = &&label_OP_IDIV_NC,
+        [OP_IMOD_NC] = &&label_OP_IMOD_NC,
+        [OP_ARRLOADIDX_NC] = &&label_OP_ARRLOADIDX_NC,
+        [OP_ARRSTOREIDX_NC] = &&label_OP_ARRSTOREIDX_NC,
+        [OP_RESULT] = &&label_OP_RESULT,
+        [OP_HALT] = &&label_OP_HALT,
+    };
+    for (int i = 0; i <= vm->instr_count; i++) {
+        vm->instrs[i].handler = dispatch_table[vm->instrs[i].op];
+    }
+    // the switch is only ever jumped into
+    VM_DISPATCH();
+#endif
+    for (;;) {
+        instr = ip++;
+        vm->instruction_count++;
+
+        switch (instr->op) {
+            VM_CASE(OP_PUSH) {
+                StackValue value = vm->constants[instr->a];
+                PUSH(value);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_STRING) {
+                StackValue value = vm->constants[instr->a];
+                PUSH_REF(value);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_W) {
+                StackValue value = vm->constants[instr->a];
+                PUSH(value);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_STRING_W) {
+                StackValue value = vm->constants[instr->a];
+                PUSH_REF(value);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_TRUE) {
                 StackValue sv = {.type = bool_type, .bool_val = true};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_PUSH_FALSE: {
+            VM_CASE(OP_PUSH_FALSE) {
                 StackValue sv = {.type = bool_type, .bool_val = false};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_0) {
+                StackValue sv = {.type = int_type, .int_val = 0};
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_PUSH_ARRAY: {
-                int len = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
+            VM_CASE(OP_PUSH_1) {
+                StackValue sv = {.type = int_type, .int_val = 1};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_I8) {
+                StackValue sv = {.type = int_type, .int_val = instr->a};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_I16) {
+                StackValue sv = {.type = int_type, .int_val = instr->a};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_ARRAY) {
+                int len = instr->a;
 
                 ArrayValue* arrv = malloc(sizeof(ArrayValue));
                 arrv->len = len;
@@ -69,7 +434,7 @@ void vm_run(VM* vm) {
                 arrv->arr_val = malloc(sizeof(StackValue) * arrv->capacity);
 
                 for (int i = len - 1; i >= 0; i--) {
-                    StackValue val = stack_pop(&vm->stack);
+                    StackValue val = POP_REF();
                     arrv->arr_val[i] = val;
                 }
 
@@ -81,223 +446,329 @@ void vm_run(VM* vm) {
 
                 StackValue sv = {.type = arr_type, .array_val = arrv};
 
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH_REF(sv);
+                VM_NEXT();
             }
-            case OP_IADD: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_IADD) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = int_type, .int_val = a.int_val + b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_ISUB: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_ISUB) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = int_type, .int_val = a.int_val - b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_IMUL: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_IMUL) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = int_type, .int_val = a.int_val * b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_IDIV: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_IDIV) {
+                StackValue b = POP();
+                StackValue a = POP();
                 if (b.int_val == 0) {
                     fprintf(stderr, "runtime error: division by 0 not allowed\n");
                     exit(1);
                 }
-                StackValue sv = {.type = int_type, .int_val = a.int_val / b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
-            }
-            case OP_IADDSTORE: {
-                StackValue value = stack_pop(&vm->stack);
-                int slot = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
-
-                if (slot >= vm->locals_size) {
-                    fprintf(stderr, "invalid slot `%d` for locals\n", slot);
-                    exit(1);
-                }
-
+                // INT_MIN / -1 overflows like the other ops do, rather than trapping
+                int quotient = b.int_val == -1 ? (int) (0u - (uint32_t) a.int_val) : a.int_val / b.int_val;
+                StackValue sv = {.type = int_type, .int_val = quotient};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_IADDSTORE) {
+                StackValue value = POP();
+                int slot = instr->a;
                 vm->locals[slot].int_val += value.int_val;
-                break;
+                VM_NEXT();
             }
-            case OP_ISUBSTORE: {
-                StackValue value = stack_pop(&vm->stack);
-                int slot = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
-
-                if (slot >= vm->locals_size) {
-                    fprintf(stderr, "invalid slot `%d` for locals\n", slot);
-                    exit(1);
-                }
-
+            VM_CASE(OP_IINC) {
+                int slot = instr->a;
+                int k = instr->b;
+                vm->locals[slot].int_val += k;
+                VM_NEXT();
+            }
+            VM_CASE(OP_ISUBSTORE) {
+                StackValue value = POP();
+                int slot = instr->a;
                 vm->locals[slot].int_val -= value.int_val;
-                break;
+                VM_NEXT();
             }
-            case OP_IDIVSTORE: {
-                StackValue value = stack_pop(&vm->stack);
-                int slot = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
-
-                if (slot >= vm->locals_size) {
-                    fprintf(stderr, "invalid slot `%d` for locals\n", slot);
+            VM_CASE(OP_IDIVSTORE) {
+                StackValue value = POP();
+                int slot = instr->a;
+                if (value.int_val == 0) {
+                    fprintf(stderr, "runtime error: division by 0 not allowed\n");
                     exit(1);
                 }
-
-                vm->locals[slot].int_val /= value.int_val;
-                break;
+                int dividend = vm->locals[slot].int_val;
+                vm->locals[slot].int_val = value.int_val == -1 ? (int) (0u - (uint32_t) dividend) : dividend / value.int_val;
+                VM_NEXT();
             }
-            case OP_IMULSTORE: {
-                StackValue value = stack_pop(&vm->stack);
-                int slot = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
-
-                if (slot >= vm->locals_size) {
-                    fprintf(stderr, "invalid slot `%d` for locals\n", slot);
-                    exit(1);
-                }
-
+            VM_CASE(OP_IMULSTORE) {
+                StackValue value = POP();
+                int slot = instr->a;
                 vm->locals[slot].int_val *= value.int_val;
-                break;
+                VM_NEXT();
             }
-            case OP_IGT: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_IGT) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = a.int_val > b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_IGTE: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_IGTE) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = a.int_val >= b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_ILT: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_ILT) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = a.int_val < b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_ILTE: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_ILTE) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = a.int_val <= b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_IMOD: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_IMOD) {
+                StackValue b = POP();
+                StackValue a = POP();
                 if (b.int_val == 0) {
                     fprintf(stderr, "runtime error: division by 0 not allowed\n");
                     exit(1);
                 }
-                StackValue sv = {.type = int_type, .int_val = a.int_val % b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                StackValue sv = {.type = int_type, .int_val = b.int_val == -1 ? 0 : a.int_val % b.int_val};
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_IEQ: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_IEQ) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = a.int_val == b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_BEQ: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_BEQ) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = a.bool_val == b.bool_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_INEQ: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_INEQ) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = a.int_val != b.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_BNEQ: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_BNEQ) {
+                StackValue b = POP();
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = a.bool_val != b.bool_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_INEG: {
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_INEG) {
+                StackValue a = POP();
                 StackValue sv = {.type = int_type, .int_val = -a.int_val};
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_NOT:
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_NOT) {
+                StackValue a = POP();
                 StackValue sv = {.type = bool_type, .bool_val = !a.bool_val};
-                stack_push(&vm->stack, sv);
-                break;
-            case OP_BLOAD:
-            case OP_SLOAD:
-            case OP_ARRLOAD:
-            case OP_ILOAD: {
-                int slot = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
-                if (slot >= vm->locals_size) {
-                    fprintf(stderr, "invalid slot `%d` for locals\n", slot);
-                    exit(1);
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_BLOAD)
+            VM_CASE(OP_ILOAD) {
+                int slot = instr->a;
+                PUSH(vm->locals[slot]);
+                VM_NEXT();
+            }
+            VM_CASE(OP_SLOAD)
+            VM_CASE(OP_ARRLOAD) {
+                int slot = instr->a;
+                PUSH_REF(vm->locals[slot]);
+                VM_NEXT();
+            }
+            VM_CASE(OP_SSTORE) {
+                int slot = instr->a;
+                // the local takes over the stack's reference
+                StackValue value = POP();
+                release_local(&vm->locals[slot]);
+                vm->locals[slot] = value;
+                VM_NEXT();
+            }
+            VM_CASE(OP_BSTORE)
+            VM_CASE(OP_ISTORE) {
+                int slot = instr->a;
+                release_local(&vm->locals[slot]);
+                vm->locals[slot] = POP();
+                VM_NEXT();
+            }
+            VM_CASE(OP_ARRSTORE) {
+                int slot = instr->a;
+                release_local(&vm->locals[slot]);
+                vm->locals[slot] = POP_REF();
+                VM_NEXT();
+            }
+            VM_CASE(OP_ISTORE_KEEP) {
+                int slot = instr->a;
+                release_local(&vm->locals[slot]);
+                vm->locals[slot] = PEEK();
+                VM_NEXT();
+            }
+            VM_CASE(OP_JMP) {
+                ip = vm->instrs + instr->a;
+                VM_NEXT();
+            }
+            VM_CASE(OP_JMPN) {
+                StackValue sv = POP();
+                if (!sv.bool_val) {
+                    ip = vm->instrs + instr->a;
                 }
-                stack_push(&vm->stack, vm->locals[slot]);
-                break;
+                VM_NEXT();
             }
-            case OP_BSTORE:
-            case OP_SSTORE:
-            case OP_ARRSTORE:
-            case OP_ISTORE: {
-                int slot = (vm->code[vm->pc] << 8) | vm->code[vm->pc + 1];
-                vm->pc += 2;
-                if (slot >= vm->locals_size) {
-                    fprintf(stderr, "invalid slot `%d` for locals\n", slot);
-                    exit(1);
+            VM_CASE(OP_JMPT) {
+                StackValue sv = POP();
+                if (sv.bool_val) {
+                    ip = vm->instrs + instr->a;
                 }
-                vm->locals[slot] = stack_pop(&vm->stack);
-                break;
+                VM_NEXT();
+            }
+            VM_CASE(OP_POP)
+                POP_REF();
+                VM_NEXT();
+            VM_CASE(OP_RESULT) {
+                // the result takes over the stack's reference, like a local
+                StackValue value = POP();
+                release_local(&vm->result);
+                vm->result = value;
+                VM_NEXT();
+            }
+            VM_CASE(OP_ISHR) {
+                StackValue b = POP();
+                StackValue a = POP();
+                StackValue sv = {.type = int_type, .int_val = a.int_val >> (b.int_val & 31)};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_IAND) {
+                StackValue b = POP();
+                StackValue a = POP();
+                StackValue sv = {.type = int_type, .int_val = a.int_val & b.int_val};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_IDIV_NC) {
+                StackValue b = POP();
+                StackValue a = POP();
+                StackValue sv = {.type = int_type, .int_val = a.int_val / b.int_val};
+                PUSH(sv);
+                VM_NEXT();
             }
-            case OP_JMP: {
-                int steps = (int)(int16_t)(vm->code[vm->pc] << 8 | vm->code[vm->pc + 1]);
-                vm->pc += steps + 2; // steps and then the 2 for the actual step amount
-                break;
+            VM_CASE(OP_IMOD_NC) {
+                StackValue b = POP();
+                StackValue a = POP();
+                StackValue sv = {.type = int_type, .int_val = a.int_val % b.int_val};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_ARRLOADIDX_NC) {
+                StackValue array = POP_REF();
+                StackValue idx = POP();
+                PUSH_REF(array.array_val->arr_val[idx.int_val]);
+                VM_NEXT();
+            }
+            VM_CASE(OP_ARRSTOREIDX_NC) {
+                StackValue value = POP_REF();
+                StackValue array = POP_REF();
+                StackValue idx = POP();
+                array.array_val->arr_val[idx.int_val] = value;
+                VM_NEXT();
             }
-            case OP_JMPN: {
-                int steps = (int)(int16_t)(vm->code[vm->pc] << 8 | vm->code[vm->pc + 1]);
-                vm->pc += 2;
-                StackValue sv = stack_pop(&vm->stack);
-                if (!sv.bool_val) {
-                    vm->pc += steps;
+            VM_CASE(OP_IGT_JMPN) {
+                StackValue b = POP();
+                StackValue a = POP();
+                if (!(a.int_val > b.int_val)) {
+                    ip = vm->instrs + instr->a;
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_JMPT: {
-                int steps = (int)(int16_t)(vm->code[vm->pc] << 8 | vm->code[vm->pc + 1]);
-                vm->pc += 2;
-                StackValue sv = stack_pop(&vm->stack);
-                if (sv.bool_val) {
-                    vm->pc += steps;
+            VM_CASE(OP_IGTE_JMPN) {
+                StackValue b = POP();
+                StackValue a = POP();
+                if (!(a.int_val >= b.int_val)) {
+                    ip = vm->instrs + instr->a;
                 }
-                break;
+                VM_NEXT();
+            }
+            VM_CASE(OP_ILT_JMPN) {
+                StackValue b = POP();
+                StackValue a = POP();
+                if (!(a.int_val < b.int_val)) {
+                    ip = vm->instrs + instr->a;
+                }
+                VM_NEXT();
             }
-            case OP_SCONCAT: {
-                StackValue b = stack_pop(&vm->stack);
-                StackValue a = stack_pop(&vm->stack);
+            VM_CASE(OP_ILTE_JMPN) {
+                StackValue b = POP();
+                StackValue a = POP();
+                if (!(a.int_val <= b.int_val)) {
+                    ip = vm->instrs + instr->a;
+                }
+                VM_NEXT();
+            }
+            VM_CASE(OP_IEQ_JMPN) {
+                StackValue b = POP();
+                StackValue a = POP();
+                if (!(a.int_val == b.int_val)) {
+                    ip = vm->instrs + instr->a;
+                }
+                VM_NEXT();
+            }
+            VM_CASE(OP_INEQ_JMPN) {
+                StackValue b = POP();
+                StackValue a = POP();
+                if (!(a.int_val != b.int_val)) {
+                    ip = vm->instrs + instr->a;
+                }
+                VM_NEXT();
+            }
+            VM_CASE(OP_ILOAD_ILOAD_IADD) {
+                StackValue sv = {.type = int_type, .int_val = vm->locals[instr->a].int_val + vm->locals[instr->b].int_val};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_ILOAD_PUSH_ILT) {
+                int slot = instr->a;
+                int k = instr->b;
+                StackValue sv = {.type = bool_type, .bool_val = vm->locals[slot].int_val < k};
+                PUSH(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_SCONCAT) {
+                // read before popping, as popping drops the stack's reference & may free a temporary
+                StackValue b = sp[-1];
+                StackValue a = sp[-2];
 
                 size_t len_a = a.string_val->len;
                 size_t len_b = b.string_val->len;
@@ -314,46 +785,47 @@ void vm_run(VM* vm) {
                 memcpy(result + len_a, b.string_val->string_val, len_b);
                 result[len_a + len_b] = '\0';
 
-                decrement_ref(a.string_val);
-                decrement_ref(b.string_val);
+                POP_REF();
+                POP_REF();
 
                 StringValue* strv = malloc(sizeof(StringValue));
                 strv->string_val = result;
                 strv->len = len_result;
-                strv->ref_count = 1;
+                // the push below takes the only reference
+                strv->ref_count = 0;
 
                 StackValue sv = {.type=string_type, .string_val = strv};
 
-                stack_push(&vm->stack, sv);
-                break;
+                PUSH_REF(sv);
+                VM_NEXT();
             }
-            case OP_ARRLOADIDX: {
-                StackValue array = stack_pop(&vm->stack);
-                StackValue idx = stack_pop(&vm->stack);
-                if (idx.int_val >= array.array_val->len) {
+            VM_CASE(OP_ARRLOADIDX) {
+                StackValue array = POP_REF();
+                StackValue idx = POP();
+                if (idx.int_val < 0 || idx.int_val >= array.array_val->len) {
                     fprintf(stderr, "runtime error: idx %d oob on array of len %d\n", idx.int_val, array.array_val->len);
                     exit(1);
                 }
 
                 StackValue sv = array.array_val->arr_val[idx.int_val];
-                stack_push(&vm->stack, sv);
-                break;
-            }
-            case OP_ARRSTOREIDX: {
-                StackValue value = stack_pop(&vm->stack);
-                StackValue array = stack_pop(&vm->stack);
-                StackValue idx = stack_pop(&vm->stack);
-                if (idx.int_val >= array.array_val->len) {
+                PUSH_REF(sv);
+                VM_NEXT();
+            }
+            VM_CASE(OP_ARRSTOREIDX) {
+                StackValue value = POP_REF();
+                StackValue array = POP_REF();
+                StackValue idx = POP();
+                if (idx.int_val < 0 || idx.int_val >= array.array_val->len) {
                     fprintf(stderr, "runtime error: idx %d oob on array of len %d\n", idx.int_val, array.array_val->len);
                     exit(1);
                 }
 
                 array.array_val->arr_val[idx.int_val] = value;
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAPPEND: {
-                StackValue value = stack_pop(&vm->stack);
-                StackValue array = stack_pop(&vm->stack);
+            VM_CASE(OP_ARRAPPEND) {
+                StackValue value = POP_REF();
+                StackValue array = POP_REF();
 
                 if (array.array_val->len + 1 >= array.array_val->capacity) {
                     array.array_val->capacity *= 2;
@@ -366,26 +838,43 @@ void vm_run(VM* vm) {
                 }
 
                 array.array_val->arr_val[array.array_val->len++] = value;
-                stack_push(&vm->stack, array);
-                break;
-            }
+                PUSH_REF(array);
+                VM_NEXT();
+            }
+            VM_CASE(OP_HALT)
+                // not one of the program's instructions
+                vm->instruction_count--;
+                vm->pc = instr - vm->instrs;
+                vm->stack.top = sp - vm->stack.data - 1;
+                return;
             default:
-                fprintf(stderr, "unknown opcode: %d\n", instruction);
+                fprintf(stderr, "unknown opcode: %d at byte %d\n", instr->op, vm->offsets[instr - vm->instrs]);
                 exit(1);
         }
     }
 }
 
 void vm_free(VM* vm) {
+    // string constants can be on the stack more than once, so these are released by reference rather than free'd
     for (int i = 0; i <= vm->stack.top; i++) {
         if (vm->stack.data[i].type.base_type == VALUE_STRING && vm->stack.data[i].type.nested == -1) {
-            free(vm->stack.data[i].string_val->string_val);
-            free(vm->stack.data[i].string_val);
+            decrement_ref(vm->stack.data[i].string_val);
+        }
+    }
+    for (int i = 0; i < vm->locals_size; i++) {
+        release_local(&vm->locals[i]);
+    }
+    release_local(&vm->result);
+    for (int i = 0; i < vm->constants_size; i++) {
+        if (vm->constants[i].type.base_type == VALUE_STRING && vm->constants[i].type.nested == -1) {
+            decrement_ref(vm->constants[i].string_val);
         }
     }
 
     free(vm->constants);
     free(vm->locals);
     free(vm->code);
+    free(vm->instrs);
+    free(vm->offsets);
     free(vm->stack.data);
 }
@@ -5,8 +5,22 @@
 #include "bytecode_emit.h"
 #include "stack.h"
 
+// an instruction as vm_run executes it, decoded from the bytecode by vm_init so no operand bytes are read while running
 typedef struct {
+    // the label of its handler, bound by vm_run with threaded dispatch
+    const void* handler;
+    uint8_t op;
+    // slot, constant index, immediate or array length. for a jump, the index of the instruction it lands on
+    int a;
+    // the second slot or the immediate of the two operand instructions
+    int b;
+} VmInstr;
+
+typedef struct {
+    // sized by vm_init for the most values the verified code can have on it
     Stack stack;
+    // what the last OP_RESULT popped
+    StackValue result;
 
     StackValue* constants;
     int constants_size;
@@ -16,12 +30,28 @@ typedef struct {
 
     uint8_t* code;
     int code_size;
+    // decoded from code, ending with an OP_HALT
+    VmInstr* instrs;
+    int instr_count;
+    // the byte offset in code of each instruction, for diagnostics. the halt's is the code's size
+    int* offsets;
+    // index in instrs of the next instruction to run, up to date once vm_run returns
     int pc;
+
+    // instructions dispatched by vm_run, for benchmarking
+    long instruction_count;
 } VM;
 
+// exits with an error for code that doesn't verify: an unknown opcode or operand, a pop from an empty stack, or two
+// paths reaching an instruction with different numbers of values on the stack
 void vm_init(VM* vm, BytecodeEmitter* b, int num_locals);
+// runs words from bytecode_emit_words instead of b's code, which the vm still takes over along with the constants.
+// offsets are then byte offsets in words. the caller keeps & frees the words
+void vm_init_words(VM* vm, BytecodeEmitter* b, const uint32_t* words, int count, int num_locals);
 
 void vm_run(VM* vm);
+// "threaded" when vm_run was built with GRBLANG_THREADED_DISPATCH on a compiler that supports it, "switch" otherwise
+const char* vm_dispatch_name(void);
 
 // to be called after vm_run has finished execution
 void vm_free(VM* vm);